@@ -1,3 +1,4 @@
+import pyb
 from pyb import ADC, Pin, ADCALL
 
 adc0 = ADC(Pin.board.A4)
@@ -8,3 +9,13 @@ print(val)
 adc_all = ADCALL(12, 0x6000000)
 adc_all.read_core_temp()
 adc_all.read_core_vbat()
+
+# Free running window comparator, then back to single reads
+adc0.threshold(1000, 3000, 4, lambda status: print('threshold', status))
+pyb.delay(100)
+try:
+	adc0.read()
+except OSError as e:
+	print('read while watched:', e)
+adc0.threshold(None)
+print(adc0.read())
@@ -0,0 +1,29 @@
+from pyb import PWM
+from pyb import Pin
+import time
+
+# Motor mode duty check on two pairs given by their low side pins:
+# D13 (EPWM0 CH3, pair 1) and D11 (EPWM0 CH5, pair 2).
+# The low side is the complement of the high side duty, less the dead-time.
+
+def low_ratio(pin, samples = 2000):
+	high = 0
+	for i in range(samples):
+		high += pin.value()
+		time.sleep_us(7)
+	return high * 100 / samples
+
+epwm0 = PWM(0, PWM.EPWM, freq = 1000)
+epwm0.motor([Pin.board.D13, Pin.board.D11], deadtime = 500)
+epwm0.motor_duty(25, 75)
+time.sleep_ms(10)
+
+pair1 = low_ratio(Pin.board.D13)
+pair2 = low_ratio(Pin.board.D11)
+print('pair1 low side %d%%, pair2 low side %d%%' % (pair1, pair2))
+
+assert abs(pair1 - 75) < 5, 'pair 1 duty'
+assert abs(pair2 - 25) < 5, 'pair 2 duty'
+
+epwm0.deinit()
+print('PWM motor test passed')
@@ -0,0 +1,26 @@
+import sys
+import time
+
+# VCP console throughput. Run with the output captured on the host, e.g.
+#   mpremote run VCPBench.py > out.txt
+# Writes block while the host is slow, so the rate is the rate the host took.
+
+LINE = '0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ+/\n'
+TOTAL = 1024 * 1024
+
+def bench(chunk):
+	buf = LINE * (chunk // len(LINE))
+	count = TOTAL // len(buf)
+	start = time.ticks_ms()
+	for i in range(count):
+		sys.stdout.write(buf)
+	ms = time.ticks_diff(time.ticks_ms(), start)
+	return count * len(buf), ms
+
+results = []
+for chunk in (65, 650, 4096):
+	size, ms = bench(chunk)
+	results.append((chunk, size, ms))
+
+for chunk, size, ms in results:
+	print('write %5d bytes: %d bytes in %d ms, %d KB/s' % (chunk, size, ms, size * 1000 // (ms * 1024 or 1)))
@@ -7,6 +7,8 @@
  * @copyright (C) 2025 Nuvoton Technology Corp. All rights reserved.
  *****************************************************************************/
 
+#include <string.h>
+
 #include "py/mphal.h"
 
 #include "NuMicro.h"
@@ -18,8 +20,49 @@
 
 #define MAX_CANFD_INST 2
 
+#define CANFD_RXQ_INT_EVENT	(CANFD_IE_RF0NE_Msk | CANFD_IE_RF1NE_Msk)
+#define CANFD_TXQ_NONE		0xFFFF
+#define CANFD_MAX_TX_BUF	32
+
+#ifndef CANFD_SRAM_BASE_ADDR
+#define CANFD_SRAM_BASE_ADDR(psCanfd)	((uint32_t)(psCanfd) + 0x200)
+#endif
+
+//Data field size of RXESC/TXESC element size codes
+static const uint8_t s_au8ElemDataSize[8] = {8, 12, 16, 20, 24, 32, 48, 64};
+
 typedef struct nu_canfd_var {
     canfd_t *     obj;
+
+    canfd_rxslot_t *rxq_slots;			//receive queue, filled by the ISR
+    uint32_t    rxq_size;
+    volatile uint32_t rxq_head;			//written by ISR
+    volatile uint32_t rxq_tail;			//written by reader
+    volatile uint32_t rxq_overrun;
+
+    canfd_txslot_t *txq_slots;			//send queue, sorted by CAN ID priority
+    uint32_t    txq_size;
+    uint16_t    txq_head;				//first pending slot
+    uint16_t    txq_free;				//first free slot
+    uint32_t    txq_bufs;				//number of hardware Tx buffers
+    uint32_t    txq_busy;				//Tx buffers loaded from the queue
+    uint32_t    txq_stamp[CANFD_MAX_TX_BUF];	//queuing time of the frame in each Tx buffer
+    uint32_t    txq_bustime[CANFD_MAX_TX_BUF];	//bus time (ns) of the frame in each Tx buffer
+    CANFD_SendQueueStats_t txq_stats;
+
+    uint32_t    u32RxBufNum;			//dedicated Rx buffers in message RAM (RXBC region)
+    uint32_t    u32NormBitRate;
+    uint32_t    u32DataBitRate;
+    uint32_t    u32StatsStart;			//mp_hal_ticks_us() at start of counting window
+    CANFD_Stats_t stats;
+
+    PFN_CANFD_RECV_HOOK pfnRecvHook;	//protocol engine, see CANFD_SetProtocolHook()
+    PFN_CANFD_EVENT_HOOK pfnTxHook;
+    PFN_CANFD_EVENT_HOOK pfnTickHook;
+    void       *pvHookData;
+
+    PFN_CANFD_RECV_HOOK pfnDecodeHook;	//signal decoder, see CANFD_SetDecodeHook()
+    void       *pvDecodeData;
 } s_nu_canfd_var;
 
 static struct nu_canfd_var canfd0_var = {
@@ -37,6 +80,173 @@ static const struct nu_modinit_s canfd_modinit_tab[] = {
     {0, 0, 0, 0, 0, (IRQn_Type) 0, NULL}
 };
 
+typedef struct {
+    uint32_t u32Brp;
+    uint32_t u32Tseg1;		//propagation + phase segment 1, in time quanta
+    uint32_t u32Tseg2;
+    uint32_t u32Sjw;
+} canfd_bittiming_t;
+
+typedef struct {
+    uint32_t u32BrpMax;
+    uint32_t u32Tseg1Min;
+    uint32_t u32Tseg1Max;
+    uint32_t u32Tseg2Min;
+    uint32_t u32Tseg2Max;
+} canfd_bittiming_limit_t;
+
+static const canfd_bittiming_limit_t s_sNormTimingLimit = {512, 2, 256, 2, 128};
+static const canfd_bittiming_limit_t s_sDataTimingLimit = {32, 1, 32, 1, 16};
+
+//CiA 601-3 recommended sample points
+static uint32_t CANFD_DefaultSamplePoint(
+    uint32_t u32BitRate,
+    bool bDataPhase
+)
+{
+    if(bDataPhase)
+        return (u32BitRate > 2000000) ? 750 : 800;
+
+    if(u32BitRate > 800000)
+        return 750;
+    if(u32BitRate > 500000)
+        return 800;
+    return 875;
+}
+
+//Find the timing closest to u32SamplePoint (per mille), the smallest prescaler wins among equals
+static int32_t CANFD_CalcBitTiming(
+    uint32_t u32Clock,
+    uint32_t u32BitRate,
+    uint32_t u32SamplePoint,
+    const canfd_bittiming_limit_t *psLimit,
+    canfd_bittiming_t *psTiming
+)
+{
+    uint32_t u32BestErr = UINT32_MAX;
+    uint32_t u32Brp;
+
+    if(u32BitRate == 0)
+        return -1;
+
+    for(u32Brp = 1; u32Brp <= psLimit->u32BrpMax; u32Brp ++) {
+        uint32_t u32Tq, u32Tseg1, u32Tseg2, u32Err;
+
+        if(u32Clock % (u32Brp * u32BitRate))
+            continue;
+
+        u32Tq = u32Clock / (u32Brp * u32BitRate);
+        if(u32Tq < (1 + psLimit->u32Tseg1Min + psLimit->u32Tseg2Min))
+            break;
+        if(u32Tq > (1 + psLimit->u32Tseg1Max + psLimit->u32Tseg2Max))
+            continue;
+
+        // Sample point is after sync segment and tseg1
+        u32Tseg1 = ((u32Tq * u32SamplePoint + 500) / 1000) - 1;
+        if(u32Tseg1 < psLimit->u32Tseg1Min)
+            u32Tseg1 = psLimit->u32Tseg1Min;
+        if(u32Tseg1 > psLimit->u32Tseg1Max)
+            u32Tseg1 = psLimit->u32Tseg1Max;
+
+        u32Tseg2 = u32Tq - 1 - u32Tseg1;
+        if(u32Tseg2 < psLimit->u32Tseg2Min) {
+            u32Tseg2 = psLimit->u32Tseg2Min;
+            u32Tseg1 = u32Tq - 1 - u32Tseg2;
+        }
+        if((u32Tseg2 > psLimit->u32Tseg2Max) || (u32Tseg1 > psLimit->u32Tseg1Max) || (u32Tseg1 < psLimit->u32Tseg1Min))
+            continue;
+
+        u32Err = ((1 + u32Tseg1) * 1000) / u32Tq;
+        u32Err = (u32Err > u32SamplePoint) ? (u32Err - u32SamplePoint) : (u32SamplePoint - u32Err);
+
+        if(u32Err < u32BestErr) {
+            u32BestErr = u32Err;
+            psTiming->u32Brp = u32Brp;
+            psTiming->u32Tseg1 = u32Tseg1;
+            psTiming->u32Tseg2 = u32Tseg2;
+            psTiming->u32Sjw = u32Tseg2;
+        }
+    }
+
+    return (u32BestErr == UINT32_MAX) ? -1 : 0;
+}
+
+//CAN FD clock is APLL0/2 (see canfd_modinit_tab)
+static uint32_t CANFD_GetClockFreq(void)
+{
+    return CLK_GetAPLLClockFreq(CLK_APLL0_SELECT) / 2;
+}
+
+//Program nominal/data bit timing and transmitter delay compensation, module in init mode
+static int32_t CANFD_SetBitTiming(
+    CANFD_T *canfd,
+    CANFD_InitTypeDef *psInitDef
+)
+{
+    uint32_t u32Clock = CANFD_GetClockFreq();
+    canfd_bittiming_t sNorm;
+    canfd_bittiming_t sData;
+    uint32_t u32SamplePoint;
+
+    u32SamplePoint = psInitDef->NormalSamplePoint ? psInitDef->NormalSamplePoint : CANFD_DefaultSamplePoint(psInitDef->NormalBitRate, false);
+    if(CANFD_CalcBitTiming(u32Clock, psInitDef->NormalBitRate, u32SamplePoint, &s_sNormTimingLimit, &sNorm) != 0)
+        return -2;
+
+    canfd->CCCR |= CANFD_CCCR_INIT_Msk;
+    while(!(canfd->CCCR & CANFD_CCCR_INIT_Msk));
+    canfd->CCCR |= CANFD_CCCR_CCE_Msk;
+
+    /* Timestamp counter counts nominal bit times */
+    canfd->TSCC = (0 << CANFD_TSCC_TCP_Pos) | (1 << CANFD_TSCC_TSS_Pos);
+
+    /* Timeout counter reloads every CANFD_TICK_US in continuous mode, the protocol engine tick */
+    uint32_t u32TickBits = (uint32_t)(((uint64_t)psInitDef->NormalBitRate * CANFD_TICK_US) / 1000000);
+    if(u32TickBits == 0)
+        u32TickBits = 1;
+    canfd->TOCC = (u32TickBits << CANFD_TOCC_TOP_Pos) | CANFD_TOCC_ETOC_Msk;
+
+    canfd->NBTP = ((sNorm.u32Sjw - 1) << CANFD_NBTP_NSJW_Pos) |
+                  ((sNorm.u32Brp - 1) << CANFD_NBTP_NBRP_Pos) |
+                  ((sNorm.u32Tseg1 - 1) << CANFD_NBTP_NTSEG1_Pos) |
+                  ((sNorm.u32Tseg2 - 1) << CANFD_NBTP_NTSEG2_Pos);
+
+    if(!psInitDef->FDMode) {
+        canfd->CCCR &= ~(CANFD_CCCR_FDOE_Msk | CANFD_CCCR_BRSE_Msk);
+        return 0;
+    }
+
+    if(!psInitDef->BitRateSwitch) {
+        canfd->CCCR = (canfd->CCCR & ~CANFD_CCCR_BRSE_Msk) | CANFD_CCCR_FDOE_Msk;
+        return 0;
+    }
+
+    u32SamplePoint = psInitDef->DataSamplePoint ? psInitDef->DataSamplePoint : CANFD_DefaultSamplePoint(psInitDef->DataBitRate, true);
+    if(CANFD_CalcBitTiming(u32Clock, psInitDef->DataBitRate, u32SamplePoint, &s_sDataTimingLimit, &sData) != 0)
+        return -2;
+
+    uint32_t u32DBTP = ((sData.u32Brp - 1) << CANFD_DBTP_DBRP_Pos) |
+                       ((sData.u32Tseg1 - 1) << CANFD_DBTP_DTSEG1_Pos) |
+                       ((sData.u32Tseg2 - 1) << CANFD_DBTP_DTSEG2_Pos) |
+                       ((sData.u32Sjw - 1) << CANFD_DBTP_DSJW_Pos);
+
+    // Above 1 Mbit/s the transceiver loop delay exceeds the data phase sample point, sample the
+    // transmitted bits at the secondary sample point: the data sample point in CAN clocks plus the measured delay
+    if((psInitDef->DataBitRate > 1000000) && (sData.u32Brp <= 2)) {
+        uint32_t u32Tdco = sData.u32Brp * (1 + sData.u32Tseg1);
+
+        if(u32Tdco > 127)
+            u32Tdco = 127;
+
+        canfd->TDCR = (u32Tdco << CANFD_TDCR_TDCO_Pos);
+        u32DBTP |= CANFD_DBTP_TDC_Msk;
+    }
+
+    canfd->DBTP = u32DBTP;
+    canfd->CCCR |= (CANFD_CCCR_FDOE_Msk | CANFD_CCCR_BRSE_Msk);
+
+    return 0;
+}
+
 int32_t CANFD_Init(
     canfd_t *psCANFDObj,
     CANFD_InitTypeDef *psInitDef
@@ -47,9 +257,19 @@ int32_t CANFD_Init(
     if(modinit == NULL)
         return -1;
 
+    struct nu_canfd_var *var = (struct nu_canfd_var *) modinit->var;
+
     // Reset this module
     SYS_ResetModule(modinit->rsetidx);
 
+    var->obj = psCANFDObj;
+    var->rxq_slots = NULL;
+    var->txq_slots = NULL;
+    var->u32NormBitRate = psInitDef->NormalBitRate;
+    var->u32DataBitRate = (psInitDef->FDMode && psInitDef->BitRateSwitch) ? psInitDef->DataBitRate : psInitDef->NormalBitRate;
+    memset(&var->stats, 0, sizeof(var->stats));
+    var->u32StatsStart = mp_hal_ticks_us();
+
     /* Select CAN FD0 clock source is APLL0/2 */
     CLK_SetModuleClock(modinit->clkidx, modinit->clksrc, modinit->clkdiv);
     CLK_EnableModuleClock(modinit->clkidx);
@@ -62,13 +282,24 @@ int32_t CANFD_Init(
     sCANFD_Config.sElemSize.u32UserDef = 0;
     /* Get the CAN FD configuration value */
     CANFD_GetDefaultConfig(&sCANFD_Config, psInitDef->FDMode);
+    var->u32RxBufNum = sCANFD_Config.sElemSize.u32RxBuf;
     sCANFD_Config.sBtConfig.bEnableLoopBack = psInitDef->LoopBack;
     sCANFD_Config.sBtConfig.sNormBitRate.u32BitRate = psInitDef->NormalBitRate;
     sCANFD_Config.sBtConfig.sDataBitRate.u32BitRate = psInitDef->DataBitRate;
+    sCANFD_Config.sBtConfig.bBitRateSwitch = (psInitDef->FDMode && psInitDef->BitRateSwitch);
 
     /* Open the CAN FD feature */
     CANFD_Open(psCANFDObj->canfd, &sCANFD_Config);
 
+    /* Replace the BSP timing by the one at the requested sample points */
+    if(CANFD_SetBitTiming(psCANFDObj->canfd, psInitDef) != 0) {
+        CANFD_Close(psCANFDObj->canfd);
+        NVIC_DisableIRQ(modinit->irq_n);
+        CLK_DisableModuleClock(modinit->clkidx);
+        var->obj = NULL;
+        return -2;
+    }
+
     /* CAN FD Run to Normal mode */
     CANFD_RunToNormal(psCANFDObj->canfd, TRUE);
 
@@ -84,18 +315,31 @@ void CANFD_Final(
     if(modinit == NULL)
         return;
 
-    /* Enable I2C0 module clock */
-    CLK_DisableModuleClock(modinit->clkidx);
+    struct nu_canfd_var *var = (struct nu_canfd_var *) modinit->var;
+
     NVIC_DisableIRQ(modinit->irq_n);
+    var->rxq_slots = NULL;
+    var->txq_slots = NULL;
+    var->pfnRecvHook = NULL;
+    var->pfnTxHook = NULL;
+    var->pfnTickHook = NULL;
+    var->pfnDecodeHook = NULL;
+    var->obj = NULL;
+    psCANFDObj->pfnStatusHandler = NULL;
 
     /* CAN FD Run to Normal mode */
     CANFD_RunToNormal(psCANFDObj->canfd, FALSE);
 
-    uint32_t u32INTMask = CANFD_IE_BOE_Msk | CANFD_IE_EWE_Msk | CANFD_IE_EPE_Msk;
+    uint32_t u32INTMask = CANFD_IE_BOE_Msk | CANFD_IE_EWE_Msk | CANFD_IE_EPE_Msk |
+                          CANFD_RXQ_INT_EVENT | CANFD_IE_TCE_Msk | CANFD_IE_TOOE_Msk;
 
     CANFD_DisableInt(psCANFDObj->canfd, u32INTMask, u32INTMask, 0xFFFFFFFF, 0xFFFFFFFF);
 
     CANFD_Close(psCANFDObj->canfd);
+
+    /* Disable CANFD module clock */
+    CLK_DisableModuleClock(modinit->clkidx);
+
     psCANFDObj->i32FIFOIdx = -1;
     psCANFDObj->u32StdFilterIdx = 0;
     psCANFDObj->u32ExtFilterIdx = 0;
@@ -126,9 +370,9 @@ uint32_t CANFD_AmountDataRecv(
         return 0;
 
     if(psCANFDObj->i32FIFOIdx == 0) {
-        u32RecvData = ((psCANFDObj->canfd->RXF0C & CANFD_RXF0S_F0FL_Msk) >> CANFD_RXF0S_F0FL_Pos);
+        u32RecvData = ((psCANFDObj->canfd->RXF0S & CANFD_RXF0S_F0FL_Msk) >> CANFD_RXF0S_F0FL_Pos);
     } else if(psCANFDObj->i32FIFOIdx == 1) {
-        u32RecvData = ((psCANFDObj->canfd->RXF1C & CANFD_RXF1S_F1FL_Msk) >> CANFD_RXF1S_F1FL_Pos);
+        u32RecvData = ((psCANFDObj->canfd->RXF1S & CANFD_RXF1S_F1FL_Msk) >> CANFD_RXF1S_F1FL_Pos);
     }
 
     return u32RecvData;
@@ -148,7 +392,7 @@ int32_t CANFD_SetRecvFilter(
         return -1;
 
     /* Reject Non-Matching Standard ID and Extended ID Filter(RX fifo1) */
-    CANFD_SetGFC(CANFD0, eCANFD_REJ_NON_MATCH_FRM, eCANFD_REJ_NON_MATCH_FRM, 1, 1);
+    CANFD_SetGFC(psCANFDObj->canfd, eCANFD_REJ_NON_MATCH_FRM, eCANFD_REJ_NON_MATCH_FRM, 1, 1);
 
     if(psCANFDObj->canfd == CANFD0) {
         if(eIDType == eCANFD_SID) {
@@ -176,6 +420,243 @@ int32_t CANFD_SetRecvFilter(
 }
 
 
+//Filter element configuration field (SFEC/EFEC) of each CANFD_FILTER_TO_xxx
+static const uint8_t s_au8FilterElemConfig[] = {
+    1,		//store in Rx FIFO 0
+    2,		//store in Rx FIFO 1
+    3,		//reject
+    7,		//store into Rx buffer
+};
+
+int32_t CANFD_SetRecvFilterTable(
+    canfd_t *psCANFDObj,
+    const canfd_filter_t *psFilters,
+    uint32_t u32Count,
+    uint32_t u32NonMatch
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psCANFDObj->canfd, canfd_modinit_tab);
+
+    if(modinit == NULL)
+        return -1;
+
+    struct nu_canfd_var *var = (struct nu_canfd_var *) modinit->var;
+    CANFD_T *canfd = psCANFDObj->canfd;
+    uint32_t u32StdMax = (canfd->SIDFC & CANFD_SIDFC_LSS_Msk) >> CANFD_SIDFC_LSS_Pos;
+    uint32_t u32ExtMax = (canfd->XIDFC & CANFD_XIDFC_LSE_Msk) >> CANFD_XIDFC_LSE_Pos;
+    uint32_t u32StdIdx = 0;
+    uint32_t u32ExtIdx = 0;
+    int32_t i32FIFOIdx = -1;
+    uint32_t u32Primask;
+    uint32_t i;
+    const E_CANFD_ACC_NON_MATCH_FRM aeNonMatch[] = {
+        eCANFD_ACC_NON_MATCH_FRM_RX_FIFO0,
+        eCANFD_ACC_NON_MATCH_FRM_RX_FIFO1,
+        eCANFD_REJ_NON_MATCH_FRM,
+    };
+
+    if(u32NonMatch > CANFD_FILTER_REJECT)
+        return -1;
+
+    for(i = 0; i < u32Count; i ++) {
+        if((psFilters[i].u8Type > CANFD_FILTER_MASK) || (psFilters[i].u8Target > CANFD_FILTER_TO_RXBUF))
+            return -1;
+
+        if((psFilters[i].u8Target == CANFD_FILTER_TO_RXBUF) && (psFilters[i].u8RxBufIdx >= var->u32RxBufNum))
+            return -3;
+
+        if(psFilters[i].bExtId)
+            u32ExtIdx ++;
+        else
+            u32StdIdx ++;
+
+        if((i32FIFOIdx < 0) && (psFilters[i].u8Target <= CANFD_FILTER_TO_FIFO1))
+            i32FIFOIdx = psFilters[i].u8Target;
+    }
+
+    if((u32StdIdx > u32StdMax) || (u32ExtIdx > u32ExtMax))
+        return -2;
+
+    u32Primask = __get_PRIMASK();
+    __disable_irq();
+
+    // Frames on the bus meanwhile are lost, the node joins again after 11 recessive bits
+    canfd->CCCR |= CANFD_CCCR_INIT_Msk;
+    while(!(canfd->CCCR & CANFD_CCCR_INIT_Msk));
+    canfd->CCCR |= CANFD_CCCR_CCE_Msk;
+
+    u32StdIdx = 0;
+    u32ExtIdx = 0;
+
+    for(i = 0; i < u32Count; i ++) {
+        const canfd_filter_t *psFilter = &psFilters[i];
+        uint32_t u32Config = s_au8FilterElemConfig[psFilter->u8Target];
+        uint32_t u32Id2 = psFilter->u32Id2;
+
+        // Rx buffer elements match u32Id1 exactly, the buffer index is in the ID2 field
+        if(psFilter->u8Target == CANFD_FILTER_TO_RXBUF)
+            u32Id2 = psFilter->u8RxBufIdx;
+
+        if(psFilter->bExtId) {
+            // EFT range without XIDAM (3), dual (1), classic mask (2)
+            uint32_t u32Type = (psFilter->u8Type == CANFD_FILTER_RANGE) ? 3 : psFilter->u8Type;
+
+            CANFD_SetXIDFltr(canfd, u32ExtIdx ++,
+                             (u32Config << 29) | (psFilter->u32Id1 & 0x1FFFFFFF),
+                             (u32Type << 30) | (u32Id2 & 0x1FFFFFFF));
+        } else {
+            CANFD_SetSIDFltr(canfd, u32StdIdx ++,
+                             ((uint32_t)psFilter->u8Type << 30) | (u32Config << 27) |
+                             ((psFilter->u32Id1 & 0x7FF) << 16) | (u32Id2 & 0x7FF));
+        }
+    }
+
+    psCANFDObj->u32StdFilterIdx = u32StdIdx;
+    psCANFDObj->u32ExtFilterIdx = u32ExtIdx;
+
+    // Unused elements are disabled (SFEC/EFEC = 0)
+    while(u32StdIdx < u32StdMax)
+        CANFD_SetSIDFltr(canfd, u32StdIdx ++, 0);
+    while(u32ExtIdx < u32ExtMax)
+        CANFD_SetXIDFltr(canfd, u32ExtIdx ++, 0, 0);
+
+    CANFD_SetGFC(canfd, aeNonMatch[u32NonMatch], aeNonMatch[u32NonMatch], 1, 1);
+
+    canfd->CCCR &= ~CANFD_CCCR_CCE_Msk;
+    canfd->CCCR &= ~CANFD_CCCR_INIT_Msk;
+
+    __set_PRIMASK(u32Primask);
+
+    // recv() without receive queue reads the FIFO of the first storing filter
+    if(i32FIFOIdx < 0)
+        i32FIFOIdx = (u32NonMatch == CANFD_FILTER_REJECT) ? 0 : u32NonMatch;
+    psCANFDObj->i32FIFOIdx = i32FIFOIdx;
+
+    return 0;
+}
+
+int32_t CANFD_RecvBufMsg(
+    canfd_t *psCANFDObj,
+    uint32_t u32BufIdx,
+    CANFD_FD_MSG_T *psMsgFrame
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psCANFDObj->canfd, canfd_modinit_tab);
+
+    if(modinit == NULL)
+        return -1;
+
+    struct nu_canfd_var *var = (struct nu_canfd_var *) modinit->var;
+
+    if(u32BufIdx >= var->u32RxBufNum)
+        return -1;
+
+    if(CANFD_ReadRxBufMsg(psCANFDObj->canfd, u32BufIdx, psMsgFrame) == 0)
+        return -2;
+
+    return 0;
+}
+
+uint32_t CANFD_GetRxBufCount(
+    canfd_t *psCANFDObj
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psCANFDObj->canfd, canfd_modinit_tab);
+
+    if(modinit == NULL)
+        return 0;
+
+    return ((struct nu_canfd_var *) modinit->var)->u32RxBufNum;
+}
+
+//Bus time of a frame in ns, stuff bits are not counted
+static uint32_t CANFD_FrameBusTime(
+    struct nu_canfd_var *var,
+    const CANFD_FD_MSG_T *psMsg
+)
+{
+    uint32_t u32ArbBits;
+    uint32_t u32DataBits;
+    uint32_t u32DataRate = var->u32NormBitRate;
+
+    if(var->u32NormBitRate == 0)
+        return 0;
+
+    if(!psMsg->bFDFormat) {
+        // SOF, ID, RTR/IDE/r0 (+SRR/IDE/ID extension), DLC, data, CRC 15 + delimiter, ACK 2, EOF 7, IFS 3
+        u32ArbBits = ((psMsg->eIdType == eCANFD_XID) ? 67 : 47);
+        if(psMsg->eFrmType != eCANFD_REMOTE_FRM)
+            u32ArbBits += psMsg->u32DLC * 8;
+        return (uint32_t)(((uint64_t)u32ArbBits * 1000000000UL) / var->u32NormBitRate);
+    }
+
+    // Nominal rate: SOF to BRS, CRC delimiter to IFS. Data rate if switched: ESI, DLC, data, stuff count, CRC 17/21
+    u32ArbBits = ((psMsg->eIdType == eCANFD_XID) ? 36 : 17) + 13;
+    u32DataBits = 1 + 4 + (psMsg->u32DLC * 8) + 4 + ((psMsg->u32DLC > 16) ? 21 : 17);
+
+    if(psMsg->bBitRateSwitch)
+        u32DataRate = var->u32DataBitRate;
+
+    return (uint32_t)(((uint64_t)u32ArbBits * 1000000000UL) / var->u32NormBitRate +
+                      ((uint64_t)u32DataBits * 1000000000UL) / u32DataRate);
+}
+
+//Account a frame in the statistics, interrupt disabled or in interrupt context
+static void CANFD_StatsAddFrame(
+    struct nu_canfd_var *var,
+    uint32_t u32BusTimeNs,
+    uint32_t u32Stamp,
+    bool bTx
+)
+{
+    if(bTx) {
+        var->stats.u32TxFrames ++;
+        var->stats.u32LastTxStamp = u32Stamp;
+    } else {
+        var->stats.u32RxFrames ++;
+        var->stats.u32LastRxStamp = u32Stamp;
+    }
+
+    var->stats.u64BusTimeNs += u32BusTimeNs;
+}
+
+//Timestamp of the oldest frame of RX FIFO u32FIFOIdx, converted to mp_hal_ticks_us() time base.
+//The RXTS field of the element is read from message RAM, the BSP frame read does not return it.
+//Also records the FIFO fill level high-water mark.
+static uint32_t CANFD_RxFifoStamp(
+    struct nu_canfd_var *var,
+    uint32_t u32FIFOIdx
+)
+{
+    CANFD_T *canfd = var->obj->canfd;
+    uint32_t u32Now = mp_hal_ticks_us();
+    uint32_t u32TSC = canfd->TSCV & 0xFFFF;
+    // RXF0S/RXF1S and RXF0C/RXF1C share the same layout
+    uint32_t u32Status = u32FIFOIdx ? canfd->RXF1S : canfd->RXF0S;
+    uint32_t u32Config = u32FIFOIdx ? canfd->RXF1C : canfd->RXF0C;
+    uint32_t u32Fill = (u32Status & CANFD_RXF0S_F0FL_Msk) >> CANFD_RXF0S_F0FL_Pos;
+    uint32_t u32GetIdx = (u32Status & CANFD_RXF0S_F0GI_Msk) >> CANFD_RXF0S_F0GI_Pos;
+    uint32_t u32ElemSize = 8 + s_au8ElemDataSize[(canfd->RXESC >> (u32FIFOIdx ? 4 : 0)) & 0x7];
+    uint32_t u32Elem = CANFD_SRAM_BASE_ADDR(canfd) + (u32Config & CANFD_RXF0C_F0SA_Msk) + u32GetIdx * u32ElemSize;
+    uint32_t u32Age;
+
+    if(u32FIFOIdx) {
+        if(u32Fill > var->stats.u32Fifo1Max)
+            var->stats.u32Fifo1Max = u32Fill;
+    } else {
+        if(u32Fill > var->stats.u32Fifo0Max)
+            var->stats.u32Fifo0Max = u32Fill;
+    }
+
+    if((u32Fill == 0) || (var->u32NormBitRate == 0))
+        return u32Now;
+
+    // Element word 1 bits 15:0 hold RXTS, counter wraps after 65536 bit times
+    u32Age = (u32TSC - ((*(volatile uint32_t *)(u32Elem + 4)) & 0xFFFF)) & 0xFFFF;
+
+    return u32Now - (uint32_t)(((uint64_t)u32Age * 1000000UL) / var->u32NormBitRate);
+}
+
 //Reture available message object index. available: 0~31
 int32_t CANFD_GetFreeMsgObjIdx(
     canfd_t *psCANFDObj,
@@ -212,7 +693,8 @@ int32_t CANFD_GetFreeMsgObjIdx(
 int32_t CANFD_RecvMsg(
     canfd_t *psCANFDObj,
     CANFD_FD_MSG_T	*psMsgFrame,
-    uint32_t u32Timeout		//millisecond
+    uint32_t u32Timeout,		//millisecond
+    uint32_t *pu32Stamp
 )
 {
     const struct nu_modinit_s *modinit = get_modinit((uint32_t)psCANFDObj->canfd, canfd_modinit_tab);
@@ -220,6 +702,13 @@ int32_t CANFD_RecvMsg(
     if(modinit == NULL)
         return -1;
 
+    struct nu_canfd_var *var = (struct nu_canfd_var *) modinit->var;
+    uint32_t u32Primask;
+    uint32_t u32Stamp;
+
+    if(var->obj == NULL)
+        return -1;
+
 
     uint32_t u32EndTick = mp_hal_ticks_ms() + u32Timeout;
     uint32_t u32TotalMsg = 0;
@@ -237,12 +726,92 @@ int32_t CANFD_RecvMsg(
     if(u32TotalMsg <= 0)
         return -2;		//Timeout
 
-    if(CANFD_ReadRxFifoMsg(CANFD0, psCANFDObj->i32FIFOIdx, psMsgFrame) == 0)
+    u32Primask = __get_PRIMASK();
+    __disable_irq();
+
+    u32Stamp = CANFD_RxFifoStamp(var, psCANFDObj->i32FIFOIdx);
+
+    if(CANFD_ReadRxFifoMsg(psCANFDObj->canfd, psCANFDObj->i32FIFOIdx, psMsgFrame) == 0) {
+        __set_PRIMASK(u32Primask);
         return -3;		//Rx FIFI empty
+    }
+
+    CANFD_StatsAddFrame(var, CANFD_FrameBusTime(var, psMsgFrame), u32Stamp, false);
+    __set_PRIMASK(u32Primask);
+
+    if(pu32Stamp)
+        *pu32Stamp = u32Stamp;
 
     return 0;
 }
 
+//Send message by Tx buffer u32BufIdx
+int32_t CANFD_SendMsg(
+    canfd_t *psCANFDObj,
+    uint32_t u32BufIdx,
+    CANFD_FD_MSG_T *psMsgFrame
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psCANFDObj->canfd, canfd_modinit_tab);
+
+    if(modinit == NULL)
+        return -1;
+
+    struct nu_canfd_var *var = (struct nu_canfd_var *) modinit->var;
+    uint32_t u32Primask;
+
+    if(CANFD_TransmitTxMsg(psCANFDObj->canfd, u32BufIdx, psMsgFrame) != eCANFD_TRANSMIT_SUCCESS)
+        return -2;
+
+    // Counted when requested, direct sends have no completion interrupt
+    u32Primask = __get_PRIMASK();
+    __disable_irq();
+    CANFD_StatsAddFrame(var, CANFD_FrameBusTime(var, psMsgFrame), mp_hal_ticks_us(), true);
+    __set_PRIMASK(u32Primask);
+
+    return 0;
+}
+
+void CANFD_GetStats(
+    canfd_t *psCANFDObj,
+    CANFD_Stats_t *psStats,
+    bool bRestart
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psCANFDObj->canfd, canfd_modinit_tab);
+
+    memset(psStats, 0, sizeof(CANFD_Stats_t));
+
+    if(modinit == NULL)
+        return;
+
+    struct nu_canfd_var *var = (struct nu_canfd_var *) modinit->var;
+    // CEL is cleared by reading ECR
+    uint32_t u32CEL = (psCANFDObj->canfd->ECR & CANFD_ECR_CEL_Msk) >> CANFD_ECR_CEL_Pos;
+    uint32_t u32Now = mp_hal_ticks_us();
+    uint32_t u32Primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    var->stats.u32ErrLogCount += u32CEL;
+    var->stats.u32WindowUs = u32Now - var->u32StatsStart;
+    memcpy(psStats, &var->stats, sizeof(CANFD_Stats_t));
+
+    if(bRestart) {
+        var->stats.u32RxFrames = 0;
+        var->stats.u32TxFrames = 0;
+        var->stats.u64BusTimeNs = 0;
+        var->stats.u32Fifo0Max = 0;
+        var->stats.u32Fifo1Max = 0;
+        var->stats.u32RxQueueMax = 0;
+        var->stats.u32RxOverrun = 0;
+        var->stats.u32ErrLogCount = 0;
+        var->u32StatsStart = u32Now;
+    }
+
+    __set_PRIMASK(u32Primask);
+}
+
 //Enable status interrupt
 int32_t CANFD_EnableStatusInt(
     canfd_t *psCANFDObj,
@@ -279,10 +848,484 @@ void CANFD_DisableStatusInt(
 
     struct nu_canfd_var *var = (struct nu_canfd_var *) modinit->var;
 
+    // Receive queue, protocol engine and signal decoder keep their interrupts
+    if((var->rxq_slots) || (var->pfnRecvHook) || (var->pfnDecodeHook))
+        u32INTMask &= ~CANFD_RXQ_INT_EVENT;
+
+    // Send queue is refilled from the transmission completed interrupt
+    if(var->txq_slots)
+        u32INTMask &= ~CANFD_IE_TCE_Msk;
+
     CANFD_DisableInt(psCANFDObj->canfd, u32INTMask, 0, 0, 0);
-    NVIC_DisableIRQ(modinit->irq_n);
     psCANFDObj->pfnStatusHandler = NULL;
-    var->obj = NULL;
+}
+
+int32_t CANFD_EnableRecvQueue(
+    canfd_t *psCANFDObj,
+    canfd_rxslot_t *psSlots,
+    uint32_t u32Slots
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psCANFDObj->canfd, canfd_modinit_tab);
+
+    if((modinit == NULL) || (psSlots == NULL) || (u32Slots < 2))
+        return -1;
+
+    struct nu_canfd_var *var = (struct nu_canfd_var *) modinit->var;
+
+    CANFD_DisableInt(psCANFDObj->canfd, CANFD_RXQ_INT_EVENT, 0, 0, 0);
+
+    var->obj = psCANFDObj;
+    var->rxq_size = u32Slots;
+    var->rxq_head = 0;
+    var->rxq_tail = 0;
+    var->rxq_overrun = 0;
+    var->rxq_slots = psSlots;
+
+    NVIC_EnableIRQ(modinit->irq_n);
+    CANFD_EnableInt(psCANFDObj->canfd, CANFD_RXQ_INT_EVENT, 0, 0, 0);
+    return 0;
+}
+
+void CANFD_DisableRecvQueue(
+    canfd_t *psCANFDObj
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psCANFDObj->canfd, canfd_modinit_tab);
+
+    if(modinit == NULL)
+        return;
+
+    struct nu_canfd_var *var = (struct nu_canfd_var *) modinit->var;
+
+    if(var->rxq_slots == NULL)
+        return;
+
+    // The status handler, protocol engine or signal decoder may still want the new message interrupts
+    if((psCANFDObj->pfnStatusHandler == NULL) && (var->pfnRecvHook == NULL) && (var->pfnDecodeHook == NULL))
+        CANFD_DisableInt(psCANFDObj->canfd, CANFD_RXQ_INT_EVENT, 0, 0, 0);
+
+    var->rxq_slots = NULL;
+}
+
+int32_t CANFD_SetProtocolHook(
+    canfd_t *psCANFDObj,
+    PFN_CANFD_RECV_HOOK pfnRecvHook,
+    PFN_CANFD_EVENT_HOOK pfnTxHook,
+    PFN_CANFD_EVENT_HOOK pfnTickHook,
+    void *pvUserData
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psCANFDObj->canfd, canfd_modinit_tab);
+
+    if(modinit == NULL)
+        return -1;
+
+    struct nu_canfd_var *var = (struct nu_canfd_var *) modinit->var;
+    uint32_t u32Primask;
+
+    if(var->obj == NULL)
+        return -1;
+
+    u32Primask = __get_PRIMASK();
+    __disable_irq();
+
+    var->pfnRecvHook = pfnRecvHook;
+    var->pfnTxHook = pfnTxHook;
+    var->pfnTickHook = pfnTickHook;
+    var->pvHookData = pvUserData;
+
+    __set_PRIMASK(u32Primask);
+
+    if(pfnRecvHook) {
+        NVIC_EnableIRQ(modinit->irq_n);
+        CANFD_EnableInt(psCANFDObj->canfd, CANFD_RXQ_INT_EVENT, 0, 0, 0);
+    } else {
+        CANFD_DisableInt(psCANFDObj->canfd, CANFD_IE_TOOE_Msk, 0, 0, 0);
+        if((var->rxq_slots == NULL) && (var->pfnDecodeHook == NULL) && (psCANFDObj->pfnStatusHandler == NULL))
+            CANFD_DisableInt(psCANFDObj->canfd, CANFD_RXQ_INT_EVENT, 0, 0, 0);
+    }
+
+    return 0;
+}
+
+int32_t CANFD_SetDecodeHook(
+    canfd_t *psCANFDObj,
+    PFN_CANFD_RECV_HOOK pfnDecodeHook,
+    void *pvUserData
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psCANFDObj->canfd, canfd_modinit_tab);
+
+    if(modinit == NULL)
+        return -1;
+
+    struct nu_canfd_var *var = (struct nu_canfd_var *) modinit->var;
+    uint32_t u32Primask;
+
+    if(var->obj == NULL)
+        return -1;
+
+    u32Primask = __get_PRIMASK();
+    __disable_irq();
+
+    var->pfnDecodeHook = pfnDecodeHook;
+    var->pvDecodeData = pvUserData;
+
+    __set_PRIMASK(u32Primask);
+
+    if(pfnDecodeHook) {
+        NVIC_EnableIRQ(modinit->irq_n);
+        CANFD_EnableInt(psCANFDObj->canfd, CANFD_RXQ_INT_EVENT, 0, 0, 0);
+    } else if((var->rxq_slots == NULL) && (var->pfnRecvHook == NULL) && (psCANFDObj->pfnStatusHandler == NULL)) {
+        CANFD_DisableInt(psCANFDObj->canfd, CANFD_RXQ_INT_EVENT, 0, 0, 0);
+    }
+
+    return 0;
+}
+
+void CANFD_EnableTick(
+    canfd_t *psCANFDObj,
+    bool bEnable
+)
+{
+    if(bEnable) {
+        // Writing TOCV restarts the period
+        psCANFDObj->canfd->TOCV = 0;
+        CANFD_EnableInt(psCANFDObj->canfd, CANFD_IE_TOOE_Msk, 0, 0, 0);
+    } else {
+        CANFD_DisableInt(psCANFDObj->canfd, CANFD_IE_TOOE_Msk, 0, 0, 0);
+    }
+}
+
+uint32_t CANFD_RecvQueueCount(
+    canfd_t *psCANFDObj
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psCANFDObj->canfd, canfd_modinit_tab);
+
+    if(modinit == NULL)
+        return 0;
+
+    struct nu_canfd_var *var = (struct nu_canfd_var *) modinit->var;
+    uint32_t u32Head = var->rxq_head;
+    uint32_t u32Tail = var->rxq_tail;
+
+    if(var->rxq_slots == NULL)
+        return 0;
+
+    return (u32Head >= u32Tail) ? (u32Head - u32Tail) : (var->rxq_size - u32Tail + u32Head);
+}
+
+canfd_rxslot_t *CANFD_RecvQueuePeek(
+    canfd_t *psCANFDObj
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psCANFDObj->canfd, canfd_modinit_tab);
+
+    if(modinit == NULL)
+        return NULL;
+
+    struct nu_canfd_var *var = (struct nu_canfd_var *) modinit->var;
+
+    if((var->rxq_slots == NULL) || (var->rxq_head == var->rxq_tail))
+        return NULL;
+
+    return &var->rxq_slots[var->rxq_tail];
+}
+
+void CANFD_RecvQueuePop(
+    canfd_t *psCANFDObj
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psCANFDObj->canfd, canfd_modinit_tab);
+
+    if(modinit == NULL)
+        return;
+
+    struct nu_canfd_var *var = (struct nu_canfd_var *) modinit->var;
+    uint32_t u32Tail = var->rxq_tail;
+
+    if((var->rxq_slots == NULL) || (var->rxq_head == u32Tail))
+        return;
+
+    var->rxq_tail = ((u32Tail + 1) == var->rxq_size) ? 0 : (u32Tail + 1);
+}
+
+uint32_t CANFD_RecvQueueOverrun(
+    canfd_t *psCANFDObj
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psCANFDObj->canfd, canfd_modinit_tab);
+
+    if(modinit == NULL)
+        return 0;
+
+    struct nu_canfd_var *var = (struct nu_canfd_var *) modinit->var;
+
+    return var->rxq_overrun;
+}
+
+//Arbitration order key, lower wins: base ID, then standard before extended, then ID extension
+static uint32_t CANFD_SendQueueKey(
+    const CANFD_FD_MSG_T *psMsg
+)
+{
+    if(psMsg->eIdType == eCANFD_SID)
+        return (psMsg->u32Id & 0x7FF) << 19;
+
+    return ((psMsg->u32Id & 0x1FFFFFFF) >> 18) << 19 | (1 << 18) | (psMsg->u32Id & 0x3FFFF);
+}
+
+//Load free hardware Tx buffers with the head of the send queue, interrupt disabled or in interrupt context
+static void CANFD_SendQueueKick(
+    struct nu_canfd_var *var
+)
+{
+    CANFD_T *canfd = var->obj->canfd;
+    uint32_t u32Pending = canfd->TXBRP | var->txq_busy;
+    uint32_t u32BufIdx;
+
+    for(u32BufIdx = 0; (u32BufIdx < var->txq_bufs) && (var->txq_head != CANFD_TXQ_NONE); u32BufIdx ++) {
+        uint16_t u16Slot = var->txq_head;
+        canfd_txslot_t *psSlot = &var->txq_slots[u16Slot];
+
+        if(u32Pending & (1UL << u32BufIdx))
+            continue;
+
+        var->txq_head = psSlot->u16Next;
+
+        if(CANFD_TransmitTxMsg(canfd, u32BufIdx, &psSlot->sMsg) == eCANFD_TRANSMIT_SUCCESS) {
+            var->txq_busy |= (1UL << u32BufIdx);
+            var->txq_stamp[u32BufIdx] = psSlot->u32Stamp;
+            var->txq_bustime[u32BufIdx] = CANFD_FrameBusTime(var, &psSlot->sMsg);
+        } else {
+            var->txq_stats.u32Dropped ++;
+        }
+
+        psSlot->u16Next = var->txq_free;
+        var->txq_free = u16Slot;
+        var->txq_stats.u32Depth --;
+    }
+}
+
+//Account the Tx buffers whose transmission completed and refill them, in interrupt context
+static void CANFD_SendQueueService(
+    struct nu_canfd_var *var
+)
+{
+    CANFD_T *canfd = var->obj->canfd;
+    uint32_t u32Done = var->txq_busy & canfd->TXBTO;
+    uint32_t u32Now = mp_hal_ticks_us();
+    uint32_t u32BufIdx;
+
+    for(u32BufIdx = 0; u32Done; u32BufIdx ++) {
+        if(!(u32Done & (1UL << u32BufIdx)))
+            continue;
+
+        uint32_t u32Latency = u32Now - var->txq_stamp[u32BufIdx];
+
+        u32Done &= ~(1UL << u32BufIdx);
+        var->txq_busy &= ~(1UL << u32BufIdx);
+
+        var->txq_stats.u32Sent ++;
+        var->txq_stats.u32LatencyLastUs = u32Latency;
+        if(u32Latency > var->txq_stats.u32LatencyMaxUs)
+            var->txq_stats.u32LatencyMaxUs = u32Latency;
+        var->txq_stats.u64LatencySumUs += u32Latency;
+
+        CANFD_StatsAddFrame(var, var->txq_bustime[u32BufIdx], u32Now, true);
+    }
+
+    CANFD_SendQueueKick(var);
+
+    if(var->pfnTxHook)
+        var->pfnTxHook(var->pvHookData);
+}
+
+int32_t CANFD_EnableSendQueue(
+    canfd_t *psCANFDObj,
+    canfd_txslot_t *psSlots,
+    uint32_t u32Slots
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psCANFDObj->canfd, canfd_modinit_tab);
+
+    if((modinit == NULL) || (psSlots == NULL) || (u32Slots == 0) || (u32Slots >= CANFD_TXQ_NONE))
+        return -1;
+
+    struct nu_canfd_var *var = (struct nu_canfd_var *) modinit->var;
+    CANFD_T *canfd = psCANFDObj->canfd;
+    uint32_t u32Primask;
+    uint32_t i;
+
+    var->txq_bufs = (canfd->TXBC & CANFD_TXBC_NDTB_Msk) >> CANFD_TXBC_NDTB_Pos;
+    if(var->txq_bufs > CANFD_MAX_TX_BUF)
+        var->txq_bufs = CANFD_MAX_TX_BUF;
+    if(var->txq_bufs == 0)
+        return -2;
+
+    u32Primask = __get_PRIMASK();
+    __disable_irq();
+
+    for(i = 0; i < u32Slots; i ++)
+        psSlots[i].u16Next = ((i + 1) < u32Slots) ? (i + 1) : CANFD_TXQ_NONE;
+
+    var->obj = psCANFDObj;
+    var->txq_size = u32Slots;
+    var->txq_head = CANFD_TXQ_NONE;
+    var->txq_free = 0;
+    var->txq_busy = 0;
+    memset(&var->txq_stats, 0, sizeof(var->txq_stats));
+    var->txq_slots = psSlots;
+
+    __set_PRIMASK(u32Primask);
+
+    NVIC_EnableIRQ(modinit->irq_n);
+    CANFD_EnableInt(canfd, CANFD_IE_TCE_Msk, 0, (var->txq_bufs == CANFD_MAX_TX_BUF) ? 0xFFFFFFFF : ((1UL << var->txq_bufs) - 1), 0);
+    return 0;
+}
+
+int32_t CANFD_SendQueuePut(
+    canfd_t *psCANFDObj,
+    const CANFD_FD_MSG_T *psMsg
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psCANFDObj->canfd, canfd_modinit_tab);
+
+    if(modinit == NULL)
+        return -1;
+
+    struct nu_canfd_var *var = (struct nu_canfd_var *) modinit->var;
+    uint32_t u32Key = CANFD_SendQueueKey(psMsg);
+    uint32_t u32Primask;
+
+    if(var->txq_slots == NULL)
+        return -1;
+
+    u32Primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint16_t u16Slot = var->txq_free;
+
+    if(u16Slot == CANFD_TXQ_NONE) {
+        __set_PRIMASK(u32Primask);
+        return -2;		//queue full
+    }
+
+    canfd_txslot_t *psSlot = &var->txq_slots[u16Slot];
+    uint16_t *pu16Link = &var->txq_head;
+
+    var->txq_free = psSlot->u16Next;
+
+    memcpy(&psSlot->sMsg, psMsg, sizeof(CANFD_FD_MSG_T));
+    psSlot->u32Key = u32Key;
+    psSlot->u32Stamp = mp_hal_ticks_us();
+
+    // Behind the frames of higher or equal priority, equal IDs stay in order
+    while((*pu16Link != CANFD_TXQ_NONE) && (var->txq_slots[*pu16Link].u32Key <= u32Key))
+        pu16Link = &var->txq_slots[*pu16Link].u16Next;
+
+    psSlot->u16Next = *pu16Link;
+    *pu16Link = u16Slot;
+
+    var->txq_stats.u32Depth ++;
+    if(var->txq_stats.u32Depth > var->txq_stats.u32MaxDepth)
+        var->txq_stats.u32MaxDepth = var->txq_stats.u32Depth;
+
+    CANFD_SendQueueKick(var);
+
+    __set_PRIMASK(u32Primask);
+    return 0;
+}
+
+//Return free slots of send queue
+uint32_t CANFD_SendQueueSpace(
+    canfd_t *psCANFDObj
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psCANFDObj->canfd, canfd_modinit_tab);
+
+    if(modinit == NULL)
+        return 0;
+
+    struct nu_canfd_var *var = (struct nu_canfd_var *) modinit->var;
+
+    if(var->txq_slots == NULL)
+        return 0;
+
+    return var->txq_size - var->txq_stats.u32Depth;
+}
+
+void CANFD_SendQueueGetStats(
+    canfd_t *psCANFDObj,
+    CANFD_SendQueueStats_t *psStats
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psCANFDObj->canfd, canfd_modinit_tab);
+
+    memset(psStats, 0, sizeof(CANFD_SendQueueStats_t));
+
+    if(modinit == NULL)
+        return;
+
+    struct nu_canfd_var *var = (struct nu_canfd_var *) modinit->var;
+    uint32_t u32Primask = __get_PRIMASK();
+
+    __disable_irq();
+    memcpy(psStats, &var->txq_stats, sizeof(CANFD_SendQueueStats_t));
+    __set_PRIMASK(u32Primask);
+}
+
+//Move all the frames of RX FIFO u32FIFOIdx into the receive queue, in interrupt context
+static void CANFD_RecvQueueFill(
+    struct nu_canfd_var *var,
+    uint32_t u32FIFOIdx
+)
+{
+    CANFD_T *canfd = var->obj->canfd;
+    static canfd_rxslot_t s_sDropMsg;
+
+    while(1) {
+        uint32_t u32Head = var->rxq_head;
+        uint32_t u32Next = 0;
+        canfd_rxslot_t *psSlot = &s_sDropMsg;
+        uint32_t u32Depth;
+
+        // Queue full or no queue: the frame is still read out to free the hardware FIFO
+        if(var->rxq_slots) {
+            u32Next = ((u32Head + 1) == var->rxq_size) ? 0 : (u32Head + 1);
+            if(u32Next != var->rxq_tail)
+                psSlot = &var->rxq_slots[u32Head];
+        }
+
+        psSlot->u32Stamp = CANFD_RxFifoStamp(var, u32FIFOIdx);
+
+        if(CANFD_ReadRxFifoMsg(canfd, u32FIFOIdx, &psSlot->sMsg) == 0)
+            break;
+
+        CANFD_StatsAddFrame(var, CANFD_FrameBusTime(var, &psSlot->sMsg), psSlot->u32Stamp, false);
+
+        // Decoded signal frames may be consumed, frames of the protocol engine do not enter the queue
+        if((var->pfnDecodeHook) && var->pfnDecodeHook(var->pvDecodeData, &psSlot->sMsg))
+            continue;
+
+        if((var->pfnRecvHook) && var->pfnRecvHook(var->pvHookData, &psSlot->sMsg))
+            continue;
+
+        if(psSlot == &s_sDropMsg) {
+            if(var->rxq_slots)
+                var->rxq_overrun ++;
+            var->stats.u32RxOverrun ++;
+            continue;
+        }
+
+        var->rxq_head = u32Next;
+
+        u32Depth = (u32Next >= var->rxq_tail) ? (u32Next - var->rxq_tail) : (var->rxq_size - var->rxq_tail + u32Next);
+        if(u32Depth > var->stats.u32RxQueueMax)
+            var->stats.u32RxQueueMax = u32Depth;
+    }
 }
 
 /**
@@ -302,6 +1345,19 @@ void Handle_CANFD_Irq(CANFD_T *canfd, uint32_t u32Status)
 
     canfd_t *psCANFDObj = var->obj;
 
+    if((psCANFDObj) && (var->txq_slots) && (u32Status & CANFD_IR_TC_Msk))
+        CANFD_SendQueueService(var);
+
+    if((psCANFDObj) && (var->pfnTickHook) && (u32Status & CANFD_IR_TOO_Msk))
+        var->pfnTickHook(var->pvHookData);
+
+    if((psCANFDObj) && ((var->rxq_slots) || (var->pfnRecvHook) || (var->pfnDecodeHook))) {
+        if(u32Status & CANFD_IR_RF0N_Msk)
+            CANFD_RecvQueueFill(var, 0);
+        if(u32Status & CANFD_IR_RF1N_Msk)
+            CANFD_RecvQueueFill(var, 1);
+    }
+
     if((psCANFDObj) && (psCANFDObj->pfnStatusHandler)) {
         psCANFDObj->pfnStatusHandler(psCANFDObj, u32Status);
     }
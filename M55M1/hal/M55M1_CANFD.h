@@ -11,6 +11,13 @@
 
 typedef void (*PFN_STATUS_INT_HANDLER)(void *obj, uint32_t u32Status);
 
+//Protocol engine hooks, interrupt context. The receive hook returns true when it consumes the frame.
+typedef bool (*PFN_CANFD_RECV_HOOK)(void *pvUserData, const CANFD_FD_MSG_T *psMsg);
+typedef void (*PFN_CANFD_EVENT_HOOK)(void *pvUserData);
+
+//Period of the protocol engine tick
+#define CANFD_TICK_US	100
+
 typedef struct {
     CANFD_T *canfd;
     int32_t i32FIFOIdx;		//assigned >=0
@@ -19,14 +26,58 @@ typedef struct {
     PFN_STATUS_INT_HANDLER pfnStatusHandler;
 } canfd_t;
 
+//Receive queue slot, u32Stamp: reception time in mp_hal_ticks_us() time base
+typedef struct {
+    CANFD_FD_MSG_T sMsg;
+    uint32_t u32Stamp;
+} canfd_rxslot_t;
+
+//Send queue slot, owned by the HAL once given to CANFD_EnableSendQueue()
+typedef struct {
+    CANFD_FD_MSG_T sMsg;
+    uint32_t u32Key;
+    uint32_t u32Stamp;
+    uint16_t u16Next;
+} canfd_txslot_t;
+
+typedef struct {
+    uint32_t u32Depth;			//frames waiting in the send queue
+    uint32_t u32MaxDepth;		//high-water mark of u32Depth
+    uint32_t u32Sent;			//frames transmitted from the queue
+    uint32_t u32Dropped;		//frames refused by the Tx buffer
+    uint32_t u32LatencyLastUs;	//queuing to end of transmission
+    uint32_t u32LatencyMaxUs;
+    uint64_t u64LatencySumUs;
+} CANFD_SendQueueStats_t;
+
+//Traffic statistics of the counting window started by CANFD_Init() or the last CANFD_GetStats(.., true)
+typedef struct {
+    uint32_t u32WindowUs;		//length of the counting window
+    uint32_t u32RxFrames;
+    uint32_t u32TxFrames;
+    uint64_t u64BusTimeNs;		//bus time of the frames above, estimated from their format, without stuff bits
+    uint32_t u32Fifo0Max;		//RX FIFO 0 fill level high-water mark
+    uint32_t u32Fifo1Max;		//RX FIFO 1 fill level high-water mark
+    uint32_t u32RxQueueMax;		//receive queue high-water mark
+    uint32_t u32RxOverrun;		//received frames no hook took and the receive queue could not store (full or no queue)
+    uint32_t u32ErrLogCount;	//CAN error logging counter (ECR.CEL) accumulated
+    uint32_t u32LastRxStamp;	//mp_hal_ticks_us() time of the last received frame
+    uint32_t u32LastTxStamp;	//mp_hal_ticks_us() time of the last transmitted frame
+} CANFD_Stats_t;
+
 typedef struct {
     bool FDMode;			//can/canfd mode
     bool LoopBack;			//loopback
+    bool BitRateSwitch;		//FD frames may switch to the data bit rate
     uint32_t NormalBitRate;	//Normal bit rate
     uint32_t DataBitRate;	//Data bit rate
+    uint32_t NormalSamplePoint;	//per mille, 0: automatic
+    uint32_t DataSamplePoint;	//per mille, 0: automatic
 } CANFD_InitTypeDef;
 
-//Init CANFD object
+//Init CANFD object. Nominal and data bit timing are calculated from the bit rates and sample points,
+//transmitter delay compensation is enabled for data bit rates above 1 Mbit/s.
+//Return -2 if a bit rate can not be reached with the CANFD clock.
 int32_t CANFD_Init(
     canfd_t *psCANFDObj,
     CANFD_InitTypeDef *psInitDef
@@ -61,11 +112,69 @@ int32_t CANFD_SetRecvFilter(
     uint32_t u32Mask
 );
 
-//Receive message with timeout
+#define CANFD_FILTER_RANGE		0		//u32Id1 <= ID <= u32Id2
+#define CANFD_FILTER_DUAL		1		//ID == u32Id1 or ID == u32Id2
+#define CANFD_FILTER_MASK		2		//(ID & u32Id2) == (u32Id1 & u32Id2)
+
+#define CANFD_FILTER_TO_FIFO0	0
+#define CANFD_FILTER_TO_FIFO1	1
+#define CANFD_FILTER_REJECT		2
+#define CANFD_FILTER_TO_RXBUF	3		//ID == u32Id1 is stored into Rx buffer u8RxBufIdx
+
+typedef struct {
+    uint8_t u8Type;			//CANFD_FILTER_RANGE/DUAL/MASK
+    uint8_t u8Target;		//CANFD_FILTER_TO_xxx
+    uint8_t u8RxBufIdx;		//0~63
+    bool bExtId;
+    uint32_t u32Id1;
+    uint32_t u32Id2;
+} canfd_filter_t;
+
+//Replace the standard and extended filter tables by psFilters, in list order (first match wins).
+//u32NonMatch: CANFD_FILTER_TO_FIFO0/FIFO1/REJECT for the frames no filter matches.
+//The tables are written in init mode with interrupt disabled, no frame sees a partial table.
+//Return -2 if the filters exceed the standard/extended table sizes of the message RAM,
+//-3 if a CANFD_FILTER_TO_RXBUF filter targets a buffer beyond CANFD_GetRxBufCount().
+int32_t CANFD_SetRecvFilterTable(
+    canfd_t *psCANFDObj,
+    const canfd_filter_t *psFilters,
+    uint32_t u32Count,
+    uint32_t u32NonMatch
+);
+
+//Read dedicated Rx buffer u32BufIdx, return -2 if it holds no new frame
+int32_t CANFD_RecvBufMsg(
+    canfd_t *psCANFDObj,
+    uint32_t u32BufIdx,
+    CANFD_FD_MSG_T *psMsgFrame
+);
+
+//Number of dedicated Rx buffers configured in the message RAM (RXBC region) at CANFD_Init()
+uint32_t CANFD_GetRxBufCount(
+    canfd_t *psCANFDObj
+);
+
+//Receive message with timeout, pu32Stamp (may be NULL) gets the reception time in mp_hal_ticks_us() time base
+//Without receive queue it is derived from the 16 bit timestamp counter when read, exact for frames read within 65536 bit times
 int32_t CANFD_RecvMsg(
     canfd_t *psCANFDObj,
     CANFD_FD_MSG_T	*psMsgFrame,
-    uint32_t u32Timeout		//millisecond
+    uint32_t u32Timeout,		//millisecond
+    uint32_t *pu32Stamp
+);
+
+//Send message by Tx buffer u32BufIdx (see CANFD_GetFreeMsgObjIdx)
+int32_t CANFD_SendMsg(
+    canfd_t *psCANFDObj,
+    uint32_t u32BufIdx,
+    CANFD_FD_MSG_T *psMsgFrame
+);
+
+//Get traffic statistics, bRestart starts a new counting window
+void CANFD_GetStats(
+    canfd_t *psCANFDObj,
+    CANFD_Stats_t *psStats,
+    bool bRestart
 );
 
 //Enable status interrupt
@@ -81,6 +190,85 @@ void CANFD_DisableStatusInt(
     uint32_t u32INTMask
 );
 
+//Receive queue: the ISR moves the frames of both RX FIFOs into psSlots, a ring of u32Slots
+//preallocated frames (u32Slots - 1 usable). Frames are dropped and counted when the queue is full.
+int32_t CANFD_EnableRecvQueue(
+    canfd_t *psCANFDObj,
+    canfd_rxslot_t *psSlots,
+    uint32_t u32Slots
+);
+
+void CANFD_DisableRecvQueue(
+    canfd_t *psCANFDObj
+);
+
+//Install the protocol engine (e.g. ISO-TP) of a controller, NULL hooks remove it. pfnRecvHook sees the frames
+//of both RX FIFOs before the receive queue, pfnTxHook is called when the send queue moved frames to the
+//Tx buffers, pfnTickHook every CANFD_TICK_US while enabled by CANFD_EnableTick().
+int32_t CANFD_SetProtocolHook(
+    canfd_t *psCANFDObj,
+    PFN_CANFD_RECV_HOOK pfnRecvHook,
+    PFN_CANFD_EVENT_HOOK pfnTxHook,
+    PFN_CANFD_EVENT_HOOK pfnTickHook,
+    void *pvUserData
+);
+
+void CANFD_EnableTick(
+    canfd_t *psCANFDObj,
+    bool bEnable
+);
+
+//Install the signal decoder of a controller, NULL removes it. pfnDecodeHook sees the frames of both
+//RX FIFOs before the protocol engine and the receive queue, and returns true to consume a frame.
+int32_t CANFD_SetDecodeHook(
+    canfd_t *psCANFDObj,
+    PFN_CANFD_RECV_HOOK pfnDecodeHook,
+    void *pvUserData
+);
+
+//Return amount of frames in receive queue
+uint32_t CANFD_RecvQueueCount(
+    canfd_t *psCANFDObj
+);
+
+//Oldest frame of receive queue, NULL if empty. It stays valid until CANFD_RecvQueuePop()
+canfd_rxslot_t *CANFD_RecvQueuePeek(
+    canfd_t *psCANFDObj
+);
+
+void CANFD_RecvQueuePop(
+    canfd_t *psCANFDObj
+);
+
+//Number of frames dropped because the receive queue was full
+uint32_t CANFD_RecvQueueOverrun(
+    canfd_t *psCANFDObj
+);
+
+//Send queue: frames are kept in psSlots sorted by CAN ID priority and loaded into the hardware
+//Tx buffers from the transmission completed interrupt. Direct sends must not be used meanwhile.
+int32_t CANFD_EnableSendQueue(
+    canfd_t *psCANFDObj,
+    canfd_txslot_t *psSlots,
+    uint32_t u32Slots
+);
+
+//Queue a frame, return -2 if the queue is full
+int32_t CANFD_SendQueuePut(
+    canfd_t *psCANFDObj,
+    const CANFD_FD_MSG_T *psMsg
+);
+
+//Return free slots of send queue
+uint32_t CANFD_SendQueueSpace(
+    canfd_t *psCANFDObj
+);
+
+void CANFD_SendQueueGetStats(
+    canfd_t *psCANFDObj,
+    CANFD_SendQueueStats_t *psStats
+);
+
 /**
  * Handle the CANFD interrupt
  * @param[in] obj The CANFD peripheral that generated the interrupt
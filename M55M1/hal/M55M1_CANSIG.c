@@ -0,0 +1,304 @@
+/**************************************************************************//**
+ * @file     M55M1_CANSIG.c
+ * @version  V1.00
+ * @brief    M55M1 CAN signal (DBC) decode/encode HAL source file for micropython
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * @copyright (C) 2025 Nuvoton Technology Corp. All rights reserved.
+ *****************************************************************************/
+
+#include <string.h>
+
+#include "NuMicro.h"
+#include "M55M1_CANSIG.h"
+
+//Largest CAN FD frame, in bits
+#define CANSIG_FRAME_BITS	(64 * 8)
+
+static uint64_t CANSIG_RawMask(
+    uint32_t u32Length
+)
+{
+    return (u32Length >= 64) ? ~0ULL : ((1ULL << u32Length) - 1);
+}
+
+//First signal of u32Key, or u32NumSignals
+static uint32_t CANSIG_Find(
+    const cansig_table_t *psTable,
+    uint32_t u32Key
+)
+{
+    uint32_t u32Low = 0;
+    uint32_t u32High = psTable->u32NumSignals;
+
+    while(u32Low < u32High) {
+        uint32_t u32Mid = (u32Low + u32High) / 2;
+
+        if(psTable->psSignals[u32Mid].u32Key < u32Key)
+            u32Low = u32Mid + 1;
+        else
+            u32High = u32Mid;
+    }
+
+    return u32Low;
+}
+
+int32_t CANSIG_Compile(
+    const cansig_def_t *psDefs,
+    uint32_t u32Num,
+    cansig_signal_t *psSignals
+)
+{
+    uint32_t i, j;
+
+    if(u32Num > 0xFFFF)
+        return -1;
+
+    for(i = 0; i < u32Num; i ++) {
+        const cansig_def_t *psDef = &psDefs[i];
+        cansig_signal_t sSig;
+        uint32_t u32Lead;
+
+        if((psDef->u8Length == 0) || (psDef->u8Length > 64) || (psDef->u16StartBit >= CANSIG_FRAME_BITS))
+            return -1;
+
+        if(psDef->u32Id > ((psDef->u8Flags & CANSIG_EXTID) ? 0x1FFFFFFF : 0x7FF))
+            return -1;
+
+        sSig.u32Key = psDef->u32Id | ((psDef->u8Flags & CANSIG_EXTID) ? CANSIG_KEY_EXTID : 0);
+        sSig.u16Index = i;
+        sSig.u8Length = psDef->u8Length;
+        sSig.u8Flags = psDef->u8Flags;
+        sSig.fScale = psDef->fScale;
+        sSig.fOffset = psDef->fOffset;
+
+        if(psDef->u8Flags & CANSIG_BIG_ENDIAN) {
+            // DBC numbers the MSB in its byte (bit 7 first), the signal runs towards the following bytes
+            uint32_t u32MsbPos = (psDef->u16StartBit & ~7) + (7 - (psDef->u16StartBit & 7));
+
+            if((u32MsbPos + psDef->u8Length) > CANSIG_FRAME_BITS)
+                return -1;
+
+            u32Lead = u32MsbPos & 7;
+            sSig.u8FirstByte = u32MsbPos >> 3;
+            sSig.u8NumBytes = (u32Lead + psDef->u8Length + 7) >> 3;
+            sSig.i8Shift = (int32_t)(u32Lead + psDef->u8Length) - 8;
+            sSig.i8Step = -8;
+        } else {
+            if((psDef->u16StartBit + psDef->u8Length) > CANSIG_FRAME_BITS)
+                return -1;
+
+            u32Lead = psDef->u16StartBit & 7;
+            sSig.u8FirstByte = psDef->u16StartBit >> 3;
+            sSig.u8NumBytes = (u32Lead + psDef->u8Length + 7) >> 3;
+            sSig.i8Shift = -(int32_t)u32Lead;
+            sSig.i8Step = 8;
+        }
+
+        // Insertion sort by key, signals of a frame keep the definition order
+        for(j = i; (j > 0) && (psSignals[j - 1].u32Key > sSig.u32Key); j --)
+            psSignals[j] = psSignals[j - 1];
+
+        psSignals[j] = sSig;
+    }
+
+    return 0;
+}
+
+uint32_t CANSIG_Decode(
+    cansig_table_t *psTable,
+    const CANFD_FD_MSG_T *psMsg
+)
+{
+    uint32_t u32Key = psMsg->u32Id | ((psMsg->eIdType == eCANFD_XID) ? CANSIG_KEY_EXTID : 0);
+    uint32_t u32Changed = 0;
+    uint32_t i;
+
+    if(psMsg->eFrmType != eCANFD_DATA_FRM)
+        return 0;
+
+    i = CANSIG_Find(psTable, u32Key);
+
+    if((i < psTable->u32NumSignals) && (psTable->psSignals[i].u32Key == u32Key))
+        psTable->u32Frames ++;
+
+    for(; (i < psTable->u32NumSignals) && (psTable->psSignals[i].u32Key == u32Key); i ++) {
+        const cansig_signal_t *psSig = &psTable->psSignals[i];
+        const uint8_t *pu8Data = &psMsg->au8Data[psSig->u8FirstByte];
+        int32_t i32Shift = psSig->i8Shift;
+        uint64_t u64Raw = 0;
+        uint32_t n;
+        float fValue;
+
+        // Signals beyond the received data length keep their value
+        if((psSig->u8FirstByte + psSig->u8NumBytes) > psMsg->u32DLC)
+            continue;
+
+        for(n = 0; n < psSig->u8NumBytes; n ++) {
+            u64Raw |= (i32Shift >= 0) ? ((uint64_t)pu8Data[n] << i32Shift) : (uint64_t)(pu8Data[n] >> -i32Shift);
+            i32Shift += psSig->i8Step;
+        }
+
+        u64Raw &= CANSIG_RawMask(psSig->u8Length);
+
+        if((psSig->u8Flags & CANSIG_SIGNED) && (psSig->u8Length < 64) && (u64Raw >> (psSig->u8Length - 1)))
+            u64Raw |= ~0ULL << psSig->u8Length;
+
+        // 32 bits conversions are single FPU instructions
+        if(psSig->u8Length <= 31)
+            fValue = (float)(int32_t)u64Raw;
+        else if(psSig->u8Flags & CANSIG_SIGNED)
+            fValue = (float)(int64_t)u64Raw;
+        else
+            fValue = (float)u64Raw;
+
+        fValue = fValue * psSig->fScale + psSig->fOffset;
+
+        if(psTable->pfValues[psSig->u16Index] != fValue) {
+            psTable->pfValues[psSig->u16Index] = fValue;
+            psTable->pu32Changed[psSig->u16Index >> 5] |= 1UL << (psSig->u16Index & 31);
+            u32Changed ++;
+        }
+    }
+
+    return u32Changed;
+}
+
+uint32_t CANSIG_FrameLen(
+    const cansig_table_t *psTable,
+    uint32_t u32Key
+)
+{
+    uint32_t u32Len = 0;
+    uint32_t i;
+
+    for(i = CANSIG_Find(psTable, u32Key); (i < psTable->u32NumSignals) && (psTable->psSignals[i].u32Key == u32Key); i ++) {
+        const cansig_signal_t *psSig = &psTable->psSignals[i];
+
+        if((uint32_t)(psSig->u8FirstByte + psSig->u8NumBytes) > u32Len)
+            u32Len = psSig->u8FirstByte + psSig->u8NumBytes;
+    }
+
+    return u32Len;
+}
+
+//Raw value of fValue, rounded to nearest and saturated
+static uint64_t CANSIG_ToRaw(
+    const cansig_signal_t *psSig,
+    float fValue
+)
+{
+    float fRaw = (psSig->fScale != 0.0f) ? ((fValue - psSig->fOffset) / psSig->fScale) : 0.0f;
+
+    if(psSig->u8Flags & CANSIG_SIGNED) {
+        float fLimit = (float)(1ULL << (psSig->u8Length - 1));
+
+        if(fRaw >= fLimit)
+            return (uint64_t)((1ULL << (psSig->u8Length - 1)) - 1);
+        if(fRaw <= -fLimit)
+            return 1ULL << (psSig->u8Length - 1);	// the most negative value once masked
+
+        return (uint64_t)(int64_t)((fRaw >= 0.0f) ? (fRaw + 0.5f) : (fRaw - 0.5f));
+    }
+
+    if(!(fRaw > 0.0f))
+        return 0;	// negative and NaN
+    if((psSig->u8Length >= 64) ? (fRaw >= 18446744073709551616.0f) : (fRaw >= (float)(1ULL << psSig->u8Length)))
+        return CANSIG_RawMask(psSig->u8Length);
+
+    return (uint64_t)(fRaw + 0.5f);
+}
+
+int32_t CANSIG_Encode(
+    const cansig_table_t *psTable,
+    uint32_t u32Key,
+    uint8_t *pu8Data,
+    uint32_t u32Len
+)
+{
+    uint32_t i;
+
+    if(CANSIG_FrameLen(psTable, u32Key) > u32Len)
+        return -1;
+
+    for(i = CANSIG_Find(psTable, u32Key); (i < psTable->u32NumSignals) && (psTable->psSignals[i].u32Key == u32Key); i ++) {
+        const cansig_signal_t *psSig = &psTable->psSignals[i];
+        uint8_t *pu8Byte = &pu8Data[psSig->u8FirstByte];
+        uint64_t u64Mask = CANSIG_RawMask(psSig->u8Length);
+        uint64_t u64Raw = CANSIG_ToRaw(psSig, psTable->pfValues[psSig->u16Index]) & u64Mask;
+        int32_t i32Shift = psSig->i8Shift;
+        uint32_t n;
+
+        for(n = 0; n < psSig->u8NumBytes; n ++) {
+            uint8_t u8Bits, u8Mask;
+
+            if(i32Shift >= 0) {
+                u8Bits = u64Raw >> i32Shift;
+                u8Mask = u64Mask >> i32Shift;
+            } else {
+                u8Bits = u64Raw << -i32Shift;
+                u8Mask = u64Mask << -i32Shift;
+            }
+
+            pu8Byte[n] = (pu8Byte[n] & ~u8Mask) | (u8Bits & u8Mask);
+            i32Shift += psSig->i8Step;
+        }
+    }
+
+    return 0;
+}
+
+void CANSIG_TakeChanged(
+    cansig_table_t *psTable,
+    uint32_t *pu32Bitmap,
+    uint32_t u32Words
+)
+{
+    uint32_t u32Primask = __get_PRIMASK();
+
+    __disable_irq();
+    memcpy(pu32Bitmap, psTable->pu32Changed, u32Words * sizeof(uint32_t));
+    memset(psTable->pu32Changed, 0, u32Words * sizeof(uint32_t));
+    __set_PRIMASK(u32Primask);
+}
+
+//CANFD receive interrupt hook
+static bool CANSIG_RecvHook(
+    void *pvUserData,
+    const CANFD_FD_MSG_T *psMsg
+)
+{
+    cansig_table_t *psTable = (cansig_table_t *)pvUserData;
+    uint32_t u32Frames = psTable->u32Frames;
+
+    if((CANSIG_Decode(psTable, psMsg) > 0) && (psTable->pfnChange))
+        psTable->pfnChange(psTable->pvUserData);
+
+    return psTable->bConsume && (psTable->u32Frames != u32Frames);
+}
+
+int32_t CANSIG_Attach(
+    cansig_table_t *psTable,
+    canfd_t *psCANFDObj
+)
+{
+    psTable->psCANFDObj = psCANFDObj;
+
+    if(CANFD_SetDecodeHook(psCANFDObj, CANSIG_RecvHook, psTable) != 0) {
+        psTable->psCANFDObj = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+void CANSIG_Detach(
+    cansig_table_t *psTable
+)
+{
+    if(psTable->psCANFDObj == NULL)
+        return;
+
+    CANFD_SetDecodeHook(psTable->psCANFDObj, NULL, NULL);
+    psTable->psCANFDObj = NULL;
+}
@@ -0,0 +1,104 @@
+/**************************************************************************//**
+ * @file     M55M1_CANSIG.h
+ * @version  V1.00
+ * @brief    M55M1 CAN signal (DBC) decode/encode HAL header file for micropython
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * @copyright (C) 2025 Nuvoton Technology Corp. All rights reserved.
+ *****************************************************************************/
+#ifndef __M55M1_CANSIG_H__
+#define __M55M1_CANSIG_H__
+
+#include "M55M1_CANFD.h"
+
+#define CANSIG_BIG_ENDIAN	(1 << 0)	//Motorola byte order (DBC @0), the start bit is the MSB
+#define CANSIG_SIGNED		(1 << 1)	//two's complement raw value (DBC -)
+#define CANSIG_EXTID		(1 << 2)	//29 bits CAN ID
+
+#define CANSIG_KEY_EXTID	0x80000000
+
+//Signal definition, as in a DBC SG_ line: value = raw * fScale + fOffset
+typedef struct {
+    uint32_t u32Id;
+    uint16_t u16StartBit;
+    uint8_t u8Length;		//1~64 bits
+    uint8_t u8Flags;		//CANSIG_BIG_ENDIAN | CANSIG_SIGNED | CANSIG_EXTID
+    float fScale;
+    float fOffset;
+} cansig_def_t;
+
+//Compiled signal, see CANSIG_Compile()
+typedef struct {
+    uint32_t u32Key;		//CAN ID | CANSIG_KEY_EXTID
+    uint16_t u16Index;		//slot in the value array, the definition index
+    uint8_t u8FirstByte;	//first data byte holding signal bits
+    uint8_t u8NumBytes;
+    int8_t i8Shift;			//value bit position of the first byte bit 0, negative when the byte is shifted right
+    int8_t i8Step;			//shift change of the following bytes: +8 little endian, -8 big endian
+    uint8_t u8Length;
+    uint8_t u8Flags;
+    float fScale;
+    float fOffset;
+} cansig_signal_t;
+
+//Called in interrupt context when a frame changed at least one value
+typedef void (*PFN_CANSIG_CHANGE)(void *pvUserData);
+
+typedef struct {
+    cansig_signal_t *psSignals;		//sorted by u32Key
+    uint32_t u32NumSignals;
+    float *pfValues;				//u32NumSignals values, in definition order
+    uint32_t *pu32Changed;			//one bit per value, set when the value changes
+    bool bConsume;					//decoded frames do not go further to the receive queue
+    volatile uint32_t u32Frames;	//frames holding signals of the table
+    PFN_CANSIG_CHANGE pfnChange;
+    void *pvUserData;
+    canfd_t *psCANFDObj;
+} cansig_table_t;
+
+//Check and compile u32Num definitions into psSignals (u32Num entries), -1 if a definition is invalid
+int32_t CANSIG_Compile(
+    const cansig_def_t *psDefs,
+    uint32_t u32Num,
+    cansig_signal_t *psSignals
+);
+
+//Decode the frames of the table in the receive interrupt of the controller
+int32_t CANSIG_Attach(
+    cansig_table_t *psTable,
+    canfd_t *psCANFDObj
+);
+
+void CANSIG_Detach(
+    cansig_table_t *psTable
+);
+
+//Update the values and change bits from a frame, return the number of changed values
+uint32_t CANSIG_Decode(
+    cansig_table_t *psTable,
+    const CANFD_FD_MSG_T *psMsg
+);
+
+//Data length needed by the signals of u32Key, 0 if there are none
+uint32_t CANSIG_FrameLen(
+    const cansig_table_t *psTable,
+    uint32_t u32Key
+);
+
+//Write the current values of the signals of u32Key into pu8Data, other bits are kept.
+//Values are rounded and saturated to the raw range. Return -1 if u32Len is too short.
+int32_t CANSIG_Encode(
+    const cansig_table_t *psTable,
+    uint32_t u32Key,
+    uint8_t *pu8Data,
+    uint32_t u32Len
+);
+
+//Copy and clear the change bits, u32Words words of pu32Bitmap
+void CANSIG_TakeChanged(
+    cansig_table_t *psTable,
+    uint32_t *pu32Bitmap,
+    uint32_t u32Words
+);
+
+#endif
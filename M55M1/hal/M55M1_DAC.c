@@ -22,6 +22,12 @@ struct nu_dac_var {
     uint32_t	dma_trans_len;
     uint8_t		*dma_tarns_buf;
 
+    nu_pdma_desc_t	pingpong_desc[2];
+    PFN_DAC_REFILL_HANDLER pingpong_handler;
+    void		*pingpong_userdata;
+    uint32_t	pingpong_half;
+    volatile uint32_t pingpong_busy;
+    volatile uint32_t pingpong_underrun;
 };
 
 static struct nu_dac_var dac0_var = {
@@ -103,6 +109,12 @@ void DAC_Final(
         dac_var->dma_chn_id_tx = NU_PDMA_OUT_OF_CHANNELS;
     }
 
+    if (dac_var->pingpong_handler) {
+        nu_pdma_sgtbls_free(dac_var->pingpong_desc, 2);
+        dac_var->pingpong_handler = NULL;
+        dac_var->pingpong_userdata = NULL;
+    }
+
     DAC_Close(psObj->dac, 0);
 
     /* Disable module clock */
@@ -143,6 +155,23 @@ static void DAC_DMA_Handler_TX(void* id, uint32_t event_dma)
     if (event_dma & NU_PDMA_EVENT_ABORT) {
     }
 
+    if ((dac_var->pingpong_handler) && (event_dma & NU_PDMA_EVENT_TRANSFER_DONE)) {
+        uint32_t u32Half = dac_var->pingpong_half;
+
+        dac_var->pingpong_half ^= 1;
+
+        // PDMA is now playing the other half, it must have been refilled
+        if (dac_var->pingpong_busy & (1 << (u32Half ^ 1)))
+            dac_var->pingpong_underrun ++;
+
+        if (dac_var->pingpong_handler(dac_var->pingpong_userdata, u32Half))
+            dac_var->pingpong_busy |= (1 << u32Half);
+        else
+            dac_var->pingpong_underrun ++;	//not refilled, the half is played again as it is
+
+        return;
+    }
+
     // Expect UART IRQ will catch this transfer done event
     if (event_dma & NU_PDMA_EVENT_TRANSFER_DONE) {
         //retrigger transfer
@@ -183,7 +212,7 @@ int32_t DAC_TimerPDMAConv(
     struct nu_dac_var *dac_var = (struct nu_dac_var *)modinit->var;
 
     if(dac_var->dma_chn_id_tx != NU_PDMA_OUT_OF_CHANNELS)
-        nu_pdma_channel_free(dac_var->dma_chn_id_tx);
+        DAC_StopTimerPDMAConv(psObj, timer);
 
     DAC_InitTypeDef dacInit;
 
@@ -242,6 +271,146 @@ int32_t DAC_TimerPDMAConv(
 }
 
 
+int32_t DAC_TimerPDMAPingPong(
+    dac_t *psObj,
+    TIMER_T *timer,
+    uint32_t u32TriggerMode,
+    E_DAC_BITWIDTH eBitWidth,
+    uint8_t *pu8Buf,
+    uint32_t u32BufLen,
+    PFN_DAC_REFILL_HANDLER pfnHandler,
+    void *pvUserData
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->dac, dac_modinit_tab);
+
+    if(modinit == NULL)
+        return -1;
+
+    struct nu_dac_var *dac_var = (struct nu_dac_var *)modinit->var;
+    uint32_t u32HalfLen;
+    uint32_t u32HalfBytes;
+
+    if(pfnHandler == NULL)
+        return -1;
+
+    if(dac_var->dma_chn_id_tx != NU_PDMA_OUT_OF_CHANNELS)
+        DAC_StopTimerPDMAConv(psObj, timer);
+
+    DAC_InitTypeDef dacInit;
+
+    dacInit.u32TriggerMode = u32TriggerMode;
+    dacInit.eBitWidth = eBitWidth;
+
+    //Re-init dac
+    DAC_Init(psObj, &dacInit);
+
+    dac_var->dma_data_width = (eBitWidth == eDAC_BITWIDTH_8) ? 8 : 16;
+    dac_var->dma_trans_len = u32BufLen / (dac_var->dma_data_width / 8);
+    dac_var->dma_tarns_buf = pu8Buf;
+
+    u32HalfLen = dac_var->dma_trans_len / 2;
+    u32HalfBytes = u32HalfLen * (dac_var->dma_data_width / 8);
+
+    if((u32HalfLen == 0) || (u32HalfLen > NU_PDMA_MAX_TXCNT))
+        return -1;
+
+    dac_var->dma_chn_id_tx = nu_pdma_channel_dynamic_allocate(dac_var->pdma_perp_tx);
+
+    if(dac_var->dma_chn_id_tx == NU_PDMA_OUT_OF_CHANNELS)
+        return -1;
+
+    if(nu_pdma_sgtbls_allocate(dac_var->pingpong_desc, 2) != 0) {
+        nu_pdma_channel_free(dac_var->dma_chn_id_tx);
+        dac_var->dma_chn_id_tx = NU_PDMA_OUT_OF_CHANNELS;
+        return -1;
+    }
+
+    nu_pdma_filtering_set(dac_var->dma_chn_id_tx, NU_PDMA_EVENT_TRANSFER_DONE | NU_PDMA_EVENT_TIMEOUT);
+
+    {
+        struct nu_pdma_chn_cb pdma_tx_chn_cb;
+
+        pdma_tx_chn_cb.m_eCBType = eCBType_Event;
+        pdma_tx_chn_cb.m_pfnCBHandler = DAC_DMA_Handler_TX;
+        pdma_tx_chn_cb.m_pvUserData = psObj;
+
+        nu_pdma_callback_register(dac_var->dma_chn_id_tx, &pdma_tx_chn_cb);
+    }
+
+    // Two descriptors linked in a ring, each one raises transfer done when its half is played
+    nu_pdma_desc_setup(dac_var->dma_chn_id_tx, dac_var->pingpong_desc[0], dac_var->dma_data_width,
+                       (uint32_t)pu8Buf, (uint32_t)&(psObj->dac)->DAT,
+                       u32HalfLen, dac_var->pingpong_desc[1], 0);
+    nu_pdma_desc_setup(dac_var->dma_chn_id_tx, dac_var->pingpong_desc[1], dac_var->dma_data_width,
+                       (uint32_t)(pu8Buf + u32HalfBytes), (uint32_t)&(psObj->dac)->DAT,
+                       u32HalfLen, dac_var->pingpong_desc[0], 0);
+
+    dac_var->pingpong_handler = pfnHandler;
+    dac_var->pingpong_userdata = pvUserData;
+    dac_var->pingpong_half = 0;
+    dac_var->pingpong_busy = 0;
+    dac_var->pingpong_underrun = 0;
+
+    nu_pdma_sg_transfer(dac_var->dma_chn_id_tx, dac_var->pingpong_desc[0], 0);
+
+    /* Enable the PDMA Mode */
+    DAC_ENABLE_PDMA(psObj->dac);
+
+    // timer have been opened, just stop and reset it
+    TIMER_Stop(timer);
+    TIMER_ResetCounter(timer);
+    TIMER_SetTriggerTarget(timer, TIMER_TRG_TO_DAC);
+    TIMER_Start(timer);
+
+    return 0;
+}
+
+void DAC_PingPongRelease(
+    dac_t *psObj,
+    uint32_t u32Half
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->dac, dac_modinit_tab);
+
+    if(modinit == NULL)
+        return;
+
+    struct nu_dac_var *dac_var = (struct nu_dac_var *)modinit->var;
+
+    if(dac_var->pingpong_handler == NULL)
+        return;
+
+#if (NVT_DCACHE_ON == 1)
+    {
+        uint32_t u32HalfBytes = (dac_var->dma_trans_len / 2) * (dac_var->dma_data_width / 8);
+
+        // Refilled samples must reach memory before PDMA reads them
+        SCB_CleanDCache_by_Addr(dac_var->dma_tarns_buf + ((u32Half & 1) * u32HalfBytes), u32HalfBytes);
+    }
+#endif
+
+    uint32_t u32Primask = __get_PRIMASK();
+
+    __disable_irq();
+    dac_var->pingpong_busy &= ~(1 << (u32Half & 1));
+    __set_PRIMASK(u32Primask);
+}
+
+uint32_t DAC_PingPongUnderrun(
+    dac_t *psObj
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->dac, dac_modinit_tab);
+
+    if(modinit == NULL)
+        return 0;
+
+    struct nu_dac_var *dac_var = (struct nu_dac_var *)modinit->var;
+
+    return dac_var->pingpong_underrun;
+}
+
 int32_t DAC_StopTimerPDMAConv(
     dac_t *psObj,
     TIMER_T *timer
@@ -258,6 +427,7 @@ int32_t DAC_StopTimerPDMAConv(
     DAC_DISABLE_PDMA(psObj->dac);
 
     if (dac_var->dma_chn_id_tx != NU_PDMA_OUT_OF_CHANNELS) {
+        nu_pdma_channel_terminate(dac_var->dma_chn_id_tx);
         nu_pdma_channel_free(dac_var->dma_chn_id_tx);
         dac_var->dma_chn_id_tx = NU_PDMA_OUT_OF_CHANNELS;
         dac_var->dma_tarns_buf = NULL;
@@ -265,6 +435,12 @@ int32_t DAC_StopTimerPDMAConv(
         dac_var->dma_trans_len = 0;
     }
 
+    if (dac_var->pingpong_handler) {
+        nu_pdma_sgtbls_free(dac_var->pingpong_desc, 2);
+        dac_var->pingpong_handler = NULL;
+        dac_var->pingpong_userdata = NULL;
+    }
+
     return 0;
 }
 
@@ -47,6 +47,33 @@ int32_t DAC_TimerPDMAConv(
     bool bCircular
 );
 
+//Called in PDMA interrupt context when half u32Half (0/1) of the ping-pong buffer has been played.
+//Return true if the half is handed over for refilling, it must be given back by DAC_PingPongRelease().
+//Return false if it cannot be refilled (e.g. the refill could not be queued), it counts as an underrun.
+typedef bool (*PFN_DAC_REFILL_HANDLER)(void *pvUserData, uint32_t u32Half);
+
+//Play pu8Buf as two halves in turn, pfnHandler is called each time a half is played while PDMA goes on with the other one.
+int32_t DAC_TimerPDMAPingPong(
+    dac_t *psObj,
+    TIMER_T *timer,
+    uint32_t u32TriggerMode,
+    E_DAC_BITWIDTH eBitWidth,
+    uint8_t *pu8Buf,
+    uint32_t u32BufLen,
+    PFN_DAC_REFILL_HANDLER pfnHandler,
+    void *pvUserData
+);
+
+void DAC_PingPongRelease(
+    dac_t *psObj,
+    uint32_t u32Half
+);
+
+//Number of halves played again because they were not refilled in time
+uint32_t DAC_PingPongUnderrun(
+    dac_t *psObj
+);
+
 int32_t DAC_StopTimerPDMAConv(
     dac_t *psObj,
     TIMER_T *timer
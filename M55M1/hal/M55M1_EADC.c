@@ -0,0 +1,655 @@
+/**************************************************************************//**
+ * @file     M55M1_EADC.c
+ * @version  V0.01
+ * @brief    M55M1 series EADC HAL source file
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * @copyright (C) 2025 Nuvoton Technology Corp. All rights reserved.
+ *****************************************************************************/
+
+#include "NuMicro.h"
+
+#include "M55M1_EADC.h"
+#include "nu_modutil.h"
+#include "drv_pdma.h"
+
+#define EADC_LAST_GPIO_MODULE	(23)
+#define EADC_SCAN_TIMEOUT		(0x100000)
+#define EADC_MAX_DATA			(0xFFF)
+#define EADC_CMP_MAX_MCNT		(16)
+
+struct nu_eadc_var {
+    eadc_t *    psObj;
+    uint8_t     pdma_perp_rx;
+
+    int         dma_chn_id_rx;
+    uint32_t	module_mask;
+    uint32_t	dma_trans_len;
+    uint16_t	*dma_trans_buf;
+    volatile uint32_t dma_event;
+    TIMER_T     *timer;
+
+    nu_pdma_desc_t	stream_desc[2];
+    PFN_EADC_STREAM_HANDLER stream_handler;
+    void		*stream_userdata;
+    uint32_t	stream_half;
+    volatile uint32_t stream_busy;
+    volatile uint32_t stream_overrun;
+
+    PFN_EADC_CMP_HANDLER cmp_handler;
+    void		*cmp_userdata;
+    uint32_t	cmp_module;
+    TIMER_T     *cmp_timer;
+    IRQn_Type   adint1_irq_n;			//free running compare, the ADIF1 clear raises the next trigger
+};
+
+static struct nu_eadc_var eadc0_var = {
+    .psObj              =   NULL,
+    .pdma_perp_rx       =   PDMA_EADC0_RX,
+    .dma_chn_id_rx		=	NU_PDMA_OUT_OF_CHANNELS,
+    .adint1_irq_n       =   EADC01_IRQn,
+};
+
+static const struct nu_modinit_s eadc_modinit_tab[] = {
+    {(uint32_t)EADC0, EADC0_MODULE, CLK_EADCSEL_EADC0SEL_APLL1_DIV2, CLK_EADCDIV_EADC0DIV(10), SYS_EADC0RST, EADC00_IRQn, &eadc0_var},
+
+    {0, 0, 0, 0, 0, (IRQn_Type) 0, NULL}
+};
+
+static int32_t EADC_GetTimerTrigger(
+    TIMER_T *timer,
+    uint32_t *pu32Trigger
+)
+{
+    if(timer == TIMER0) {
+        *pu32Trigger = EADC_TIMER0_TRIGGER;
+    } else if (timer == TIMER1) {
+        *pu32Trigger = EADC_TIMER1_TRIGGER;
+    } else if (timer == TIMER2) {
+        *pu32Trigger = EADC_TIMER2_TRIGGER;
+    } else if (timer == TIMER3) {
+        *pu32Trigger = EADC_TIMER3_TRIGGER;
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
+//Sample modules or timer trigger already used by a timed conversion, a stream or the window comparator
+static bool EADC_IsInUse(
+    struct nu_eadc_var *eadc_var,
+    uint32_t u32ModuleMask,
+    TIMER_T *timer
+)
+{
+    if((eadc_var->dma_chn_id_rx != NU_PDMA_OUT_OF_CHANNELS) &&
+            ((eadc_var->module_mask & u32ModuleMask) || ((timer) && (timer == eadc_var->timer))))
+        return true;
+
+    if((eadc_var->cmp_handler) &&
+            (((1 << eadc_var->cmp_module) & u32ModuleMask) || ((timer) && (timer == eadc_var->cmp_timer))))
+        return true;
+
+    return false;
+}
+
+bool EADC_IsModuleBusy(
+    eadc_t *psObj,
+    uint32_t u32ModuleMask
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->eadc, eadc_modinit_tab);
+
+    if(modinit == NULL)
+        return false;
+
+    return EADC_IsInUse((struct nu_eadc_var *)modinit->var, u32ModuleMask, NULL);
+}
+
+int32_t EADC_ScanConv(
+    eadc_t *psObj,
+    uint32_t u32ModuleMask,
+    uint16_t *pu16Buf
+)
+{
+    uint32_t u32Module;
+    uint32_t u32Timeout = EADC_SCAN_TIMEOUT;
+
+    if((u32ModuleMask == 0) || (pu16Buf == NULL))
+        return -1;
+
+    for(u32Module = 0; u32Module < 32; u32Module ++) {
+        if((u32ModuleMask & (1 << u32Module)) == 0)
+            continue;
+
+        if(u32Module <= EADC_LAST_GPIO_MODULE)
+            EADC_ConfigSampleModule(psObj->eadc, u32Module, EADC_SOFTWARE_TRIGGER, u32Module);
+        else
+            EADC_SetExtendSampleTime(psObj->eadc, u32Module, 0xFF);	//Band-gap, temperature, Vbat
+
+        // Reading the data register clears a stale valid flag
+        (void)EADC_GET_CONV_DATA(psObj->eadc, u32Module);
+    }
+
+    /* One trigger for the whole sequence, modules are converted in ascending order */
+    EADC_START_CONV(psObj->eadc, u32ModuleMask);
+
+    while(EADC_GET_DATA_VALID_FLAG(psObj->eadc, u32ModuleMask) != u32ModuleMask) {
+        if(--u32Timeout == 0)
+            return -2;
+    }
+
+    for(u32Module = 0; u32Module < 32; u32Module ++) {
+        if(u32ModuleMask & (1 << u32Module))
+            *pu16Buf++ = EADC_GET_CONV_DATA(psObj->eadc, u32Module);
+    }
+
+    return 0;
+}
+
+static void EADC_DMA_Handler_RX(void* id, uint32_t event_dma)
+{
+    eadc_t *psObj = (eadc_t *) id;
+
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->eadc, eadc_modinit_tab);
+    if(modinit == NULL)
+        return;
+
+    struct nu_eadc_var *eadc_var = (struct nu_eadc_var *)modinit->var;
+
+    if(eadc_var->psObj != psObj)
+        return;
+
+    if ((eadc_var->stream_handler) && (event_dma & NU_PDMA_EVENT_TRANSFER_DONE)) {
+        uint32_t u32Half = eadc_var->stream_half;
+        uint32_t u32HalfLen = eadc_var->dma_trans_len / 2;
+
+        eadc_var->stream_half ^= 1;
+
+        // PDMA is now filling the other half, it must not be in use
+        if (eadc_var->stream_busy & (1 << (u32Half ^ 1)))
+            eadc_var->stream_overrun ++;
+
+#if (NVT_DCACHE_ON == 1)
+        SCB_InvalidateDCache_by_Addr(eadc_var->dma_trans_buf + (u32Half * u32HalfLen), u32HalfLen * sizeof(uint16_t));
+#endif
+
+        if (eadc_var->stream_handler(eadc_var->stream_userdata, u32Half))
+            eadc_var->stream_busy |= (1 << u32Half);
+        else
+            eadc_var->stream_overrun ++;
+
+        return;
+    }
+
+#if (NVT_DCACHE_ON == 1)
+    // Drop stale lines, CPU must see the samples written by PDMA
+    if ((event_dma & NU_PDMA_EVENT_TRANSFER_DONE) && (eadc_var->dma_trans_buf))
+        SCB_InvalidateDCache_by_Addr(eadc_var->dma_trans_buf, eadc_var->dma_trans_len * sizeof(uint16_t));
+#endif
+
+    eadc_var->dma_event |= event_dma;
+}
+
+static void EADC_SetAverage(
+    EADC_T *eadc,
+    uint32_t u32ModuleMask,
+    uint32_t u32Average
+)
+{
+    uint32_t u32Module;
+    uint32_t u32ACU = 0;
+
+    while ((1ul << u32ACU) < u32Average)
+        u32ACU ++;
+
+    for(u32Module = 0; u32Module <= EADC_LAST_GPIO_MODULE; u32Module ++) {
+        if((u32ModuleMask & (1 << u32Module)) == 0)
+            continue;
+
+        eadc->SCTL[u32Module] &= ~(EADC_SCTL_ACU_Msk | EADC_SCTL_AVG_Msk);
+
+        if(u32ACU)
+            eadc->SCTL[u32Module] |= (u32ACU << EADC_SCTL_ACU_Pos) | EADC_SCTL_AVG_Msk;
+    }
+}
+
+static int32_t EADC_TimerPDMASetup(
+    eadc_t *psObj,
+    TIMER_T *timer,
+    uint32_t u32ModuleMask,
+    uint32_t u32Average,
+    uint16_t *pu16Buf,
+    uint32_t u32BufLen,
+    struct nu_eadc_var **ppsVar
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->eadc, eadc_modinit_tab);
+
+    if(modinit == NULL)
+        return -1;
+
+    struct nu_eadc_var *eadc_var = (struct nu_eadc_var *)modinit->var;
+    uint32_t u32Trigger;
+    uint32_t u32Module;
+
+    if((u32ModuleMask == 0) || (u32BufLen == 0) || (pu16Buf == NULL))
+        return -1;
+
+    if((u32Average == 0) || (u32Average > 256) || (u32Average & (u32Average - 1)))
+        return -1;
+
+    if((u32Average > 1) && (u32ModuleMask >> (EADC_LAST_GPIO_MODULE + 1)))
+        return -1;
+
+    if(EADC_GetTimerTrigger(timer, &u32Trigger) != 0)
+        return -1;
+
+    //A running conversion or stream is stopped by its owner first
+    if((eadc_var->dma_chn_id_rx != NU_PDMA_OUT_OF_CHANNELS) || (EADC_IsInUse(eadc_var, u32ModuleMask, timer)))
+        return -4;
+
+    eadc_var->dma_chn_id_rx = nu_pdma_channel_dynamic_allocate(eadc_var->pdma_perp_rx);
+
+    if(eadc_var->dma_chn_id_rx == NU_PDMA_OUT_OF_CHANNELS)
+        return -1;
+
+    eadc_var->psObj = psObj;
+    eadc_var->timer = timer;
+    eadc_var->module_mask = u32ModuleMask;
+    eadc_var->dma_trans_buf = pu16Buf;
+    eadc_var->dma_trans_len = u32BufLen;
+    eadc_var->dma_event = 0;
+    eadc_var->stream_handler = NULL;
+
+    nu_pdma_filtering_set(eadc_var->dma_chn_id_rx, NU_PDMA_EVENT_TRANSFER_DONE | NU_PDMA_EVENT_ABORT);
+
+    {
+        struct nu_pdma_chn_cb pdma_rx_chn_cb;
+
+        pdma_rx_chn_cb.m_eCBType = eCBType_Event;
+        pdma_rx_chn_cb.m_pfnCBHandler = EADC_DMA_Handler_RX;
+        pdma_rx_chn_cb.m_pvUserData = psObj;
+
+        nu_pdma_callback_register(eadc_var->dma_chn_id_rx, &pdma_rx_chn_cb);
+    }
+
+    // Sample module n <----> channel n, all of them are triggered by the same timer event
+    for(u32Module = 0; u32Module < 32; u32Module ++) {
+        if(u32ModuleMask & (1 << u32Module))
+            EADC_ConfigSampleModule(psObj->eadc, u32Module, u32Trigger, u32Module);
+    }
+
+    EADC_SetAverage(psObj->eadc, u32ModuleMask, u32Average);
+
+    *ppsVar = eadc_var;
+    return 0;
+}
+
+static void EADC_TimerPDMAEnable(
+    eadc_t *psObj,
+    TIMER_T *timer,
+    uint32_t u32ModuleMask
+)
+{
+    /* Enable the PDMA request of the sample modules */
+    EADC_ENABLE_SAMPLE_MODULE_PDMA(psObj->eadc, u32ModuleMask);
+
+    // Keep the other trigger targets (DAC, EPWM...) of this timer untouched
+    timer->TRGCTL |= TIMER_TRGCTL_TRGEADC_Msk;
+}
+
+int32_t EADC_TimerPDMAConv(
+    eadc_t *psObj,
+    TIMER_T *timer,
+    uint32_t u32ModuleMask,
+    uint16_t *pu16Buf,
+    uint32_t u32BufLen
+)
+{
+    struct nu_eadc_var *eadc_var;
+    int32_t i32Ret = EADC_TimerPDMASetup(psObj, timer, u32ModuleMask, 1, pu16Buf, u32BufLen, &eadc_var);
+
+    if(i32Ret != 0)
+        return i32Ret;
+
+    nu_pdma_transfer( eadc_var->dma_chn_id_rx,
+                      16,
+                      (uint32_t)&(psObj->eadc)->CURDAT,
+                      (uint32_t)pu16Buf,
+                      u32BufLen,
+                      0
+                    );
+
+    EADC_TimerPDMAEnable(psObj, timer, u32ModuleMask);
+
+    return 0;
+}
+
+int32_t EADC_TimerPDMAStreamStart(
+    eadc_t *psObj,
+    TIMER_T *timer,
+    uint32_t u32ModuleMask,
+    uint32_t u32Average,
+    uint16_t *pu16Buf,
+    uint32_t u32BufLen,
+    PFN_EADC_STREAM_HANDLER pfnHandler,
+    void *pvUserData
+)
+{
+    struct nu_eadc_var *eadc_var;
+    uint32_t u32HalfLen = u32BufLen / 2;
+    int32_t i32Ret;
+
+    if((pfnHandler == NULL) || (u32BufLen & 1) || (u32HalfLen > NU_PDMA_MAX_TXCNT))
+        return -1;
+
+    i32Ret = EADC_TimerPDMASetup(psObj, timer, u32ModuleMask, u32Average, pu16Buf, u32BufLen, &eadc_var);
+    if(i32Ret != 0)
+        return i32Ret;
+
+    if(nu_pdma_sgtbls_allocate(eadc_var->stream_desc, 2) != 0) {
+        EADC_StopTimerPDMAConv(psObj, NULL);
+        return -1;
+    }
+
+    // Two descriptors linked in a ring, each one raises transfer done when its half is filled
+    nu_pdma_desc_setup(eadc_var->dma_chn_id_rx, eadc_var->stream_desc[0], 16,
+                       (uint32_t)&(psObj->eadc)->CURDAT, (uint32_t)pu16Buf,
+                       u32HalfLen, eadc_var->stream_desc[1], 0);
+    nu_pdma_desc_setup(eadc_var->dma_chn_id_rx, eadc_var->stream_desc[1], 16,
+                       (uint32_t)&(psObj->eadc)->CURDAT, (uint32_t)(pu16Buf + u32HalfLen),
+                       u32HalfLen, eadc_var->stream_desc[0], 0);
+
+    eadc_var->stream_handler = pfnHandler;
+    eadc_var->stream_userdata = pvUserData;
+    eadc_var->stream_half = 0;
+    eadc_var->stream_busy = 0;
+    eadc_var->stream_overrun = 0;
+
+    nu_pdma_sg_transfer(eadc_var->dma_chn_id_rx, eadc_var->stream_desc[0], 0);
+
+    EADC_TimerPDMAEnable(psObj, timer, u32ModuleMask);
+
+    return 0;
+}
+
+void EADC_TimerPDMAStreamRelease(
+    eadc_t *psObj,
+    uint32_t u32Half
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->eadc, eadc_modinit_tab);
+
+    if(modinit == NULL)
+        return;
+
+    struct nu_eadc_var *eadc_var = (struct nu_eadc_var *)modinit->var;
+
+    uint32_t u32Primask = __get_PRIMASK();
+
+    __disable_irq();
+    eadc_var->stream_busy &= ~(1 << (u32Half & 1));
+    __set_PRIMASK(u32Primask);
+}
+
+uint32_t EADC_TimerPDMAStreamOverrun(
+    eadc_t *psObj
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->eadc, eadc_modinit_tab);
+
+    if(modinit == NULL)
+        return 0;
+
+    struct nu_eadc_var *eadc_var = (struct nu_eadc_var *)modinit->var;
+
+    return eadc_var->stream_overrun;
+}
+
+bool EADC_IsPDMAConvDone(
+    eadc_t *psObj
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->eadc, eadc_modinit_tab);
+
+    if(modinit == NULL)
+        return true;
+
+    struct nu_eadc_var *eadc_var = (struct nu_eadc_var *)modinit->var;
+
+    if(eadc_var->dma_chn_id_rx == NU_PDMA_OUT_OF_CHANNELS)
+        return true;
+
+    return (eadc_var->dma_event & (NU_PDMA_EVENT_TRANSFER_DONE | NU_PDMA_EVENT_ABORT)) ? true : false;
+}
+
+int32_t EADC_StopTimerPDMAConv(
+    eadc_t *psObj,
+    TIMER_T *timer
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->eadc, eadc_modinit_tab);
+
+    if(modinit == NULL)
+        return -1;
+
+    struct nu_eadc_var *eadc_var = (struct nu_eadc_var *)modinit->var;
+    uint32_t u32Module;
+
+    if(timer == NULL)
+        timer = eadc_var->timer;
+
+    if(timer)
+        timer->TRGCTL &= ~TIMER_TRGCTL_TRGEADC_Msk;
+
+    EADC_DISABLE_SAMPLE_MODULE_PDMA(psObj->eadc, eadc_var->module_mask);
+    EADC_SetAverage(psObj->eadc, eadc_var->module_mask, 1);
+
+    // Give the sample modules back to software trigger
+    for(u32Module = 0; u32Module < 32; u32Module ++) {
+        if(eadc_var->module_mask & (1 << u32Module))
+            EADC_ConfigSampleModule(psObj->eadc, u32Module, EADC_SOFTWARE_TRIGGER, u32Module);
+    }
+
+    if (eadc_var->dma_chn_id_rx != NU_PDMA_OUT_OF_CHANNELS) {
+        nu_pdma_channel_terminate(eadc_var->dma_chn_id_rx);
+        nu_pdma_channel_free(eadc_var->dma_chn_id_rx);
+        eadc_var->dma_chn_id_rx = NU_PDMA_OUT_OF_CHANNELS;
+    }
+
+    if(eadc_var->stream_handler) {
+        nu_pdma_sgtbls_free(eadc_var->stream_desc, 2);
+        eadc_var->stream_handler = NULL;
+        eadc_var->stream_userdata = NULL;
+    }
+
+    eadc_var->psObj = NULL;
+    eadc_var->timer = NULL;
+    eadc_var->module_mask = 0;
+    eadc_var->dma_trans_buf = NULL;
+    eadc_var->dma_trans_len = 0;
+
+    return 0;
+}
+
+int32_t EADC_CompareStart(
+    eadc_t *psObj,
+    TIMER_T *timer,
+    uint32_t u32Module,
+    uint32_t u32Low,
+    uint32_t u32High,
+    uint32_t u32Count,
+    PFN_EADC_CMP_HANDLER pfnHandler,
+    void *pvUserData
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->eadc, eadc_modinit_tab);
+
+    if(modinit == NULL)
+        return -1;
+
+    struct nu_eadc_var *eadc_var = (struct nu_eadc_var *)modinit->var;
+    uint32_t u32Trigger = EADC_ADINT1_TRIGGER;
+
+    if((pfnHandler == NULL) || (u32Module > EADC_LAST_GPIO_MODULE))
+        return -1;
+
+    if((u32Count == 0) || (u32Count > EADC_CMP_MAX_MCNT) || (u32Low > u32High) || (u32High > EADC_MAX_DATA))
+        return -1;
+
+    if(timer && (EADC_GetTimerTrigger(timer, &u32Trigger) != 0))
+        return -1;
+
+    EADC_CompareStop(psObj);
+
+    if(EADC_IsInUse(eadc_var, (1 << u32Module), timer))
+        return -4;
+
+    eadc_var->cmp_module = u32Module;
+    eadc_var->cmp_timer = timer;
+    eadc_var->cmp_userdata = pvUserData;
+    eadc_var->cmp_handler = pfnHandler;
+
+    EADC_ConfigSampleModule(psObj->eadc, u32Module, u32Trigger, u32Module);
+
+    psObj->eadc->CMP[0] = 0;
+    psObj->eadc->CMP[1] = 0;
+
+    // Both ends of the window are checked by a comparator of its own, the window is left when either one matches
+    if(u32Low > 0) {
+        EADC_ENABLE_CMP0(psObj->eadc, u32Module, EADC_CMP_CMPCOND_LESS_THAN, u32Low, u32Count);
+        EADC_ENABLE_CMP_INT(psObj->eadc, 0);
+    }
+
+    if(u32High < EADC_MAX_DATA) {
+        EADC_ENABLE_CMP1(psObj->eadc, u32Module, EADC_CMP_CMPCOND_GREATER_OR_EQUAL, u32High + 1, u32Count);
+        EADC_ENABLE_CMP_INT(psObj->eadc, 1);
+    }
+
+    EADC_CLR_INT_FLAG(psObj->eadc, EADC_STATUS2_ADCMPF0_Msk | EADC_STATUS2_ADCMPF1_Msk);
+
+    /* Compare interrupts are reported on ADINT0 */
+    EADC_ENABLE_INT(psObj->eadc, BIT0);
+    NVIC_EnableIRQ(modinit->irq_n);
+
+    if(timer) {
+        timer->TRGCTL |= TIMER_TRGCTL_TRGEADC_Msk;
+    } else {
+        // Free running: end of conversion raises ADINT1 which triggers the next one, once ADIF1 is cleared
+        EADC_CLR_INT_FLAG(psObj->eadc, EADC_STATUS2_ADIF1_Msk);
+        EADC_ENABLE_SAMPLE_MODULE_INT(psObj->eadc, 1, (1 << u32Module));
+        EADC_ENABLE_INT(psObj->eadc, BIT1);
+        NVIC_EnableIRQ(eadc_var->adint1_irq_n);
+        EADC_START_CONV(psObj->eadc, (1 << u32Module));
+    }
+
+    return 0;
+}
+
+void EADC_CompareRearm(
+    eadc_t *psObj
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->eadc, eadc_modinit_tab);
+
+    if(modinit == NULL)
+        return;
+
+    struct nu_eadc_var *eadc_var = (struct nu_eadc_var *)modinit->var;
+
+    if(eadc_var->cmp_handler == NULL)
+        return;
+
+    EADC_CLR_INT_FLAG(psObj->eadc, EADC_STATUS2_ADCMPF0_Msk | EADC_STATUS2_ADCMPF1_Msk);
+
+    if(psObj->eadc->CMP[0] & EADC_CMP_ADCMPEN_Msk)
+        EADC_ENABLE_CMP_INT(psObj->eadc, 0);
+
+    if(psObj->eadc->CMP[1] & EADC_CMP_ADCMPEN_Msk)
+        EADC_ENABLE_CMP_INT(psObj->eadc, 1);
+}
+
+int32_t EADC_CompareStop(
+    eadc_t *psObj
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->eadc, eadc_modinit_tab);
+
+    if(modinit == NULL)
+        return -1;
+
+    struct nu_eadc_var *eadc_var = (struct nu_eadc_var *)modinit->var;
+
+    if(eadc_var->cmp_handler == NULL)
+        return 0;
+
+    uint32_t u32ModuleMask = (1 << eadc_var->cmp_module);
+    uint32_t u32Timeout = EADC_SCAN_TIMEOUT;
+
+    NVIC_DisableIRQ(modinit->irq_n);
+    NVIC_DisableIRQ(eadc_var->adint1_irq_n);
+
+    if(eadc_var->cmp_timer)
+        eadc_var->cmp_timer->TRGCTL &= ~TIMER_TRGCTL_TRGEADC_Msk;
+
+    // Take the ADINT1/timer trigger away from the module first, a conversion ending now does not restart it
+    EADC_ConfigSampleModule(psObj->eadc, eadc_var->cmp_module, EADC_SOFTWARE_TRIGGER, eadc_var->cmp_module);
+
+    EADC_DISABLE_SAMPLE_MODULE_INT(psObj->eadc, 1, u32ModuleMask);
+    EADC_DISABLE_INT(psObj->eadc, BIT0 | BIT1);
+
+    // Drop a pending trigger and let a conversion in progress end before its flags are cleared
+    EADC_STOP_CONV(psObj->eadc, u32ModuleMask);
+    while((EADC_IS_BUSY(psObj->eadc)) && (--u32Timeout > 0));
+
+    psObj->eadc->CMP[0] = 0;
+    psObj->eadc->CMP[1] = 0;
+    EADC_CLR_INT_FLAG(psObj->eadc, EADC_STATUS2_ADCMPF0_Msk | EADC_STATUS2_ADCMPF1_Msk | EADC_STATUS2_ADIF0_Msk | EADC_STATUS2_ADIF1_Msk);
+
+    // Reading the data register clears the valid flag of the last window conversion
+    (void)EADC_GET_CONV_DATA(psObj->eadc, eadc_var->cmp_module);
+
+    eadc_var->cmp_handler = NULL;
+    eadc_var->cmp_userdata = NULL;
+    eadc_var->cmp_timer = NULL;
+
+    return 0;
+}
+
+void Handle_EADC_Irq(EADC_T *eadc, uint32_t u32IntNum)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)eadc, eadc_modinit_tab);
+
+    if(modinit == NULL)
+        return;
+
+    struct nu_eadc_var *eadc_var = (struct nu_eadc_var *)modinit->var;
+
+    if(u32IntNum == 1) {
+        // Free running compare: clearing ADIF1 gives the edge that triggers the next conversion
+        EADC_CLR_INT_FLAG(eadc, EADC_STATUS2_ADIF1_Msk);
+        return;
+    }
+
+    uint32_t u32Flags = eadc->STATUS2 & (EADC_STATUS2_ADCMPF0_Msk | EADC_STATUS2_ADCMPF1_Msk);
+    uint32_t u32Status = 0;
+
+    EADC_CLR_INT_FLAG(eadc, u32Flags | EADC_STATUS2_ADIF0_Msk);
+
+    if(u32Flags & EADC_STATUS2_ADCMPF0_Msk)
+        u32Status |= EADC_CMP_BELOW_LOW;
+
+    if(u32Flags & EADC_STATUS2_ADCMPF1_Msk)
+        u32Status |= EADC_CMP_ABOVE_HIGH;
+
+    if((u32Status == 0) || (eadc_var->cmp_handler == NULL))
+        return;
+
+    // One report per excursion, the consumer rearms when it is done
+    EADC_DISABLE_CMP_INT(eadc, 0);
+    EADC_DISABLE_CMP_INT(eadc, 1);
+
+    eadc_var->cmp_handler(eadc_var->cmp_userdata, u32Status);
+}
@@ -0,0 +1,114 @@
+/**************************************************************************//**
+ * @file     M55M1_EADC.h
+ * @version  V1.00
+ * @brief    M55M1 EADC HAL header file for micropython
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * @copyright (C) 2025 Nuvoton Technology Corp. All rights reserved.
+ *****************************************************************************/
+#ifndef __M55M1_EADC_H__
+#define __M55M1_EADC_H__
+
+typedef struct {
+    EADC_T *eadc;
+} eadc_t;
+
+//Called in PDMA interrupt context when half u32Half (0/1) of the stream buffer is filled.
+//Return true if the half is handed over to the consumer, it must be given back by EADC_TimerPDMAStreamRelease().
+typedef bool (*PFN_EADC_STREAM_HANDLER)(void *pvUserData, uint32_t u32Half);
+
+//Convert the sample modules in u32ModuleMask in one sequence started by a single software trigger.
+//The results are stored into pu16Buf in ascending sample module order (count of bits in u32ModuleMask).
+int32_t EADC_ScanConv(
+    eadc_t *psObj,
+    uint32_t u32ModuleMask,
+    uint16_t *pu16Buf
+);
+
+//Timer triggered conversion, sample modules in u32ModuleMask are converted on each timer event
+//and the results (EADC CURDAT) are moved by PDMA into pu16Buf. Sample module n converts channel n.
+//Samples of the same timer event are stored in ascending sample module order.
+//Returns -4 while a conversion or stream runs, or if the modules or the timer are used by the window comparator.
+int32_t EADC_TimerPDMAConv(
+    eadc_t *psObj,
+    TIMER_T *timer,
+    uint32_t u32ModuleMask,
+    uint16_t *pu16Buf,
+    uint32_t u32BufLen		//count of uint16_t
+);
+
+//Circular version of EADC_TimerPDMAConv. pu16Buf is split into two halves, pfnHandler is called each time
+//a half is filled while PDMA goes on with the other one. u32Average: 1, 2, 4 ... 256 conversions per trigger
+//are averaged by the EADC accumulator (sample module 0~23 only).
+int32_t EADC_TimerPDMAStreamStart(
+    eadc_t *psObj,
+    TIMER_T *timer,
+    uint32_t u32ModuleMask,
+    uint32_t u32Average,
+    uint16_t *pu16Buf,
+    uint32_t u32BufLen,		//count of uint16_t, even
+    PFN_EADC_STREAM_HANDLER pfnHandler,
+    void *pvUserData
+);
+
+void EADC_TimerPDMAStreamRelease(
+    eadc_t *psObj,
+    uint32_t u32Half
+);
+
+//Number of halves overwritten before being released or not handed over
+uint32_t EADC_TimerPDMAStreamOverrun(
+    eadc_t *psObj
+);
+
+#define EADC_CMP_BELOW_LOW		(1 << 0)
+#define EADC_CMP_ABOVE_HIGH		(1 << 1)
+
+//Called in EADC interrupt context with EADC_CMP_BELOW_LOW/EADC_CMP_ABOVE_HIGH. The compare interrupt
+//stays disabled until EADC_CompareRearm() is called.
+typedef void (*PFN_EADC_CMP_HANDLER)(void *pvUserData, uint32_t u32Status);
+
+//Watch the result of sample module u32Module with compare unit 0 (< u32Low) and 1 (> u32High).
+//An interrupt is raised when the condition holds for u32Count (1~16) conversions.
+//timer: trigger source of the sample module, NULL for free running (module re-triggered by its own ADINT1)
+//Returns -4 if the module or the timer is used by a timed conversion or a stream.
+int32_t EADC_CompareStart(
+    eadc_t *psObj,
+    TIMER_T *timer,
+    uint32_t u32Module,
+    uint32_t u32Low,
+    uint32_t u32High,
+    uint32_t u32Count,
+    PFN_EADC_CMP_HANDLER pfnHandler,
+    void *pvUserData
+);
+
+void EADC_CompareRearm(
+    eadc_t *psObj
+);
+
+//Stop watching: the module goes back to software trigger with no conversion left pending or running
+int32_t EADC_CompareStop(
+    eadc_t *psObj
+);
+
+bool EADC_IsPDMAConvDone(
+    eadc_t *psObj
+);
+
+//Sample modules in u32ModuleMask are used by a timed conversion, a stream or the window comparator
+bool EADC_IsModuleBusy(
+    eadc_t *psObj,
+    uint32_t u32ModuleMask
+);
+
+//Stop timed conversion or stream, timer may be NULL to use the one given at start
+int32_t EADC_StopTimerPDMAConv(
+    eadc_t *psObj,
+    TIMER_T *timer
+);
+
+//u32IntNum: 0 for ADINT0 (compare), 1 for ADINT1 (free running compare trigger)
+void Handle_EADC_Irq(EADC_T *eadc, uint32_t u32IntNum);
+
+#endif
@@ -0,0 +1,207 @@
+/**************************************************************************//**
+ * @file     M55M1_EQEI.c
+ * @version  V0.01
+ * @brief    M55M1 series EQEI HAL source file
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * @copyright (C) 2025 Nuvoton Technology Corp. All rights reserved.
+ *****************************************************************************/
+
+#include "NuMicro.h"
+
+#include "M55M1_EQEI.h"
+#include "nu_modutil.h"
+
+struct nu_eqei_var {
+    eqei_t *    psObj;
+    uint32_t    (*pfnGetPCLK)(void);		//APB clock of the unit, clocks the unit timer
+
+    uint32_t    speed_window_us;		//unit timer period, 0 if speed capture is off
+    uint64_t    speed_modulus;			//count range of compare counting modes, 0 for free counting
+    uint32_t    speed_hold;				//CNTHOLD of the previous window
+    volatile int32_t speed_cnt;			//counts in the last complete window
+};
+
+static struct nu_eqei_var eqei0_var = {
+    .psObj              =   NULL,
+    .pfnGetPCLK         =   CLK_GetPCLK0Freq,
+};
+
+static struct nu_eqei_var eqei1_var = {
+    .psObj              =   NULL,
+    .pfnGetPCLK         =   CLK_GetPCLK2Freq,
+};
+
+static struct nu_eqei_var eqei2_var = {
+    .psObj              =   NULL,
+    .pfnGetPCLK         =   CLK_GetPCLK0Freq,
+};
+
+static struct nu_eqei_var eqei3_var = {
+    .psObj              =   NULL,
+    .pfnGetPCLK         =   CLK_GetPCLK2Freq,
+};
+
+static const struct nu_modinit_s eqei_modinit_tab[] = {
+    {(uint32_t)EQEI0, EQEI0_MODULE, MODULE_NoMsk, MODULE_NoMsk, SYS_EQEI0RST, EQEI0_IRQn, &eqei0_var},
+    {(uint32_t)EQEI1, EQEI1_MODULE, MODULE_NoMsk, MODULE_NoMsk, SYS_EQEI1RST, EQEI1_IRQn, &eqei1_var},
+    {(uint32_t)EQEI2, EQEI2_MODULE, MODULE_NoMsk, MODULE_NoMsk, SYS_EQEI2RST, EQEI2_IRQn, &eqei2_var},
+    {(uint32_t)EQEI3, EQEI3_MODULE, MODULE_NoMsk, MODULE_NoMsk, SYS_EQEI3RST, EQEI3_IRQn, &eqei3_var},
+
+    {0, 0, 0, 0, 0, (IRQn_Type) 0, NULL}
+};
+
+int32_t EQEI_Init(
+    eqei_t *psObj,
+    EQEI_InitTypeDef *psInitDef
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->eqei, eqei_modinit_tab);
+
+    if(modinit == NULL)
+        return -1;
+
+    struct nu_eqei_var *eqei_var = (struct nu_eqei_var *)modinit->var;
+    uint32_t u32UTTicks = 0;
+
+    if(psInitDef->u32SpeedWindowUs) {
+        u32UTTicks = (uint32_t)(((uint64_t)eqei_var->pfnGetPCLK() * psInitDef->u32SpeedWindowUs) / 1000000UL);
+        if(u32UTTicks < 2)
+            return -1;
+    }
+
+    NVIC_DisableIRQ(modinit->irq_n);
+
+    // Reset this module
+    SYS_ResetModule(modinit->rsetidx);
+
+    // Enable IP clock
+    CLK_EnableModuleClock(modinit->clkidx);
+
+    eqei_var->psObj = psObj;
+    eqei_var->speed_window_us = psInitDef->u32SpeedWindowUs;
+    eqei_var->speed_cnt = 0;
+    eqei_var->speed_hold = 0;
+    eqei_var->speed_modulus = 0;
+
+    if((psInitDef->u32Mode == EQEI_CTL_X4_COMPARE_COUNTING_MODE) || (psInitDef->u32Mode == EQEI_CTL_X2_COMPARE_COUNTING_MODE))
+        eqei_var->speed_modulus = (uint64_t)psInitDef->u32MaxCount + 1;
+
+    EQEI_Open(psObj->eqei, psInitDef->u32Mode, psInitDef->u32MaxCount);
+
+    /* Filter glitches shorter than a few PCLK cycles on A/B/index */
+    EQEI_ENABLE_NOISE_FILTER(psObj->eqei, EQEI_CTL_NFCLKSEL_DIV1);
+
+    if(psInitDef->bIndexLatch)
+        EQEI_ENABLE_INDEX_LATCH(psObj->eqei);
+
+    if(u32UTTicks) {
+        // Each unit timer event holds CNT into CNTHOLD and restarts the window, the interrupt takes the delta
+        psObj->eqei->UTCMP = u32UTTicks - 1;
+        psObj->eqei->CTL2 |= EQEI_CTL2_UTEN_Msk | EQEI_CTL2_UTHOLDEN_Msk | EQEI_CTL2_UTEVTRST_Msk | EQEI_CTL2_UTIEN_Msk;
+        EQEI_CLR_INT_FLAG(psObj->eqei, EQEI_STATUS_UTIEF_Msk);
+        NVIC_EnableIRQ(modinit->irq_n);
+    }
+
+    EQEI_Start(psObj->eqei);
+
+    return 0;
+}
+
+void EQEI_SetPosition(
+    eqei_t *psObj,
+    uint32_t u32Position
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->eqei, eqei_modinit_tab);
+
+    if(modinit == NULL)
+        return;
+
+    struct nu_eqei_var *eqei_var = (struct nu_eqei_var *)modinit->var;
+    uint32_t u32Primask = __get_PRIMASK();
+
+    // The current window would see the jump as a speed
+    __disable_irq();
+    EQEI_Stop(psObj->eqei);
+    psObj->eqei->CNT = u32Position;
+    eqei_var->speed_hold = u32Position;
+    EQEI_Start(psObj->eqei);
+    __set_PRIMASK(u32Primask);
+}
+
+int32_t EQEI_GetSpeed(
+    eqei_t *psObj,
+    uint32_t *pu32WindowUs
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->eqei, eqei_modinit_tab);
+
+    if(modinit == NULL)
+        return 0;
+
+    struct nu_eqei_var *eqei_var = (struct nu_eqei_var *)modinit->var;
+
+    if(pu32WindowUs)
+        *pu32WindowUs = eqei_var->speed_window_us;
+
+    return eqei_var->speed_cnt;
+}
+
+void Handle_EQEI_Irq(EQEI_T *eqei)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)eqei, eqei_modinit_tab);
+
+    if(modinit == NULL)
+        return;
+
+    struct nu_eqei_var *eqei_var = (struct nu_eqei_var *)modinit->var;
+    uint32_t u32Hold;
+    int64_t i64Delta;
+
+    if(!EQEI_GET_INT_FLAG(eqei, EQEI_STATUS_UTIEF_Msk))
+        return;
+
+    EQEI_CLR_INT_FLAG(eqei, EQEI_STATUS_UTIEF_Msk);
+
+    u32Hold = eqei->CNTHOLD;
+
+    if(eqei_var->speed_modulus) {
+        // Compare counting wraps at CNTMAX, take the shortest way around the range
+        i64Delta = (int64_t)u32Hold - (int64_t)eqei_var->speed_hold;
+
+        if(i64Delta > (int64_t)(eqei_var->speed_modulus / 2))
+            i64Delta -= eqei_var->speed_modulus;
+        else if(i64Delta < -(int64_t)(eqei_var->speed_modulus / 2))
+            i64Delta += eqei_var->speed_modulus;
+    } else {
+        i64Delta = (int32_t)(u32Hold - eqei_var->speed_hold);
+    }
+
+    eqei_var->speed_hold = u32Hold;
+    eqei_var->speed_cnt = (int32_t)i64Delta;
+}
+
+void EQEI_Final(
+    eqei_t *psObj
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->eqei, eqei_modinit_tab);
+
+    if(modinit == NULL)
+        return;
+
+    struct nu_eqei_var *eqei_var = (struct nu_eqei_var *)modinit->var;
+
+    eqei_var->psObj = NULL;
+    eqei_var->speed_window_us = 0;
+
+    NVIC_DisableIRQ(modinit->irq_n);
+    psObj->eqei->CTL2 &= ~(EQEI_CTL2_UTEN_Msk | EQEI_CTL2_UTHOLDEN_Msk | EQEI_CTL2_UTEVTRST_Msk | EQEI_CTL2_UTIEN_Msk);
+
+    EQEI_Stop(psObj->eqei);
+    EQEI_Close(psObj->eqei);
+
+    // Disable IP clock
+    CLK_DisableModuleClock(modinit->clkidx);
+}
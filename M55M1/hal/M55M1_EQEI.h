@@ -0,0 +1,48 @@
+/**************************************************************************//**
+ * @file     M55M1_EQEI.h
+ * @version  V1.00
+ * @brief    M55M1 EQEI HAL header file for micropython
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * @copyright (C) 2025 Nuvoton Technology Corp. All rights reserved.
+ *****************************************************************************/
+#ifndef __M55M1_EQEI_H__
+#define __M55M1_EQEI_H__
+
+typedef struct {
+    EQEI_T *eqei;
+} eqei_t;
+
+typedef struct {
+    uint32_t u32Mode;		//EQEI_CTL_X4_FREE_COUNTING_MODE, EQEI_CTL_X2_FREE_COUNTING_MODE,
+    //EQEI_CTL_X4_COMPARE_COUNTING_MODE, EQEI_CTL_X2_COMPARE_COUNTING_MODE
+    uint32_t u32MaxCount;	//counter wraps to 0 above u32MaxCount in compare counting modes
+    bool bIndexLatch;		//latch the counter into CNTLATCH on each index pulse
+    uint32_t u32SpeedWindowUs;	//unit timer window of the speed capture, 0 to disable
+} EQEI_InitTypeDef;
+
+int32_t EQEI_Init(
+    eqei_t *psObj,
+    EQEI_InitTypeDef *psInitDef
+);
+
+void EQEI_Final(
+    eqei_t *psObj
+);
+
+//Load the position counter, the speed capture goes on from the new position
+void EQEI_SetPosition(
+    eqei_t *psObj,
+    uint32_t u32Position
+);
+
+//Counts of the last complete speed window, taken by the unit timer hold in the EQEI interrupt.
+//pu32WindowUs (may be NULL) gets the window length, 0 if speed capture is off.
+int32_t EQEI_GetSpeed(
+    eqei_t *psObj,
+    uint32_t *pu32WindowUs
+);
+
+void Handle_EQEI_Irq(EQEI_T *eqei);
+
+#endif
@@ -0,0 +1,401 @@
+/**************************************************************************//**
+ * @file     M55M1_GPIO.c
+ * @version  V0.01
+ * @brief    M55M1 series GPIO port HAL source file
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * @copyright (C) 2025 Nuvoton Technology Corp. All rights reserved.
+ *****************************************************************************/
+
+#include "NuMicro.h"
+
+#include "M55M1_GPIO.h"
+#include "nu_modutil.h"
+#include "drv_pdma.h"
+
+struct nu_gpio_var {
+    gpio_port_t *psObj;
+    TIMER_T     *timer;
+
+    int         dma_chn_id;
+    uint32_t    dma_data_width;
+    uint32_t    dma_trans_len;
+    nu_pdma_desc_t dma_desc;			//self linked descriptor of circular transfer
+    void        *dma_rx_buf;			//capture buffer, NULL for pattern output
+    volatile bool dma_done;
+
+    uint32_t    datmsk;					//DATMSK before the transfer
+};
+
+static struct nu_gpio_var gpioa_var = {
+    .psObj              =   NULL,
+    .dma_chn_id         =   NU_PDMA_OUT_OF_CHANNELS,
+};
+
+static struct nu_gpio_var gpiob_var = {
+    .psObj              =   NULL,
+    .dma_chn_id         =   NU_PDMA_OUT_OF_CHANNELS,
+};
+
+static struct nu_gpio_var gpioc_var = {
+    .psObj              =   NULL,
+    .dma_chn_id         =   NU_PDMA_OUT_OF_CHANNELS,
+};
+
+static struct nu_gpio_var gpiod_var = {
+    .psObj              =   NULL,
+    .dma_chn_id         =   NU_PDMA_OUT_OF_CHANNELS,
+};
+
+static struct nu_gpio_var gpioe_var = {
+    .psObj              =   NULL,
+    .dma_chn_id         =   NU_PDMA_OUT_OF_CHANNELS,
+};
+
+static struct nu_gpio_var gpiof_var = {
+    .psObj              =   NULL,
+    .dma_chn_id         =   NU_PDMA_OUT_OF_CHANNELS,
+};
+
+static struct nu_gpio_var gpiog_var = {
+    .psObj              =   NULL,
+    .dma_chn_id         =   NU_PDMA_OUT_OF_CHANNELS,
+};
+
+static struct nu_gpio_var gpioh_var = {
+    .psObj              =   NULL,
+    .dma_chn_id         =   NU_PDMA_OUT_OF_CHANNELS,
+};
+
+static struct nu_gpio_var gpioi_var = {
+    .psObj              =   NULL,
+    .dma_chn_id         =   NU_PDMA_OUT_OF_CHANNELS,
+};
+
+static struct nu_gpio_var gpioj_var = {
+    .psObj              =   NULL,
+    .dma_chn_id         =   NU_PDMA_OUT_OF_CHANNELS,
+};
+
+static const struct nu_modinit_s gpio_modinit_tab[] = {
+    {(uint32_t)PA, GPIOA_MODULE, MODULE_NoMsk, MODULE_NoMsk, 0, GPA_IRQn, &gpioa_var},
+    {(uint32_t)PB, GPIOB_MODULE, MODULE_NoMsk, MODULE_NoMsk, 0, GPB_IRQn, &gpiob_var},
+    {(uint32_t)PC, GPIOC_MODULE, MODULE_NoMsk, MODULE_NoMsk, 0, GPC_IRQn, &gpioc_var},
+    {(uint32_t)PD, GPIOD_MODULE, MODULE_NoMsk, MODULE_NoMsk, 0, GPD_IRQn, &gpiod_var},
+    {(uint32_t)PE, GPIOE_MODULE, MODULE_NoMsk, MODULE_NoMsk, 0, GPE_IRQn, &gpioe_var},
+    {(uint32_t)PF, GPIOF_MODULE, MODULE_NoMsk, MODULE_NoMsk, 0, GPF_IRQn, &gpiof_var},
+    {(uint32_t)PG, GPIOG_MODULE, MODULE_NoMsk, MODULE_NoMsk, 0, GPG_IRQn, &gpiog_var},
+    {(uint32_t)PH, GPIOH_MODULE, MODULE_NoMsk, MODULE_NoMsk, 0, GPH_IRQn, &gpioh_var},
+    {(uint32_t)PI, GPIOI_MODULE, MODULE_NoMsk, MODULE_NoMsk, 0, GPI_IRQn, &gpioi_var},
+    {(uint32_t)PJ, GPIOJ_MODULE, MODULE_NoMsk, MODULE_NoMsk, 0, GPJ_IRQn, &gpioj_var},
+
+    {0, 0, 0, 0, 0, (IRQn_Type) 0, NULL}
+};
+
+//PDMA request of the timer, 0 if the timer can't request PDMA
+static uint32_t GPIO_TimerPDMAReq(
+    TIMER_T *timer
+)
+{
+    if(timer == TIMER0)
+        return PDMA_TMR0;
+    else if(timer == TIMER1)
+        return PDMA_TMR1;
+    else if(timer == TIMER2)
+        return PDMA_TMR2;
+    else if(timer == TIMER3)
+        return PDMA_TMR3;
+
+    return 0;
+}
+
+static void GPIO_DMA_Handler(void *pvUserData, uint32_t event_dma)
+{
+    struct nu_gpio_var *gpio_var = (struct nu_gpio_var *)pvUserData;
+
+    if (event_dma & (NU_PDMA_EVENT_TRANSFER_DONE | NU_PDMA_EVENT_ABORT)) {
+        // Stop pacing, the timer is restarted by the next transfer
+        TIMER_Stop(gpio_var->timer);
+        gpio_var->dma_done = true;
+    }
+}
+
+int32_t GPIO_TimerPDMAWrite(
+    gpio_port_t *psObj,
+    TIMER_T *timer,
+    uint32_t u32Mask,
+    const void *pvBuf,
+    uint32_t u32DataWidth,
+    uint32_t u32Len,
+    bool bCircular
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->gpio, gpio_modinit_tab);
+
+    if(modinit == NULL)
+        return -1;
+
+    struct nu_gpio_var *gpio_var = (struct nu_gpio_var *)modinit->var;
+    GPIO_T *gpio = psObj->gpio;
+    uint32_t u32PDMAReq = GPIO_TimerPDMAReq(timer);
+
+    if((u32PDMAReq == 0) || (u32Len == 0))
+        return -1;
+
+    if(!(u32DataWidth == 8 || u32DataWidth == 16 || u32DataWidth == 32))
+        return -1;
+
+    //The whole buffer is replayed by one descriptor
+    if((bCircular) && (u32Len > NU_PDMA_MAX_TXCNT))
+        return -2;
+
+    //The port is driven or sampled by another owner, e.g. PortWriter against PortReader
+    if((gpio_var->dma_chn_id != NU_PDMA_OUT_OF_CHANNELS) && (gpio_var->psObj != psObj))
+        return -4;
+
+    if(gpio_var->dma_chn_id != NU_PDMA_OUT_OF_CHANNELS)
+        GPIO_StopTimerPDMA(psObj);
+
+    CLK_EnableModuleClock(modinit->clkidx);
+
+    gpio_var->dma_chn_id = nu_pdma_channel_dynamic_allocate(u32PDMAReq);
+
+    if(gpio_var->dma_chn_id == NU_PDMA_OUT_OF_CHANNELS)
+        return -3;
+
+    gpio_var->psObj = psObj;
+    gpio_var->timer = timer;
+    gpio_var->dma_data_width = u32DataWidth;
+    gpio_var->dma_trans_len = u32Len;
+    gpio_var->dma_done = false;
+
+    // Pins out of u32Mask keep their DOUT value whatever is written by PDMA
+    gpio_var->datmsk = gpio->DATMSK;
+    gpio->DATMSK = (~u32Mask) & 0xFFFF;
+    GPIO_SetMode(gpio, u32Mask & 0xFFFF, GPIO_MODE_OUTPUT);
+
+#if (NVT_DCACHE_ON == 1)
+    // Pattern must reach memory before PDMA reads it
+    SCB_CleanDCache_by_Addr((void *)pvBuf, u32Len * (u32DataWidth / 8));
+#endif
+
+    if(bCircular) {
+        if(nu_pdma_sgtbls_allocate(&gpio_var->dma_desc, 1) != 0) {
+            GPIO_StopTimerPDMA(psObj);
+            return -3;
+        }
+
+        // Descriptor linked to itself, replays the buffer without interrupt until stopped
+        nu_pdma_desc_setup(gpio_var->dma_chn_id, gpio_var->dma_desc, u32DataWidth,
+                           (uint32_t)pvBuf, (uint32_t)&gpio->DOUT,
+                           u32Len, gpio_var->dma_desc, 1);
+
+        nu_pdma_sg_transfer(gpio_var->dma_chn_id, gpio_var->dma_desc, 0);
+    } else {
+        struct nu_pdma_chn_cb pdma_tx_chn_cb;
+
+        nu_pdma_filtering_set(gpio_var->dma_chn_id, NU_PDMA_EVENT_TRANSFER_DONE | NU_PDMA_EVENT_ABORT);
+
+        pdma_tx_chn_cb.m_eCBType = eCBType_Event;
+        pdma_tx_chn_cb.m_pfnCBHandler = GPIO_DMA_Handler;
+        pdma_tx_chn_cb.m_pvUserData = gpio_var;
+
+        nu_pdma_callback_register(gpio_var->dma_chn_id, &pdma_tx_chn_cb);
+
+        nu_pdma_transfer(gpio_var->dma_chn_id, u32DataWidth,
+                         (uint32_t)pvBuf, (uint32_t)&gpio->DOUT,
+                         u32Len, 0);
+    }
+
+    // timer have been opened, just stop and reset it
+    TIMER_Stop(timer);
+    TIMER_ResetCounter(timer);
+    //Only the PDMA trigger, the other targets of the timer are left as they are
+    timer->TRGCTL |= TIMER_TRGCTL_TRGPDMA_Msk;
+    TIMER_Start(timer);
+
+    return 0;
+}
+
+int32_t GPIO_TimerPDMARead(
+    gpio_port_t *psObj,
+    TIMER_T *timer,
+    void *pvBuf,
+    uint32_t u32DataWidth,
+    uint32_t u32Len,
+    bool bDeferStart
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->gpio, gpio_modinit_tab);
+
+    if(modinit == NULL)
+        return -1;
+
+    struct nu_gpio_var *gpio_var = (struct nu_gpio_var *)modinit->var;
+    GPIO_T *gpio = psObj->gpio;
+    uint32_t u32PDMAReq = GPIO_TimerPDMAReq(timer);
+
+    if((u32PDMAReq == 0) || (u32Len == 0))
+        return -1;
+
+    if(!(u32DataWidth == 8 || u32DataWidth == 16 || u32DataWidth == 32))
+        return -1;
+
+    //The port is driven or sampled by another owner, e.g. PortWriter against PortReader
+    if((gpio_var->dma_chn_id != NU_PDMA_OUT_OF_CHANNELS) && (gpio_var->psObj != psObj))
+        return -4;
+
+    if(gpio_var->dma_chn_id != NU_PDMA_OUT_OF_CHANNELS)
+        GPIO_StopTimerPDMA(psObj);
+
+    CLK_EnableModuleClock(modinit->clkidx);
+
+    gpio_var->dma_chn_id = nu_pdma_channel_dynamic_allocate(u32PDMAReq);
+
+    if(gpio_var->dma_chn_id == NU_PDMA_OUT_OF_CHANNELS)
+        return -3;
+
+    // Timer request is registered for memory to peripheral, capture goes the other way
+    nu_pdma_channel_memctrl_set(gpio_var->dma_chn_id, eMemCtl_SrcFix_DstInc);
+
+    gpio_var->psObj = psObj;
+    gpio_var->timer = timer;
+    gpio_var->dma_data_width = u32DataWidth;
+    gpio_var->dma_trans_len = u32Len;
+    gpio_var->dma_rx_buf = pvBuf;
+    gpio_var->dma_done = false;
+    gpio_var->datmsk = gpio->DATMSK;
+
+#if (NVT_DCACHE_ON == 1)
+    // No dirty line of the buffer may be evicted over the samples
+    SCB_InvalidateDCache_by_Addr(pvBuf, u32Len * (u32DataWidth / 8));
+#endif
+
+    {
+        struct nu_pdma_chn_cb pdma_rx_chn_cb;
+
+        nu_pdma_filtering_set(gpio_var->dma_chn_id, NU_PDMA_EVENT_TRANSFER_DONE | NU_PDMA_EVENT_ABORT);
+
+        pdma_rx_chn_cb.m_eCBType = eCBType_Event;
+        pdma_rx_chn_cb.m_pfnCBHandler = GPIO_DMA_Handler;
+        pdma_rx_chn_cb.m_pvUserData = gpio_var;
+
+        nu_pdma_callback_register(gpio_var->dma_chn_id, &pdma_rx_chn_cb);
+    }
+
+    nu_pdma_transfer(gpio_var->dma_chn_id, u32DataWidth,
+                     (uint32_t)&gpio->PIN, (uint32_t)pvBuf,
+                     u32Len, 0);
+
+    // timer have been opened, just stop and reset it
+    TIMER_Stop(timer);
+    TIMER_ResetCounter(timer);
+    //Only the PDMA trigger, the other targets of the timer are left as they are
+    timer->TRGCTL |= TIMER_TRGCTL_TRGPDMA_Msk;
+
+    if(!bDeferStart)
+        TIMER_Start(timer);
+
+    return 0;
+}
+
+void GPIO_TimerPDMAStart(
+    gpio_port_t *psObj
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->gpio, gpio_modinit_tab);
+
+    if(modinit == NULL)
+        return;
+
+    struct nu_gpio_var *gpio_var = (struct nu_gpio_var *)modinit->var;
+
+    if((gpio_var->dma_chn_id == NU_PDMA_OUT_OF_CHANNELS) || (gpio_var->dma_done))
+        return;
+
+    TIMER_Start(gpio_var->timer);
+}
+
+bool GPIO_IsTimerPDMADone(
+    gpio_port_t *psObj
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->gpio, gpio_modinit_tab);
+
+    if(modinit == NULL)
+        return true;
+
+    struct nu_gpio_var *gpio_var = (struct nu_gpio_var *)modinit->var;
+
+    if(gpio_var->dma_chn_id == NU_PDMA_OUT_OF_CHANNELS)
+        return true;
+
+    return gpio_var->dma_done;
+}
+
+uint32_t GPIO_TimerPDMACount(
+    gpio_port_t *psObj
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->gpio, gpio_modinit_tab);
+
+    if(modinit == NULL)
+        return 0;
+
+    struct nu_gpio_var *gpio_var = (struct nu_gpio_var *)modinit->var;
+    uint32_t u32Bytes = gpio_var->dma_trans_len * (gpio_var->dma_data_width / 8);
+    int32_t i32Bytes;
+
+    if(gpio_var->dma_chn_id == NU_PDMA_OUT_OF_CHANNELS)
+        return 0;
+
+    if(gpio_var->dma_done)
+        return gpio_var->dma_trans_len;
+
+    i32Bytes = nu_pdma_transferred_byte_get(gpio_var->dma_chn_id, u32Bytes);
+    if(i32Bytes < 0)
+        return 0;
+
+    return i32Bytes / (gpio_var->dma_data_width / 8);
+}
+
+int32_t GPIO_StopTimerPDMA(
+    gpio_port_t *psObj
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->gpio, gpio_modinit_tab);
+
+    if(modinit == NULL)
+        return -1;
+
+    struct nu_gpio_var *gpio_var = (struct nu_gpio_var *)modinit->var;
+
+    if((gpio_var->dma_chn_id == NU_PDMA_OUT_OF_CHANNELS) || (gpio_var->psObj != psObj))
+        return 0;
+
+    TIMER_Stop(gpio_var->timer);
+    gpio_var->timer->TRGCTL &= ~TIMER_TRGCTL_TRGPDMA_Msk;
+
+    nu_pdma_channel_terminate(gpio_var->dma_chn_id);
+    nu_pdma_channel_free(gpio_var->dma_chn_id);
+    gpio_var->dma_chn_id = NU_PDMA_OUT_OF_CHANNELS;
+
+    if(gpio_var->dma_desc) {
+        nu_pdma_sgtbls_free(&gpio_var->dma_desc, 1);
+        gpio_var->dma_desc = NULL;
+    }
+
+#if (NVT_DCACHE_ON == 1)
+    // Drop stale lines, the CPU must see the samples written by PDMA
+    if(gpio_var->dma_rx_buf)
+        SCB_InvalidateDCache_by_Addr(gpio_var->dma_rx_buf, gpio_var->dma_trans_len * (gpio_var->dma_data_width / 8));
+#endif
+    gpio_var->dma_rx_buf = NULL;
+
+    psObj->gpio->DATMSK = gpio_var->datmsk;
+
+    gpio_var->dma_done = true;
+    gpio_var->psObj = NULL;
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+/**************************************************************************//**
+ * @file     M55M1_GPIO.h
+ * @version  V1.00
+ * @brief    M55M1 GPIO port HAL header file for micropython
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * @copyright (C) 2025 Nuvoton Technology Corp. All rights reserved.
+ *****************************************************************************/
+#ifndef __M55M1_GPIO_H__
+#define __M55M1_GPIO_H__
+
+typedef struct {
+    GPIO_T *gpio;
+} gpio_port_t;
+
+//Timer paced pattern output, one word of pvBuf is copied into the port DOUT register on each
+//timer event by PDMA. Only the bits set in u32Mask are driven, they are switched to output mode.
+//timer: TIMER0~3, opened in periodic mode. Circular: replays pvBuf until GPIO_StopTimerPDMA(),
+//u32Len <= NU_PDMA_MAX_TXCNT. pvBuf must stay valid while the transfer is running.
+//Returns -4 if the port is used by another psObj, stop that transfer first.
+int32_t GPIO_TimerPDMAWrite(
+    gpio_port_t *psObj,
+    TIMER_T *timer,
+    uint32_t u32Mask,
+    const void *pvBuf,
+    uint32_t u32DataWidth,	//8, 16 or 32
+    uint32_t u32Len,		//count of words
+    bool bCircular
+);
+
+//Timer paced capture, the port PIN register is sampled into pvBuf on each timer event by PDMA.
+//bDeferStart: the timer is left stopped until GPIO_TimerPDMAStart(), e.g. called on a pin edge.
+//The samples are valid in pvBuf once done and GPIO_StopTimerPDMA() is called.
+//Returns -4 if the port is used by another psObj.
+int32_t GPIO_TimerPDMARead(
+    gpio_port_t *psObj,
+    TIMER_T *timer,
+    void *pvBuf,
+    uint32_t u32DataWidth,	//8, 16 or 32
+    uint32_t u32Len,		//count of words
+    bool bDeferStart
+);
+
+//Start a deferred capture, may be called in interrupt context
+void GPIO_TimerPDMAStart(
+    gpio_port_t *psObj
+);
+
+bool GPIO_IsTimerPDMADone(
+    gpio_port_t *psObj
+);
+
+//Words transferred by a one-shot transfer or a capture
+uint32_t GPIO_TimerPDMACount(
+    gpio_port_t *psObj
+);
+
+int32_t GPIO_StopTimerPDMA(
+    gpio_port_t *psObj
+);
+
+#endif
@@ -26,12 +26,21 @@ typedef struct {
     uint8_t u8State;
 } I2C_TRANS_PRIV;
 
+typedef struct {
+    uint32_t u32RegPtr;			//Auto-increment register pointer
+    uint32_t u32WriteStart;		//First register written in current transaction
+    uint32_t u32WriteLen;		//Number of registers written in current transaction
+    uint8_t u8AddrRecv;			//Register address bytes received in current transaction
+} I2C_REGMAP_PRIV;
+
 typedef void (*PFN_TRANS_IRQ)(void *i2c, uint32_t u32Status, I2C_TRANS_PARAM *psParam, I2C_TRANS_PRIV *psPriv);
 
 typedef struct {
     I2C_TRANS_PARAM *psTransParam;
     PFN_TRANS_IRQ pfnTransIRQ;
     I2C_TRANS_PRIV sTransPriv;
+    I2C_REGMAP_PARAM *psRegMapParam;
+    I2C_REGMAP_PRIV sRegMapPriv;
     uint8_t bHookIRQ;
 } I2C_TRANS_HANDLER;
 
@@ -739,6 +748,127 @@ static void _LPI2C_SlaveRxTx_IRQ(void *pvI2C, uint32_t u32Status, I2C_TRANS_PARA
 }
 
 
+/* Register-map slave helpers, shared by I2C and LPI2C state machine */
+static void _RegMap_AddrStart(I2C_REGMAP_PRIV *psPriv)
+{
+    psPriv->u8AddrRecv = 0;
+    psPriv->u32WriteLen = 0;
+}
+
+static void _RegMap_DataRecv(I2C_REGMAP_PARAM *psParam, I2C_REGMAP_PRIV *psPriv, uint8_t u8Data)
+{
+    if(psPriv->u8AddrRecv < psParam->u8AddrLen) {
+        //Register address stage, MSB first
+        if(psPriv->u8AddrRecv == 0)
+            psPriv->u32RegPtr = 0;
+
+        psPriv->u32RegPtr = (psPriv->u32RegPtr << 8) | u8Data;
+        psPriv->u8AddrRecv ++;
+
+        if(psPriv->u8AddrRecv == psParam->u8AddrLen) {
+            if(psPriv->u32RegPtr >= psParam->u32RegFileLen)
+                psPriv->u32RegPtr = psPriv->u32RegPtr % psParam->u32RegFileLen;
+            psPriv->u32WriteStart = psPriv->u32RegPtr;
+        }
+        return;
+    }
+
+    //Register data stage
+    psParam->pu8RegFile[psPriv->u32RegPtr] = u8Data;
+    psPriv->u32WriteLen ++;
+    psPriv->u32RegPtr ++;
+    if(psPriv->u32RegPtr >= psParam->u32RegFileLen)
+        psPriv->u32RegPtr = 0;
+}
+
+static uint8_t _RegMap_DataSend(I2C_REGMAP_PARAM *psParam, I2C_REGMAP_PRIV *psPriv)
+{
+    uint8_t u8Data = psParam->pu8RegFile[psPriv->u32RegPtr];
+
+    psPriv->u32RegPtr ++;
+    if(psPriv->u32RegPtr >= psParam->u32RegFileLen)
+        psPriv->u32RegPtr = 0;
+
+    return u8Data;
+}
+
+static void _RegMap_Stop(I2C_REGMAP_PARAM *psParam, I2C_REGMAP_PRIV *psPriv)
+{
+    if(psPriv->u32WriteLen) {
+        if(psParam->pfnWriteNotify)
+            psParam->pfnWriteNotify(psParam->pvUserData, psPriv->u32WriteStart, psPriv->u32WriteLen);
+        psPriv->u32WriteLen = 0;
+    }
+
+    psPriv->u8AddrRecv = 0;
+}
+
+static void _I2C_SlaveRegMap_IRQ(I2C_T *i2c, uint32_t u32Status, I2C_REGMAP_PARAM *psParam, I2C_REGMAP_PRIV *psPriv)
+{
+    uint8_t u8Ctrl = I2C_CTL_SI_AA;
+
+    switch(u32Status) {
+    case 0x60u:	//Slave receive address ACK
+    case 0x68u:	//Slave receive arbitration lost
+        _RegMap_AddrStart(psPriv);
+        break;
+    case 0x80u:	//Slave receive data ACK
+    case 0x88u:	//Slave receive data NACK
+        _RegMap_DataRecv(psParam, psPriv, (uint8_t)I2C_GET_DATA(i2c));
+        break;
+    case 0xA0u:	//Slave receive repeat start or stop
+        _RegMap_Stop(psParam, psPriv);
+        break;
+    case 0xA8u:	//Slave transmit address ACK
+    case 0xB0u:	//Slave transmit arbitration lost
+    case 0xB8u:	//Slave transmit data ACK
+        I2C_SET_DATA(i2c, _RegMap_DataSend(psParam, psPriv));
+        break;
+    case 0xC0u:	//Slave transmit data NACK
+    case 0xC8u:	//Slave transmit last data ACK
+    case 0x70u:	//General call address ACK
+    case 0x90u:	//General call data ACK
+    case 0x98u:	//General call data NACK
+        break;
+    default:	//Unknow status, back to not addressed slave mode
+        break;
+    }
+    I2C_SET_CONTROL_REG(i2c, u8Ctrl);                          /* Write controlbit to I2C_CTL register */
+}
+
+static void _LPI2C_SlaveRegMap_IRQ(LPI2C_T *lpi2c, uint32_t u32Status, I2C_REGMAP_PARAM *psParam, I2C_REGMAP_PRIV *psPriv)
+{
+    uint8_t u8Ctrl = LPI2C_CTL_SI_AA;
+
+    switch(u32Status) {
+    case 0x60u:	//Slave receive address ACK
+    case 0x68u:	//Slave receive arbitration lost
+        _RegMap_AddrStart(psPriv);
+        break;
+    case 0x80u:	//Slave receive data ACK
+    case 0x88u:	//Slave receive data NACK
+        _RegMap_DataRecv(psParam, psPriv, (uint8_t)LPI2C_GET_DATA(lpi2c));
+        break;
+    case 0xA0u:	//Slave receive repeat start or stop
+        _RegMap_Stop(psParam, psPriv);
+        break;
+    case 0xA8u:	//Slave transmit address ACK
+    case 0xB0u:	//Slave transmit arbitration lost
+    case 0xB8u:	//Slave transmit data ACK
+        LPI2C_SET_DATA(lpi2c, _RegMap_DataSend(psParam, psPriv));
+        break;
+    case 0xC0u:	//Slave transmit data NACK
+    case 0xC8u:	//Slave transmit last data ACK
+    case 0x70u:	//General call address ACK
+    case 0x90u:	//General call data ACK
+    case 0x98u:	//General call data NACK
+        break;
+    default:	//Unknow status, back to not addressed slave mode
+        break;
+    }
+    LPI2C_SET_CONTROL_REG(lpi2c, u8Ctrl);                          /* Write controlbit to I2C_CTL register */
+}
+
 void Handle_I2C_Irq(I2C_T *i2c, uint32_t u32Status)
 {
 
@@ -750,6 +880,11 @@ void Handle_I2C_Irq(I2C_T *i2c, uint32_t u32Status)
 
     psTransHandler = (I2C_TRANS_HANDLER *)modinit->var;
 
+    if((psTransHandler) && (psTransHandler->psRegMapParam)) {
+        _I2C_SlaveRegMap_IRQ(i2c, u32Status, psTransHandler->psRegMapParam, &psTransHandler->sRegMapPriv);
+        return;
+    }
+
     if((psTransHandler) && (psTransHandler->pfnTransIRQ)) {
         psTransHandler->pfnTransIRQ(i2c, u32Status, psTransHandler->psTransParam, &psTransHandler->sTransPriv);
     }
@@ -765,6 +900,11 @@ void Handle_LPI2C_Irq(LPI2C_T *lpi2c, uint32_t u32Status)
 
     psTransHandler = (I2C_TRANS_HANDLER *)modinit->var;
 
+    if((psTransHandler) && (psTransHandler->psRegMapParam)) {
+        _LPI2C_SlaveRegMap_IRQ(lpi2c, u32Status, psTransHandler->psRegMapParam, &psTransHandler->sRegMapPriv);
+        return;
+    }
+
     if((psTransHandler) && (psTransHandler->pfnTransIRQ)) {
         psTransHandler->pfnTransIRQ(lpi2c, u32Status, psTransHandler->psTransParam, &psTransHandler->sTransPriv);
     }
@@ -909,6 +1049,9 @@ int I2C_SlaveSendRecv(
     if(psTransPriv->u8InTrans)
         return -2;
 
+    //Register-map mode owns the slave state machine
+    if(psTransHandler->psRegMapParam)
+        return -2;
 
     memset(psTransPriv, 0x0, sizeof(I2C_TRANS_PRIV));
     psTransPriv->u8InTrans = 1;
@@ -964,3 +1107,66 @@ int I2C_SlaveSendRecv(
 
     return psTransPriv->u32DataTrans;
 }
+
+int32_t I2C_SlaveRegMapStart(
+    i2c_t *psI2CObj,
+    I2C_REGMAP_PARAM *psParam
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psI2CObj->u_i2c.i2c, i2c_modinit_tab);
+    I2C_TRANS_HANDLER *psTransHandler = NULL;
+
+    if(modinit == NULL)
+        return -1;
+
+    if((psParam == NULL) || (psParam->pu8RegFile == NULL) || (psParam->u32RegFileLen == 0))
+        return -1;
+
+    if((psParam->u8AddrLen != 1) && (psParam->u8AddrLen != 2))
+        return -1;
+
+    psTransHandler = (I2C_TRANS_HANDLER *)modinit->var;
+
+    if(psTransHandler->sTransPriv.u8InTrans)
+        return -2;
+
+    memset(&psTransHandler->sRegMapPriv, 0x0, sizeof(I2C_REGMAP_PRIV));
+    psTransHandler->psRegMapParam = psParam;
+
+    if(psI2CObj->bLPI2C) {
+        /* I2C enter no address SLV mode */
+        LPI2C_SET_CONTROL_REG(psI2CObj->u_i2c.lpi2c, LPI2C_CTL_SI | LPI2C_CTL_AA);
+        LPI2C_EnableInt(psI2CObj->u_i2c.lpi2c);
+    } else {
+        /* I2C enter no address SLV mode */
+        I2C_SET_CONTROL_REG(psI2CObj->u_i2c.i2c, I2C_CTL_SI | I2C_CTL_AA);
+        I2C_EnableInt(psI2CObj->u_i2c.i2c);
+    }
+
+    return 0;
+}
+
+int32_t I2C_SlaveRegMapStop(
+    i2c_t *psI2CObj
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psI2CObj->u_i2c.i2c, i2c_modinit_tab);
+    I2C_TRANS_HANDLER *psTransHandler = NULL;
+
+    if(modinit == NULL)
+        return -1;
+
+    psTransHandler = (I2C_TRANS_HANDLER *)modinit->var;
+
+    if(psTransHandler->bHookIRQ == 0) {
+        if(psI2CObj->bLPI2C) {
+            LPI2C_DisableInt(psI2CObj->u_i2c.lpi2c);
+        } else {
+            I2C_DisableInt(psI2CObj->u_i2c.i2c);
+        }
+    }
+
+    psTransHandler->psRegMapParam = NULL;
+
+    return 0;
+}
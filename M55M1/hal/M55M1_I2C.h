@@ -35,6 +35,17 @@ typedef struct {
     uint32_t u32DataLen;
 } I2C_TRANS_PARAM;
 
+/* Register-map slave mode: host accesses are served from pu8RegFile directly in the ISR */
+typedef void (*PFN_I2C_REGMAP_WRITE)(void *pvUserData, uint32_t u32RegAddr, uint32_t u32Len);
+
+typedef struct {
+    uint8_t *pu8RegFile;		//Register file memory
+    uint32_t u32RegFileLen;		//Register file size in bytes
+    uint8_t u8AddrLen;			//Register address length sent by host, 1 or 2 bytes
+    PFN_I2C_REGMAP_WRITE pfnWriteNotify;	//Called from ISR at STOP/repeat start after the host wrote registers
+    void *pvUserData;
+} I2C_REGMAP_PARAM;
+
 int32_t I2C_Init(
     i2c_t *psI2CObj,
     I2C_InitTypeDef *psInitDef
@@ -71,6 +82,15 @@ int I2C_SlaveSendRecv(
     uint32_t u32TimeOut
 );
 
+int32_t I2C_SlaveRegMapStart(
+    i2c_t *psI2CObj,
+    I2C_REGMAP_PARAM *psParam
+);
+
+int32_t I2C_SlaveRegMapStop(
+    i2c_t *psI2CObj
+);
+
 int32_t I2C_HookIRQHandler(
     i2c_t *psI2CObj,
     uint8_t u8Recv,
@@ -0,0 +1,546 @@
+/**************************************************************************//**
+ * @file     M55M1_ISOTP.c
+ * @version  V1.00
+ * @brief    M55M1 ISO-TP (ISO 15765-2) transport HAL source file for micropython
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * @copyright (C) 2025 Nuvoton Technology Corp. All rights reserved.
+ *****************************************************************************/
+
+#include <string.h>
+
+#include "py/mphal.h"
+
+#include "NuMicro.h"
+#include "M55M1_ISOTP.h"
+
+#define MAX_CANFD_INST 2
+
+#define ISOTP_PCI_SF	0x0
+#define ISOTP_PCI_FF	0x1
+#define ISOTP_PCI_CF	0x2
+#define ISOTP_PCI_FC	0x3
+
+#define ISOTP_FS_CTS	0x0
+#define ISOTP_FS_WAIT	0x1
+#define ISOTP_FS_OVFLW	0x2
+
+//Links attached to each controller, walked by the CANFD interrupt hooks
+static isotp_link_t *s_apsLinks[MAX_CANFD_INST];
+
+static isotp_link_t **ISOTP_LinkList(
+    canfd_t *psCANFDObj
+)
+{
+    return (psCANFDObj->canfd == CANFD0) ? &s_apsLinks[0] : &s_apsLinks[1];
+}
+
+//Shortest CAN FD data length holding u32Len bytes
+static uint32_t ISOTP_FrameLen(
+    uint32_t u32Len
+)
+{
+    const uint8_t au8FDLen[] = {12, 16, 20, 24, 32, 48, 64};
+    uint32_t i;
+
+    if(u32Len <= 8)
+        return u32Len;
+
+    for(i = 0; i < sizeof(au8FDLen); i ++) {
+        if(u32Len <= au8FDLen[i])
+            return au8FDLen[i];
+    }
+
+    return 64;
+}
+
+//CAN data length of a frame carrying u32Len bytes: the link data length when padded, else the shortest one
+static uint32_t ISOTP_SendFrameLen(
+    const isotp_link_t *psLink,
+    uint32_t u32Len
+)
+{
+    return (psLink->i16Padding >= 0) ? psLink->u8TxDL : ISOTP_FrameLen(u32Len);
+}
+
+//Queue a frame of u32Len bytes, padded to the link data length. Interrupt context or disabled.
+static int32_t ISOTP_SendFrame(
+    isotp_link_t *psLink,
+    const uint8_t *pu8Data,
+    uint32_t u32Len
+)
+{
+    CANFD_FD_MSG_T sMsg;
+    uint32_t u32FrameLen = ISOTP_SendFrameLen(psLink, u32Len);
+
+    memcpy(&sMsg.au8Data[0], pu8Data, u32Len);
+    // CAN FD data length padding is 0xCC when no padding byte is given
+    memset(&sMsg.au8Data[u32Len], (psLink->i16Padding >= 0) ? psLink->i16Padding : 0xCC, u32FrameLen - u32Len);
+
+    sMsg.eIdType = psLink->bExtId ? eCANFD_XID : eCANFD_SID;
+    sMsg.eFrmType = eCANFD_DATA_FRM;
+    sMsg.u32Id = psLink->u32TxId;
+    sMsg.u32DLC = u32FrameLen;
+    sMsg.bFDFormat = psLink->bFD;
+    sMsg.bBitRateSwitch = psLink->bFD && psLink->bBRS;
+
+    return CANFD_SendQueuePut(psLink->psCANFDObj, &sMsg);
+}
+
+static void ISOTP_SendFlowControl(
+    isotp_link_t *psLink,
+    uint32_t u32FlowStatus
+)
+{
+    uint8_t au8FC[3];
+
+    au8FC[0] = (ISOTP_PCI_FC << 4) | u32FlowStatus;
+    au8FC[1] = psLink->u8BlockSize;
+    au8FC[2] = psLink->u8STmin;
+
+    if(ISOTP_SendFrame(psLink, au8FC, sizeof(au8FC)) != 0)
+        psLink->eRxState = eISOTP_ERR_SEND;
+}
+
+//STmin of a flow control frame in ticks, one more tick as the first one is partial
+static uint32_t ISOTP_STminTicks(
+    uint8_t u8STmin
+)
+{
+    uint32_t u32Us;
+
+    if(u8STmin == 0)
+        return 0;
+
+    if(u8STmin <= 0x7F)
+        u32Us = u8STmin * 1000;
+    else if((u8STmin >= 0xF1) && (u8STmin <= 0xF9))
+        u32Us = (u8STmin - 0xF0) * 100;
+    else
+        u32Us = 0x7F * 1000;	//reserved values are handled as the maximum
+
+    return ((u32Us + CANFD_TICK_US - 1) / CANFD_TICK_US) + 1;
+}
+
+//Queue consecutive frames while the send queue, the block size and STmin allow. Interrupt context or disabled.
+static void ISOTP_SendPump(
+    isotp_link_t *psLink
+)
+{
+    uint8_t au8Frame[64];
+
+    while((psLink->eTxState == eISOTP_BUSY) && (psLink->u32TxTickWait == 0)) {
+        uint32_t u32Len = MIN((uint32_t)(psLink->u8TxDL - 1), psLink->u32TxLen - psLink->u32TxPos);
+        int32_t i32Ret;
+
+        au8Frame[0] = (ISOTP_PCI_CF << 4) | psLink->u8TxSN;
+        memcpy(&au8Frame[1], psLink->pu8TxBuf + psLink->u32TxPos, u32Len);
+
+        i32Ret = ISOTP_SendFrame(psLink, au8Frame, u32Len + 1);
+
+        // Queue full, continued from the send queue hook
+        if(i32Ret == -2)
+            return;
+
+        if(i32Ret != 0) {
+            psLink->eTxState = eISOTP_ERR_SEND;
+            return;
+        }
+
+        psLink->u32TxPos += u32Len;
+        psLink->u8TxSN = (psLink->u8TxSN + 1) & 0xF;
+        psLink->u32TxEventMs = mp_hal_ticks_ms();
+
+        if(psLink->u32TxPos >= psLink->u32TxLen) {
+            psLink->eTxState = eISOTP_DONE;
+            return;
+        }
+
+        if(psLink->u8TxBS && (++ psLink->u8TxBSCount >= psLink->u8TxBS)) {
+            psLink->u8TxBSCount = 0;
+            psLink->eTxState = eISOTP_WAIT_FC;
+            return;
+        }
+
+        if(psLink->u32TxSTminTicks) {
+            psLink->u32TxTickWait = psLink->u32TxSTminTicks;
+            CANFD_EnableTick(psLink->psCANFDObj, true);
+            return;
+        }
+    }
+}
+
+static void ISOTP_RecvSingle(
+    isotp_link_t *psLink,
+    const uint8_t *pu8Data,
+    uint32_t u32DL
+)
+{
+    uint32_t u32Len = pu8Data[0] & 0xF;
+    uint32_t u32Offset = 1;
+
+    // Frames above 8 bytes must use the escape sequence, with the length in the second byte
+    if(u32Len == 0) {
+        if(u32DL <= 8)
+            return;
+        u32Len = pu8Data[1];
+        u32Offset = 2;
+    } else if(u32DL > 8) {
+        return;
+    }
+
+    if((u32Len == 0) || ((u32Len + u32Offset) > u32DL))
+        return;
+
+    // The previous message is not released yet
+    if(psLink->eRxState == eISOTP_DONE)
+        return;
+
+    psLink->u32RxEventMs = mp_hal_ticks_ms();
+
+    if(u32Len > psLink->u32RxBufSize) {
+        psLink->eRxState = eISOTP_ERR_OVERFLOW;
+        return;
+    }
+
+    // A single frame also ends an unfinished segmented reception
+    memcpy(psLink->pu8RxBuf, &pu8Data[u32Offset], u32Len);
+    psLink->u32RxLen = u32Len;
+    psLink->u32RxPos = u32Len;
+    psLink->eRxState = eISOTP_DONE;
+}
+
+static void ISOTP_RecvFirst(
+    isotp_link_t *psLink,
+    const uint8_t *pu8Data,
+    uint32_t u32DL
+)
+{
+    uint32_t u32Len = ((pu8Data[0] & 0xF) << 8) | pu8Data[1];
+    uint32_t u32Offset = 2;
+
+    if(u32DL < 8)
+        return;
+
+    // Messages above 4095 bytes carry a 32 bits length
+    if(u32Len == 0) {
+        u32Len = ((uint32_t)pu8Data[2] << 24) | ((uint32_t)pu8Data[3] << 16) | ((uint32_t)pu8Data[4] << 8) | pu8Data[5];
+        u32Offset = 6;
+    }
+
+    psLink->u32RxEventMs = mp_hal_ticks_ms();
+
+    if((psLink->eRxState == eISOTP_DONE) || (u32Len > psLink->u32RxBufSize)) {
+        ISOTP_SendFlowControl(psLink, ISOTP_FS_OVFLW);
+        if(psLink->eRxState != eISOTP_DONE)
+            psLink->eRxState = eISOTP_ERR_OVERFLOW;
+        return;
+    }
+
+    uint32_t u32Copy = MIN(u32DL - u32Offset, u32Len);
+
+    memcpy(psLink->pu8RxBuf, &pu8Data[u32Offset], u32Copy);
+    psLink->u32RxLen = u32Len;
+    psLink->u32RxPos = u32Copy;
+    psLink->u8RxSN = 1;
+    psLink->u8RxBSCount = 0;
+    psLink->eRxState = eISOTP_BUSY;
+
+    ISOTP_SendFlowControl(psLink, ISOTP_FS_CTS);
+}
+
+static void ISOTP_RecvConsecutive(
+    isotp_link_t *psLink,
+    const uint8_t *pu8Data,
+    uint32_t u32DL
+)
+{
+    if(psLink->eRxState != eISOTP_BUSY)
+        return;
+
+    psLink->u32RxEventMs = mp_hal_ticks_ms();
+
+    if((pu8Data[0] & 0xF) != psLink->u8RxSN) {
+        psLink->eRxState = eISOTP_ERR_SEQUENCE;
+        return;
+    }
+
+    uint32_t u32Copy = MIN(u32DL - 1, psLink->u32RxLen - psLink->u32RxPos);
+
+    memcpy(psLink->pu8RxBuf + psLink->u32RxPos, &pu8Data[1], u32Copy);
+    psLink->u32RxPos += u32Copy;
+    psLink->u8RxSN = (psLink->u8RxSN + 1) & 0xF;
+
+    if(psLink->u32RxPos >= psLink->u32RxLen) {
+        psLink->eRxState = eISOTP_DONE;
+        return;
+    }
+
+    if(psLink->u8BlockSize && (++ psLink->u8RxBSCount >= psLink->u8BlockSize)) {
+        psLink->u8RxBSCount = 0;
+        ISOTP_SendFlowControl(psLink, ISOTP_FS_CTS);
+    }
+}
+
+static void ISOTP_RecvFlowControl(
+    isotp_link_t *psLink,
+    const uint8_t *pu8Data,
+    uint32_t u32DL
+)
+{
+    if((psLink->eTxState != eISOTP_WAIT_FC) || (u32DL < 3))
+        return;
+
+    psLink->u32TxEventMs = mp_hal_ticks_ms();
+
+    switch(pu8Data[0] & 0xF) {
+    case ISOTP_FS_CTS:
+        psLink->u8TxBS = pu8Data[1];
+        psLink->u8TxBSCount = 0;
+        psLink->u32TxSTminTicks = ISOTP_STminTicks(pu8Data[2]);
+        psLink->u32TxTickWait = 0;
+        psLink->eTxState = eISOTP_BUSY;
+        ISOTP_SendPump(psLink);
+        break;
+    case ISOTP_FS_WAIT:
+        // Still waiting, the N_Bs timeout restarts
+        break;
+    case ISOTP_FS_OVFLW:
+        psLink->eTxState = eISOTP_ERR_OVERFLOW;
+        break;
+    default:
+        psLink->eTxState = eISOTP_ERR_FC;
+        break;
+    }
+}
+
+//CANFD receive hook, interrupt context
+static bool ISOTP_RecvHook(
+    void *pvUserData,
+    const CANFD_FD_MSG_T *psMsg
+)
+{
+    isotp_link_t *psLink;
+
+    if(psMsg->eFrmType != eCANFD_DATA_FRM)
+        return false;
+
+    for(psLink = *(isotp_link_t **)pvUserData; psLink; psLink = psLink->psNext) {
+        if((psLink->u32RxId != psMsg->u32Id) || (psLink->bExtId != (psMsg->eIdType == eCANFD_XID)))
+            continue;
+
+        if(psMsg->u32DLC == 0)
+            return true;
+
+        switch(psMsg->au8Data[0] >> 4) {
+        case ISOTP_PCI_SF:
+            ISOTP_RecvSingle(psLink, psMsg->au8Data, psMsg->u32DLC);
+            break;
+        case ISOTP_PCI_FF:
+            ISOTP_RecvFirst(psLink, psMsg->au8Data, psMsg->u32DLC);
+            break;
+        case ISOTP_PCI_CF:
+            ISOTP_RecvConsecutive(psLink, psMsg->au8Data, psMsg->u32DLC);
+            break;
+        case ISOTP_PCI_FC:
+            ISOTP_RecvFlowControl(psLink, psMsg->au8Data, psMsg->u32DLC);
+            break;
+        default:
+            break;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+//CANFD send queue hook, interrupt context
+static void ISOTP_TxHook(
+    void *pvUserData
+)
+{
+    isotp_link_t *psLink;
+
+    for(psLink = *(isotp_link_t **)pvUserData; psLink; psLink = psLink->psNext)
+        ISOTP_SendPump(psLink);
+}
+
+//CANFD tick hook, interrupt context
+static void ISOTP_TickHook(
+    void *pvUserData
+)
+{
+    isotp_link_t *psLink;
+    bool bWaiting = false;
+
+    for(psLink = *(isotp_link_t **)pvUserData; psLink; psLink = psLink->psNext) {
+        if(psLink->u32TxTickWait == 0)
+            continue;
+
+        if(-- psLink->u32TxTickWait == 0)
+            ISOTP_SendPump(psLink);
+
+        if(psLink->u32TxTickWait)
+            bWaiting = true;
+    }
+
+    if((!bWaiting) && (*(isotp_link_t **)pvUserData))
+        CANFD_EnableTick((*(isotp_link_t **)pvUserData)->psCANFDObj, false);
+}
+
+int32_t ISOTP_Open(
+    isotp_link_t *psLink
+)
+{
+    isotp_link_t **ppsList = ISOTP_LinkList(psLink->psCANFDObj);
+    uint32_t u32Primask;
+
+    if((psLink->u8TxDL < 8) || (psLink->u8TxDL > 64) || (ISOTP_FrameLen(psLink->u8TxDL) != psLink->u8TxDL))
+        return -1;
+
+    if((psLink->u8TxDL > 8) && (!psLink->bFD))
+        return -1;
+
+    psLink->eRxState = eISOTP_IDLE;
+    psLink->eTxState = eISOTP_IDLE;
+    psLink->u32RxLen = 0;
+    psLink->u32RxPos = 0;
+    psLink->u32TxTickWait = 0;
+
+    u32Primask = __get_PRIMASK();
+    __disable_irq();
+
+    psLink->psNext = *ppsList;
+    *ppsList = psLink;
+
+    __set_PRIMASK(u32Primask);
+
+    if(CANFD_SetProtocolHook(psLink->psCANFDObj, ISOTP_RecvHook, ISOTP_TxHook, ISOTP_TickHook, ppsList) != 0) {
+        ISOTP_Close(psLink);
+        return -2;
+    }
+
+    return 0;
+}
+
+void ISOTP_Close(
+    isotp_link_t *psLink
+)
+{
+    isotp_link_t **ppsList = ISOTP_LinkList(psLink->psCANFDObj);
+    isotp_link_t **ppsLink;
+    uint32_t u32Primask;
+
+    u32Primask = __get_PRIMASK();
+    __disable_irq();
+
+    for(ppsLink = ppsList; *ppsLink; ppsLink = &(*ppsLink)->psNext) {
+        if(*ppsLink == psLink) {
+            *ppsLink = psLink->psNext;
+            break;
+        }
+    }
+
+    psLink->psNext = NULL;
+    psLink->eTxState = eISOTP_IDLE;
+    psLink->eRxState = eISOTP_IDLE;
+    psLink->u32TxTickWait = 0;
+
+    __set_PRIMASK(u32Primask);
+
+    if(*ppsList == NULL)
+        CANFD_SetProtocolHook(psLink->psCANFDObj, NULL, NULL, NULL, NULL);
+}
+
+int32_t ISOTP_Send(
+    isotp_link_t *psLink,
+    const uint8_t *pu8Buf,
+    uint32_t u32Len
+)
+{
+    uint8_t au8Frame[64];
+    uint32_t u32SFMax = (psLink->u8TxDL > 8) ? (psLink->u8TxDL - 2) : 7;
+    uint32_t u32Primask;
+    uint32_t u32Offset;
+    uint32_t u32Copy;
+
+    if((psLink->eTxState == eISOTP_BUSY) || (psLink->eTxState == eISOTP_WAIT_FC))
+        return -2;
+
+    if(u32Len == 0)
+        return -1;
+
+    u32Primask = __get_PRIMASK();
+    __disable_irq();
+
+    psLink->pu8TxBuf = pu8Buf;
+    psLink->u32TxLen = u32Len;
+    psLink->u32TxTickWait = 0;
+    psLink->u32TxEventMs = mp_hal_ticks_ms();
+
+    if(u32Len <= u32SFMax) {
+        // The 4 bits length is only valid in frames up to 8 bytes, padded FD frames use the escape sequence
+        if((u32Len <= 7) && (ISOTP_SendFrameLen(psLink, 1 + u32Len) <= 8)) {
+            au8Frame[0] = (ISOTP_PCI_SF << 4) | u32Len;
+            u32Offset = 1;
+        } else {
+            au8Frame[0] = (ISOTP_PCI_SF << 4);
+            au8Frame[1] = u32Len;
+            u32Offset = 2;
+        }
+
+        memcpy(&au8Frame[u32Offset], pu8Buf, u32Len);
+        psLink->u32TxPos = u32Len;
+        psLink->eTxState = (ISOTP_SendFrame(psLink, au8Frame, u32Offset + u32Len) == 0) ? eISOTP_DONE : eISOTP_ERR_SEND;
+    } else {
+        if(u32Len <= 4095) {
+            au8Frame[0] = (ISOTP_PCI_FF << 4) | (u32Len >> 8);
+            au8Frame[1] = u32Len & 0xFF;
+            u32Offset = 2;
+        } else {
+            au8Frame[0] = (ISOTP_PCI_FF << 4);
+            au8Frame[1] = 0;
+            au8Frame[2] = u32Len >> 24;
+            au8Frame[3] = u32Len >> 16;
+            au8Frame[4] = u32Len >> 8;
+            au8Frame[5] = u32Len;
+            u32Offset = 6;
+        }
+
+        u32Copy = psLink->u8TxDL - u32Offset;
+        memcpy(&au8Frame[u32Offset], pu8Buf, u32Copy);
+        psLink->u32TxPos = u32Copy;
+        psLink->u8TxSN = 1;
+        psLink->eTxState = (ISOTP_SendFrame(psLink, au8Frame, psLink->u8TxDL) == 0) ? eISOTP_WAIT_FC : eISOTP_ERR_SEND;
+    }
+
+    __set_PRIMASK(u32Primask);
+
+    return (psLink->eTxState == eISOTP_ERR_SEND) ? -3 : 0;
+}
+
+void ISOTP_SendAbort(
+    isotp_link_t *psLink
+)
+{
+    uint32_t u32Primask = __get_PRIMASK();
+
+    __disable_irq();
+    psLink->eTxState = eISOTP_IDLE;
+    psLink->u32TxTickWait = 0;
+    __set_PRIMASK(u32Primask);
+}
+
+void ISOTP_RecvRelease(
+    isotp_link_t *psLink
+)
+{
+    uint32_t u32Primask = __get_PRIMASK();
+
+    __disable_irq();
+    psLink->u32RxLen = 0;
+    psLink->u32RxPos = 0;
+    psLink->eRxState = eISOTP_IDLE;
+    __set_PRIMASK(u32Primask);
+}
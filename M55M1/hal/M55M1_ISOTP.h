@@ -0,0 +1,89 @@
+/**************************************************************************//**
+ * @file     M55M1_ISOTP.h
+ * @version  V1.00
+ * @brief    M55M1 ISO-TP (ISO 15765-2) transport HAL header file for micropython
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ * @copyright (C) 2025 Nuvoton Technology Corp. All rights reserved.
+ *****************************************************************************/
+#ifndef __M55M1_ISOTP_H__
+#define __M55M1_ISOTP_H__
+
+#include "M55M1_CANFD.h"
+
+#define ISOTP_MAX_PAYLOAD	0xFFFFFFFF
+
+typedef enum {
+    eISOTP_IDLE = 0,
+    eISOTP_BUSY,			//rx: consecutive frames expected, tx: sending
+    eISOTP_WAIT_FC,			//tx: flow control expected
+    eISOTP_DONE,			//rx: message complete and not released, tx: last frame queued
+    eISOTP_ERR_OVERFLOW,	//rx: message too long for the buffer, tx: receiver flow control overflow
+    eISOTP_ERR_SEQUENCE,	//rx: wrong consecutive frame sequence number
+    eISOTP_ERR_SEND,		//send queue full, a frame could not be queued
+    eISOTP_ERR_FC,			//tx: invalid flow status
+} E_ISOTP_STATE;
+
+typedef struct isotp_link {
+    canfd_t *psCANFDObj;
+    uint32_t u32TxId;
+    uint32_t u32RxId;
+    bool bExtId;
+    bool bFD;
+    bool bBRS;
+    uint8_t u8TxDL;			//frame length: 8, or 12~64 with CAN FD
+    int16_t i16Padding;		//padding byte, -1 for the shortest valid length
+    uint8_t u8BlockSize;	//BS sent in our flow control frames
+    uint8_t u8STmin;		//STmin sent in our flow control frames
+
+    uint8_t *pu8RxBuf;
+    uint32_t u32RxBufSize;
+    volatile uint32_t u32RxLen;
+    volatile uint32_t u32RxPos;
+    uint8_t u8RxSN;
+    uint8_t u8RxBSCount;
+    volatile E_ISOTP_STATE eRxState;
+    volatile uint32_t u32RxEventMs;		//mp_hal_ticks_ms() of the last receive event
+
+    const uint8_t *pu8TxBuf;
+    uint32_t u32TxLen;
+    volatile uint32_t u32TxPos;
+    uint8_t u8TxSN;
+    uint8_t u8TxBS;			//BS of the receiver, 0: no limit
+    uint8_t u8TxBSCount;
+    uint32_t u32TxSTminTicks;	//STmin of the receiver, in CANFD_TICK_US
+    volatile uint32_t u32TxTickWait;
+    volatile E_ISOTP_STATE eTxState;
+    volatile uint32_t u32TxEventMs;		//mp_hal_ticks_ms() of the last send event
+
+    struct isotp_link *psNext;
+} isotp_link_t;
+
+//Attach a link to its CAN controller. The controller must be initialized with a send queue,
+//frames with u32RxId are consumed by the link in the receive interrupt.
+int32_t ISOTP_Open(
+    isotp_link_t *psLink
+);
+
+void ISOTP_Close(
+    isotp_link_t *psLink
+);
+
+//Start sending u32Len bytes of pu8Buf, the buffer must stay valid until eTxState leaves eISOTP_BUSY/eISOTP_WAIT_FC
+int32_t ISOTP_Send(
+    isotp_link_t *psLink,
+    const uint8_t *pu8Buf,
+    uint32_t u32Len
+);
+
+//Abort sending
+void ISOTP_SendAbort(
+    isotp_link_t *psLink
+);
+
+//Give the receive buffer back after a received message (eISOTP_DONE) or an error
+void ISOTP_RecvRelease(
+    isotp_link_t *psLink
+);
+
+#endif
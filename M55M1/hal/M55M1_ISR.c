@@ -20,6 +20,8 @@
 #include "hal/M55M1_PWM.h"
 #include "hal/M55M1_Timer.h"
 #include "hal/M55M1_RTC.h"
+#include "hal/M55M1_EADC.h"
+#include "hal/M55M1_EQEI.h"
 #include "hal/drv_pdma.h"
 #include "hal/pin_int.h"
 #include "hal/StorIF_SDCard.h"
@@ -32,6 +34,8 @@ uint32_t irq_stats[TOTAL_IRQn_CNT + 1] = {0};
 
 __IO uint32_t uwTick;
 
+extern void mp_hal_stdout_tick(void);
+
 void SysTick_Handler(void)
 {
     // Instead of calling HAL_IncTick we do the increment here of the counter.
@@ -42,6 +46,8 @@ void SysTick_Handler(void)
     // without the volatile specifier.
     uwTick += 1;
 
+    mp_hal_stdout_tick();
+
 #if MICROPY_LVGL
     lv_tick_inc(1);
 #endif
@@ -440,9 +446,9 @@ void CANFD00_IRQHandler(void)
     u32IRStatus = CANFD0->IR;
 
     if(u32IRStatus) {
-        Handle_CANFD_Irq(CANFD0, u32IRStatus);
-        /* Clear the Interrupt flag */
+        /* Clear the Interrupt flag first, events raised while handling are kept */
         CANFD_ClearStatusFlag(CANFD0, u32IRStatus);
+        Handle_CANFD_Irq(CANFD0, u32IRStatus);
     }
 
     IRQ_EXIT(CANFD00_IRQn);
@@ -456,9 +462,9 @@ void CANFD01_IRQHandler(void)
     u32IRStatus = CANFD0->IR;
 
     if(u32IRStatus) {
-        Handle_CANFD_Irq(CANFD0, u32IRStatus);
-        /* Clear the Interrupt flag */
+        /* Clear the Interrupt flag first, events raised while handling are kept */
         CANFD_ClearStatusFlag(CANFD0, u32IRStatus);
+        Handle_CANFD_Irq(CANFD0, u32IRStatus);
     }
 
     IRQ_EXIT(CANFD01_IRQn);
@@ -472,9 +478,9 @@ void CANFD10_IRQHandler(void)
     u32IRStatus = CANFD1->IR;
 
     if(u32IRStatus) {
-        Handle_CANFD_Irq(CANFD1, u32IRStatus);
-        /* Clear the Interrupt flag */
+        /* Clear the Interrupt flag first, events raised while handling are kept */
         CANFD_ClearStatusFlag(CANFD1, u32IRStatus);
+        Handle_CANFD_Irq(CANFD1, u32IRStatus);
     }
 
     IRQ_EXIT(CANFD10_IRQn);
@@ -488,9 +494,9 @@ void CANFD11_IRQHandler(void)
     u32IRStatus = CANFD1->IR;
 
     if(u32IRStatus) {
-        Handle_CANFD_Irq(CANFD1, u32IRStatus);
-        /* Clear the Interrupt flag */
+        /* Clear the Interrupt flag first, events raised while handling are kept */
         CANFD_ClearStatusFlag(CANFD1, u32IRStatus);
+        Handle_CANFD_Irq(CANFD1, u32IRStatus);
     }
 
     IRQ_EXIT(CANFD11_IRQn);
@@ -585,6 +591,48 @@ void TIMER3_IRQHandler(void)
 
 }
 
+void EQEI0_IRQHandler(void)
+{
+    IRQ_ENTER(EQEI0_IRQn);
+    Handle_EQEI_Irq(EQEI0);
+    IRQ_EXIT(EQEI0_IRQn);
+}
+
+void EQEI1_IRQHandler(void)
+{
+    IRQ_ENTER(EQEI1_IRQn);
+    Handle_EQEI_Irq(EQEI1);
+    IRQ_EXIT(EQEI1_IRQn);
+}
+
+void EQEI2_IRQHandler(void)
+{
+    IRQ_ENTER(EQEI2_IRQn);
+    Handle_EQEI_Irq(EQEI2);
+    IRQ_EXIT(EQEI2_IRQn);
+}
+
+void EQEI3_IRQHandler(void)
+{
+    IRQ_ENTER(EQEI3_IRQn);
+    Handle_EQEI_Irq(EQEI3);
+    IRQ_EXIT(EQEI3_IRQn);
+}
+
+void EADC00_IRQHandler(void)
+{
+    IRQ_ENTER(EADC00_IRQn);
+    Handle_EADC_Irq(EADC0, 0);
+    IRQ_EXIT(EADC00_IRQn);
+}
+
+void EADC01_IRQHandler(void)
+{
+    IRQ_ENTER(EADC01_IRQn);
+    Handle_EADC_Irq(EADC0, 1);
+    IRQ_EXIT(EADC01_IRQn);
+}
+
 void LPTMR0_IRQHandler(void)
 {
     IRQ_ENTER(LPTMR0_IRQn);
@@ -14,11 +14,29 @@
 #include "NuMicro.h"
 #include "M55M1_PWM.h"
 #include "nu_modutil.h"
+#include "drv_pdma.h"
 
 #define MAX_PWM_INST 2
+#define PWM_CHANNEL_PAIRS 3
+
+typedef struct nu_pwm_capture_dma {
+    int         dma_chn_id_rx;
+    uint32_t	dma_trans_len;
+    uint16_t	*dma_trans_buf;
+    volatile uint32_t dma_event;
+} s_nu_pwm_capture_dma;
 
 typedef struct nu_pwm_var {
     pwm_t *     obj;
+    uint8_t     pdma_perp_cap[PWM_CHANNEL_PAIRS];
+    s_nu_pwm_capture_dma cap_dma[PWM_CHANNEL_PAIRS];
+    IRQn_Type   pair_irq_n[PWM_CHANNEL_PAIRS];
+
+    uint32_t    motor_pair_mask;
+    uint32_t    motor_ch;				//even channel of the lowest pair, raises the ADC trigger and the period hook
+    bool        motor_zero_int;			//period hook on zero point instead of period point
+    PFN_PWM_PERIOD_HANDLER motor_handler;
+    void        *motor_userdata;
 } s_nu_pwm_var;
 
 static struct nu_pwm_var bpwm0_var = {
@@ -31,10 +49,16 @@ static struct nu_pwm_var bpwm1_var = {
 
 static struct nu_pwm_var epwm0_var = {
     .obj                =   NULL,
+    .pdma_perp_cap      =   {PDMA_EPWM0_P1_RX, PDMA_EPWM0_P2_RX, PDMA_EPWM0_P3_RX},
+    .cap_dma            =   {{NU_PDMA_OUT_OF_CHANNELS}, {NU_PDMA_OUT_OF_CHANNELS}, {NU_PDMA_OUT_OF_CHANNELS}},
+    .pair_irq_n         =   {EPWM0P0_IRQn, EPWM0P1_IRQn, EPWM0P2_IRQn},
 };
 
 static struct nu_pwm_var epwm1_var = {
     .obj                =   NULL,
+    .pdma_perp_cap      =   {PDMA_EPWM1_P1_RX, PDMA_EPWM1_P2_RX, PDMA_EPWM1_P3_RX},
+    .cap_dma            =   {{NU_PDMA_OUT_OF_CHANNELS}, {NU_PDMA_OUT_OF_CHANNELS}, {NU_PDMA_OUT_OF_CHANNELS}},
+    .pair_irq_n         =   {EPWM1P0_IRQn, EPWM1P1_IRQn, EPWM1P2_IRQn},
 };
 
 
@@ -95,6 +119,14 @@ void PWM_Final(
         return;
 
     if(psPWMObj->bEPWM) {
+        struct nu_pwm_var *var = (struct nu_pwm_var *) modinit->var;
+
+        EPWM_DisableZeroInt(psPWMObj->u_pwm.epwm, var->motor_ch);
+        EPWM_DisablePeriodInt(psPWMObj->u_pwm.epwm, var->motor_ch);
+        EPWM_DisableADCTrigger(psPWMObj->u_pwm.epwm, var->motor_ch);
+        var->motor_handler = NULL;
+        var->motor_pair_mask = 0;
+
         EPWM_ForceStop(psPWMObj->u_pwm.epwm, 0x3F);
     } else {
         BPWM_ForceStop(psPWMObj->u_pwm.bpwm, 0x3F);
@@ -446,6 +478,153 @@ int32_t PWM_CaptureClearInt(
     return 0;
 }
 
+static void PWM_Capture_DMA_Handler_RX(void* id, uint32_t event_dma)
+{
+    s_nu_pwm_capture_dma *cap_dma = (s_nu_pwm_capture_dma *) id;
+
+#if (NVT_DCACHE_ON == 1)
+    // Drop stale lines, CPU must see the values written by PDMA
+    if ((event_dma & NU_PDMA_EVENT_TRANSFER_DONE) && (cap_dma->dma_trans_buf))
+        SCB_InvalidateDCache_by_Addr(cap_dma->dma_trans_buf, cap_dma->dma_trans_len * sizeof(uint16_t));
+#endif
+
+    cap_dma->dma_event |= event_dma;
+}
+
+int32_t PWM_CapturePDMAStart(
+    pwm_t *psPWMObj,
+    uint32_t u32Channel,
+    E_CAPTURE_EDGE_LATCH_TYPE eCaptureEdge,
+    uint16_t *pu16Buf,
+    uint32_t u32BufLen
+)
+{
+    const struct nu_modinit_s *modinit = NULL;
+
+    if(!psPWMObj->bEPWM)
+        return -1;
+
+    modinit = get_modinit((uint32_t)psPWMObj->u_pwm.epwm, epwm_modinit_tab);
+
+    if((modinit == NULL) || (pu16Buf == NULL) || (u32BufLen == 0) || (u32Channel >= (PWM_CHANNEL_PAIRS * 2)))
+        return -1;
+
+    struct nu_pwm_var *var = (struct nu_pwm_var *) modinit->var;
+    s_nu_pwm_capture_dma *cap_dma = &var->cap_dma[u32Channel / 2];
+    uint32_t u32PDMAMode;
+
+    if(cap_dma->dma_chn_id_rx != NU_PDMA_OUT_OF_CHANNELS)
+        PWM_CapturePDMAStop(psPWMObj, u32Channel);
+
+    if(eCaptureEdge == eCAPTURE_RISING_LATCH)
+        u32PDMAMode = EPWM_CAPTURE_PDMA_RISING_LATCH;
+    else if(eCaptureEdge == eCAPTURE_FALLING_LATCH)
+        u32PDMAMode = EPWM_CAPTURE_PDMA_FALLING_LATCH;
+    else
+        u32PDMAMode = EPWM_CAPTURE_PDMA_RISING_FALLING_LATCH;
+
+    cap_dma->dma_chn_id_rx = nu_pdma_channel_dynamic_allocate(var->pdma_perp_cap[u32Channel / 2]);
+
+    if(cap_dma->dma_chn_id_rx == NU_PDMA_OUT_OF_CHANNELS)
+        return -1;
+
+    cap_dma->dma_trans_buf = pu16Buf;
+    cap_dma->dma_trans_len = u32BufLen;
+    cap_dma->dma_event = 0;
+
+    nu_pdma_filtering_set(cap_dma->dma_chn_id_rx, NU_PDMA_EVENT_TRANSFER_DONE | NU_PDMA_EVENT_ABORT);
+
+    {
+        struct nu_pdma_chn_cb pdma_rx_chn_cb;
+
+        pdma_rx_chn_cb.m_eCBType = eCBType_Event;
+        pdma_rx_chn_cb.m_pfnCBHandler = PWM_Capture_DMA_Handler_RX;
+        pdma_rx_chn_cb.m_pvUserData = cap_dma;
+
+        nu_pdma_callback_register(cap_dma->dma_chn_id_rx, &pdma_rx_chn_cb);
+    }
+
+    nu_pdma_transfer( cap_dma->dma_chn_id_rx,
+                      16,
+                      (uint32_t)&(psPWMObj->u_pwm.epwm)->PDMACAP[u32Channel / 2],
+                      (uint32_t)pu16Buf,
+                      u32BufLen,
+                      0
+                    );
+
+    /* Each latched value of the channel raises a PDMA request, rising latch is moved first */
+    EPWM_EnablePDMA(psPWMObj->u_pwm.epwm, u32Channel, TRUE, u32PDMAMode);
+
+    return 0;
+}
+
+uint32_t PWM_CapturePDMACount(
+    pwm_t *psPWMObj,
+    uint32_t u32Channel
+)
+{
+    const struct nu_modinit_s *modinit = NULL;
+
+    if(!psPWMObj->bEPWM)
+        return 0;
+
+    modinit = get_modinit((uint32_t)psPWMObj->u_pwm.epwm, epwm_modinit_tab);
+
+    if((modinit == NULL) || (u32Channel >= (PWM_CHANNEL_PAIRS * 2)))
+        return 0;
+
+    struct nu_pwm_var *var = (struct nu_pwm_var *) modinit->var;
+    s_nu_pwm_capture_dma *cap_dma = &var->cap_dma[u32Channel / 2];
+    int i32Bytes;
+
+    if(cap_dma->dma_chn_id_rx == NU_PDMA_OUT_OF_CHANNELS)
+        return 0;
+
+    if(cap_dma->dma_event & NU_PDMA_EVENT_TRANSFER_DONE)
+        return cap_dma->dma_trans_len;
+
+    i32Bytes = nu_pdma_transferred_byte_get(cap_dma->dma_chn_id_rx, cap_dma->dma_trans_len * sizeof(uint16_t));
+
+    return (i32Bytes > 0) ? (i32Bytes / sizeof(uint16_t)) : 0;
+}
+
+int32_t PWM_CapturePDMAStop(
+    pwm_t *psPWMObj,
+    uint32_t u32Channel
+)
+{
+    const struct nu_modinit_s *modinit = NULL;
+
+    if(!psPWMObj->bEPWM)
+        return -1;
+
+    modinit = get_modinit((uint32_t)psPWMObj->u_pwm.epwm, epwm_modinit_tab);
+
+    if((modinit == NULL) || (u32Channel >= (PWM_CHANNEL_PAIRS * 2)))
+        return -1;
+
+    struct nu_pwm_var *var = (struct nu_pwm_var *) modinit->var;
+    s_nu_pwm_capture_dma *cap_dma = &var->cap_dma[u32Channel / 2];
+
+    EPWM_DisablePDMA(psPWMObj->u_pwm.epwm, u32Channel);
+
+    if (cap_dma->dma_chn_id_rx != NU_PDMA_OUT_OF_CHANNELS) {
+#if (NVT_DCACHE_ON == 1)
+        // Partial capture, make the values written so far visible
+        if (cap_dma->dma_trans_buf)
+            SCB_InvalidateDCache_by_Addr(cap_dma->dma_trans_buf, cap_dma->dma_trans_len * sizeof(uint16_t));
+#endif
+        nu_pdma_channel_terminate(cap_dma->dma_chn_id_rx);
+        nu_pdma_channel_free(cap_dma->dma_chn_id_rx);
+        cap_dma->dma_chn_id_rx = NU_PDMA_OUT_OF_CHANNELS;
+    }
+
+    cap_dma->dma_trans_buf = NULL;
+    cap_dma->dma_trans_len = 0;
+
+    return 0;
+}
+
 static uint32_t BPWMCalNewDutyCMR(BPWM_T *pwm, uint32_t u32ChannelNum, uint32_t u32DutyCycle, uint32_t u32CycleResolution)
 {
     return (u32DutyCycle * (BPWM_GET_CNR(pwm, u32ChannelNum) + 1) / u32CycleResolution);
@@ -493,6 +672,188 @@ int32_t PWM_ChangeChannelDuty(
     return 0;
 }
 
+int32_t PWM_MotorInit(
+    pwm_t *psPWMObj,
+    PWM_MotorInitTypeDef *psInitDef
+)
+{
+    const struct nu_modinit_s *modinit = NULL;
+
+    if(!psPWMObj->bEPWM)
+        return -1;
+
+    modinit = get_modinit((uint32_t)psPWMObj->u_pwm.epwm, epwm_modinit_tab);
+
+    if((modinit == NULL) || (psInitDef->u32Freq == 0) || (psInitDef->u32PairMask == 0) || (psInitDef->u32PairMask & ~0x7))
+        return -1;
+
+    struct nu_pwm_var *var = (struct nu_pwm_var *) modinit->var;
+    EPWM_T *epwm = psPWMObj->u_pwm.epwm;
+    uint32_t u32ChannelMask = 0;
+    uint32_t u32Pair;
+
+    EPWM_DisableZeroInt(epwm, var->motor_ch);
+    EPWM_DisablePeriodInt(epwm, var->motor_ch);
+    EPWM_DisableADCTrigger(epwm, var->motor_ch);
+    var->motor_handler = NULL;
+    var->motor_pair_mask = 0;
+
+    for(u32Pair = 0; u32Pair < PWM_CHANNEL_PAIRS; u32Pair ++) {
+        uint32_t u32Ch = u32Pair * 2;
+        uint32_t u32Freq;
+        uint32_t u32Clk;
+        uint32_t u32DeadCnt;
+
+        if(!(psInitDef->u32PairMask & (1 << u32Pair)))
+            continue;
+
+        /* Up-down counting doubles the period, so configure for twice the frequency */
+        u32Freq = EPWM_ConfigOutputChannel(epwm, u32Ch, psInitDef->u32Freq * 2, 0);
+        if(u32Freq == 0)
+            return -1;
+
+        /* EPWM clock, edge aligned period is (CNR + 1) * (prescaler + 1) clocks */
+        u32Clk = u32Freq * (EPWM_GET_CNR(epwm, u32Ch) + 1) * (EPWM_GET_PRESCALER(epwm, u32Ch) + 1);
+
+        EPWM_SET_ALIGNED_TYPE(epwm, (0x3 << u32Ch), EPWM_CENTER_ALIGNED);
+
+        /* High side is on between compare up and compare down, centered on the period point */
+        EPWM_SET_OUTPUT_LEVEL(epwm, (0x1 << u32Ch), EPWM_OUTPUT_LOW, EPWM_OUTPUT_HIGH, EPWM_OUTPUT_NOTHING, EPWM_OUTPUT_LOW);
+        EPWM_SET_CMR(epwm, u32Ch, EPWM_GET_CNR(epwm, u32Ch) + 1);
+
+        /* Odd channel outputs the inverse of the even one */
+        epwm->CTL1 |= ((0x1 << u32Pair) << EPWM_CTL1_OUTMODE0_Pos);
+
+        /* Dead zone counter runs on the EPWM clock, 12 bits */
+        u32DeadCnt = (uint32_t)(((uint64_t)u32Clk * psInitDef->u32DeadTimeNs) / 1000000000UL);
+        if(u32DeadCnt > 0xFFF)
+            u32DeadCnt = 0xFFF;
+
+        if(u32DeadCnt)
+            EPWM_EnableDeadZone(epwm, u32Ch, u32DeadCnt);
+        else
+            EPWM_DisableDeadZone(epwm, u32Ch);
+
+        /* CMPDAT written by PWM_MotorSetDuty() is loaded only when the load window is opened */
+        EPWM_ENABLE_LOAD_MODE(epwm, u32Ch, EPWM_LOAD_MODE_WINDOW);
+
+        u32ChannelMask |= (0x3 << u32Ch);
+    }
+
+    /* Only the selected pairs run, the events are taken from the lowest one */
+    for(u32Pair = 0; !(psInitDef->u32PairMask & (1 << u32Pair)); u32Pair ++);
+
+    var->motor_pair_mask = psInitDef->u32PairMask;
+    var->motor_ch = u32Pair * 2;
+    var->motor_zero_int = true;
+
+    if(psInitDef->u32ADCTrigger == PWM_MOTOR_ADC_TRG_CENTER) {
+        EPWM_EnableADCTrigger(epwm, var->motor_ch, EPWM_TRG_ADC_EVEN_PERIOD);
+    } else if(psInitDef->u32ADCTrigger == PWM_MOTOR_ADC_TRG_ZERO) {
+        EPWM_EnableADCTrigger(epwm, var->motor_ch, EPWM_TRG_ADC_EVEN_ZERO);
+        var->motor_zero_int = false;
+    }
+
+    EPWM_EnableOutput(epwm, u32ChannelMask);
+
+    /* Start all counters with a single write so the phases stay aligned */
+    EPWM_Start(epwm, u32ChannelMask);
+
+    return 0;
+}
+
+int32_t PWM_MotorSetDuty(
+    pwm_t *psPWMObj,
+    const uint16_t *pu16Duty
+)
+{
+    const struct nu_modinit_s *modinit = NULL;
+
+    if(!psPWMObj->bEPWM)
+        return -1;
+
+    modinit = get_modinit((uint32_t)psPWMObj->u_pwm.epwm, epwm_modinit_tab);
+
+    if(modinit == NULL)
+        return -1;
+
+    struct nu_pwm_var *var = (struct nu_pwm_var *) modinit->var;
+    EPWM_T *epwm = psPWMObj->u_pwm.epwm;
+    uint32_t u32LoadMask = 0;
+    uint32_t u32Pair;
+
+    for(u32Pair = 0; u32Pair < PWM_CHANNEL_PAIRS; u32Pair ++) {
+        uint32_t u32Ch = u32Pair * 2;
+        uint32_t u32Cnr;
+        uint32_t u32Cmp;
+
+        if(!(var->motor_pair_mask & (1 << u32Pair)))
+            continue;
+
+        u32Cnr = EPWM_GET_CNR(epwm, u32Ch);
+
+        /* High side on-time is 2 * (CNR - CMP) of 2 * CNR, CMP above CNR never matches (0%) */
+        if(pu16Duty[u32Pair] == 0)
+            u32Cmp = u32Cnr + 1;
+        else
+            u32Cmp = u32Cnr - (((pu16Duty[u32Pair] + 1) * u32Cnr) >> 16);
+
+        EPWM_SET_CMR(epwm, u32Ch, u32Cmp);
+        u32LoadMask |= (0x1 << u32Ch);
+    }
+
+    /* Open the load window of all pairs at once, loaded together at the end of this period */
+    EPWM_SET_LOAD_WINDOW(epwm, u32LoadMask);
+
+    return 0;
+}
+
+int32_t PWM_MotorSetPeriodHandler(
+    pwm_t *psPWMObj,
+    PFN_PWM_PERIOD_HANDLER pfnHandler,
+    void *pvUserData
+)
+{
+    const struct nu_modinit_s *modinit = NULL;
+
+    if(!psPWMObj->bEPWM)
+        return -1;
+
+    modinit = get_modinit((uint32_t)psPWMObj->u_pwm.epwm, epwm_modinit_tab);
+
+    if(modinit == NULL)
+        return -1;
+
+    struct nu_pwm_var *var = (struct nu_pwm_var *) modinit->var;
+    EPWM_T *epwm = psPWMObj->u_pwm.epwm;
+
+    uint32_t u32Ch = var->motor_ch;
+
+    if(var->motor_pair_mask == 0)
+        return -1;
+
+    EPWM_DisableZeroInt(epwm, u32Ch);
+    EPWM_DisablePeriodInt(epwm, u32Ch);
+
+    var->motor_userdata = pvUserData;
+    var->motor_handler = pfnHandler;
+
+    if(pfnHandler == NULL)
+        return 0;
+
+    if(var->motor_zero_int) {
+        EPWM_ClearZeroIntFlag(epwm, u32Ch);
+        EPWM_EnableZeroInt(epwm, u32Ch);
+    } else {
+        EPWM_ClearPeriodIntFlag(epwm, u32Ch);
+        EPWM_EnablePeriodInt(epwm, u32Ch, 0);
+    }
+
+    NVIC_EnableIRQ(var->pair_irq_n[u32Ch / 2]);
+
+    return 0;
+}
+
 /**
  * Handle the BPWM interrupt
  * @param[in] obj The BPWM peripheral that generated the interrupt
@@ -533,6 +894,15 @@ void Handle_EPWM_Irq(EPWM_T *epwm, uint32_t u32ChannGroup)
 
     pwm_t *psPWMObj = var->obj;
 
+    if((u32ChannGroup == (var->motor_ch / 2)) && (var->motor_handler)) {
+        if((var->motor_zero_int) && (EPWM_GetZeroIntFlag(epwm, var->motor_ch))) {
+            EPWM_ClearZeroIntFlag(epwm, var->motor_ch);
+            var->motor_handler(var->motor_userdata);
+        } else if((!var->motor_zero_int) && (EPWM_GetPeriodIntFlag(epwm, var->motor_ch))) {
+            EPWM_ClearPeriodIntFlag(epwm, var->motor_ch);
+            var->motor_handler(var->motor_userdata);
+        }
+    }
 
     if((psPWMObj) && (psPWMObj->pfnCaptureHandler)) {
         psPWMObj->pfnCaptureHandler(psPWMObj, u32ChannGroup);
@@ -17,6 +17,20 @@ typedef enum {
 
 typedef void (*PFN_CAPTURE_INT_HANDLER)(void *obj, uint32_t u32ChannelGroup);
 
+//Called once per PWM period in EPWM interrupt context (motor control mode)
+typedef void (*PFN_PWM_PERIOD_HANDLER)(void *pvUserData);
+
+#define PWM_MOTOR_ADC_TRG_NONE		0
+#define PWM_MOTOR_ADC_TRG_CENTER	1		//period point, middle of the high side on-time
+#define PWM_MOTOR_ADC_TRG_ZERO		2		//zero point, middle of the low side on-time
+
+typedef struct {
+    uint32_t u32Freq;			//PWM frequency, center aligned
+    uint32_t u32PairMask;		//bit n: complementary pair CH2n/CH2n+1, 0x7 for three phases
+    uint32_t u32DeadTimeNs;		//dead-time inserted on both edges of each pair
+    uint32_t u32ADCTrigger;		//PWM_MOTOR_ADC_TRG_xxx, EADC trigger source EPWMxTGn, n the even channel of the lowest pair
+} PWM_MotorInitTypeDef;
+
 typedef struct {
     union {
         BPWM_T *bpwm;
@@ -86,6 +100,49 @@ int32_t PWM_ChangeChannelDuty(
     uint32_t u32Duty
 );
 
+//Capture counter values of an EPWM channel into pu16Buf by PDMA, EPWM only.
+//In eCAPTURE_RISING_FALLING_LATCH mode rising and falling latches are stored in turn, rising first.
+int32_t PWM_CapturePDMAStart(
+    pwm_t *psPWMObj,
+    uint32_t u32Channel,
+    E_CAPTURE_EDGE_LATCH_TYPE eCaptureEdge,
+    uint16_t *pu16Buf,
+    uint32_t u32BufLen		//count of uint16_t
+);
+
+//Return count of captured values so far, u32BufLen when done
+uint32_t PWM_CapturePDMACount(
+    pwm_t *psPWMObj,
+    uint32_t u32Channel
+);
+
+int32_t PWM_CapturePDMAStop(
+    pwm_t *psPWMObj,
+    uint32_t u32Channel
+);
+
+//Motor control mode, EPWM only: complementary pairs with dead-time, up-down (center aligned) counting,
+//all pairs started together. Duty of all pairs is 0 until PWM_MotorSetDuty().
+int32_t PWM_MotorInit(
+    pwm_t *psPWMObj,
+    PWM_MotorInitTypeDef *psInitDef
+);
+
+//Update the duty (0~65535 for 0~100% high side on-time) of all pairs given in u32PairMask.
+//New values are loaded together at the end of the current period.
+int32_t PWM_MotorSetDuty(
+    pwm_t *psPWMObj,
+    const uint16_t *pu16Duty	//indexed by pair number
+);
+
+//Hook called every period half a period after the ADC trigger point of the lowest pair, so conversions started
+//at the trigger are complete. Duty set in the hook is applied from the next period. NULL to remove.
+int32_t PWM_MotorSetPeriodHandler(
+    pwm_t *psPWMObj,
+    PFN_PWM_PERIOD_HANDLER pfnHandler,
+    void *pvUserData
+);
+
 void Handle_BPWM_Irq(BPWM_T *bpwm);
 void Handle_EPWM_Irq(EPWM_T *epwm, uint32_t u32ChannGroup);
 
@@ -11,33 +11,66 @@
 
 #include "M55M1_Timer.h"
 #include "nu_modutil.h"
+#include "drv_pdma.h"
+
+#define TIMER_METER_MODULUS	0xFFFFFF
+
+typedef enum {
+    eTIMER_METER_FREE,			//free counting, counter wraps are accumulated
+    eTIMER_METER_GATE,			//counting edges until the gate timer expires
+    eTIMER_METER_PERIOD,		//gate timer counts clocks until the last edge
+    eTIMER_METER_DONE,
+} E_TIMER_METER_STATE;
 
 struct nu_timer_var {
     hw_timer_t *  psObj;
+    hw_timer_t *  meter_peer;				//gate timer of a counter and vice versa
+    volatile uint32_t meter_state;
+    uint32_t    meter_cnt_wraps;
+    uint32_t    meter_ref_wraps;
+    uint32_t    meter_cnt_start;
+    uint32_t    meter_ref_start;
+    uint32_t    meter_edges;
+    uint64_t    meter_ticks;
+
+    uint8_t     pdma_perp_pwm;
+    int         pwm_dma_chn_id;
+    nu_pdma_desc_t pwm_dma_desc;			//self linked descriptor of circular stream
+    volatile bool pwm_dma_done;
 };
 
 static struct nu_timer_var timer0_var = {
     .psObj                =   NULL,
+    .pdma_perp_pwm        =   PDMA_TMR0,
+    .pwm_dma_chn_id       =   NU_PDMA_OUT_OF_CHANNELS,
 };
 
 static struct nu_timer_var timer1_var = {
     .psObj                =   NULL,
+    .pdma_perp_pwm        =   PDMA_TMR1,
+    .pwm_dma_chn_id       =   NU_PDMA_OUT_OF_CHANNELS,
 };
 
 static struct nu_timer_var timer2_var = {
     .psObj                =   NULL,
+    .pdma_perp_pwm        =   PDMA_TMR2,
+    .pwm_dma_chn_id       =   NU_PDMA_OUT_OF_CHANNELS,
 };
 
 static struct nu_timer_var timer3_var = {
     .psObj                =   NULL,
+    .pdma_perp_pwm        =   PDMA_TMR3,
+    .pwm_dma_chn_id       =   NU_PDMA_OUT_OF_CHANNELS,
 };
 
 static struct nu_timer_var timer4_var = {
     .psObj                =   NULL,
+    .pwm_dma_chn_id       =   NU_PDMA_OUT_OF_CHANNELS,
 };
 
 static struct nu_timer_var timer5_var = {
     .psObj                =   NULL,
+    .pwm_dma_chn_id       =   NU_PDMA_OUT_OF_CHANNELS,
 };
 
 static const struct nu_modinit_s timer_modinit_tab[] = {
@@ -107,6 +140,8 @@ void Timer_Final(
         return;
     }
 
+    Timer_PWMPDMAStreamStop(psObj);
+
     TIMER_Stop(psObj->u_timer.timer);
     TIMER_Close(psObj->u_timer.timer);
     return;
@@ -564,6 +599,454 @@ uint32_t Timer_GetPWMCompareData(
     return (psObj->u_timer.timer)->PWMCMPDAT;
 }
 
+static void Timer_PWM_DMA_Handler(void *pvUserData, uint32_t event_dma)
+{
+    struct nu_timer_var *timer_var = (struct nu_timer_var *)pvUserData;
+
+    if (event_dma & (NU_PDMA_EVENT_TRANSFER_DONE | NU_PDMA_EVENT_ABORT))
+        timer_var->pwm_dma_done = true;
+}
+
+int32_t Timer_PWMPDMAStream(
+    hw_timer_t *psObj,
+    const uint16_t *pu16Buf,
+    uint32_t u32BufLen,
+    bool bCircular
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->u_timer.timer, timer_modinit_tab);
+
+    if((modinit == NULL) || (psObj->bLPTimer))
+        return -1;
+
+    struct nu_timer_var *timer_var = (struct nu_timer_var *)modinit->var;
+    TIMER_T *timer = psObj->u_timer.timer;
+
+    if(u32BufLen == 0)
+        return -1;
+
+    //The whole buffer is replayed by one descriptor
+    if((bCircular) && (u32BufLen > NU_PDMA_MAX_TXCNT))
+        return -2;
+
+    if(timer_var->pwm_dma_chn_id != NU_PDMA_OUT_OF_CHANNELS)
+        Timer_PWMPDMAStreamStop(psObj);
+
+    timer_var->pwm_dma_chn_id = nu_pdma_channel_dynamic_allocate(timer_var->pdma_perp_pwm);
+
+    if(timer_var->pwm_dma_chn_id == NU_PDMA_OUT_OF_CHANNELS)
+        return -3;
+
+    timer_var->pwm_dma_done = false;
+
+#if (NVT_DCACHE_ON == 1)
+    // Compare values must reach memory before PDMA reads them
+    SCB_CleanDCache_by_Addr((void *)pu16Buf, u32BufLen * sizeof(uint16_t));
+#endif
+
+    if(bCircular) {
+        if(nu_pdma_sgtbls_allocate(&timer_var->pwm_dma_desc, 1) != 0) {
+            nu_pdma_channel_free(timer_var->pwm_dma_chn_id);
+            timer_var->pwm_dma_chn_id = NU_PDMA_OUT_OF_CHANNELS;
+            return -3;
+        }
+
+        // Descriptor linked to itself, replays the buffer without interrupt until stopped
+        nu_pdma_desc_setup(timer_var->pwm_dma_chn_id, timer_var->pwm_dma_desc, 16,
+                           (uint32_t)pu16Buf, (uint32_t)&timer->PWMCMPDAT,
+                           u32BufLen, timer_var->pwm_dma_desc, 1);
+
+        nu_pdma_sg_transfer(timer_var->pwm_dma_chn_id, timer_var->pwm_dma_desc, 0);
+    } else {
+        struct nu_pdma_chn_cb pdma_pwm_chn_cb;
+
+        nu_pdma_filtering_set(timer_var->pwm_dma_chn_id, NU_PDMA_EVENT_TRANSFER_DONE | NU_PDMA_EVENT_ABORT);
+
+        pdma_pwm_chn_cb.m_eCBType = eCBType_Event;
+        pdma_pwm_chn_cb.m_pfnCBHandler = Timer_PWM_DMA_Handler;
+        pdma_pwm_chn_cb.m_pvUserData = timer_var;
+
+        nu_pdma_callback_register(timer_var->pwm_dma_chn_id, &pdma_pwm_chn_cb);
+
+        nu_pdma_transfer(timer_var->pwm_dma_chn_id, 16,
+                         (uint32_t)pu16Buf, (uint32_t)&timer->PWMCMPDAT,
+                         u32BufLen, 0);
+    }
+
+    // One PDMA request per PWM period, CMPDAT is double buffered and loaded at the next period
+    TPWM_EnableTrigger(timer, TPWM_TRG_TO_PDMA, TPWM_TRIGGER_AT_PERIOD_POINT);
+
+    return 0;
+}
+
+bool Timer_IsPWMPDMAStreamDone(
+    hw_timer_t *psObj
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->u_timer.timer, timer_modinit_tab);
+
+    if(modinit == NULL)
+        return true;
+
+    struct nu_timer_var *timer_var = (struct nu_timer_var *)modinit->var;
+
+    if(timer_var->pwm_dma_chn_id == NU_PDMA_OUT_OF_CHANNELS)
+        return true;
+
+    return timer_var->pwm_dma_done;
+}
+
+void Timer_PWMPDMAStreamStop(
+    hw_timer_t *psObj
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->u_timer.timer, timer_modinit_tab);
+
+    if((modinit == NULL) || (psObj->bLPTimer))
+        return;
+
+    struct nu_timer_var *timer_var = (struct nu_timer_var *)modinit->var;
+
+    if(timer_var->pwm_dma_chn_id == NU_PDMA_OUT_OF_CHANNELS)
+        return;
+
+    TPWM_DisableTrigger(psObj->u_timer.timer, TPWM_TRG_TO_PDMA);
+
+    nu_pdma_channel_terminate(timer_var->pwm_dma_chn_id);
+    nu_pdma_channel_free(timer_var->pwm_dma_chn_id);
+    timer_var->pwm_dma_chn_id = NU_PDMA_OUT_OF_CHANNELS;
+
+    if(timer_var->pwm_dma_desc) {
+        nu_pdma_sgtbls_free(&timer_var->pwm_dma_desc, 1);
+        timer_var->pwm_dma_desc = NULL;
+    }
+
+    timer_var->pwm_dma_done = true;
+}
+
+static struct nu_timer_var *Timer_GetMeterVar(
+    hw_timer_t *psObj
+)
+{
+    const struct nu_modinit_s *modinit = get_modinit((uint32_t)psObj->u_timer.timer, timer_modinit_tab);
+
+    if((modinit == NULL) || (psObj->bLPTimer))
+        return NULL;
+
+    return (struct nu_timer_var *)modinit->var;
+}
+
+//Read counter and reference counter back to back, pending wrap interrupts are taken into account
+static void Timer_MeterSnapshot(
+    struct nu_timer_var *cnt_var,
+    uint32_t *pu32Edges,
+    uint64_t *pu64Ticks
+)
+{
+    TIMER_T *counter = cnt_var->psObj->u_timer.timer;
+    TIMER_T *gate = cnt_var->meter_peer->u_timer.timer;
+    uint32_t u32Cnt = TIMER_GetCounter(counter);
+    uint32_t u32Ref = TIMER_GetCounter(gate);
+
+    if((cnt_var->meter_state == eTIMER_METER_GATE) && TIMER_GetIntFlag(counter) && (u32Cnt < (TIMER_METER_MODULUS / 2))) {
+        TIMER_ClearIntFlag(counter);
+        cnt_var->meter_cnt_wraps ++;
+    }
+
+    if((cnt_var->meter_state == eTIMER_METER_PERIOD) && TIMER_GetIntFlag(gate) && (u32Ref < (TIMER_METER_MODULUS / 2))) {
+        TIMER_ClearIntFlag(gate);
+        cnt_var->meter_ref_wraps ++;
+    }
+
+    if(cnt_var->meter_state == eTIMER_METER_GATE) {
+        *pu32Edges = (cnt_var->meter_cnt_wraps * TIMER_METER_MODULUS) + u32Cnt;
+    } else {
+        //Continuous counting, counter rolls over at 24 bits
+        *pu32Edges = (u32Cnt - cnt_var->meter_cnt_start) & TIMER_METER_MODULUS;
+    }
+
+    *pu64Ticks = ((uint64_t)cnt_var->meter_ref_wraps * TIMER_METER_MODULUS) + u32Ref - cnt_var->meter_ref_start;
+}
+
+static void Timer_MeterFinish(
+    struct nu_timer_var *cnt_var
+)
+{
+    TIMER_Stop(cnt_var->psObj->u_timer.timer);
+    TIMER_Stop(cnt_var->meter_peer->u_timer.timer);
+    TIMER_DisableInt(cnt_var->meter_peer->u_timer.timer);
+    cnt_var->meter_state = eTIMER_METER_DONE;
+}
+
+static void Timer_Counter_Handler(void *obj, uint32_t u32Status)
+{
+    struct nu_timer_var *cnt_var = Timer_GetMeterVar((hw_timer_t *)obj);
+    uint64_t u64Ticks;
+
+    if(cnt_var == NULL)
+        return;
+
+    if(cnt_var->meter_state == eTIMER_METER_PERIOD) {
+        //Last edge counted
+        Timer_MeterSnapshot(cnt_var, &cnt_var->meter_edges, &u64Ticks);
+        cnt_var->meter_ticks = u64Ticks;
+        Timer_MeterFinish(cnt_var);
+    } else if(cnt_var->meter_state != eTIMER_METER_DONE) {
+        cnt_var->meter_cnt_wraps ++;
+    }
+}
+
+static void Timer_Gate_Handler(void *obj, uint32_t u32Status)
+{
+    struct nu_timer_var *gate_var = Timer_GetMeterVar((hw_timer_t *)obj);
+    struct nu_timer_var *cnt_var;
+    uint64_t u64Ticks;
+
+    if((gate_var == NULL) || (gate_var->meter_peer == NULL))
+        return;
+
+    cnt_var = Timer_GetMeterVar(gate_var->meter_peer);
+
+    if(cnt_var == NULL)
+        return;
+
+    if(cnt_var->meter_state == eTIMER_METER_GATE) {
+        //End of gate, meter_ticks is the gate length
+        TIMER_Stop(cnt_var->psObj->u_timer.timer);
+        Timer_MeterSnapshot(cnt_var, &cnt_var->meter_edges, &u64Ticks);
+        Timer_MeterFinish(cnt_var);
+    } else if(cnt_var->meter_state == eTIMER_METER_PERIOD) {
+        cnt_var->meter_ref_wraps ++;
+    }
+}
+
+//Reset and restart the counter and the gate timer, both are started with interrupts masked
+static void Timer_MeterRestart(
+    struct nu_timer_var *cnt_var,
+    uint32_t u32CntMode,
+    uint32_t u32GateMode,
+    uint32_t u32GatePrescale,
+    uint32_t u32GatePeriod,
+    uint32_t u32State
+)
+{
+    TIMER_T *counter = cnt_var->psObj->u_timer.timer;
+    TIMER_T *gate = cnt_var->meter_peer ? cnt_var->meter_peer->u_timer.timer : NULL;
+
+    TIMER_Stop(counter);
+    TIMER_SET_CMP_VALUE(counter, TIMER_METER_MODULUS);
+    TIMER_SET_OPMODE(counter, u32CntMode);
+    TIMER_ResetCounter(counter);
+    TIMER_ClearIntFlag(counter);
+
+    if(gate) {
+        TIMER_Stop(gate);
+        TIMER_DisableInt(gate);
+        TIMER_SET_PRESCALE_VALUE(gate, u32GatePrescale);
+        TIMER_SET_CMP_VALUE(gate, u32GatePeriod);
+        TIMER_SET_OPMODE(gate, u32GateMode);
+        TIMER_ResetCounter(gate);
+        TIMER_ClearIntFlag(gate);
+    }
+
+    uint32_t u32Primask = __get_PRIMASK();
+    __disable_irq();
+
+    cnt_var->meter_state = u32State;
+    cnt_var->meter_cnt_wraps = 0;
+    cnt_var->meter_ref_wraps = 0;
+    cnt_var->meter_cnt_start = 0;
+    cnt_var->meter_ref_start = 0;
+
+    //Gate timer is idle while free counting
+    if((gate) && (u32State != eTIMER_METER_FREE)) {
+        TIMER_Start(gate);
+        TIMER_EnableInt(gate);
+    }
+
+    TIMER_Start(counter);
+
+    __set_PRIMASK(u32Primask);
+}
+
+int32_t Timer_CounterStart(
+    hw_timer_t *psCounter,
+    hw_timer_t *psGate,
+    uint32_t u32Edge
+)
+{
+    struct nu_timer_var *cnt_var = Timer_GetMeterVar(psCounter);
+    struct nu_timer_var *gate_var = Timer_GetMeterVar(psGate);
+
+    if((cnt_var == NULL) || (gate_var == NULL) || (cnt_var == gate_var))
+        return -1;
+
+    cnt_var->meter_peer = psGate;
+    gate_var->meter_peer = psCounter;
+
+    TIMER_Stop(psCounter->u_timer.timer);
+    TIMER_SET_PRESCALE_VALUE(psCounter->u_timer.timer, 0);
+    TIMER_EnableEventCounter(psCounter->u_timer.timer, u32Edge);
+
+    Timer_EnableInt(psCounter, Timer_Counter_Handler);
+    Timer_EnableInt(psGate, Timer_Gate_Handler);
+
+    Timer_MeterRestart(cnt_var, TIMER_PERIODIC_MODE, TIMER_PERIODIC_MODE, 0, TIMER_METER_MODULUS, eTIMER_METER_FREE);
+
+    return 0;
+}
+
+uint64_t Timer_CounterRead(
+    hw_timer_t *psCounter
+)
+{
+    struct nu_timer_var *cnt_var = Timer_GetMeterVar(psCounter);
+    uint32_t u32Cnt;
+    uint64_t u64Count;
+
+    if(cnt_var == NULL)
+        return 0;
+
+    uint32_t u32Primask = __get_PRIMASK();
+    __disable_irq();
+
+    u32Cnt = TIMER_GetCounter(psCounter->u_timer.timer);
+
+    if((cnt_var->meter_state == eTIMER_METER_FREE) && TIMER_GetIntFlag(psCounter->u_timer.timer) && (u32Cnt < (TIMER_METER_MODULUS / 2))) {
+        TIMER_ClearIntFlag(psCounter->u_timer.timer);
+        cnt_var->meter_cnt_wraps ++;
+    }
+
+    u64Count = ((uint64_t)cnt_var->meter_cnt_wraps * TIMER_METER_MODULUS) + u32Cnt;
+
+    __set_PRIMASK(u32Primask);
+
+    return u64Count;
+}
+
+int32_t Timer_CounterReset(
+    hw_timer_t *psCounter
+)
+{
+    struct nu_timer_var *cnt_var = Timer_GetMeterVar(psCounter);
+
+    if((cnt_var == NULL) || (cnt_var->meter_peer == NULL))
+        return -1;
+
+    Timer_MeterRestart(cnt_var, TIMER_PERIODIC_MODE, TIMER_PERIODIC_MODE, 0, TIMER_METER_MODULUS, eTIMER_METER_FREE);
+
+    return 0;
+}
+
+int32_t Timer_MeterGate(
+    hw_timer_t *psCounter,
+    uint32_t u32GateTicks
+)
+{
+    struct nu_timer_var *cnt_var = Timer_GetMeterVar(psCounter);
+    uint32_t u32Prescale;
+    uint32_t u32Period;
+
+    if((cnt_var == NULL) || (cnt_var->meter_peer == NULL) || (u32GateTicks < 2))
+        return -1;
+
+    //24 bits CMPDAT, 8 bits prescaler
+    u32Prescale = (u32GateTicks - 1) >> 24;
+    if(u32Prescale > 0xFF)
+        return -2;
+
+    u32Period = u32GateTicks / (u32Prescale + 1);
+    cnt_var->meter_ticks = (uint64_t)u32Period * (u32Prescale + 1);
+
+    Timer_MeterRestart(cnt_var, TIMER_PERIODIC_MODE, TIMER_ONESHOT_MODE, u32Prescale, u32Period, eTIMER_METER_GATE);
+
+    return 0;
+}
+
+int32_t Timer_MeterPeriod(
+    hw_timer_t *psCounter,
+    uint32_t u32Edges
+)
+{
+    struct nu_timer_var *cnt_var = Timer_GetMeterVar(psCounter);
+    TIMER_T *counter;
+    TIMER_T *gate;
+
+    if((cnt_var == NULL) || (cnt_var->meter_peer == NULL) || (u32Edges == 0) || (u32Edges >= TIMER_METER_MODULUS))
+        return -1;
+
+    counter = psCounter->u_timer.timer;
+    gate = cnt_var->meter_peer->u_timer.timer;
+
+    //Counter runs continuous so that CMPDAT can be moved ahead of it
+    Timer_MeterRestart(cnt_var, TIMER_CONTINUOUS_MODE, TIMER_PERIODIC_MODE, 0, TIMER_METER_MODULUS, eTIMER_METER_PERIOD);
+
+    uint32_t u32Primask = __get_PRIMASK();
+    __disable_irq();
+
+    //Measurement starts at the first snapshot, edge phase error is one input period over u32Edges
+    cnt_var->meter_cnt_start = TIMER_GetCounter(counter);
+    cnt_var->meter_ref_start = TIMER_GetCounter(gate);
+    TIMER_SET_CMP_VALUE(counter, (cnt_var->meter_cnt_start + u32Edges) & TIMER_METER_MODULUS);
+    TIMER_ClearIntFlag(counter);
+
+    //Fast input may already be past CMPDAT, finish right now instead of waiting for the roll over
+    if(((TIMER_GetCounter(counter) - cnt_var->meter_cnt_start) & TIMER_METER_MODULUS) >= u32Edges) {
+        uint64_t u64Ticks;
+
+        Timer_MeterSnapshot(cnt_var, &cnt_var->meter_edges, &u64Ticks);
+        cnt_var->meter_ticks = u64Ticks;
+        Timer_MeterFinish(cnt_var);
+    }
+
+    __set_PRIMASK(u32Primask);
+
+    return 0;
+}
+
+bool Timer_MeterResult(
+    hw_timer_t *psCounter,
+    uint32_t *pu32Edges,
+    uint64_t *pu64Ticks
+)
+{
+    struct nu_timer_var *cnt_var = Timer_GetMeterVar(psCounter);
+
+    if((cnt_var == NULL) || (cnt_var->meter_state != eTIMER_METER_DONE))
+        return false;
+
+    *pu32Edges = cnt_var->meter_edges;
+    *pu64Ticks = cnt_var->meter_ticks;
+    return true;
+}
+
+void Timer_CounterStop(
+    hw_timer_t *psCounter
+)
+{
+    struct nu_timer_var *cnt_var = Timer_GetMeterVar(psCounter);
+
+    if(cnt_var == NULL)
+        return;
+
+    TIMER_Stop(psCounter->u_timer.timer);
+    TIMER_DisableInt(psCounter->u_timer.timer);
+    TIMER_DisableEventCounter(psCounter->u_timer.timer);
+
+    if(cnt_var->meter_peer) {
+        struct nu_timer_var *gate_var = Timer_GetMeterVar(cnt_var->meter_peer);
+
+        TIMER_Stop(cnt_var->meter_peer->u_timer.timer);
+        TIMER_DisableInt(cnt_var->meter_peer->u_timer.timer);
+
+        if(gate_var)
+            gate_var->meter_peer = NULL;
+        cnt_var->meter_peer = NULL;
+    }
+
+    cnt_var->meter_state = eTIMER_METER_FREE;
+}
+
 void Handle_Timer_Irq(TIMER_T *timer)
 {
     uint32_t u32Status;
@@ -151,6 +151,68 @@ uint32_t Timer_GetPWMCompareData(
     hw_timer_t *psObj
 );
 
+//Write pu16Buf[i] to the PWM compare register on each PWM period by PDMA, from the period after the call.
+//One-shot: the last value stays in effect once the buffer is done. Circular: replays the buffer until
+//Timer_PWMPDMAStreamStop(), u32BufLen <= NU_PDMA_MAX_TXCNT. pu16Buf must stay valid while streaming.
+//Timer PWM must be set up by Timer_SetPWMMode(), LPTimer is not supported.
+int32_t Timer_PWMPDMAStream(
+    hw_timer_t *psObj,
+    const uint16_t *pu16Buf,
+    uint32_t u32BufLen,		//count of uint16_t
+    bool bCircular
+);
+
+bool Timer_IsPWMPDMAStreamDone(
+    hw_timer_t *psObj
+);
+
+void Timer_PWMPDMAStreamStop(
+    hw_timer_t *psObj
+);
+
+//Count edges on the TMx pin of psCounter, u32Edge: TIMER_COUNTER_EVENT_RISING/TIMER_COUNTER_EVENT_FALLING.
+//psGate is a second timer used as gate/reference clock by Timer_MeterGate() and Timer_MeterPeriod().
+//Both timers must be initialized by Timer_Init(), LPTimer is not supported.
+int32_t Timer_CounterStart(
+    hw_timer_t *psCounter,
+    hw_timer_t *psGate,
+    uint32_t u32Edge
+);
+
+//Edges counted since start/reset
+uint64_t Timer_CounterRead(
+    hw_timer_t *psCounter
+);
+
+int32_t Timer_CounterReset(
+    hw_timer_t *psCounter
+);
+
+//Gated measurement: count edges while the gate timer runs u32GateTicks module clocks,
+//the result is taken in the single end of gate interrupt.
+int32_t Timer_MeterGate(
+    hw_timer_t *psCounter,
+    uint32_t u32GateTicks
+);
+
+//Reciprocal measurement: gate timer module clocks elapsed during u32Edges input edges,
+//the result is taken in the counter compare interrupt on the last edge.
+int32_t Timer_MeterPeriod(
+    hw_timer_t *psCounter,
+    uint32_t u32Edges
+);
+
+//Return true when the measurement is done. Input frequency = edges * gate clock / ticks
+bool Timer_MeterResult(
+    hw_timer_t *psCounter,
+    uint32_t *pu32Edges,
+    uint64_t *pu64Ticks
+);
+
+void Timer_CounterStop(
+    hw_timer_t *psCounter
+);
+
 void Handle_Timer_Irq(TIMER_T *timer);
 void Handle_LPTimer_Irq(LPTMR_T *lptimer);
 
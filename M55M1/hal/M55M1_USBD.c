@@ -17,7 +17,25 @@
 #include "MSC_VCPDesc.h"
 #include "MSC_VCPTrans.h"
 
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
 static S_USBDEV_STATE s_sUSBDev_state;
+
+//Writers blocked on a full VCP send ring wait on s_tVCPSendSem, given by the EP2 interrupt
+static xSemaphoreHandle s_tVCPSendSem = NULL;
+static volatile bool s_bVCPSendWait = false;
+//Set when a write timed out, writers do not wait again until the host takes data
+static volatile bool s_bVCPSendStalled = false;
+//Task writers take turns on the single producer side of the send ring
+static xSemaphoreHandle s_tVCPSendMutex = NULL;
+static volatile bool s_bVCPSendLocked = false;
+//Readers waiting for VCP data sleep on s_tVCPRecvSem, given by the EP3 interrupt
+static xSemaphoreHandle s_tVCPRecvSem = NULL;
+static volatile bool s_bVCPRecvWait = false;
+//The MSC service task sleeps on s_tMSCEventSem, given by the interrupt on MSC bulk and bus events
+static xSemaphoreHandle s_tMSCEventSem = NULL;
 S_USBD_INFO_T g_sUSBDev_DescInfo;
 
 uint32_t volatile g_u32MSCOutToggle = 0, g_u32MSCOutSkip = 0;
@@ -77,6 +95,18 @@ S_USBDEV_STATE *USBDEV_Init(
 
     EnableHSUSBDevPhyClock();
 
+    if(s_tVCPSendSem == NULL)
+        s_tVCPSendSem = xSemaphoreCreateBinary();
+
+    if(s_tVCPSendMutex == NULL)
+        s_tVCPSendMutex = xSemaphoreCreateMutex();
+
+    if(s_tVCPRecvSem == NULL)
+        s_tVCPRecvSem = xSemaphoreCreateBinary();
+
+    if(s_tMSCEventSem == NULL)
+        s_tMSCEventSem = xSemaphoreCreateBinary();
+
     if((eUSBMode & eUSBDEV_MODE_MSC_VCP) == eUSBDEV_MODE_MSC_VCP) {
         MSCVCPDesc_SetupDescInfo(&g_sUSBDev_DescInfo);
         MSCVCPDesc_SetVID(&g_sUSBDev_DescInfo, u16VID);
@@ -138,6 +168,16 @@ int32_t USBDEV_DataBusConnect(void)
     return g_u32DataBusConnect;
 }
 
+int32_t USBDEV_MSCWaitEvent(
+    uint32_t u32Timeout
+)
+{
+    if(s_tMSCEventSem == NULL)
+        return 0;
+
+    return (xSemaphoreTake(s_tMSCEventSem, (u32Timeout == USBDEV_WAIT_FOREVER) ? portMAX_DELAY : pdMS_TO_TICKS(u32Timeout)) == pdTRUE);
+}
+
 void USBDEV_MSCEnDisable(
     int32_t i32EnDisable
 )
@@ -158,6 +198,18 @@ int32_t USBDEV_VCPCanSend(
     return VCPTrans_BulkInCanSend();
 }
 
+//Callers can sleep: a task with interrupts enabled, not an ISR or the start-up code
+static bool USBDEV_VCPCanWait(void)
+{
+    if((__get_IPSR() != 0) || (__get_PRIMASK() != 0))
+        return false;
+
+    return (s_tVCPSendSem != NULL) && (s_tVCPSendMutex != NULL) && (s_tVCPRecvSem != NULL) &&
+           (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING);
+}
+
+//Queue u32DataBufLen bytes into the send ring. While the host reads the VCP, a full ring blocks the
+//caller until the EP2 interrupt frees space, at most u32Timeout ms. Return the queued length.
 int32_t USBDEV_VCPSendData(
     uint8_t *pu8DataBuf,
     uint32_t u32DataBufLen,
@@ -165,24 +217,54 @@ int32_t USBDEV_VCPSendData(
     S_USBDEV_STATE *psUSBDevState
 )
 {
-    int i32SendedLen = 0;
+    uint32_t u32SendedLen = 0;
+    uint32_t u32SendTime = mp_hal_ticks_ms();
+    bool bCanWait = USBDEV_VCPCanWait();
+
     if(pu8DataBuf == NULL)
-        return i32SendedLen;
+        return 0;
 
-    i32SendedLen = VCPTrans_BulkInSend(pu8DataBuf, u32DataBufLen);
+    if(bCanWait) {
+        xSemaphoreTake(s_tVCPSendMutex, portMAX_DELAY);
+        s_bVCPSendLocked = true;
+    } else if(s_bVCPSendLocked) {
+        // Interrupt output while a task is in the middle of its write
+        return 0;
+    }
 
-    uint32_t u32SendTime = mp_hal_ticks_ms();
+    while(1) {
+        u32SendedLen += VCPTrans_BulkInSend(pu8DataBuf + u32SendedLen, u32DataBufLen - u32SendedLen);
 
-    while((mp_hal_ticks_ms() - u32SendTime) < u32Timeout) {
-        if((i32SendedLen >=  u32DataBufLen))
+        if(u32SendedLen >= u32DataBufLen)
             break;
 
-        if(VCPTrans_BulkInCanSend()) {
-            i32SendedLen += VCPTrans_BulkInSend(pu8DataBuf + i32SendedLen, u32DataBufLen);
+        // Nobody reads: keep what fits without waiting
+        if((s_bVCPSendStalled) || (!USBD_IS_ATTACHED()) || (!g_u32VCPConnect) || (!bCanWait))
+            break;
+
+        uint32_t u32Elapsed = mp_hal_ticks_ms() - u32SendTime;
+
+        if(u32Elapsed >= u32Timeout) {
+            if(u32Timeout)
+                s_bVCPSendStalled = true;
+            break;
         }
+
+        s_bVCPSendWait = true;
+
+        // Space freed before the wait flag was seen by the EP2 interrupt
+        if(VCPTrans_BulkInCanSend())
+            continue;
+
+        xSemaphoreTake(s_tVCPSendSem, pdMS_TO_TICKS(u32Timeout - u32Elapsed) + 1);
     }
 
-    return i32SendedLen;
+    if(bCanWait) {
+        s_bVCPSendLocked = false;
+        xSemaphoreGive(s_tVCPSendMutex);
+    }
+
+    return u32SendedLen;
 }
 
 int32_t USBDEV_VCPCanRecv(
@@ -192,6 +274,40 @@ int32_t USBDEV_VCPCanRecv(
     return VCPTrans_BulkOutCanRecv();
 }
 
+//Wait at most u32Timeout ms (USBDEV_WAIT_FOREVER: no limit) for received VCP data, return the available length.
+//Tasks sleep until the EP3 interrupt stores a packet, other callers poll.
+int32_t USBDEV_VCPWaitRecv(
+    uint32_t u32Timeout,
+    S_USBDEV_STATE *psUSBDevState
+)
+{
+    uint32_t u32WaitTime = mp_hal_ticks_ms();
+    bool bCanWait = USBDEV_VCPCanWait();
+    int32_t i32Len;
+
+    while((i32Len = VCPTrans_BulkOutCanRecv()) == 0) {
+        uint32_t u32Elapsed = mp_hal_ticks_ms() - u32WaitTime;
+
+        if((u32Timeout != USBDEV_WAIT_FOREVER) && (u32Elapsed >= u32Timeout))
+            break;
+
+        if(!bCanWait)
+            continue;
+
+        s_bVCPRecvWait = true;
+
+        // A packet stored before the wait flag was seen by the EP3 interrupt
+        if(VCPTrans_BulkOutCanRecv())
+            continue;
+
+        xSemaphoreTake(s_tVCPRecvSem, (u32Timeout == USBDEV_WAIT_FOREVER) ? portMAX_DELAY : (pdMS_TO_TICKS(u32Timeout - u32Elapsed) + 1));
+    }
+
+    s_bVCPRecvWait = false;
+    return i32Len;
+}
+
+//Receive up to u32DataBufLen bytes, until the buffer is full or no data came for u32Timeout ms
 int32_t USBDEV_VCPRecvData(
     uint8_t *pu8DataBuf,
     uint32_t u32DataBufLen,
@@ -199,26 +315,19 @@ int32_t USBDEV_VCPRecvData(
     S_USBDEV_STATE *psUSBDevState
 )
 {
-    int i32CopyLen = 0;
-    int i32RecvLen = 0;
+    uint32_t u32RecvLen = 0;
 
     if(pu8DataBuf == NULL)
-        return i32RecvLen;
-
-    uint32_t u32RecvTime = mp_hal_ticks_ms();
+        return 0;
 
-    while((mp_hal_ticks_ms() - u32RecvTime) < u32Timeout) {
+    while(u32RecvLen < u32DataBufLen) {
+        u32RecvLen += VCPTrans_BulkOutRecv(pu8DataBuf + u32RecvLen, u32DataBufLen - u32RecvLen);
 
-        i32CopyLen = VCPTrans_BulkOutRecv(pu8DataBuf + i32RecvLen, u32DataBufLen - i32RecvLen);
-        if(i32CopyLen) {
-            i32RecvLen += i32CopyLen;
-            if(i32RecvLen >= u32DataBufLen)
-                break;
-            u32RecvTime = mp_hal_ticks_ms();
-        }
+        if((u32RecvLen < u32DataBufLen) && (USBDEV_VCPWaitRecv(u32Timeout, psUSBDevState) == 0))
+            break;
     }
 
-    return i32RecvLen;
+    return u32RecvLen;
 }
 
 static void EP5_Handler(void)
@@ -236,7 +345,16 @@ static void EP2_Handler(void)
 {
     //VCP/MSC Bulk IN handler
     if(s_sUSBDev_state.eUSBMode & eUSBDEV_MODE_VCP) {
-        VCPTrans_BulkInHandler();
+        if(VCPTrans_BulkInHandler() > 0)
+            s_bVCPSendStalled = false;
+
+        if(s_bVCPSendWait) {
+            BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+            s_bVCPSendWait = false;
+            xSemaphoreGiveFromISR(s_tVCPSendSem, &xHigherPriorityTaskWoken);
+            portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+        }
     } else if(s_sUSBDev_state.eUSBMode & eUSBDEV_MODE_HID) {
     }
 
@@ -257,7 +375,13 @@ static void EP3_Handler(void)
             /* bulk OUT */
             pu8EPAddr = (uint8_t *)(USBD_BUF_BASE + USBD_GET_EP_BUF_ADDR(EP3));
 
-            VCPTrans_BulkOutHandler(pu8EPAddr, USBD_GET_PAYLOAD_LEN(EP3));
+            if((VCPTrans_BulkOutHandler(pu8EPAddr, USBD_GET_PAYLOAD_LEN(EP3)) > 0) && (s_bVCPRecvWait)) {
+                BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+                s_bVCPRecvWait = false;
+                xSemaphoreGiveFromISR(s_tVCPRecvSem, &xHigherPriorityTaskWoken);
+                portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+            }
             g_u32VCPOutToggle = USBD->EPSTS0 & 0xf000;
         }
     } else if(s_sUSBDev_state.eUSBMode & eUSBDEV_MODE_HID) {
@@ -270,11 +394,13 @@ void Handle_USBDEV_Irq(
     uint32_t u32BusState
 )
 {
+    bool bMSCEvent = false;
 
 //------------------------------------------------------------------
     if (u32IntStatus & USBD_INTSTS_FLDET) {
         // Floating detect
         USBD_CLR_INT_FLAG(USBD_INTSTS_FLDET);
+        bMSCEvent = true;
 
         if (USBD_IS_ATTACHED()) {
             /* USB Plug In */
@@ -289,6 +415,7 @@ void Handle_USBDEV_Irq(
     if (u32IntStatus & USBD_INTSTS_BUS) {
         /* Clear event flag */
         USBD_CLR_INT_FLAG(USBD_INTSTS_BUS);
+        bMSCEvent = true;
 
         if (u32BusState & USBD_STATE_USBRST) {
             /* Bus reset */
@@ -299,6 +426,8 @@ void Handle_USBDEV_Irq(
             g_u32VCPConnect = 0;
             g_u32MSCConnect = 0;
             g_u32DataBusConnect = 1;
+            VCPTrans_BulkInReset();
+            VCPTrans_BulkOutReset();
             printf("USBD_STATE_USBRST \n");
         }
         if (u32BusState & USBD_STATE_SUSPEND) {
@@ -381,6 +510,7 @@ void Handle_USBDEV_Irq(
             USBD_CLR_INT_FLAG(USBD_INTSTS_EP5);
             // Interrupt IN
             EP5_Handler();
+            bMSCEvent = true;
         }
 
         if (u32IntStatus & USBD_INTSTS_EP6) {
@@ -388,6 +518,7 @@ void Handle_USBDEV_Irq(
             USBD_CLR_INT_FLAG(USBD_INTSTS_EP6);
             // Interrupt OUT
             EP6_Handler();
+            bMSCEvent = true;
         }
 
         if (u32IntStatus & USBD_INTSTS_EP7) {
@@ -401,6 +532,14 @@ void Handle_USBDEV_Irq(
         }
 
     }
+
+    // Setup packets and VCP endpoints are served here, the MSC task only runs for its bulk endpoints and bus changes
+    if((bMSCEvent) && (s_tMSCEventSem != NULL)) {
+        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+        xSemaphoreGiveFromISR(s_tMSCEventSem, &xHigherPriorityTaskWoken);
+        portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+    }
 }
 
 void USBDEV_VCPRegisterSingal(
@@ -40,6 +40,8 @@ typedef struct {
 
 typedef int32_t (*PFN_USBDEV_VCPRecvSignal)(uint8_t *pu8Buf, uint32_t u32Size);
 
+#define USBDEV_WAIT_FOREVER		0xFFFFFFFF
+
 E_USBDEV_MODE USBDEV_GetMode(S_USBDEV_STATE *psUSBDevState);
 
 S_USBDEV_STATE *USBDEV_Init(
@@ -78,6 +80,12 @@ int32_t USBDEV_HIDRecvData(
     S_USBDEV_STATE *psUSBDevState
 );
 
+//Block up to u32Timeout ms (or USBDEV_WAIT_FOREVER) until VCP data is received, return the available length
+int32_t USBDEV_VCPWaitRecv(
+    uint32_t u32Timeout,
+    S_USBDEV_STATE *psUSBDevState
+);
+
 int32_t USBDEV_VCPRecvData(
     uint8_t *pu8DataBuf,
     uint32_t u32DataBufLen,
@@ -101,6 +109,7 @@ int32_t USBDEV_HIDSendData(
     S_USBDEV_STATE *psUSBDevState
 );
 
+//Queue data to the VCP, blocking up to u32Timeout ms on a full send ring while the host reads
 int32_t USBDEV_VCPSendData(
     uint8_t *pu8DataBuf,
     uint32_t u32DataBufLen,
@@ -118,6 +127,12 @@ void USBDEV_MSCEnDisable(
 
 int32_t USBDEV_DataBusConnect(void);
 
+//Block up to u32Timeout ms (or USBDEV_WAIT_FOREVER) until MSC bulk traffic or a bus event needs
+//MSCTrans_ProcessCmd(), return 0 on timeout
+int32_t USBDEV_MSCWaitEvent(
+    uint32_t u32Timeout
+);
+
 
 void USBDEV_VCPRegisterSingal(
     PFN_USBDEV_VCPRecvSignal pfnSignal
@@ -139,99 +139,137 @@ static int32_t volatile g_i32MSCMaxLun;
 /* Functions for VCP*/
 
 
-#define MAX_VCP_SEND_BUF_LEN	1024
+// Send ring, single producer (thread) and single consumer (EP2 interrupt). The indices run
+// freely and are masked on access, the length must be a power of 2 and at least one packet.
+#ifndef MAX_VCP_SEND_BUF_LEN
+#define MAX_VCP_SEND_BUF_LEN	2048
+#endif
+#if (MAX_VCP_SEND_BUF_LEN & (MAX_VCP_SEND_BUF_LEN - 1)) || (MAX_VCP_SEND_BUF_LEN < EP2_VCP_MAX_PKT_SIZE)
+#error "MAX_VCP_SEND_BUF_LEN must be a power of 2 of at least one packet"
+#endif
 static uint8_t s_au8VCPSendBuf[DCACHE_ALIGN_LINE_SIZE(MAX_VCP_SEND_BUF_LEN)]__attribute__((aligned(DCACHE_LINE_SIZE)));
-static volatile uint32_t s_u32VCPSendBufIn = 0;
-static volatile uint32_t s_u32VCPSendBufOut = 0;
-static volatile int32_t s_b32VCPSendTrans = 0;
+static volatile uint32_t s_u32VCPSendBufIn = 0;		//written by VCPTrans_BulkInSend()
+static volatile uint32_t s_u32VCPSendBufOut = 0;	//written by VCPTrans_BulkInHandler()
+static volatile int32_t s_b32VCPSendTrans = 0;		//EP2 IN transaction armed
+static volatile uint32_t s_u32VCPSendLastLen = 0;	//length of the armed packet
 
 
+//Load the next packet of the send ring into EP2, in EP2 interrupt context or with interrupts disabled
 int32_t VCPTrans_BulkInHandler()
 {
-    int32_t i32Len;
+    uint32_t u32Out = s_u32VCPSendBufOut;
+    uint32_t u32Len = s_u32VCPSendBufIn - u32Out;
+    uint32_t u32Idx = u32Out & (MAX_VCP_SEND_BUF_LEN - 1);
+    uint32_t u32FirstLen;
     uint8_t *pu8EPBufAddr;
 
-    if((s_b32VCPSendTrans) && (s_u32VCPSendBufIn == s_u32VCPSendBufOut)) {
-        s_b32VCPSendTrans = 0;
-        return 0;
-    }
+    if(u32Len == 0) {
+        // The host only completes a transfer ending with a full packet on a short one
+        if((s_b32VCPSendTrans) && (s_u32VCPSendLastLen == EP2_VCP_MAX_PKT_SIZE)) {
+            s_u32VCPSendLastLen = 0;
+            USBD_SET_PAYLOAD_LEN(EP2, 0);
+            return 0;
+        }
 
-    if(s_u32VCPSendBufOut > s_u32VCPSendBufIn) {
-        s_u32VCPSendBufOut = s_u32VCPSendBufIn;
         s_b32VCPSendTrans = 0;
         return 0;
     }
 
-    i32Len = s_u32VCPSendBufIn - s_u32VCPSendBufOut;
+    if(u32Len > EP2_VCP_MAX_PKT_SIZE)
+        u32Len = EP2_VCP_MAX_PKT_SIZE;
 
-    if(i32Len > EP2_VCP_MAX_PKT_SIZE)
-        i32Len = EP2_VCP_MAX_PKT_SIZE;
-
-    if(i32Len == 0) {
-        s_b32VCPSendTrans = 0;
-        return 0;
-    }
+    u32FirstLen = MAX_VCP_SEND_BUF_LEN - u32Idx;
+    if(u32FirstLen > u32Len)
+        u32FirstLen = u32Len;
 
     s_b32VCPSendTrans = 1;
     pu8EPBufAddr = (uint8_t *)(USBD_BUF_BASE + USBD_GET_EP_BUF_ADDR(EP2));
 
-#if 0 //(NVT_DCACHE_ON == 1)
-    // Clean the D-Cache for the programmed region to ensure data consistency when D-Cache is enabled
-    SCB_CleanDCache_by_Addr(s_au8VCPSendBuf + s_u32VCPSendBufOut, i32Len);
-#endif
     //USBD_MemCopy is CPU memory copy operation(not DMA), so we don't need to care DCache coherence issue
-    USBD_MemCopy(pu8EPBufAddr, (void *)s_au8VCPSendBuf + s_u32VCPSendBufOut, i32Len);
-    USBD_SET_PAYLOAD_LEN(EP2, i32Len);
+    USBD_MemCopy(pu8EPBufAddr, s_au8VCPSendBuf + u32Idx, u32FirstLen);
+    if(u32FirstLen < u32Len)
+        USBD_MemCopy(pu8EPBufAddr + u32FirstLen, s_au8VCPSendBuf, u32Len - u32FirstLen);
 
-    s_u32VCPSendBufOut += i32Len;
+    s_u32VCPSendLastLen = u32Len;
+    USBD_SET_PAYLOAD_LEN(EP2, u32Len);
 
-    return i32Len;
-}
+    s_u32VCPSendBufOut = u32Out + u32Len;
 
+    return u32Len;
+}
 
+//Copy as much of pu8DataBuf as fits into the send ring, return the copied length
 int32_t VCPTrans_BulkInSend(
     uint8_t *pu8DataBuf,
     uint32_t u32DataBufLen
 )
 {
-    uint32_t u32MaxLen;
-
-    u32MaxLen = u32DataBufLen;
-
-    if(s_b32VCPSendTrans == 0) {
-        s_u32VCPSendBufIn = 0;
-        s_u32VCPSendBufOut = 0;
-
-        if(u32MaxLen > MAX_VCP_SEND_BUF_LEN)
-            u32MaxLen = MAX_VCP_SEND_BUF_LEN;
-    } else {
-        if(u32MaxLen > (MAX_VCP_SEND_BUF_LEN - s_u32VCPSendBufIn))
-            u32MaxLen = MAX_VCP_SEND_BUF_LEN - s_u32VCPSendBufIn;
+    uint32_t u32In = s_u32VCPSendBufIn;
+    uint32_t u32Idx = u32In & (MAX_VCP_SEND_BUF_LEN - 1);
+    uint32_t u32MaxLen = MAX_VCP_SEND_BUF_LEN - (u32In - s_u32VCPSendBufOut);
+    uint32_t u32FirstLen;
+    uint32_t u32Primask;
+
+    if(u32MaxLen > u32DataBufLen)
+        u32MaxLen = u32DataBufLen;
+
+    if(u32MaxLen) {
+        u32FirstLen = MAX_VCP_SEND_BUF_LEN - u32Idx;
+        if(u32FirstLen > u32MaxLen)
+            u32FirstLen = u32MaxLen;
+
+        memcpy(s_au8VCPSendBuf + u32Idx, pu8DataBuf, u32FirstLen);
+        memcpy(s_au8VCPSendBuf, pu8DataBuf + u32FirstLen, u32MaxLen - u32FirstLen);
+
+        // Data before index, the EP2 interrupt reads it as soon as the index moves
+        __DMB();
+        s_u32VCPSendBufIn = u32In + u32MaxLen;
     }
 
-    memcpy(s_au8VCPSendBuf + s_u32VCPSendBufIn, pu8DataBuf, u32MaxLen);
-    s_u32VCPSendBufIn += u32MaxLen;
-
-    if(s_b32VCPSendTrans == 0) {
+    // Start EP2 if idle. The EP2 interrupt may be finishing the last packet, so check under disabled interrupts.
+    u32Primask = __get_PRIMASK();
+    __disable_irq();
+    if(s_b32VCPSendTrans == 0)
         VCPTrans_BulkInHandler();
-    }
+    __set_PRIMASK(u32Primask);
 
     return u32MaxLen;
 }
 
+//Free space of the send ring
 int32_t VCPTrans_BulkInCanSend()
 {
-    if(s_u32VCPSendBufIn < MAX_VCP_SEND_BUF_LEN)
-        return 1;
-    return !s_b32VCPSendTrans;
+    return MAX_VCP_SEND_BUF_LEN - (s_u32VCPSendBufIn - s_u32VCPSendBufOut);
 }
 
+//Bytes of the send ring not yet loaded into EP2
+int32_t VCPTrans_BulkInPending()
+{
+    return s_u32VCPSendBufIn - s_u32VCPSendBufOut;
+}
+
+//Bus reset drops the armed packet, the remaining data is sent on the next write
+void VCPTrans_BulkInReset()
+{
+    s_b32VCPSendTrans = 0;
+    s_u32VCPSendLastLen = 0;
+}
 
 
-#define MAX_VCP_RECV_BUF_LEN (EP3_VCP_MAX_PKT_SIZE * 3)
+
+// Receive ring, single producer (EP3 interrupt) and single consumer (thread). The indices run freely
+// and are masked on access, the length must be a power of 2 and at least two packets.
+// EP3 is only armed while a whole packet fits: the host is NAKed instead of losing data.
+#ifndef MAX_VCP_RECV_BUF_LEN
+#define MAX_VCP_RECV_BUF_LEN	2048
+#endif
+#if (MAX_VCP_RECV_BUF_LEN & (MAX_VCP_RECV_BUF_LEN - 1)) || (MAX_VCP_RECV_BUF_LEN < (2 * EP3_VCP_MAX_PKT_SIZE))
+#error "MAX_VCP_RECV_BUF_LEN must be a power of 2 of at least two packets"
+#endif
 static uint8_t s_au8VCPRecvBuf[DCACHE_ALIGN_LINE_SIZE(MAX_VCP_RECV_BUF_LEN)]__attribute__((aligned(DCACHE_LINE_SIZE)));
-static volatile uint32_t s_u32VCPRecvBufIn = 0;
-static volatile uint32_t s_u32VCPRecvBufOut = 0;
+static volatile uint32_t s_u32VCPRecvBufIn = 0;		//written by VCPTrans_BulkOutHandler()
+static volatile uint32_t s_u32VCPRecvBufOut = 0;	//written by VCPTrans_BulkOutRecv()
+static volatile int32_t s_b32VCPRecvArmed = 1;		//EP3 ready for an OUT packet, armed by MSCVCPTrans_Init()
 
 extern int mp_interrupt_char;
 
@@ -242,86 +280,57 @@ void VCPTrans_RegisterSingal(
     s_pfnVCPRecvSignel = pfnSignal;
 }
 
+//Arm EP3 if a packet fits in the receive ring, in EP3 interrupt context or with interrupts disabled
+static void VCPTrans_BulkOutArm(void)
+{
+    uint32_t u32FreeLen = MAX_VCP_RECV_BUF_LEN - (s_u32VCPRecvBufIn - s_u32VCPRecvBufOut);
+
+    if((s_b32VCPRecvArmed == 0) && (u32FreeLen >= EP3_VCP_MAX_PKT_SIZE)) {
+        s_b32VCPRecvArmed = 1;
+        USBD_SET_PAYLOAD_LEN(EP3, EP3_VCP_MAX_PKT_SIZE);
+    }
+}
+
+//EP3 OUT packet received, in interrupt context
 int32_t VCPTrans_BulkOutHandler(
     uint8_t *pu8EPBuf,
     uint32_t u32Size
 )
 {
-    int32_t i32BufFreeLen;
-    uint32_t u32LimitLen;
-    uint32_t u32NewInIdx = s_u32VCPRecvBufIn;
-    uint32_t u32OutIdx = s_u32VCPRecvBufOut;
-
-    if(u32NewInIdx >= u32OutIdx) {
-        i32BufFreeLen = MAX_VCP_RECV_BUF_LEN - u32NewInIdx +  u32OutIdx;
-        u32LimitLen = MAX_VCP_RECV_BUF_LEN - u32NewInIdx;
-    } else {
-        i32BufFreeLen = u32OutIdx - u32NewInIdx;
-        u32LimitLen = i32BufFreeLen;
-    }
+    uint32_t u32In = s_u32VCPRecvBufIn;
+    uint32_t u32Idx = u32In & (MAX_VCP_RECV_BUF_LEN - 1);
+    uint32_t u32FirstLen;
 
-    if(i32BufFreeLen < u32Size) {
-        printf("USBD receive buffer size overflow, lost packet \n");
-        return 0;
-    }
+    s_b32VCPRecvArmed = 0;
 
     if(s_pfnVCPRecvSignel) {
         if(s_pfnVCPRecvSignel(pu8EPBuf, u32Size) == 0) {
-            USBD_SET_PAYLOAD_LEN(EP3, EP3_VCP_MAX_PKT_SIZE);
+            VCPTrans_BulkOutArm();
             return 0;
         }
     }
 
-    if(u32LimitLen < u32Size) {
-        USBD_MemCopy(s_au8VCPRecvBuf + u32NewInIdx, pu8EPBuf, u32LimitLen);
-
-#if 0 //(NVT_DCACHE_ON == 1)
-        // Invalidate the D-Cache for the programmed region to ensure data consistency when D-Cache is enabled
-        SCB_InvalidateDCache_by_Addr(s_au8VCPRecvBuf + u32NewInIdx, u32LimitLen);
-#endif
-
-        USBD_MemCopy(s_au8VCPRecvBuf, pu8EPBuf + u32LimitLen, u32Size - u32LimitLen);
+    // EP3 was armed with a packet of space, so the packet fits
+    u32FirstLen = MAX_VCP_RECV_BUF_LEN - u32Idx;
+    if(u32FirstLen > u32Size)
+        u32FirstLen = u32Size;
 
-#if 0 //(NVT_DCACHE_ON == 1)
-        // Invalidate the D-Cache for the programmed region to ensure data consistency when D-Cache is enabled
-        SCB_InvalidateDCache_by_Addr(s_au8VCPRecvBuf, u32Size - u32LimitLen);
-#endif
-
-    } else {
-        USBD_MemCopy(s_au8VCPRecvBuf + u32NewInIdx, pu8EPBuf, u32Size);
-#if 0 //(NVT_DCACHE_ON == 1)
-        // Invalidate the D-Cache for the programmed region to ensure data consistency when D-Cache is enabled
-        if((u32NewInIdx % DCACHE_LINE_SIZE) == 0)
-            SCB_InvalidateDCache_by_Addr((s_au8VCPRecvBuf + u32NewInIdx), u32Size);
-        else
-            printf("u32NewInIdx %d \n", u32NewInIdx);
-#endif
-    }
+    //USBD_MemCopy is CPU memory copy operation(not DMA), so we don't need to care DCache coherence issue
+    USBD_MemCopy(s_au8VCPRecvBuf + u32Idx, pu8EPBuf, u32FirstLen);
+    if(u32FirstLen < u32Size)
+        USBD_MemCopy(s_au8VCPRecvBuf, pu8EPBuf + u32FirstLen, u32Size - u32FirstLen);
 
+    s_u32VCPRecvBufIn = u32In + u32Size;
 
-    u32NewInIdx = (u32NewInIdx + u32Size) % MAX_VCP_RECV_BUF_LEN;
-    s_u32VCPRecvBufIn = u32NewInIdx;
-//	USBD_SET_PAYLOAD_LEN(EP3, EP3_VCP_MAX_PKT_SIZE); //TODO:delete it! It will be enabled if application read it
+    // Otherwise EP3 stays NAKed until VCPTrans_BulkOutRecv() makes room
+    VCPTrans_BulkOutArm();
 
     return u32Size;
 }
 
 int32_t VCPTrans_BulkOutCanRecv()
 {
-    uint32_t u32InIdx;
-    uint32_t u32OutIdx;
-    int i32RecvLen = 0;
-
-    u32InIdx = s_u32VCPRecvBufIn;
-    u32OutIdx = s_u32VCPRecvBufOut;
-
-    if(u32InIdx >= u32OutIdx) {
-        i32RecvLen = u32InIdx - u32OutIdx;
-    } else {
-        i32RecvLen = MAX_VCP_RECV_BUF_LEN - u32OutIdx +  u32InIdx;
-    }
-
-    return i32RecvLen;
+    return s_u32VCPRecvBufIn - s_u32VCPRecvBufOut;
 }
 
 int32_t VCPTrans_BulkOutRecv(
@@ -329,45 +338,46 @@ int32_t VCPTrans_BulkOutRecv(
     uint32_t u32DataBufLen
 )
 {
-    int i32CopyLen = 0;
-    uint32_t u32InIdx;
-    uint32_t u32NewOutIdx;
-    uint32_t u32LimitLen;
+    uint32_t u32Out = s_u32VCPRecvBufOut;
+    uint32_t u32Idx = u32Out & (MAX_VCP_RECV_BUF_LEN - 1);
+    uint32_t u32CopyLen = s_u32VCPRecvBufIn - u32Out;
+    uint32_t u32FirstLen;
+    uint32_t u32Primask;
 
     if(pu8DataBuf == NULL)
         return 0;
 
-    u32InIdx = s_u32VCPRecvBufIn;
-    u32NewOutIdx = s_u32VCPRecvBufOut;
+    if(u32CopyLen > u32DataBufLen)
+        u32CopyLen = u32DataBufLen;
 
-    if(u32InIdx >= u32NewOutIdx) {
-        i32CopyLen = u32InIdx - u32NewOutIdx;
-        u32LimitLen = i32CopyLen;
-    } else {
-        i32CopyLen = MAX_VCP_RECV_BUF_LEN - u32NewOutIdx +  u32InIdx;
-        u32LimitLen = MAX_VCP_RECV_BUF_LEN - u32NewOutIdx;
-    }
+    if(u32CopyLen == 0)
+        return 0;
 
-    if(i32CopyLen > u32DataBufLen) {
-        i32CopyLen = u32DataBufLen;
-        u32LimitLen = i32CopyLen;
-    }
+    u32FirstLen = MAX_VCP_RECV_BUF_LEN - u32Idx;
+    if(u32FirstLen > u32CopyLen)
+        u32FirstLen = u32CopyLen;
 
-    if(i32CopyLen) {
+    memcpy(pu8DataBuf, s_au8VCPRecvBuf + u32Idx, u32FirstLen);
+    memcpy(pu8DataBuf + u32FirstLen, s_au8VCPRecvBuf, u32CopyLen - u32FirstLen);
 
-        if((i32CopyLen + u32NewOutIdx) > MAX_VCP_RECV_BUF_LEN) {
-            memcpy(pu8DataBuf, s_au8VCPRecvBuf + u32NewOutIdx, u32LimitLen);
-            memcpy(pu8DataBuf + u32LimitLen, s_au8VCPRecvBuf, i32CopyLen - u32LimitLen);
-        } else {
-            memcpy(pu8DataBuf, s_au8VCPRecvBuf + u32NewOutIdx, i32CopyLen);
-        }
+    // Data read before the space is given back to the EP3 interrupt
+    __DMB();
+    s_u32VCPRecvBufOut = u32Out + u32CopyLen;
 
-        u32NewOutIdx = (u32NewOutIdx + i32CopyLen) % MAX_VCP_RECV_BUF_LEN;
-        s_u32VCPRecvBufOut = u32NewOutIdx;
-        USBD_SET_PAYLOAD_LEN(EP3, EP3_VCP_MAX_PKT_SIZE);
-    }
+    u32Primask = __get_PRIMASK();
+    __disable_irq();
+    VCPTrans_BulkOutArm();
+    __set_PRIMASK(u32Primask);
 
-    return i32CopyLen;
+    return u32CopyLen;
+}
+
+//Bus reset: input of the previous session is dropped and EP3 armed again
+void VCPTrans_BulkOutReset()
+{
+    s_u32VCPRecvBufOut = s_u32VCPRecvBufIn;
+    s_b32VCPRecvArmed = 1;
+    USBD_SET_PAYLOAD_LEN(EP3, EP3_VCP_MAX_PKT_SIZE);
 }
 
 
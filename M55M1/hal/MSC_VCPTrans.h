@@ -138,6 +138,10 @@ int32_t VCPTrans_BulkInSend(
 
 int32_t VCPTrans_BulkInCanSend();
 
+int32_t VCPTrans_BulkInPending();
+
+void VCPTrans_BulkInReset();
+
 #endif
 
 
@@ -153,6 +157,8 @@ int32_t VCPTrans_BulkOutRecv(
     uint32_t u32DataBufLen
 );
 
+void VCPTrans_BulkOutReset();
+
 void VCPTrans_RegisterSingal(
     PFN_USBDEV_VCPRecvSignal pfnSignal
 );
@@ -163,6 +163,20 @@ static const nu_pdma_periph_ctl_t g_nu_pdma_peripheral_ctl_pool[ ] = {
     { PDMA_DAC0_TX, eMemCtl_SrcInc_DstFix },
     { PDMA_DAC1_TX, eMemCtl_SrcInc_DstFix },
 
+    { PDMA_TMR0, eMemCtl_SrcInc_DstFix },
+    { PDMA_TMR1, eMemCtl_SrcInc_DstFix },
+    { PDMA_TMR2, eMemCtl_SrcInc_DstFix },
+    { PDMA_TMR3, eMemCtl_SrcInc_DstFix },
+
+    { PDMA_EADC0_RX, eMemCtl_SrcFix_DstInc },
+
+    { PDMA_EPWM0_P1_RX, eMemCtl_SrcFix_DstInc },
+    { PDMA_EPWM0_P2_RX, eMemCtl_SrcFix_DstInc },
+    { PDMA_EPWM0_P3_RX, eMemCtl_SrcFix_DstInc },
+    { PDMA_EPWM1_P1_RX, eMemCtl_SrcFix_DstInc },
+    { PDMA_EPWM1_P2_RX, eMemCtl_SrcFix_DstInc },
+    { PDMA_EPWM1_P3_RX, eMemCtl_SrcFix_DstInc },
+
     { PDMA_SPI0_TX, eMemCtl_SrcInc_DstFix },
     { PDMA_SPI0_RX, eMemCtl_SrcFix_DstInc },
     { PDMA_SPI1_TX, eMemCtl_SrcInc_DstFix },
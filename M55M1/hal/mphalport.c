@@ -34,6 +34,7 @@
 #include "py/runtime.h"
 #include "extmod/misc.h"
 #include "py/stream.h"
+#include "shared/runtime/pyexec.h"
 
 extern int kbhit(void);		//checking UART fifo data ready or not. It implemented in BSP retarget.c
 
@@ -175,6 +176,15 @@ static int call_dupterm_read(size_t idx)
 
 #include "M55M1_USBD.h"
 
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+// Longest wait for the host to take console output, a host that does not read only costs it once
+#ifndef MICROPY_HW_VCP_TX_TIMEOUT
+#define MICROPY_HW_VCP_TX_TIMEOUT	500
+#endif
+
 static void SendStr_ToUSB(char *ptr, int len)
 {
     S_USBDEV_STATE *psUSBState;
@@ -184,10 +194,10 @@ static void SendStr_ToUSB(char *ptr, int len)
     if(!(psUSBState->eUSBMode & eUSBDEV_MODE_VCP))
         return;
 
-    if(!USBDEV_VCPCanSend(psUSBState))
+    if(!USBD_IS_ATTACHED())
         return;
 
-    USBDEV_VCPSendData((uint8_t *)ptr, len, 0, psUSBState);
+    USBDEV_VCPSendData((uint8_t *)ptr, len, MICROPY_HW_VCP_TX_TIMEOUT, psUSBState);
 
 //	if(ptr[len] == '\n')
 //	{
@@ -197,7 +207,33 @@ static void SendStr_ToUSB(char *ptr, int len)
 //	}
 }
 
-static char RecvChar_FromUSB(void)
+// Cooked output is gathered here and sent in full endpoint packets
+#ifndef MICROPY_HW_STDOUT_BUF_LEN
+#define MICROPY_HW_STDOUT_BUF_LEN	256
+#endif
+
+// Longest time gathered output waits for more output before the system tick sends it
+#ifndef MICROPY_HW_STDOUT_FLUSH_MS
+#define MICROPY_HW_STDOUT_FLUSH_MS	10
+#endif
+
+static uint8_t s_au8StdoutBuf[MICROPY_HW_STDOUT_BUF_LEN];
+static volatile uint32_t s_u32StdoutLen = 0;
+static volatile uint32_t s_u32StdoutTick;		//mp_hal_ticks_ms() of the oldest gathered byte
+//A thread is gathering or flushing, the system tick flush keeps off the buffer
+static volatile bool s_bStdoutBusy = false;
+//Serializes the threads using the buffer, they run without GIL
+static StaticSemaphore_t s_sStdoutMutexBuf;
+static SemaphoreHandle_t s_tStdoutMutex = NULL;
+
+// Read-ahead of the REPL input, one endpoint packet is taken per refill instead of one call chain per byte
+static uint8_t s_au8StdinBuf[64];
+static uint32_t s_u32StdinLen = 0;
+static uint32_t s_u32StdinPos = 0;
+
+// Wait until VCP data is received, sleeping until the bulk OUT interrupt signals it, then
+// return up to len bytes.
+static int RecvStr_FromUSB(uint8_t *buf, size_t len)
 {
     S_USBDEV_STATE *psUSBState;
 
@@ -206,20 +242,30 @@ static char RecvChar_FromUSB(void)
     if(!(psUSBState->eUSBMode & eUSBDEV_MODE_VCP))
         return 0;
 
-    while(1) {
-        if(USBDEV_VCPCanRecv(psUSBState)) {
-            char chTemp;
-            USBDEV_VCPRecvData((uint8_t *)&chTemp,1,10, psUSBState);
-            return chTemp;
-        }
-        vTaskDelay(1);
+    USBDEV_VCPWaitRecv(USBDEV_WAIT_FOREVER, psUSBState);
+    return USBDEV_VCPRecvData(buf, len, 0, psUSBState);
+}
+
+static char RecvChar_FromUSB(void)
+{
+    if(s_u32StdinPos >= s_u32StdinLen) {
+        s_u32StdinPos = 0;
+        s_u32StdinLen = RecvStr_FromUSB(s_au8StdinBuf, sizeof(s_au8StdinBuf));
+
+        if(s_u32StdinLen == 0)
+            return 0;
     }
+
+    return s_au8StdinBuf[s_u32StdinPos++];
 }
 
 int REPL_can_read(void)
 {
     S_USBDEV_STATE *psUSBState;
 
+    if(s_u32StdinPos < s_u32StdinLen)
+        return 1;
+
     psUSBState = USBDEV_UpdateState();
 
     if(USBDEV_VCPCanRecv(psUSBState))
@@ -245,6 +291,10 @@ int REPL_read(int fd, char *ptr, int len)
 int mp_hal_stdin_rx_chr(void)
 {
     unsigned char c;
+
+    // The prompt and the echo must be seen before waiting for input
+    mp_hal_stdout_flush();
+
 #if MICROPY_PY_OS_DUPTERM
     // TODO only support dupterm one slot at the moment
     if (MP_STATE_VM(dupterm_objs[0]) != MP_OBJ_NULL) {
@@ -296,7 +346,7 @@ uintptr_t mp_hal_stdio_poll(uintptr_t poll_flags)
     return ret;
 }
 
-mp_uint_t mp_hal_stdout_tx_strn(const char *str, size_t len)
+static mp_uint_t stdout_tx_strn(const char *str, size_t len)
 {
 
 #if defined (REPL_TO_USB)
@@ -309,16 +359,167 @@ mp_uint_t mp_hal_stdout_tx_strn(const char *str, size_t len)
     return ret;
 }
 
-// Efficiently convert "\n" to "\r\n"
+#if defined (REPL_TO_USB)
+
+// Take the buffer in thread context, before the scheduler starts there is a single thread
+static void stdout_lock(void)
+{
+    if(xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) {
+        s_bStdoutBusy = true;
+        return;
+    }
+
+    if(s_tStdoutMutex == NULL) {
+        taskENTER_CRITICAL();
+        if(s_tStdoutMutex == NULL)
+            s_tStdoutMutex = xSemaphoreCreateMutexStatic(&s_sStdoutMutexBuf);
+        taskEXIT_CRITICAL();
+    }
+
+    xSemaphoreTake(s_tStdoutMutex, portMAX_DELAY);
+    s_bStdoutBusy = true;
+}
+
+static void stdout_unlock(void)
+{
+    // The buffer is complete before the system tick may send it
+    __DMB();
+    s_bStdoutBusy = false;
+
+    if(xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)
+        xSemaphoreGive(s_tStdoutMutex);
+}
+
+// Send the buffer, with the buffer locked
+static void stdout_flush_busy(void)
+{
+    uint32_t u32Len = s_u32StdoutLen;
+
+    if(u32Len == 0)
+        return;
+
+    // dupterm already got the output when it was gathered
+    s_u32StdoutLen = 0;
+    REPL_write(1, (char *)s_au8StdoutBuf, u32Len);
+}
+
+void mp_hal_stdout_flush(void)
+{
+    // Interrupt handlers do not flush here, the system tick only sends while no thread uses the buffer
+    if((s_u32StdoutLen == 0) || (__get_IPSR() != 0))
+        return;
+
+    stdout_lock();
+    stdout_flush_busy();
+    stdout_unlock();
+}
+
+// Append cooked output to the buffer, thread context only
+static void stdout_gather(const char *str, size_t len)
+{
+    stdout_lock();
+
+    while (len) {
+        uint32_t u32Copy;
+
+        if(s_u32StdoutLen == sizeof(s_au8StdoutBuf))
+            stdout_flush_busy();
+
+        if(s_u32StdoutLen == 0)
+            s_u32StdoutTick = mp_hal_ticks_ms();
+
+        u32Copy = MIN(len, sizeof(s_au8StdoutBuf) - s_u32StdoutLen);
+        memcpy(s_au8StdoutBuf + s_u32StdoutLen, str, u32Copy);
+        s_u32StdoutLen += u32Copy;
+        str += u32Copy;
+        len -= u32Copy;
+    }
+
+    stdout_unlock();
+}
+
+void mp_hal_stdout_tick(void)
+{
+    uint32_t u32Len = s_u32StdoutLen;
+    uint32_t u32Sent = u32Len;
+    S_USBDEV_STATE *psUSBState;
+
+    if((u32Len == 0) || (s_bStdoutBusy) || ((mp_hal_ticks_ms() - s_u32StdoutTick) < MICROPY_HW_STDOUT_FLUSH_MS))
+        return;
+
+    psUSBState = USBDEV_UpdateState();
+
+    if((psUSBState->eUSBMode & eUSBDEV_MODE_VCP) && (USBD_IS_ATTACHED())) {
+        // What fits in the send ring, without waiting. Interrupts are disabled against other handlers printing.
+        uint32_t u32Primask = __get_PRIMASK();
+
+        __disable_irq();
+        u32Sent = USBDEV_VCPSendData(s_au8StdoutBuf, u32Len, 0, psUSBState);
+        __set_PRIMASK(u32Primask);
+    }
+
+    // The rest is tried again on the next tick
+    memmove(s_au8StdoutBuf, s_au8StdoutBuf + u32Sent, u32Len - u32Sent);
+    s_u32StdoutLen = u32Len - u32Sent;
+}
+
+#else
+
+void mp_hal_stdout_flush(void)
+{
+}
+
+void mp_hal_stdout_tick(void)
+{
+}
+
+#endif
+
+// One piece of cooked output
+static void stdout_tx_strn_cooked(const char *str, size_t len)
+{
+#if defined (REPL_TO_USB)
+    if(__get_IPSR() == 0) {
+        stdout_gather(str, len);
+        mp_os_dupterm_tx_strn(str, len);
+        return;
+    }
+
+    // Interrupt handlers do not gather: they could preempt a flush of the buffer
+    stdout_tx_strn(str, len);
+#else
+    mp_hal_stdout_tx_strn(str, len);
+#endif
+}
+
+mp_uint_t mp_hal_stdout_tx_strn(const char *str, size_t len)
+{
+    // Keep the order with the gathered cooked output
+    mp_hal_stdout_flush();
+    return stdout_tx_strn(str, len);
+}
+
+// Efficiently convert "\n" to "\r\n".
+// With the USB REPL, the output of threads is gathered and sent in full packets: each line at once
+// at the friendly REPL, otherwise when the buffer is full, when the REPL waits for input, or from the
+// system tick once the oldest byte waited MICROPY_HW_STDOUT_FLUSH_MS, even while Python computes.
+// The output of interrupt handlers (callbacks, exception messages) goes out directly.
 void mp_hal_stdout_tx_strn_cooked(const char *str, size_t len)
 {
+#if defined (REPL_TO_USB)
+    bool bNewline = false;
+#endif
     const char *last = str;
+
     while (len--) {
         if (*str == '\n') {
             if (str > last) {
-                mp_hal_stdout_tx_strn(last, str - last);
+                stdout_tx_strn_cooked(last, str - last);
             }
-            mp_hal_stdout_tx_strn("\r\n", 2);
+            stdout_tx_strn_cooked("\r\n", 2);
+#if defined (REPL_TO_USB)
+            bNewline = true;
+#endif
             ++str;
             last = str;
         } else {
@@ -326,9 +527,18 @@ void mp_hal_stdout_tx_strn_cooked(const char *str, size_t len)
         }
     }
     if (str > last) {
-        mp_hal_stdout_tx_strn(last, str - last);
+        stdout_tx_strn_cooked(last, str - last);
     }
 
+#if defined (REPL_TO_USB)
+    if (__get_IPSR() != 0) {
+        return;
+    }
+
+    if (bNewline && (pyexec_mode_kind == PYEXEC_MODE_FRIENDLY_REPL)) {
+        mp_hal_stdout_flush();
+    }
+#endif
 }
 
 void mp_hal_stdout_tx_str(const char *str)
@@ -76,6 +76,9 @@ void mp_hal_delay_ms(mp_uint_t Delay)
 {
 
     if (query_irq() == IRQ_STATE_ENABLED) {
+        // Output gathered before the delay must not wait for it
+        mp_hal_stdout_flush();
+
         // IRQs enabled, so can use systick counter to do the delay
 #if MICROPY_PY_THREAD
         vTaskDelay (Delay / portTICK_PERIOD_MS);
@@ -340,7 +340,6 @@ static int32_t VCPRecvSignalCB(
 static void ExecuteUsbMSC(bool WriteProtect)
 {
     S_USBDEV_STATE *psUSBDev_msc_state = NULL;
-    uint32_t u32CheckConnTimeOut = 0;
 
     if(WriteProtect)
         psUSBDev_msc_state = USBDEV_Init(USBD_VID, USBD_MSC_VCP_PID, eUSBDEV_MODE_MSC_WP_VCP);
@@ -359,20 +358,13 @@ static void ExecuteUsbMSC(bool WriteProtect)
 #endif
 
     while(mp_USBRun == true) {
-        if (USBD_IS_ATTACHED()) {
-            u32CheckConnTimeOut = mp_hal_ticks_ms() + 1000;
+        //Sleep until the USB interrupt reports MSC bulk traffic or a bus event (attach, reset, suspend).
+        //The timeout only lets the loop see mp_USBRun.
+        USBDEV_MSCWaitEvent(1000);
 
-            //Wait usb data bus ready (1 sec)
-            while(mp_hal_ticks_ms() < u32CheckConnTimeOut) {
-                if(USBDEV_DataBusConnect())
-                    break;
-            }
-
-            if(USBDEV_DataBusConnect()) {
-                MSCTrans_ProcessCmd();
-            }
+        if ((USBD_IS_ATTACHED()) && (USBDEV_DataBusConnect())) {
+            MSCTrans_ProcessCmd();
         }
-        taskYIELD();
     }
 
     USBDEV_Deinit(psUSBDev_msc_state);
@@ -107,6 +107,7 @@ void vApplicationStackOverflowHook(TaskHandle_t pxTask, char *pcTaskName)
 //*****************************************************************************
 void vApplicationTickHook (void)
 {
+    mp_hal_stdout_tick();
 
 #if MICROPY_LVGL
     lv_tick_inc(1);
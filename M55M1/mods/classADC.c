@@ -34,8 +34,11 @@
 #include "py/binary.h"
 #include "py/stream.h"
 #include "py/mphal.h"
+#include "py/mperrno.h"
 
+#include "hal/M55M1_EADC.h"
 #include "classADC.h"
+#include "classTimer.h"
 
 
 #if MICROPY_HW_ENABLE_HW_EADC
@@ -97,6 +100,14 @@ typedef struct _pyb_adc_all_obj_t {
     EADC_T *eadc_base;
 } pyb_adc_all_obj_t;
 
+static eadc_t s_sEADC0Obj = {.eadc = EADC0};
+
+// (buffer, callback) tuple of the running ADC stream, keeps them alive while PDMA fills the buffer
+MP_REGISTER_ROOT_POINTER(mp_obj_t pyb_adc_stream_obj);
+
+// callback of the window comparator
+MP_REGISTER_ROOT_POINTER(mp_obj_t pyb_adc_threshold_cb);
+
 typedef struct _pyb_eadc_channel_obj {
     const pin_obj_t* eadc_channel_pin_obj;
 } eadc_channel_obj_t;
@@ -484,13 +495,378 @@ static mp_obj_t adc_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_
 static mp_obj_t adc_read(mp_obj_t self_in)
 {
     pyb_obj_adc_t *self = self_in;
+
+    // The sample module is triggered by a stream or the window comparator
+    if (EADC_IsModuleBusy(&s_sEADC0Obj, (1 << self->channel))) {
+        mp_raise_OSError(MP_EBUSY);
+    }
+
     return mp_obj_new_int(eadc_config_and_read_channel(self->eadc_base, self->channel));
 }
 static MP_DEFINE_CONST_FUN_OBJ_1(adc_read_obj, adc_read);
 
+static uint16_t *adc_get_u16_buffer(mp_obj_t buf_in, size_t *len)
+{
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(buf_in, &bufinfo, MP_BUFFER_WRITE);
+
+    if (mp_binary_get_size('@', bufinfo.typecode, NULL) != sizeof(uint16_t)) {
+        mp_raise_ValueError("buffer must be array('H')");
+    }
+
+    *len = bufinfo.len / sizeof(uint16_t);
+    return (uint16_t *)bufinfo.buf;
+}
+
+// Wait for the timer triggered PDMA conversion, always leave the EADC in software trigger mode
+static void adc_wait_timed_conv(TIMER_T *timer)
+{
+    nlr_buf_t nlr;
+
+    if (nlr_push(&nlr) == 0) {
+        while (!EADC_IsPDMAConvDone(&s_sEADC0Obj)) {
+            MICROPY_EVENT_POLL_HOOK
+        }
+        nlr_pop();
+    } else {
+        EADC_StopTimerPDMAConv(&s_sEADC0Obj, timer);
+        nlr_jump(nlr.ret_val);
+    }
+
+    EADC_StopTimerPDMAConv(&s_sEADC0Obj, timer);
+}
+
+/// \method read_timed(buf, timer)
+///
+/// Read analog values into `buf` at a rate set by the `timer` object.
+///
+/// `buf` must be an array('H'). `timer` is an initialised Timer (0-3); each
+/// timer event triggers one conversion and PDMA moves the result into `buf`,
+/// so no CPU time is spent per sample. Returns when the buffer is full.
+///
+/// Raises OSError(EBUSY) while a stream runs, or if the channel or the timer
+/// is used by threshold(). The same holds for read_timed_multi() and stream(),
+/// and read() of a channel used by a stream or threshold().
+static mp_obj_t adc_read_timed(mp_obj_t self_in, mp_obj_t buf_in, mp_obj_t timer_in)
+{
+    pyb_obj_adc_t *self = self_in;
+    size_t len;
+    uint16_t *buf = adc_get_u16_buffer(buf_in, &len);
+    TIMER_T *timer = pyb_timer_get_handle(timer_in);
+
+    if (len == 0) {
+        return mp_const_none;
+    }
+
+    int32_t ret = EADC_TimerPDMAConv(&s_sEADC0Obj, timer, (1 << self->channel), buf, len);
+
+    if (ret == -4) {
+        mp_raise_OSError(MP_EBUSY);
+    } else if (ret != 0) {
+        mp_raise_ValueError("ADC timed read needs Timer 0-3 and a free PDMA channel");
+    }
+
+    adc_wait_timed_conv(timer);
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_3(adc_read_timed_obj, adc_read_timed);
+
+/// \staticmethod read_timed_multi((adcx, adcy, ...), (bufx, bufy, ...), timer)
+///
+/// Read analog values from several ADC objects at a rate set by the `timer`
+/// object. Every timer event converts all the channels in one sequence.
+/// The buffers must be array('H') of the same length.
+static mp_obj_t adc_read_timed_multi(mp_obj_t adc_array_in, mp_obj_t buf_array_in, mp_obj_t timer_in)
+{
+    size_t nadcs, nbufs;
+    mp_obj_t *adc_array, *buf_array;
+    mp_obj_get_array(adc_array_in, &nadcs, &adc_array);
+    mp_obj_get_array(buf_array_in, &nbufs, &buf_array);
+
+    if (nadcs < 1) {
+        mp_raise_ValueError("need at least 1 ADC");
+    }
+    if (nadcs != nbufs) {
+        mp_raise_ValueError("length of ADC and buffer lists differ");
+    }
+
+    uint32_t module_mask = 0;
+    size_t len = 0;
+
+    for (size_t i = 0; i < nadcs; i++) {
+        size_t buf_len;
+
+        if (mp_obj_get_type(adc_array[i]) != &machine_adc_type) {
+            mp_raise_TypeError("need ADC objects");
+        }
+        adc_get_u16_buffer(buf_array[i], &buf_len);
+        if (i == 0) {
+            len = buf_len;
+        } else if (buf_len != len) {
+            mp_raise_ValueError("size and type of buffers must match");
+        }
+
+        uint32_t ch_mask = 1 << ((pyb_obj_adc_t *)adc_array[i])->channel;
+        if (module_mask & ch_mask) {
+            mp_raise_ValueError("ADC channel used twice");
+        }
+        module_mask |= ch_mask;
+    }
+
+    if (len == 0) {
+        return mp_const_none;
+    }
+
+    TIMER_T *timer = pyb_timer_get_handle(timer_in);
+
+    // Samples of one timer event come in ascending sample module order
+    uint16_t *samples = m_new(uint16_t, nadcs * len);
+    int32_t ret = EADC_TimerPDMAConv(&s_sEADC0Obj, timer, module_mask, samples, nadcs * len);
+
+    if (ret != 0) {
+        m_del(uint16_t, samples, nadcs * len);
+        if (ret == -4) {
+            mp_raise_OSError(MP_EBUSY);
+        }
+        mp_raise_ValueError("ADC timed read needs Timer 0-3 and a free PDMA channel");
+    }
+
+    adc_wait_timed_conv(timer);
+
+    for (size_t i = 0; i < nadcs; i++) {
+        uint32_t ch_mask = 1 << ((pyb_obj_adc_t *)adc_array[i])->channel;
+        size_t rank = __builtin_popcount(module_mask & (ch_mask - 1));
+        uint16_t *buf = adc_get_u16_buffer(buf_array[i], &len);
+
+        for (size_t j = 0; j < len; j++) {
+            buf[j] = samples[j * nadcs + rank];
+        }
+    }
+
+    m_del(uint16_t, samples, nadcs * len);
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_3(adc_read_timed_multi_fun_obj, adc_read_timed_multi);
+static MP_DEFINE_CONST_STATICMETHOD_OBJ(adc_read_timed_multi_obj, MP_ROM_PTR(&adc_read_timed_multi_fun_obj));
+
+// Scheduled from the PDMA ISR with the index of the filled half, the half is
+// given back to PDMA once the Python callback returns.
+static mp_obj_t adc_stream_dispatch(mp_obj_t half_in)
+{
+    mp_obj_t stream = MP_STATE_PORT(pyb_adc_stream_obj);
+    uint32_t half = MP_OBJ_SMALL_INT_VALUE(half_in);
+
+    if (stream == MP_OBJ_NULL) {
+        return mp_const_none;
+    }
+
+    mp_obj_t *items;
+    mp_obj_tuple_get(stream, NULL, &items);
+
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        mp_call_function_1(items[1], half_in);
+        nlr_pop();
+    } else {
+        EADC_TimerPDMAStreamRelease(&s_sEADC0Obj, half);
+        nlr_jump(nlr.ret_val);
+    }
+
+    EADC_TimerPDMAStreamRelease(&s_sEADC0Obj, half);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(adc_stream_dispatch_obj, adc_stream_dispatch);
+
+// Called from PDMA ISR
+static bool adc_stream_half_done(void *pvUserData, uint32_t u32Half)
+{
+    return mp_sched_schedule(MP_OBJ_FROM_PTR(&adc_stream_dispatch_obj), MP_OBJ_NEW_SMALL_INT(u32Half));
+}
+
+static void adc_stream_stop(void)
+{
+    if (MP_STATE_PORT(pyb_adc_stream_obj) != MP_OBJ_NULL) {
+        EADC_StopTimerPDMAConv(&s_sEADC0Obj, NULL);
+        MP_STATE_PORT(pyb_adc_stream_obj) = MP_OBJ_NULL;
+    }
+}
+
+/// \method stream(buf, timer, callback, *, average=1)
+///
+/// Sample continuously into `buf` (array('H') of even length) at a rate set by
+/// the `timer` object. PDMA fills the two halves of `buf` in turn; each time a
+/// half is full, `callback` is scheduled with the half index (0 or 1) and may
+/// process it while the other half fills. A half that is still being processed
+/// when PDMA comes back to it counts as an overrun, see `overrun()`.
+///
+///   - `average` is 1, 2, 4 ... 256 conversions averaged by the EADC for each
+///     timer event (channel 0~23 only)
+///
+/// `stream(None)` stops the acquisition.
+static mp_obj_t adc_stream(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_buf,      MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_timer,    MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_callback, MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_average,  MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 1} },
+    };
+
+    // parse args
+    pyb_obj_adc_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    adc_stream_stop();
+
+    if (args[0].u_obj == mp_const_none) {
+        return mp_const_none;
+    }
+
+    size_t len;
+    uint16_t *buf = adc_get_u16_buffer(args[0].u_obj, &len);
+    TIMER_T *timer = pyb_timer_get_handle(args[1].u_obj);
+
+    if ((len < 2) || (len & 1)) {
+        mp_raise_ValueError("buffer length must be even");
+    }
+
+    if (!mp_obj_is_callable(args[2].u_obj)) {
+        mp_raise_ValueError("callback must be a callable object");
+    }
+
+    mp_obj_t items[2] = {args[0].u_obj, args[2].u_obj};
+    MP_STATE_PORT(pyb_adc_stream_obj) = mp_obj_new_tuple(2, items);
+
+    int32_t ret = EADC_TimerPDMAStreamStart(&s_sEADC0Obj, timer, (1 << self->channel), args[3].u_int,
+                                            buf, len, adc_stream_half_done, self);
+
+    if (ret != 0) {
+        MP_STATE_PORT(pyb_adc_stream_obj) = MP_OBJ_NULL;
+        if (ret == -4) {
+            mp_raise_OSError(MP_EBUSY);
+        }
+        mp_raise_ValueError("ADC stream needs Timer 0-3, a valid average and a free PDMA channel");
+    }
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(adc_stream_obj, 1, adc_stream);
+
+/// \method overrun()
+/// Return the number of buffer halves lost by the current or last stream.
+static mp_obj_t adc_overrun(mp_obj_t self_in)
+{
+    return mp_obj_new_int_from_uint(EADC_TimerPDMAStreamOverrun(&s_sEADC0Obj));
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(adc_overrun_obj, adc_overrun);
+
+// Scheduled from the EADC ISR, the comparator is rearmed once the Python callback returns
+static mp_obj_t adc_threshold_dispatch(mp_obj_t status_in)
+{
+    mp_obj_t callback = MP_STATE_PORT(pyb_adc_threshold_cb);
+
+    if (callback == MP_OBJ_NULL) {
+        return mp_const_none;
+    }
+
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        mp_call_function_1(callback, status_in);
+        nlr_pop();
+    } else {
+        EADC_CompareRearm(&s_sEADC0Obj);
+        nlr_jump(nlr.ret_val);
+    }
+
+    EADC_CompareRearm(&s_sEADC0Obj);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(adc_threshold_dispatch_obj, adc_threshold_dispatch);
+
+// Called from EADC ISR
+static void adc_threshold_hit(void *pvUserData, uint32_t u32Status)
+{
+    if (!mp_sched_schedule(MP_OBJ_FROM_PTR(&adc_threshold_dispatch_obj), MP_OBJ_NEW_SMALL_INT(u32Status))) {
+        // scheduler queue is full, try again on the next excursion
+        EADC_CompareRearm(&s_sEADC0Obj);
+    }
+}
+
+/// \method threshold(low, high, count=1, callback=None, *, timer=None)
+///
+/// Watch the channel with the EADC window comparator. `callback` is scheduled
+/// when `count` (1~16) consecutive conversions fall below `low` or above `high`,
+/// and gets ADC.BELOW and/or ADC.ABOVE as argument. It is reported once per
+/// excursion: the comparator is rearmed when the callback returns.
+///
+///   - `timer` is a Timer (0-3) pacing the conversions, `None` converts
+///     continuously (channel 0~23 only)
+///
+/// `threshold(None)` stops the comparator. OSError(EBUSY) is raised if the
+/// channel or the timer is used by a stream.
+static mp_obj_t adc_threshold(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_low,      MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_high,     MP_ARG_INT, {.u_int = 4095} },
+        { MP_QSTR_count,    MP_ARG_INT, {.u_int = 1} },
+        { MP_QSTR_callback, MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_timer,    MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+    };
+
+    // parse args
+    pyb_obj_adc_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    EADC_CompareStop(&s_sEADC0Obj);
+    MP_STATE_PORT(pyb_adc_threshold_cb) = MP_OBJ_NULL;
+
+    if (args[0].u_obj == mp_const_none) {
+        return mp_const_none;
+    }
+
+    if (!mp_obj_is_callable(args[3].u_obj)) {
+        mp_raise_ValueError("callback must be a callable object");
+    }
+
+    TIMER_T *timer = NULL;
+    if (args[4].u_obj != mp_const_none) {
+        timer = pyb_timer_get_handle(args[4].u_obj);
+    }
+
+    MP_STATE_PORT(pyb_adc_threshold_cb) = args[3].u_obj;
+
+    int32_t ret = EADC_CompareStart(&s_sEADC0Obj, timer, self->channel, mp_obj_get_int(args[0].u_obj), args[1].u_int,
+                                    args[2].u_int, adc_threshold_hit, self);
+
+    if (ret != 0) {
+        MP_STATE_PORT(pyb_adc_threshold_cb) = MP_OBJ_NULL;
+        if (ret == -4) {
+            mp_raise_OSError(MP_EBUSY);
+        }
+        mp_raise_ValueError("invalid threshold, count or channel");
+    }
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(adc_threshold_obj, 1, adc_threshold);
+
 
 static const mp_rom_map_elem_t adc_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_read), MP_ROM_PTR(&adc_read_obj) },
+    { MP_ROM_QSTR(MP_QSTR_read_timed), MP_ROM_PTR(&adc_read_timed_obj) },
+    { MP_ROM_QSTR(MP_QSTR_read_timed_multi), MP_ROM_PTR(&adc_read_timed_multi_obj) },
+    { MP_ROM_QSTR(MP_QSTR_stream), MP_ROM_PTR(&adc_stream_obj) },
+    { MP_ROM_QSTR(MP_QSTR_overrun), MP_ROM_PTR(&adc_overrun_obj) },
+    { MP_ROM_QSTR(MP_QSTR_threshold), MP_ROM_PTR(&adc_threshold_obj) },
+
+    // class constants
+    { MP_ROM_QSTR(MP_QSTR_BELOW), MP_ROM_INT(EADC_CMP_BELOW_LOW) },
+    { MP_ROM_QSTR(MP_QSTR_ABOVE), MP_ROM_INT(EADC_CMP_ABOVE_HIGH) },
 };
 
 static MP_DEFINE_CONST_DICT(adc_locals_dict, adc_locals_dict_table);
@@ -560,6 +936,41 @@ static mp_obj_t adc_all_read_channel(mp_obj_t self_in, mp_obj_t channel)
 }
 static MP_DEFINE_CONST_FUN_OBJ_2(adc_all_read_channel_obj, adc_all_read_channel);
 
+/// \method read_channels(mask, buf)
+///
+/// Convert all channels selected by the bit `mask` in one conversion sequence
+/// and store the results into `buf` (array('H')) in ascending channel order.
+/// Returns the number of samples written. Nothing is allocated.
+static mp_obj_t adc_all_read_channels(mp_obj_t self_in, mp_obj_t mask_in, mp_obj_t buf_in)
+{
+    pyb_adc_all_obj_t *self = self_in;
+    uint32_t mask = mp_obj_get_int_truncated(mask_in);
+    size_t len;
+    uint16_t *buf = adc_get_u16_buffer(buf_in, &len);
+    eadc_t eadc_obj = {.eadc = self->eadc_base};
+
+    for (uint32_t channel = 0; channel < 32; ++channel) {
+        if ((mask & (1 << channel)) && ((channel > EADC_LAST_ADC_CHANNEL) || !is_adcx_channel(channel))) {
+            nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "not a valid ADC Channel: %d", channel));
+        }
+    }
+
+    size_t count = __builtin_popcount(mask);
+    if (count == 0) {
+        return MP_OBJ_NEW_SMALL_INT(0);
+    }
+    if (len < count) {
+        mp_raise_ValueError("buffer too small");
+    }
+
+    if (EADC_ScanConv(&eadc_obj, mask, buf) != 0) {
+        mp_hal_raise(HAL_TIMEOUT);
+    }
+
+    return MP_OBJ_NEW_SMALL_INT(count);
+}
+static MP_DEFINE_CONST_FUN_OBJ_3(adc_all_read_channels_obj, adc_all_read_channels);
+
 //adc_all_read_core_temp()
 static mp_obj_t adc_all_read_core_temp(mp_obj_t self_in)
 {
@@ -581,6 +992,7 @@ static MP_DEFINE_CONST_FUN_OBJ_1(adc_all_read_core_vbat_obj, adc_all_read_core_v
 
 static const mp_rom_map_elem_t adc_all_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_read_channel), MP_ROM_PTR(&adc_all_read_channel_obj) },
+    { MP_ROM_QSTR(MP_QSTR_read_channels), MP_ROM_PTR(&adc_all_read_channels_obj) },
 #if MICROPY_PY_BUILTINS_FLOAT
     { MP_ROM_QSTR(MP_QSTR_read_core_temp), MP_ROM_PTR(&adc_all_read_core_temp_obj) },
     { MP_ROM_QSTR(MP_QSTR_read_core_vbat), MP_ROM_PTR(&adc_all_read_core_vbat_obj) },
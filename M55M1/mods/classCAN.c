@@ -44,6 +44,16 @@
 #define MAX_CANFD_INST 2
 #define CAN_STATUS_INT_EVENT (CANFD_IE_BOE_Msk | CANFD_IE_EWE_Msk | CANFD_IE_EPE_Msk | CANFD_IE_RF0NE_Msk | CANFD_IE_RF1NE_Msk)
 
+// recv_many() record: id(4, little endian) | flags(1) | length(1) | reserved(2) | timestamp(4, little endian) | data(64)
+#define CAN_RECORD_SIZE			76
+#define CAN_RECORD_FLAG_EXTID	(1 << 0)
+#define CAN_RECORD_FLAG_RTR		(1 << 1)
+#define CAN_RECORD_FLAG_FDF		(1 << 2)
+#define CAN_RECORD_FLAG_BRS		(1 << 3)
+
+// mp_hal_ticks_us() stamp in time.ticks_us() time base, always a small int
+#define CAN_TICKS_US(stamp)		((stamp) & (MICROPY_PY_TIME_TICKS_PERIOD - 1))
+
 typedef struct _pyb_can_obj_t {
     mp_obj_base_t base;
     mp_uint_t can_id;
@@ -51,13 +61,22 @@ typedef struct _pyb_can_obj_t {
     CANFD_InitTypeDef *InitDef;
     bool is_enabled;
     bool extframe;
+    bool fd;
+    bool brs;
     mp_obj_t callback;
     int32_t mode;
     uint16_t num_error_warning;
     uint16_t num_error_passive;
     uint16_t num_bus_off;
+    uint16_t rxqueue_len;
+    uint16_t txqueue_len;
 } pyb_can_obj_t;
 
+// Receive queue slots of each CAN, filled by the ISR
+MP_REGISTER_ROOT_POINTER(void *pyb_can_rxqueue[MAX_CANFD_INST]);
+// Send queue slots of each CAN, drained by the ISR
+MP_REGISTER_ROOT_POINTER(void *pyb_can_txqueue[MAX_CANFD_INST]);
+
 
 enum {
     CAN_STATE_ERROR_ACTIVE = 0,
@@ -132,14 +151,29 @@ static void switch_pinfun(const pyb_can_obj_t *self, bool bCAN)
 
 
 
-// init(mode, extframe=False, baudrate = 500000)
+// init(mode, extframe=False, baudrate = 500000, *, rxqueue=0, txqueue=0, fd=False, brs=True,
+//      data_baudrate=0, sample_point=0, data_sample_point=0)
+//
+// rxqueue > 0: received frames are moved by the interrupt handler into a queue
+// of `rxqueue` preallocated frames, recv(), recv_into() and recv_many() read it.
+// txqueue > 0: send() queues the frames by ID priority, see txstats().
+// fd: CAN FD with up to 64 data bytes, brs: FD frames switch to `data_baudrate`
+// (defaults to `baudrate`). Sample points are in per mille, 0 selects the CiA
+// recommended one. Transmitter delay compensation is set for data rates above 1M.
 static mp_obj_t pyb_can_init_helper(pyb_can_obj_t *self, size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
 {
-    enum { ARG_mode, ARG_extframe, ARG_baudrate };
+    enum { ARG_mode, ARG_extframe, ARG_baudrate, ARG_rxqueue, ARG_txqueue, ARG_fd, ARG_brs, ARG_data_baudrate, ARG_sample_point, ARG_data_sample_point };
     static const mp_arg_t allowed_args[] = {
         { MP_QSTR_mode,         MP_ARG_REQUIRED | MP_ARG_INT,   {.u_int  = CAN_NORMAL_MODE} },
         { MP_QSTR_extframe,     MP_ARG_BOOL,                    {.u_bool = false} },
         { MP_QSTR_baudrate,		MP_ARG_INT,                     {.u_int  = 500000} },
+        { MP_QSTR_rxqueue,		MP_ARG_KW_ONLY | MP_ARG_INT,    {.u_int  = 0} },
+        { MP_QSTR_txqueue,		MP_ARG_KW_ONLY | MP_ARG_INT,    {.u_int  = 0} },
+        { MP_QSTR_fd,			MP_ARG_KW_ONLY | MP_ARG_BOOL,   {.u_bool = false} },
+        { MP_QSTR_brs,			MP_ARG_KW_ONLY | MP_ARG_BOOL,   {.u_bool = true} },
+        { MP_QSTR_data_baudrate, MP_ARG_KW_ONLY | MP_ARG_INT,   {.u_int  = 0} },
+        { MP_QSTR_sample_point,	MP_ARG_KW_ONLY | MP_ARG_INT,    {.u_int  = 0} },
+        { MP_QSTR_data_sample_point, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int  = 0} },
     };
 
     // parse args
@@ -147,6 +181,13 @@ static mp_obj_t pyb_can_init_helper(pyb_can_obj_t *self, size_t n_args, const mp
     mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
 
     self->extframe = args[ARG_extframe].u_bool;
+    self->fd = args[ARG_fd].u_bool;
+    self->brs = self->fd && args[ARG_brs].u_bool;
+
+    if((args[ARG_sample_point].u_int < 0) || (args[ARG_sample_point].u_int >= 1000) ||
+        (args[ARG_data_sample_point].u_int < 0) || (args[ARG_data_sample_point].u_int >= 1000)) {
+        mp_raise_ValueError("sample point is in per mille");
+    }
 
     switch_pinfun(self, true);
 
@@ -156,20 +197,60 @@ static mp_obj_t pyb_can_init_helper(pyb_can_obj_t *self, size_t n_args, const mp
 
     self->callback = mp_const_none;
     self->InitDef->NormalBitRate = i32Baudrate;
-    self->InitDef->DataBitRate = i32Baudrate;
-    self->InitDef->FDMode = FALSE;
+    self->InitDef->DataBitRate = (args[ARG_data_baudrate].u_int > 0) ? args[ARG_data_baudrate].u_int : i32Baudrate;
+    self->InitDef->NormalSamplePoint = args[ARG_sample_point].u_int;
+    self->InitDef->DataSamplePoint = args[ARG_data_sample_point].u_int;
+    self->InitDef->FDMode = self->fd;
+    self->InitDef->BitRateSwitch = self->brs;
 
     if(self->mode == CAN_LOOPBACK_MODE)
         self->InitDef->LoopBack = TRUE;
     else
         self->InitDef->LoopBack = FALSE;
 
+    if((args[ARG_rxqueue].u_int < 0) || (args[ARG_rxqueue].u_int > 0xFFFE)) {
+        mp_raise_ValueError("invalid rxqueue length");
+    }
+
+    if((args[ARG_txqueue].u_int < 0) || (args[ARG_txqueue].u_int > 0xFFFE)) {
+        mp_raise_ValueError("invalid txqueue length");
+    }
+
     i32Ret = CANFD_Init(self->obj, self->InitDef);
 
-    if(i32Ret != 0) {
+    if(i32Ret == -2) {
+        switch_pinfun(self, false);
+        mp_raise_ValueError("bit rate not reachable");
+    } else if(i32Ret != 0) {
         printf("Unable init canfd. Error %d \n", i32Ret);
     }
 
+    self->is_enabled = true;
+    self->rxqueue_len = args[ARG_rxqueue].u_int;
+    MP_STATE_PORT(pyb_can_rxqueue)[self->can_id] = NULL;
+
+    if(self->rxqueue_len > 0) {
+        // One more slot, a full ring keeps one slot free
+        canfd_rxslot_t *psSlots = m_new(canfd_rxslot_t, self->rxqueue_len + 1);
+
+        MP_STATE_PORT(pyb_can_rxqueue)[self->can_id] = psSlots;
+        CANFD_EnableRecvQueue(self->obj, psSlots, self->rxqueue_len + 1);
+    }
+
+    self->txqueue_len = args[ARG_txqueue].u_int;
+    MP_STATE_PORT(pyb_can_txqueue)[self->can_id] = NULL;
+
+    if(self->txqueue_len > 0) {
+        canfd_txslot_t *psTxSlots = m_new(canfd_txslot_t, self->txqueue_len);
+
+        MP_STATE_PORT(pyb_can_txqueue)[self->can_id] = psTxSlots;
+        if(CANFD_EnableSendQueue(self->obj, psTxSlots, self->txqueue_len) != 0) {
+            MP_STATE_PORT(pyb_can_txqueue)[self->can_id] = NULL;
+            self->txqueue_len = 0;
+            mp_hal_raise(HAL_ERROR);
+        }
+    }
+
     return mp_const_none;
 }
 
@@ -191,6 +272,11 @@ static mp_obj_t pyb_can_deinit(mp_obj_t self_in)
     CANFD_DisableStatusInt(self->obj, CAN_STATUS_INT_EVENT);
     CANFD_Final(self->obj);
 
+    MP_STATE_PORT(pyb_can_rxqueue)[self->can_id] = NULL;
+    self->rxqueue_len = 0;
+    MP_STATE_PORT(pyb_can_txqueue)[self->can_id] = NULL;
+    self->txqueue_len = 0;
+
     switch_pinfun(self, false);
 
     self->num_error_warning = 0;
@@ -252,10 +338,17 @@ static void pyb_can_print(const mp_print_t *print, mp_obj_t self_in, mp_print_ki
             mode = MP_QSTR_LOOPBACK;
             break;
         }
-        mp_printf(print, "CAN(%u, CAN.%q, extframe=%q)",
+        mp_printf(print, "CAN(%u, CAN.%q, extframe=%q, baudrate=%u",
                   self->can_id,
                   mode,
-                  self->extframe ? MP_QSTR_True : MP_QSTR_False);
+                  self->extframe ? MP_QSTR_True : MP_QSTR_False,
+                  self->InitDef->NormalBitRate);
+        if(self->fd) {
+            mp_printf(print, ", fd=True, brs=%q, data_baudrate=%u",
+                      self->brs ? MP_QSTR_True : MP_QSTR_False,
+                      self->InitDef->DataBitRate);
+        }
+        mp_printf(print, ")");
     }
 }
 
@@ -301,6 +394,9 @@ static mp_obj_t pyb_can_any(mp_obj_t self_in)
 {
     pyb_can_obj_t *self = self_in;
 
+    if(self->rxqueue_len > 0)
+        return mp_obj_new_bool(CANFD_RecvQueueCount(self->obj) > 0);
+
     if(CANFD_AmountDataRecv(self->obj) > 0)
         return mp_const_true;
 
@@ -341,6 +437,136 @@ static mp_obj_t pyb_can_setfilter(size_t n_args, const mp_obj_t *pos_args, mp_ma
 }
 static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_can_setfilter_obj, 1, pyb_can_setfilter);
 
+// setfilters() target of a frame stored into Rx buffer n: CAN.RXBUF | n
+#define CAN_FILTER_RXBUF		0x100
+
+/// \method setfilters(filters, *, nonmatch=CAN.REJECT)
+/// Replace the hardware filter tables by `filters`, a list of tuples
+/// (mode, id1, id2, target[, extid=False]), first match wins:
+///
+///   - `mode` CAN.RANGE (id1 <= id <= id2), CAN.DUAL (id1 or id2) or CAN.MASK
+///     (id & id2 == id1 & id2)
+///   - `target` CAN.FIFO0, CAN.FIFO1, CAN.REJECT or CAN.RXBUF | n to store frames
+///     with id == id1 into dedicated Rx buffer n (see readbuf()), n must be
+///     below the number of Rx buffers configured in the message RAM
+///   - `nonmatch` CAN.FIFO0, CAN.FIFO1 or CAN.REJECT for the other frames
+///
+/// The whole list is checked before the tables are written, at once. Standard
+/// and extended tables hold up to 128 and 64 filters.
+///
+/// Return value: `None`.
+static mp_obj_t pyb_can_setfilters(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    enum { ARG_filters, ARG_nonmatch };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_filters,  MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_nonmatch, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = CANFD_FILTER_REJECT} },
+    };
+
+    pyb_can_obj_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    size_t count;
+    mp_obj_t *items;
+    mp_obj_get_array(args[ARG_filters].u_obj, &count, &items);
+
+    if((args[ARG_nonmatch].u_int < CANFD_FILTER_TO_FIFO0) || (args[ARG_nonmatch].u_int > CANFD_FILTER_REJECT)) {
+        mp_raise_ValueError("invalid nonmatch");
+    }
+
+    uint32_t u32RxBufNum = CANFD_GetRxBufCount(self->obj);
+    canfd_filter_t *psFilters = m_new(canfd_filter_t, count ? count : 1);
+
+    for(size_t i = 0; i < count; i ++) {
+        size_t len;
+        mp_obj_t *elem;
+        mp_obj_get_array(items[i], &len, &elem);
+
+        if((len < 4) || (len > 5)) {
+            m_del(canfd_filter_t, psFilters, count ? count : 1);
+            nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "filter %d: (mode, id1, id2, target[, extid])", i));
+        }
+
+        mp_int_t mode = mp_obj_get_int(elem[0]);
+        mp_int_t target = mp_obj_get_int(elem[3]);
+        bool extid = (len == 5) && mp_obj_is_true(elem[4]);
+        uint32_t id_max = extid ? 0x1FFFFFFF : 0x7FF;
+        mp_uint_t id1 = mp_obj_get_int_truncated(elem[1]);
+        mp_uint_t id2 = mp_obj_get_int_truncated(elem[2]);
+
+        if((mode < CANFD_FILTER_RANGE) || (mode > CANFD_FILTER_MASK) || (id1 > id_max) || (id2 > id_max) ||
+            !(((target >= CANFD_FILTER_TO_FIFO0) && (target <= CANFD_FILTER_REJECT)) ||
+              ((target & ~0x3F) == CAN_FILTER_RXBUF))) {
+            m_del(canfd_filter_t, psFilters, count ? count : 1);
+            nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "filter %d parameter error", i));
+        }
+
+        if((target & CAN_FILTER_RXBUF) && ((uint32_t)(target & 0x3F) >= u32RxBufNum)) {
+            m_del(canfd_filter_t, psFilters, count ? count : 1);
+            nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "filter %d: Rx buffer %d not configured (%d buffers)", i, (int)(target & 0x3F), (int)u32RxBufNum));
+        }
+
+        psFilters[i].u8Type = mode;
+        psFilters[i].bExtId = extid;
+        psFilters[i].u32Id1 = id1;
+        psFilters[i].u32Id2 = id2;
+        psFilters[i].u8RxBufIdx = 0;
+
+        if(target & CAN_FILTER_RXBUF) {
+            psFilters[i].u8Target = CANFD_FILTER_TO_RXBUF;
+            psFilters[i].u8RxBufIdx = target & 0x3F;
+        } else {
+            psFilters[i].u8Target = target;
+        }
+    }
+
+    int32_t i32Ret = CANFD_SetRecvFilterTable(self->obj, psFilters, count, args[ARG_nonmatch].u_int);
+
+    m_del(canfd_filter_t, psFilters, count ? count : 1);
+
+    if(i32Ret == -2) {
+        mp_raise_ValueError("too many filters");
+    } else if(i32Ret == -3) {
+        mp_raise_ValueError("Rx buffer not configured");
+    } else if(i32Ret != 0) {
+        mp_raise_ValueError("CAN filter parameter error");
+    }
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_can_setfilters_obj, 2, pyb_can_setfilters);
+
+/// \method readbuf(index)
+/// Read dedicated Rx buffer `index` (see setfilters() CAN.RXBUF), below the
+/// number of Rx buffers configured in the message RAM.
+///
+/// Return value: (id, std, rtr, data) of the new frame in the buffer, or None.
+static mp_obj_t pyb_can_readbuf(mp_obj_t self_in, mp_obj_t index_in)
+{
+    pyb_can_obj_t *self = self_in;
+    mp_int_t index = mp_obj_get_int(index_in);
+    CANFD_FD_MSG_T tCanMsg;
+
+    if((index < 0) || ((mp_uint_t)index >= CANFD_GetRxBufCount(self->obj))) {
+        mp_raise_ValueError("invalid Rx buffer");
+    }
+
+    if(CANFD_RecvBufMsg(self->obj, index, &tCanMsg) != 0) {
+        return mp_const_none;
+    }
+
+    mp_obj_t tuple[4] = {
+        MP_OBJ_NEW_SMALL_INT(tCanMsg.u32Id),
+        tCanMsg.eIdType == eCANFD_SID ? mp_const_true : mp_const_false,
+        tCanMsg.eFrmType == eCANFD_REMOTE_FRM ? mp_const_true : mp_const_false,
+        mp_obj_new_bytes(&tCanMsg.au8Data[0], tCanMsg.u32DLC),
+    };
+
+    return mp_obj_new_tuple(4, tuple);
+}
+static MP_DEFINE_CONST_FUN_OBJ_2(pyb_can_readbuf_obj, pyb_can_readbuf);
+
 
 // Get info about error states and TX/RX buffers
 static mp_obj_t pyb_can_info(size_t n_args, const mp_obj_t *args)
@@ -376,22 +602,78 @@ static mp_obj_t pyb_can_info(size_t n_args, const mp_obj_t *args)
 static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(pyb_can_info_obj, 1, 2, pyb_can_info);
 
 
-/// \method send(send, addr, *, timeout=5000)
+/// \method stats(reset=True)
+/// Return a dict of the traffic since init() or the previous stats(reset=True):
+/// rx_fps, tx_fps, bus_load (percent, from the frame formats without stuff bits),
+/// rx_frames, tx_frames, window_ms, tec, rec, error_log (protocol errors),
+/// error_warning, error_passive, bus_off, fifo0_max, fifo1_max, rxqueue_max,
+/// rxqueue_overrun, rx_overrun (frames lost in this window because the receive
+/// queue was full or absent), last_rx_us and last_tx_us (time.ticks_us() time base).
+/// Frames are counted in the interrupt handler with the receive/send queues.
+static mp_obj_t pyb_can_stats(size_t n_args, const mp_obj_t *args)
+{
+    pyb_can_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+    bool reset = (n_args == 1) || mp_obj_is_true(args[1]);
+    CANFD_Stats_t sStats;
+    uint8_t u8TxBufErr = 0;
+    uint8_t u8RxBufErr = 0;
+
+    CANFD_GetStats(self->obj, &sStats, reset);
+    CANFD_GetBusErrCount(self->obj->canfd, &u8TxBufErr, &u8RxBufErr);
+
+    mp_float_t window = (sStats.u32WindowUs > 0) ? (mp_float_t)sStats.u32WindowUs : 1;
+    mp_obj_t dict = mp_obj_new_dict(19);
+
+    #define CAN_STATS_STORE(key, value) mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(key), value)
+    CAN_STATS_STORE(MP_QSTR_rx_fps, mp_obj_new_float((mp_float_t)sStats.u32RxFrames * 1000000 / window));
+    CAN_STATS_STORE(MP_QSTR_tx_fps, mp_obj_new_float((mp_float_t)sStats.u32TxFrames * 1000000 / window));
+    CAN_STATS_STORE(MP_QSTR_bus_load, mp_obj_new_float((mp_float_t)sStats.u64BusTimeNs / 10 / window));
+    CAN_STATS_STORE(MP_QSTR_rx_frames, mp_obj_new_int_from_uint(sStats.u32RxFrames));
+    CAN_STATS_STORE(MP_QSTR_tx_frames, mp_obj_new_int_from_uint(sStats.u32TxFrames));
+    CAN_STATS_STORE(MP_QSTR_window_ms, mp_obj_new_int_from_uint(sStats.u32WindowUs / 1000));
+    CAN_STATS_STORE(MP_QSTR_tec, MP_OBJ_NEW_SMALL_INT(u8TxBufErr));
+    CAN_STATS_STORE(MP_QSTR_rec, MP_OBJ_NEW_SMALL_INT(u8RxBufErr));
+    CAN_STATS_STORE(MP_QSTR_error_log, mp_obj_new_int_from_uint(sStats.u32ErrLogCount));
+    CAN_STATS_STORE(MP_QSTR_error_warning, MP_OBJ_NEW_SMALL_INT(self->num_error_warning));
+    CAN_STATS_STORE(MP_QSTR_error_passive, MP_OBJ_NEW_SMALL_INT(self->num_error_passive));
+    CAN_STATS_STORE(MP_QSTR_bus_off, MP_OBJ_NEW_SMALL_INT(self->num_bus_off));
+    CAN_STATS_STORE(MP_QSTR_fifo0_max, MP_OBJ_NEW_SMALL_INT(sStats.u32Fifo0Max));
+    CAN_STATS_STORE(MP_QSTR_fifo1_max, MP_OBJ_NEW_SMALL_INT(sStats.u32Fifo1Max));
+    CAN_STATS_STORE(MP_QSTR_rxqueue_max, MP_OBJ_NEW_SMALL_INT(sStats.u32RxQueueMax));
+    CAN_STATS_STORE(MP_QSTR_rxqueue_overrun, mp_obj_new_int_from_uint(CANFD_RecvQueueOverrun(self->obj)));
+    CAN_STATS_STORE(MP_QSTR_rx_overrun, mp_obj_new_int_from_uint(sStats.u32RxOverrun));
+    CAN_STATS_STORE(MP_QSTR_last_rx_us, MP_OBJ_NEW_SMALL_INT(CAN_TICKS_US(sStats.u32LastRxStamp)));
+    CAN_STATS_STORE(MP_QSTR_last_tx_us, MP_OBJ_NEW_SMALL_INT(CAN_TICKS_US(sStats.u32LastTxStamp)));
+    #undef CAN_STATS_STORE
+
+    return dict;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(pyb_can_stats_obj, 1, 2, pyb_can_stats);
+
+
+/// \method send(send, addr, *, timeout=5000, rtr=False, fd=None, brs=None)
 /// Send a message on the bus:
 ///
 ///   - `send` is the data to send (an integer to send, or a buffer object).
 ///   - `addr` is the address to send to
 ///   - `timeout` is the timeout in milliseconds to wait for the send.
+///   - `fd` sends a CAN FD frame (up to 64 bytes), `brs` switches to the data bit rate.
+///     Both default to the init() settings.
+///
+/// With a send queue (init `txqueue`), the frame is queued by CAN ID priority and send returns
+/// at once; `timeout` is then the time to wait for a free queue slot.
 ///
 /// Return value: `None`.
 static mp_obj_t pyb_can_send(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
 {
-    enum { ARG_data, ARG_id, ARG_timeout, ARG_rtr };
+    enum { ARG_data, ARG_id, ARG_timeout, ARG_rtr, ARG_fd, ARG_brs };
     static const mp_arg_t allowed_args[] = {
         { MP_QSTR_data,    MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
         { MP_QSTR_id,      MP_ARG_REQUIRED | MP_ARG_INT, {.u_int = 0} },
         { MP_QSTR_timeout, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0} },
         { MP_QSTR_rtr,     MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false} },
+        { MP_QSTR_fd,      MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_brs,     MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
     };
 
 
@@ -405,23 +687,28 @@ static mp_obj_t pyb_can_send(size_t n_args, const mp_obj_t *pos_args, mp_map_t *
     uint8_t data[1];
     pyb_buf_get_for_send(args[ARG_data].u_obj, &bufinfo, data);
 
-    if ((bufinfo.len != 8) &&
-        (bufinfo.len != 12) &&
-        (bufinfo.len != 16) &&
-        (bufinfo.len != 20) &&
-        (bufinfo.len != 24) &&
-        (bufinfo.len != 32) &&
-        (bufinfo.len != 48) &&
-        (bufinfo.len != 64)) {
-        mp_raise_ValueError("CAN data field too long");
+    bool bFD = (args[ARG_fd].u_obj == mp_const_none) ? self->fd : mp_obj_is_true(args[ARG_fd].u_obj);
+    bool bBRS = (args[ARG_brs].u_obj == mp_const_none) ? self->brs : mp_obj_is_true(args[ARG_brs].u_obj);
+
+    if(bFD && !self->fd) {
+        mp_raise_ValueError("CAN FD not enabled");
     }
 
-    int availMsgObj;
+    // Classic frames carry 0~8 bytes, FD frames also 12, 16, 20, 24, 32, 48 or 64
+    if ((bufinfo.len > 8) &&
+        (!bFD ||
+         ((bufinfo.len != 12) &&
+          (bufinfo.len != 16) &&
+          (bufinfo.len != 20) &&
+          (bufinfo.len != 24) &&
+          (bufinfo.len != 32) &&
+          (bufinfo.len != 48) &&
+          (bufinfo.len != 64)))) {
+        mp_raise_ValueError("invalid CAN data length");
+    }
 
-    //Get available message object index. available: 0~31
-    availMsgObj = CANFD_GetFreeMsgObjIdx(self->obj, args[ARG_timeout].u_int);
-    if(availMsgObj < 0) {
-        mp_hal_raise(HAL_TIMEOUT);
+    if(bFD && args[ARG_rtr].u_bool) {
+        mp_raise_ValueError("no remote frame in CAN FD");
     }
 
     CANFD_FD_MSG_T tMsg;
@@ -438,7 +725,8 @@ static mp_obj_t pyb_can_send(size_t n_args, const mp_obj_t *pos_args, mp_map_t *
         tMsg.eFrmType= eCANFD_DATA_FRM;
 
     /* Set FD frame format attribute */
-    tMsg.bFDFormat = 0;
+    tMsg.bFDFormat = bFD;
+    tMsg.bBitRateSwitch = bFD && bBRS;
 
     tMsg.u32Id       = args[ARG_id].u_int;
     tMsg.u32DLC      = bufinfo.len;
@@ -446,7 +734,28 @@ static mp_obj_t pyb_can_send(size_t n_args, const mp_obj_t *pos_args, mp_map_t *
     for(i = 0; i < bufinfo.len; i ++)
         tMsg.au8Data[i] = ((byte*)bufinfo.buf)[i];
 
-    if(CANFD_TransmitTxMsg(self->obj->canfd, availMsgObj, &tMsg) != eCANFD_TRANSMIT_SUCCESS) {
+    if(self->txqueue_len > 0) {
+        uint32_t start = mp_hal_ticks_ms();
+
+        while(CANFD_SendQueuePut(self->obj, &tMsg) != 0) {
+            if((mp_hal_ticks_ms() - start) >= (uint32_t)args[ARG_timeout].u_int) {
+                mp_hal_raise(HAL_TIMEOUT);
+            }
+            MICROPY_EVENT_POLL_HOOK
+        }
+
+        return mp_const_none;
+    }
+
+    int availMsgObj;
+
+    //Get available message object index. available: 0~31
+    availMsgObj = CANFD_GetFreeMsgObjIdx(self->obj, args[ARG_timeout].u_int);
+    if(availMsgObj < 0) {
+        mp_hal_raise(HAL_TIMEOUT);
+    }
+
+    if(CANFD_SendMsg(self->obj, availMsgObj, &tMsg) != 0) {
         mp_hal_raise(HAL_ERROR);
     }
 
@@ -456,12 +765,61 @@ static mp_obj_t pyb_can_send(size_t n_args, const mp_obj_t *pos_args, mp_map_t *
 static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_can_send_obj, 1, pyb_can_send);
 
 
-/// \method recv(fifo, list=None, *, timeout=5000)
+/// \method txstats()
+/// Return the send queue statistics as a tuple:
+/// (depth, max_depth, sent, dropped, last_latency_us, max_latency_us, avg_latency_us).
+/// Latency is measured from queuing to end of transmission.
+static mp_obj_t pyb_can_txstats(mp_obj_t self_in)
+{
+    pyb_can_obj_t *self = self_in;
+    CANFD_SendQueueStats_t sStats;
+
+    if(self->txqueue_len == 0) {
+        mp_raise_ValueError("send queue not enabled");
+    }
+
+    CANFD_SendQueueGetStats(self->obj, &sStats);
+
+    mp_obj_t tuple[7] = {
+        mp_obj_new_int_from_uint(sStats.u32Depth),
+        mp_obj_new_int_from_uint(sStats.u32MaxDepth),
+        mp_obj_new_int_from_uint(sStats.u32Sent),
+        mp_obj_new_int_from_uint(sStats.u32Dropped),
+        mp_obj_new_int_from_uint(sStats.u32LatencyLastUs),
+        mp_obj_new_int_from_uint(sStats.u32LatencyMaxUs),
+        mp_obj_new_int_from_uint(sStats.u32Sent ? (uint32_t)(sStats.u64LatencySumUs / sStats.u32Sent) : 0),
+    };
+
+    return mp_obj_new_tuple(7, tuple);
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_can_txstats_obj, pyb_can_txstats);
+
+
+// Wait for a frame in the receive queue, NULL on timeout
+static const canfd_rxslot_t *can_recvqueue_wait(pyb_can_obj_t *self, mp_int_t timeout)
+{
+    uint32_t start = mp_hal_ticks_ms();
+    const canfd_rxslot_t *psSlot;
+
+    while((psSlot = CANFD_RecvQueuePeek(self->obj)) == NULL) {
+        if((mp_hal_ticks_ms() - start) >= (uint32_t)timeout) {
+            break;
+        }
+        MICROPY_EVENT_POLL_HOOK
+    }
+
+    return psSlot;
+}
+
+/// \method recv(list=None, *, timeout=5000)
 ///
 /// Receive data on the bus:
 ///
-///   - `fifo` is an integer, which is the FIFO to receive on
-///   - `list` if not None is a list with at least 4 elements
+///   - `list` if not None is a list with at least 4 elements, its fourth element
+///     a memoryview of at least 64 bytes for CAN FD frames. A fifth element is set
+///     to the reception time in time.ticks_us() time base, from the CAN timestamp counter.
+///     Without receive queue the time is taken from the 16 bit counter when the frame
+///     is read: a frame left in the FIFO longer than 65536 bit times gets a wrong time.
 ///   - `timeout` is the timeout in milliseconds to wait for the receive.
 ///
 /// Return value: buffer of data bytes.
@@ -480,8 +838,18 @@ static mp_obj_t pyb_can_recv(size_t n_args, const mp_obj_t *pos_args, mp_map_t *
 
 
     CANFD_FD_MSG_T tCanMsg;
+    uint32_t u32Stamp;
 
-    if(CANFD_RecvMsg(self->obj, &tCanMsg, args[ARG_timeout].u_int) != 0) {
+    if(self->rxqueue_len > 0) {
+        const canfd_rxslot_t *psSlot = can_recvqueue_wait(self, args[ARG_timeout].u_int);
+
+        if(psSlot == NULL) {
+            mp_hal_raise(HAL_TIMEOUT);
+        }
+        memcpy(&tCanMsg, &psSlot->sMsg, sizeof(tCanMsg));
+        u32Stamp = psSlot->u32Stamp;
+        CANFD_RecvQueuePop(self->obj);
+    } else if(CANFD_RecvMsg(self->obj, &tCanMsg, args[ARG_timeout].u_int, &u32Stamp) != 0) {
         mp_hal_raise(HAL_TIMEOUT);
     }
 
@@ -525,11 +893,156 @@ static mp_obj_t pyb_can_recv(size_t n_args, const mp_obj_t *pos_args, mp_map_t *
     items[1] = tCanMsg.eIdType == eCANFD_SID ? mp_const_true : mp_const_false;
     items[2] = tCanMsg.eFrmType == eCANFD_REMOTE_FRM ? mp_const_true : mp_const_false;
 
+    // A fifth list element gets the reception time
+    if ((ret_obj == args[ARG_list].u_obj) && (((mp_obj_list_t *)MP_OBJ_TO_PTR(ret_obj))->len >= 5)) {
+        items[4] = MP_OBJ_NEW_SMALL_INT(CAN_TICKS_US(u32Stamp));
+    }
+
     // Return the result
     return ret_obj;
 }
 static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_can_recv_obj, 1, pyb_can_recv);
 
+/// \method recv_into(list, *, timeout=0)
+///
+/// Receive a frame into `list` = [id, std, rtr, memoryview] without heap
+/// allocation: the memoryview must reference a bytearray of 64 bytes, it is
+/// resized to the frame length. A fifth element gets the reception time
+/// (time.ticks_us() time base). Needs the receive queue (init rxqueue > 0).
+///
+/// Return value: True if a frame is received, False on timeout.
+static mp_obj_t pyb_can_recv_into(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    enum { ARG_list, ARG_timeout };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_list,    MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_timeout, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0} },
+    };
+
+    pyb_can_obj_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    if(self->rxqueue_len == 0) {
+        mp_raise_ValueError("rxqueue not enabled");
+    }
+
+    if (!MP_OBJ_IS_TYPE(args[ARG_list].u_obj, &mp_type_list)) {
+        mp_raise_TypeError(NULL);
+    }
+
+    mp_obj_list_t *list = MP_OBJ_TO_PTR(args[ARG_list].u_obj);
+
+    if ((list->len < 4) || !MP_OBJ_IS_TYPE(list->items[3], &mp_type_memoryview)) {
+        mp_raise_ValueError(NULL);
+    }
+
+    mp_obj_array_t *mv = MP_OBJ_TO_PTR(list->items[3]);
+    if (!(mv->typecode == (0x80 | BYTEARRAY_TYPECODE)
+          || (mv->typecode | 0x20) == (0x80 | 'b'))) {
+        mp_raise_ValueError(NULL);
+    }
+
+    const canfd_rxslot_t *psSlot = can_recvqueue_wait(self, args[ARG_timeout].u_int);
+
+    if(psSlot == NULL) {
+        return mp_const_false;
+    }
+
+    const CANFD_FD_MSG_T *psMsg = &psSlot->sMsg;
+
+    mv->len = psMsg->u32DLC;
+    memcpy(mv->items, &psMsg->au8Data[0], psMsg->u32DLC);
+
+    list->items[0] = MP_OBJ_NEW_SMALL_INT(psMsg->u32Id);
+    list->items[1] = psMsg->eIdType == eCANFD_SID ? mp_const_true : mp_const_false;
+    list->items[2] = psMsg->eFrmType == eCANFD_REMOTE_FRM ? mp_const_true : mp_const_false;
+
+    if(list->len >= 5) {
+        list->items[4] = MP_OBJ_NEW_SMALL_INT(CAN_TICKS_US(psSlot->u32Stamp));
+    }
+
+    CANFD_RecvQueuePop(self->obj);
+
+    return mp_const_true;
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_can_recv_into_obj, 2, pyb_can_recv_into);
+
+/// \method recv_many(buf, *, timeout=0)
+///
+/// Drain the receive queue into `buf`, a writable buffer of CAN.RECORD_SIZE
+/// bytes records: id (4 bytes, little endian), flags (CAN.FLAG_xxx), data
+/// length, 2 reserved bytes, reception time (4 bytes, little endian, time.ticks_us()
+/// time base) and 64 data bytes. Waits at most `timeout` ms for
+/// the first frame. Needs the receive queue (init rxqueue > 0).
+///
+/// Return value: number of records written.
+static mp_obj_t pyb_can_recv_many(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    enum { ARG_buf, ARG_timeout };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_buf,     MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_timeout, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0} },
+    };
+
+    pyb_can_obj_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    if(self->rxqueue_len == 0) {
+        mp_raise_ValueError("rxqueue not enabled");
+    }
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[ARG_buf].u_obj, &bufinfo, MP_BUFFER_WRITE);
+
+    size_t max_records = bufinfo.len / CAN_RECORD_SIZE;
+    size_t count = 0;
+    uint8_t *record = bufinfo.buf;
+    const canfd_rxslot_t *psSlot;
+
+    if((max_records == 0) || (can_recvqueue_wait(self, args[ARG_timeout].u_int) == NULL)) {
+        return MP_OBJ_NEW_SMALL_INT(0);
+    }
+
+    while((count < max_records) && ((psSlot = CANFD_RecvQueuePeek(self->obj)) != NULL)) {
+        const CANFD_FD_MSG_T *psMsg = &psSlot->sMsg;
+        uint32_t u32Stamp = CAN_TICKS_US(psSlot->u32Stamp);
+        uint8_t flags = 0;
+
+        if(psMsg->eIdType == eCANFD_XID)
+            flags |= CAN_RECORD_FLAG_EXTID;
+        if(psMsg->eFrmType == eCANFD_REMOTE_FRM)
+            flags |= CAN_RECORD_FLAG_RTR;
+        if(psMsg->bFDFormat)
+            flags |= CAN_RECORD_FLAG_FDF;
+        if(psMsg->bBitRateSwitch)
+            flags |= CAN_RECORD_FLAG_BRS;
+
+        record[0] = psMsg->u32Id;
+        record[1] = psMsg->u32Id >> 8;
+        record[2] = psMsg->u32Id >> 16;
+        record[3] = psMsg->u32Id >> 24;
+        record[4] = flags;
+        record[5] = psMsg->u32DLC;
+        record[6] = 0;
+        record[7] = 0;
+        record[8] = u32Stamp;
+        record[9] = u32Stamp >> 8;
+        record[10] = u32Stamp >> 16;
+        record[11] = u32Stamp >> 24;
+        memcpy(&record[12], &psMsg->au8Data[0], psMsg->u32DLC);
+
+        CANFD_RecvQueuePop(self->obj);
+
+        record += CAN_RECORD_SIZE;
+        count ++;
+    }
+
+    return MP_OBJ_NEW_SMALL_INT(count);
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_can_recv_many_obj, 2, pyb_can_recv_many);
+
 
 static void CAN_StatusInt_Handler(void *obj, uint32_t u32Status);
 
@@ -562,9 +1075,15 @@ static const mp_rom_map_elem_t pyb_can_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_state), MP_ROM_PTR(&pyb_can_state_obj) },
     { MP_ROM_QSTR(MP_QSTR_any), MP_ROM_PTR(&pyb_can_any_obj) },
     { MP_ROM_QSTR(MP_QSTR_setfilter), MP_ROM_PTR(&pyb_can_setfilter_obj) },
+    { MP_ROM_QSTR(MP_QSTR_setfilters), MP_ROM_PTR(&pyb_can_setfilters_obj) },
+    { MP_ROM_QSTR(MP_QSTR_readbuf), MP_ROM_PTR(&pyb_can_readbuf_obj) },
     { MP_ROM_QSTR(MP_QSTR_info), MP_ROM_PTR(&pyb_can_info_obj) },
+    { MP_ROM_QSTR(MP_QSTR_stats), MP_ROM_PTR(&pyb_can_stats_obj) },
     { MP_ROM_QSTR(MP_QSTR_send), MP_ROM_PTR(&pyb_can_send_obj) },
+    { MP_ROM_QSTR(MP_QSTR_txstats), MP_ROM_PTR(&pyb_can_txstats_obj) },
     { MP_ROM_QSTR(MP_QSTR_recv), MP_ROM_PTR(&pyb_can_recv_obj) },
+    { MP_ROM_QSTR(MP_QSTR_recv_into), MP_ROM_PTR(&pyb_can_recv_into_obj) },
+    { MP_ROM_QSTR(MP_QSTR_recv_many), MP_ROM_PTR(&pyb_can_recv_many_obj) },
     { MP_ROM_QSTR(MP_QSTR_rxcallback), MP_ROM_PTR(&pyb_can_rxcallback_obj) },
 
 
@@ -572,6 +1091,22 @@ static const mp_rom_map_elem_t pyb_can_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_NORMAL), MP_ROM_INT(CAN_NORMAL_MODE) },
     { MP_ROM_QSTR(MP_QSTR_LOOPBACK), MP_ROM_INT(CAN_LOOPBACK_MODE) },
 
+    // setfilters() modes and targets
+    { MP_ROM_QSTR(MP_QSTR_RANGE), MP_ROM_INT(CANFD_FILTER_RANGE) },
+    { MP_ROM_QSTR(MP_QSTR_DUAL), MP_ROM_INT(CANFD_FILTER_DUAL) },
+    { MP_ROM_QSTR(MP_QSTR_MASK), MP_ROM_INT(CANFD_FILTER_MASK) },
+    { MP_ROM_QSTR(MP_QSTR_FIFO0), MP_ROM_INT(CANFD_FILTER_TO_FIFO0) },
+    { MP_ROM_QSTR(MP_QSTR_FIFO1), MP_ROM_INT(CANFD_FILTER_TO_FIFO1) },
+    { MP_ROM_QSTR(MP_QSTR_REJECT), MP_ROM_INT(CANFD_FILTER_REJECT) },
+    { MP_ROM_QSTR(MP_QSTR_RXBUF), MP_ROM_INT(CAN_FILTER_RXBUF) },
+
+    // recv_many() record layout
+    { MP_ROM_QSTR(MP_QSTR_RECORD_SIZE), MP_ROM_INT(CAN_RECORD_SIZE) },
+    { MP_ROM_QSTR(MP_QSTR_FLAG_EXTID), MP_ROM_INT(CAN_RECORD_FLAG_EXTID) },
+    { MP_ROM_QSTR(MP_QSTR_FLAG_RTR), MP_ROM_INT(CAN_RECORD_FLAG_RTR) },
+    { MP_ROM_QSTR(MP_QSTR_FLAG_FDF), MP_ROM_INT(CAN_RECORD_FLAG_FDF) },
+    { MP_ROM_QSTR(MP_QSTR_FLAG_BRS), MP_ROM_INT(CAN_RECORD_FLAG_BRS) },
+
     // values for CAN.state()
     { MP_ROM_QSTR(MP_QSTR_STOPPED), MP_ROM_INT(CAN_STATE_STOPPED) },
     { MP_ROM_QSTR(MP_QSTR_ERROR_ACTIVE), MP_ROM_INT(CAN_STATE_ERROR_ACTIVE) },
@@ -599,13 +1134,13 @@ mp_uint_t can_ioctl(mp_obj_t self_in, mp_uint_t request, mp_uint_t arg, int *err
         mp_uint_t flags = arg;
         ret = 0;
         if (flags & MP_STREAM_POLL_RD) {
-            if(CANFD_AmountDataRecv(self->obj) > 0) {
+            if((self->rxqueue_len > 0) ? (CANFD_RecvQueueCount(self->obj) > 0) : (CANFD_AmountDataRecv(self->obj) > 0)) {
                 ret |= MP_STREAM_POLL_RD;
             }
         }
 
         if (flags & MP_STREAM_POLL_WR) {
-            if(CANFD_GetFreeMsgObjIdx(self->obj, 0) >= 0) {
+            if((self->txqueue_len > 0) ? (CANFD_SendQueueSpace(self->obj) > 0) : (CANFD_GetFreeMsgObjIdx(self->obj, 0) >= 0)) {
                 ret |= MP_STREAM_POLL_WR;
             }
         }
@@ -635,6 +1170,29 @@ MP_DEFINE_CONST_OBJ_TYPE(
 );
 
 
+canfd_t *pyb_can_get_handle(mp_obj_t can, bool *fd, bool txqueue)
+{
+    if (mp_obj_get_type(can) != &machine_can_type) {
+        mp_raise_ValueError("need a CAN object");
+    }
+
+    pyb_can_obj_t *self = can;
+
+    if (!self->is_enabled) {
+        mp_raise_ValueError("CAN not enabled");
+    }
+
+    if (txqueue && (self->txqueue_len == 0)) {
+        mp_raise_ValueError("CAN needs init() with txqueue");
+    }
+
+    if (fd) {
+        *fd = self->fd;
+    }
+
+    return self->obj;
+}
+
 static void can_handle_irq_callback(pyb_can_obj_t *self, uint32_t cb_reason)
 {
 
@@ -27,8 +27,13 @@
 #ifndef MICROPY_INCLUDED_CLASS_CAN_H
 #define MICROPY_INCLUDED_CLASS_CAN_H
 
+#include "hal/M55M1_CANFD.h"
+
 
 extern const mp_obj_type_t machine_can_type;
 
+// HAL object of an initialized CAN, raises if `can` is not a CAN, or has no send queue when `txqueue` is set
+canfd_t *pyb_can_get_handle(mp_obj_t can, bool *fd, bool txqueue);
+
 
 #endif // MICROPY_INCLUDED_CLASS_CAN_H
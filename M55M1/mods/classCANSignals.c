@@ -0,0 +1,474 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2013, 2014 Damien P. George
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "py/runtime.h"
+#include "py/gc.h"
+#include "py/mphal.h"
+
+#include "classCAN.h"
+#include "classCANSignals.h"
+#include "hal/M55M1_CANSIG.h"
+
+#if MICROPY_HW_ENABLE_CAN
+
+/// \moduleref machine
+/// \class CANSignals - DBC style signal decoding and encoding
+///
+/// CANSignals(can, signals, values) compiles a signal table once and decodes
+/// the received frames of `can` in its interrupt handler, straight into the
+/// preallocated array('f') `values`. Python only reads the values, and the
+/// indices changed since the last look.
+///
+///     values = array.array('f', [0] * 3)
+///     sig = machine.CANSignals(can, [
+///         (0x100, 0, 16, 0, 0.25, 0),                                # engine speed
+///         (0x100, 16, 8, machine.CANSignals.SIGNED, 1, -40),         # coolant
+///         (0x200, 7, 12, machine.CANSignals.BIG_ENDIAN, 0.1, 0),     # pressure
+///     ], values)
+///     sig.callback(lambda s: print(s.changed()))
+///     values[2] = 101.3
+///     can.send(sig.encode(0x200), 0x200)
+
+#define MAX_CANSIG_TABLES	2
+
+typedef struct _pyb_cansig_obj_t {
+    mp_obj_base_t base;
+    bool active;
+    volatile bool pending;		//change callback scheduled and not run yet
+    cansig_table_t table;
+} pyb_cansig_obj_t;
+
+static pyb_cansig_obj_t pyb_cansig_obj[MAX_CANSIG_TABLES] = {
+    {{&machine_cansignals_type}, false},
+    {{&machine_cansignals_type}, false},
+};
+
+// CAN object, compiled signals, values array, change bits and callback of each table, kept alive while the ISR uses them
+MP_REGISTER_ROOT_POINTER(mp_obj_t pyb_cansig_can[MAX_CANSIG_TABLES]);
+MP_REGISTER_ROOT_POINTER(void *pyb_cansig_signals[MAX_CANSIG_TABLES]);
+MP_REGISTER_ROOT_POINTER(mp_obj_t pyb_cansig_values[MAX_CANSIG_TABLES]);
+MP_REGISTER_ROOT_POINTER(void *pyb_cansig_changed[MAX_CANSIG_TABLES]);
+MP_REGISTER_ROOT_POINTER(mp_obj_t pyb_cansig_callback[MAX_CANSIG_TABLES]);
+
+static size_t cansig_index(pyb_cansig_obj_t *self)
+{
+    return self - &pyb_cansig_obj[0];
+}
+
+static void cansig_close(pyb_cansig_obj_t *self)
+{
+    size_t idx = cansig_index(self);
+
+    if (self->active) {
+        CANSIG_Detach(&self->table);
+        self->active = false;
+    }
+
+    self->pending = false;
+    memset(&self->table, 0, sizeof(self->table));
+
+    MP_STATE_PORT(pyb_cansig_can)[idx] = MP_OBJ_NULL;
+    MP_STATE_PORT(pyb_cansig_signals)[idx] = NULL;
+    MP_STATE_PORT(pyb_cansig_values)[idx] = MP_OBJ_NULL;
+    MP_STATE_PORT(pyb_cansig_changed)[idx] = NULL;
+    MP_STATE_PORT(pyb_cansig_callback)[idx] = MP_OBJ_NULL;
+}
+
+static void cansig_check_active(pyb_cansig_obj_t *self)
+{
+    if (!self->active) {
+        mp_raise_ValueError("CANSignals closed");
+    }
+}
+
+// Scheduled from the CAN ISR after a frame changed values
+static mp_obj_t cansig_dispatch(mp_obj_t self_in)
+{
+    pyb_cansig_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_obj_t callback = MP_STATE_PORT(pyb_cansig_callback)[cansig_index(self)];
+
+    self->pending = false;
+
+    if (self->active && (callback != MP_OBJ_NULL)) {
+        mp_call_function_1(callback, self_in);
+    }
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(cansig_dispatch_obj, cansig_dispatch);
+
+// Called from the CAN ISR
+static void cansig_changed(void *pvUserData)
+{
+    pyb_cansig_obj_t *self = pvUserData;
+
+    // One pending call covers the changes made until it runs
+    if (!self->pending && (MP_STATE_PORT(pyb_cansig_callback)[cansig_index(self)] != MP_OBJ_NULL)) {
+        self->pending = mp_sched_schedule(MP_OBJ_FROM_PTR(&cansig_dispatch_obj), MP_OBJ_FROM_PTR(self));
+    }
+}
+
+/// \classmethod \constructor(can, signals, values, *, consume=False)
+///
+///   - `can` an initialized machine.CAN, or None to use decode() and encode() only.
+///   - `signals` sequence of (id, start_bit, length, flags=0, scale=1, offset=0)
+///     as in a DBC file: `start_bit` is the LSB (LITTLE_ENDIAN) or the MSB
+///     (BIG_ENDIAN) in DBC numbering, `length` is 1~64 bits and `flags` is
+///     BIG_ENDIAN | SIGNED | EXTID. value = raw * scale + offset.
+///   - `values` array('f') with a slot for each signal, in `signals` order. It
+///     is written by the interrupt handler and must not be resized.
+///   - `consume` frames holding signals do not reach recv() and ISO-TP.
+///
+/// Only one table decodes the frames of a CAN. Frames are read by the CAN
+/// interrupt while a table is attached; without `rxqueue` frames that are
+/// not consumed are dropped.
+static mp_obj_t pyb_cansig_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *all_args)
+{
+    enum { ARG_can, ARG_signals, ARG_values, ARG_consume };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_can,     MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_signals, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_values,  MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_consume, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false} },
+    };
+
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all_kw_array(n_args, n_kw, all_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    canfd_t *can = NULL;
+
+    if (args[ARG_can].u_obj != mp_const_none) {
+        can = pyb_can_get_handle(args[ARG_can].u_obj, NULL, false);
+    }
+
+    size_t num;
+    mp_obj_t *items;
+    mp_obj_get_array(args[ARG_signals].u_obj, &num, &items);
+
+    if ((num == 0) || (num > 0xFFFF)) {
+        mp_raise_ValueError("invalid signals");
+    }
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[ARG_values].u_obj, &bufinfo, MP_BUFFER_RW);
+
+    if ((bufinfo.typecode != 'f') || ((bufinfo.len / sizeof(float)) < num)) {
+        mp_raise_ValueError("values must be array('f') of a slot per signal");
+    }
+
+    // A CAN has one table, the previous one is replaced
+    pyb_cansig_obj_t *self = NULL;
+
+    for (int i = 0; i < MAX_CANSIG_TABLES; i++) {
+        pyb_cansig_obj_t *table = &pyb_cansig_obj[i];
+
+        if (table->active && (can != NULL) && (table->table.psCANFDObj == can)) {
+            cansig_close(table);
+        }
+
+        if ((self == NULL) && !table->active) {
+            self = table;
+        }
+    }
+
+    if (self == NULL) {
+        mp_raise_ValueError("no free CANSignals table");
+    }
+
+    cansig_def_t *defs = m_new(cansig_def_t, num);
+
+    for (size_t i = 0; i < num; i++) {
+        size_t len;
+        mp_obj_t *sig;
+        mp_obj_get_array(items[i], &len, &sig);
+
+        if ((len < 3) || (len > 6)) {
+            m_del(cansig_def_t, defs, num);
+            mp_raise_ValueError("signal is (id, start_bit, length, flags, scale, offset)");
+        }
+
+        mp_int_t start = mp_obj_get_int(sig[1]);
+        mp_int_t length = mp_obj_get_int(sig[2]);
+        mp_int_t flags = (len > 3) ? mp_obj_get_int(sig[3]) : 0;
+
+        defs[i].u32Id = mp_obj_get_int_truncated(sig[0]);
+        defs[i].u16StartBit = ((start < 0) || (start > 0xFFFF)) ? 0xFFFF : start;
+        defs[i].u8Length = ((length < 0) || (length > 64)) ? 0 : length;
+        defs[i].u8Flags = flags & (CANSIG_BIG_ENDIAN | CANSIG_SIGNED | CANSIG_EXTID);
+        defs[i].fScale = (len > 4) ? mp_obj_get_float(sig[4]) : 1.0f;
+        defs[i].fOffset = (len > 5) ? mp_obj_get_float(sig[5]) : 0.0f;
+    }
+
+    size_t idx = cansig_index(self);
+    cansig_signal_t *signals = m_new(cansig_signal_t, num);
+    uint32_t *changed = m_new0(uint32_t, (num + 31) / 32);
+    int32_t ret = CANSIG_Compile(defs, num, signals);
+
+    m_del(cansig_def_t, defs, num);
+
+    if (ret != 0) {
+        mp_raise_ValueError("invalid signal id, start bit or length");
+    }
+
+    MP_STATE_PORT(pyb_cansig_can)[idx] = (can != NULL) ? args[ARG_can].u_obj : MP_OBJ_NULL;
+    MP_STATE_PORT(pyb_cansig_signals)[idx] = signals;
+    MP_STATE_PORT(pyb_cansig_values)[idx] = args[ARG_values].u_obj;
+    MP_STATE_PORT(pyb_cansig_changed)[idx] = changed;
+    MP_STATE_PORT(pyb_cansig_callback)[idx] = MP_OBJ_NULL;
+
+    memset(&self->table, 0, sizeof(self->table));
+    self->pending = false;
+    self->table.psSignals = signals;
+    self->table.u32NumSignals = num;
+    self->table.pfValues = bufinfo.buf;
+    self->table.pu32Changed = changed;
+    self->table.bConsume = args[ARG_consume].u_bool;
+    self->table.pfnChange = cansig_changed;
+    self->table.pvUserData = self;
+    self->active = true;
+
+    if ((can != NULL) && (CANSIG_Attach(&self->table, can) != 0)) {
+        cansig_close(self);
+        mp_hal_raise(HAL_ERROR);
+    }
+
+    return MP_OBJ_FROM_PTR(self);
+}
+
+static void pyb_cansig_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
+{
+    pyb_cansig_obj_t *self = self_in;
+
+    if (!self->active) {
+        mp_printf(print, "CANSignals()");
+        return;
+    }
+
+    mp_printf(print, "CANSignals(signals=%u, frames=%u, consume=%q)",
+              (unsigned int)self->table.u32NumSignals,
+              (unsigned int)self->table.u32Frames,
+              self->table.bConsume ? MP_QSTR_True : MP_QSTR_False);
+}
+
+static uint32_t cansig_key(mp_obj_t id_in, bool extid)
+{
+    mp_uint_t id = mp_obj_get_int_truncated(id_in);
+
+    if (id > (extid ? 0x1FFFFFFF : 0x7FF)) {
+        mp_raise_ValueError("invalid CAN ID");
+    }
+
+    return id | (extid ? CANSIG_KEY_EXTID : 0);
+}
+
+/// \method decode(id, data, *, extid=False)
+/// Decode a frame received by other means, e.g. CAN.recv().
+///
+/// Return value: number of changed values.
+static mp_obj_t pyb_cansig_decode(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    enum { ARG_id, ARG_data, ARG_extid };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_id,    MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_data,  MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_extid, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false} },
+    };
+
+    pyb_cansig_obj_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    cansig_check_active(self);
+
+    uint32_t key = cansig_key(args[ARG_id].u_obj, args[ARG_extid].u_bool);
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[ARG_data].u_obj, &bufinfo, MP_BUFFER_READ);
+
+    if (bufinfo.len > 64) {
+        mp_raise_ValueError("CAN data field too long");
+    }
+
+    CANFD_FD_MSG_T msg;
+
+    msg.eIdType = (key & CANSIG_KEY_EXTID) ? eCANFD_XID : eCANFD_SID;
+    msg.eFrmType = eCANFD_DATA_FRM;
+    msg.u32Id = key & ~CANSIG_KEY_EXTID;
+    msg.u32DLC = bufinfo.len;
+    memcpy(msg.au8Data, bufinfo.buf, bufinfo.len);
+
+    // The CAN interrupt may decode into the same table
+    mp_uint_t irq_state = disable_irq();
+    uint32_t changed = CANSIG_Decode(&self->table, &msg);
+    enable_irq(irq_state);
+
+    return MP_OBJ_NEW_SMALL_INT(changed);
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_cansig_decode_obj, 3, pyb_cansig_decode);
+
+/// \method encode(id, buf=None, *, extid=False)
+/// Write the values of the signals of frame `id` into `buf`, other bits of
+/// `buf` are kept. Values are rounded and saturated to the signal range.
+///
+/// Return value: `buf`, or a new bytearray of the shortest CAN data length
+/// holding the signals when `buf` is None.
+static mp_obj_t pyb_cansig_encode(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    enum { ARG_id, ARG_buf, ARG_extid };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_id,    MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_buf,   MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_extid, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false} },
+    };
+
+    pyb_cansig_obj_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    cansig_check_active(self);
+
+    uint32_t key = cansig_key(args[ARG_id].u_obj, args[ARG_extid].u_bool);
+    uint32_t len = CANSIG_FrameLen(&self->table, key);
+    mp_obj_t buf = args[ARG_buf].u_obj;
+
+    if (len == 0) {
+        mp_raise_ValueError("no signal in this frame");
+    }
+
+    if (buf == mp_const_none) {
+        static const uint8_t fd_len[] = {12, 16, 20, 24, 32, 48, 64};
+
+        for (size_t i = 0; (len > 8) && (i < MP_ARRAY_SIZE(fd_len)); i++) {
+            if (len <= fd_len[i]) {
+                len = fd_len[i];
+                break;
+            }
+        }
+
+        byte *data = m_new0(byte, len);
+        buf = mp_obj_new_bytearray_by_ref(len, data);
+    }
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(buf, &bufinfo, MP_BUFFER_RW);
+
+    if (CANSIG_Encode(&self->table, key, bufinfo.buf, bufinfo.len) != 0) {
+        mp_raise_ValueError("buf too small");
+    }
+
+    return buf;
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_cansig_encode_obj, 2, pyb_cansig_encode);
+
+/// \method changed()
+/// Return the list of the value indices changed since the last call.
+static mp_obj_t pyb_cansig_changed(mp_obj_t self_in)
+{
+    pyb_cansig_obj_t *self = self_in;
+
+    cansig_check_active(self);
+
+    size_t words = (self->table.u32NumSignals + 31) / 32;
+    uint32_t *bitmap = m_new(uint32_t, words);
+    mp_obj_t list = mp_obj_new_list(0, NULL);
+
+    CANSIG_TakeChanged(&self->table, bitmap, words);
+
+    for (size_t w = 0; w < words; w++) {
+        uint32_t bits = bitmap[w];
+
+        while (bits) {
+            uint32_t bit = __builtin_ctz(bits);
+            mp_obj_list_append(list, MP_OBJ_NEW_SMALL_INT(w * 32 + bit));
+            bits &= bits - 1;
+        }
+    }
+
+    m_del(uint32_t, bitmap, words);
+    return list;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_cansig_changed_obj, pyb_cansig_changed);
+
+/// \method callback(fun)
+/// Schedule `fun(cansignals)` after received frames changed values, None to
+/// remove it. Changes made before the call runs are reported once.
+static mp_obj_t pyb_cansig_callback(mp_obj_t self_in, mp_obj_t callback_in)
+{
+    pyb_cansig_obj_t *self = self_in;
+
+    cansig_check_active(self);
+
+    if (callback_in == mp_const_none) {
+        MP_STATE_PORT(pyb_cansig_callback)[cansig_index(self)] = MP_OBJ_NULL;
+    } else if (mp_obj_is_callable(callback_in)) {
+        MP_STATE_PORT(pyb_cansig_callback)[cansig_index(self)] = callback_in;
+    } else {
+        mp_raise_ValueError("callback must be None or a callable object");
+    }
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_2(pyb_cansig_callback_obj, pyb_cansig_callback);
+
+/// \method deinit()
+/// Stop decoding, the frames go to the CAN receive path again.
+static mp_obj_t pyb_cansig_deinit(mp_obj_t self_in)
+{
+    cansig_close(self_in);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_cansig_deinit_obj, pyb_cansig_deinit);
+
+static const mp_rom_map_elem_t pyb_cansig_locals_dict_table[] = {
+    // instance methods
+    { MP_ROM_QSTR(MP_QSTR_decode), MP_ROM_PTR(&pyb_cansig_decode_obj) },
+    { MP_ROM_QSTR(MP_QSTR_encode), MP_ROM_PTR(&pyb_cansig_encode_obj) },
+    { MP_ROM_QSTR(MP_QSTR_changed), MP_ROM_PTR(&pyb_cansig_changed_obj) },
+    { MP_ROM_QSTR(MP_QSTR_callback), MP_ROM_PTR(&pyb_cansig_callback_obj) },
+    { MP_ROM_QSTR(MP_QSTR_deinit), MP_ROM_PTR(&pyb_cansig_deinit_obj) },
+
+    // class constants
+    { MP_ROM_QSTR(MP_QSTR_LITTLE_ENDIAN), MP_ROM_INT(0) },
+    { MP_ROM_QSTR(MP_QSTR_BIG_ENDIAN), MP_ROM_INT(CANSIG_BIG_ENDIAN) },
+    { MP_ROM_QSTR(MP_QSTR_SIGNED), MP_ROM_INT(CANSIG_SIGNED) },
+    { MP_ROM_QSTR(MP_QSTR_EXTID), MP_ROM_INT(CANSIG_EXTID) },
+};
+
+static MP_DEFINE_CONST_DICT(pyb_cansig_locals_dict, pyb_cansig_locals_dict_table);
+
+MP_DEFINE_CONST_OBJ_TYPE(
+    machine_cansignals_type,
+    MP_QSTR_CANSignals,
+    MP_TYPE_FLAG_NONE,
+    make_new, pyb_cansig_make_new,
+    print, pyb_cansig_print,
+    locals_dict, &pyb_cansig_locals_dict
+);
+
+#endif
@@ -0,0 +1,290 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2013, 2014 Damien P. George
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "py/runtime.h"
+#include "py/gc.h"
+#include "py/mphal.h"
+
+#include "classCounter.h"
+#include "hal/M55M1_Timer.h"
+
+/// \moduleref machine
+/// \class Counter - hardware pulse counter and frequency meter
+///
+/// Counter(id) counts the edges on the TMx pin of Timer(id), id 0~3. The
+/// partner timer of the pair (0/1, 2/3) is used as gate and reference clock,
+/// so both timers are taken from machine.Timer while a Counter is in use.
+///
+///     c = machine.Counter(0, pin)
+///     c.freq(100)         # gated frequency, 100ms gate
+///     c.period(1000)      # average period (us) over 1000 edges
+///     c.count()           # raw edge count
+
+#define M55M1_MAX_COUNTER_INST 4
+
+typedef struct _pyb_counter_obj_t {
+    mp_obj_base_t base;
+    uint8_t counter_id;
+    bool enabled;
+    hw_timer_t *counter_obj;
+    hw_timer_t *gate_obj;
+} pyb_counter_obj_t;
+
+static hw_timer_t s_sCounter0Obj = {.u_timer.timer = TIMER0, .bLPTimer = false};
+static hw_timer_t s_sCounter1Obj = {.u_timer.timer = TIMER1, .bLPTimer = false};
+static hw_timer_t s_sCounter2Obj = {.u_timer.timer = TIMER2, .bLPTimer = false};
+static hw_timer_t s_sCounter3Obj = {.u_timer.timer = TIMER3, .bLPTimer = false};
+
+static pyb_counter_obj_t pyb_counter_obj[M55M1_MAX_COUNTER_INST] = {
+    {{&machine_counter_type}, 0, false, &s_sCounter0Obj, &s_sCounter1Obj},
+    {{&machine_counter_type}, 1, false, &s_sCounter1Obj, &s_sCounter0Obj},
+    {{&machine_counter_type}, 2, false, &s_sCounter2Obj, &s_sCounter3Obj},
+    {{&machine_counter_type}, 3, false, &s_sCounter3Obj, &s_sCounter2Obj},
+};
+
+static pyb_counter_obj_t *counter_get_enabled(mp_obj_t self_in)
+{
+    pyb_counter_obj_t *self = self_in;
+
+    if (!self->enabled) {
+        mp_raise_ValueError("Counter not initialised");
+    }
+    return self;
+}
+
+// Wait for the end of gate/last edge interrupt, stop the meter on exception
+static void counter_wait_result(pyb_counter_obj_t *self, uint32_t *pu32Edges, uint64_t *pu64Ticks)
+{
+    nlr_buf_t nlr;
+
+    if (nlr_push(&nlr) == 0) {
+        while (!Timer_MeterResult(self->counter_obj, pu32Edges, pu64Ticks)) {
+            MICROPY_EVENT_POLL_HOOK
+        }
+        nlr_pop();
+    } else {
+        Timer_CounterReset(self->counter_obj);
+        nlr_jump(nlr.ret_val);
+    }
+}
+
+static mp_obj_t pyb_counter_init_helper(pyb_counter_obj_t *self, size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_pin,  MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_edge, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = TIMER_COUNTER_EVENT_RISING} },
+    };
+
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    mp_obj_t pin_obj = args[0].u_obj;
+    if (!MP_OBJ_IS_TYPE(pin_obj, &pin_type)) {
+        mp_raise_ValueError("pin argument needs to be be a Pin type");
+    }
+
+    const pin_obj_t *pin = pin_obj;
+    const pin_af_obj_t *af = pin_find_af(pin, AF_FN_TM, self->counter_id);
+
+    if ((af == NULL) || (af->type != AF_PIN_TYPE_TM_TM)) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "Pin(%q) doesn't have an af for Counter(%d)", pin->name, self->counter_id));
+    }
+
+    if ((args[1].u_int != TIMER_COUNTER_EVENT_RISING) && (args[1].u_int != TIMER_COUNTER_EVENT_FALLING)) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "invalid edge (%d)", args[1].u_int));
+    }
+
+    mp_hal_pin_config_alt(pin, MP_HAL_PIN_MODE_ALT_PUSH_PULL, AF_FN_TM, self->counter_id);
+
+    Timer_InitTypeDef timerInit;
+
+    timerInit.u32Mode = TIMER_PERIODIC_MODE;
+    timerInit.u32Prescaler = 0;
+    timerInit.u32Period = 0xFFFFFF;
+
+    Timer_Init(self->counter_obj, &timerInit);
+    Timer_Init(self->gate_obj, &timerInit);
+
+    if (Timer_CounterStart(self->counter_obj, self->gate_obj, args[1].u_int) < 0) {
+        mp_raise_ValueError("Unable to start counter");
+    }
+
+    self->enabled = true;
+    return mp_const_none;
+}
+
+/// \classmethod \constructor(id, pin, *, edge=Counter.RISING)
+static mp_obj_t pyb_counter_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args)
+{
+    mp_arg_check_num(n_args, n_kw, 1, MP_OBJ_FUN_ARGS_MAX, true);
+
+    mp_int_t counter_id = mp_obj_get_int(args[0]);
+
+    if (counter_id < 0 || counter_id >= M55M1_MAX_COUNTER_INST) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "Counter(%d) doesn't exist", counter_id));
+    }
+
+    pyb_counter_obj_t *self = &pyb_counter_obj[counter_id];
+
+    if (n_args > 1 || n_kw > 0) {
+        mp_map_t kw_args;
+        mp_map_init_fixed_table(&kw_args, n_kw, args + n_args);
+        pyb_counter_init_helper(self, n_args - 1, args + 1, &kw_args);
+    }
+
+    return (mp_obj_t)self;
+}
+
+static void pyb_counter_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
+{
+    pyb_counter_obj_t *self = self_in;
+
+    mp_printf(print, "Counter(%u)", self->counter_id);
+}
+
+static mp_obj_t pyb_counter_init(size_t n_args, const mp_obj_t *args, mp_map_t *kw_args)
+{
+    return pyb_counter_init_helper(args[0], n_args - 1, args + 1, kw_args);
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_counter_init_obj, 1, pyb_counter_init);
+
+/// \method deinit()
+static mp_obj_t pyb_counter_deinit(mp_obj_t self_in)
+{
+    pyb_counter_obj_t *self = self_in;
+
+    if (self->enabled) {
+        Timer_CounterStop(self->counter_obj);
+        Timer_Final(self->counter_obj);
+        Timer_Final(self->gate_obj);
+        self->enabled = false;
+    }
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_counter_deinit_obj, pyb_counter_deinit);
+
+/// \method count()
+///
+/// Return the number of edges counted since init, reset() or the last
+/// freq()/period() measurement.
+static mp_obj_t pyb_counter_count(mp_obj_t self_in)
+{
+    pyb_counter_obj_t *self = counter_get_enabled(self_in);
+
+    return mp_obj_new_int_from_ull(Timer_CounterRead(self->counter_obj));
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_counter_count_obj, pyb_counter_count);
+
+/// \method reset()
+static mp_obj_t pyb_counter_reset(mp_obj_t self_in)
+{
+    pyb_counter_obj_t *self = counter_get_enabled(self_in);
+
+    Timer_CounterReset(self->counter_obj);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_counter_reset_obj, pyb_counter_reset);
+
+/// \method freq(gate_ms=100)
+///
+/// Count edges during a hardware gate of `gate_ms` milliseconds and return
+/// the input frequency in Hz. Best for fast signals. The gate is limited to
+/// 2^32 clocks of the reference timer, ValueError is raised beyond.
+static mp_obj_t pyb_counter_freq(size_t n_args, const mp_obj_t *args)
+{
+    pyb_counter_obj_t *self = counter_get_enabled(args[0]);
+    mp_int_t gate_ms = (n_args > 1) ? mp_obj_get_int(args[1]) : 100;
+    uint32_t u32Clk = Timer_GetModuleClock(self->gate_obj);
+    uint32_t u32Edges;
+    uint64_t u64Ticks = (gate_ms > 0) ? (uint64_t)u32Clk * gate_ms / 1000 : 0;
+
+    // The gate is programmed in 32 bits of module clocks (24 bits CMPDAT, 8 bits prescaler)
+    if ((u64Ticks == 0) || (u64Ticks > UINT32_MAX) || (Timer_MeterGate(self->counter_obj, (uint32_t)u64Ticks) < 0)) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "invalid gate time (%d)", gate_ms));
+    }
+
+    counter_wait_result(self, &u32Edges, &u64Ticks);
+    Timer_CounterReset(self->counter_obj);
+
+    return mp_obj_new_float((mp_float_t)u32Edges * u32Clk / u64Ticks);
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(pyb_counter_freq_obj, 1, 2, pyb_counter_freq);
+
+/// \method period(edges=16)
+///
+/// Measure the reference clock elapsed during `edges` input edges and return
+/// the average period in microseconds. Best for slow signals.
+static mp_obj_t pyb_counter_period(size_t n_args, const mp_obj_t *args)
+{
+    pyb_counter_obj_t *self = counter_get_enabled(args[0]);
+    mp_int_t edges = (n_args > 1) ? mp_obj_get_int(args[1]) : 16;
+    uint32_t u32Clk = Timer_GetModuleClock(self->gate_obj);
+    uint32_t u32Edges;
+    uint64_t u64Ticks;
+
+    if ((edges <= 0) || (Timer_MeterPeriod(self->counter_obj, edges) < 0)) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "invalid edge count (%d)", edges));
+    }
+
+    counter_wait_result(self, &u32Edges, &u64Ticks);
+    Timer_CounterReset(self->counter_obj);
+
+    if (u32Edges == 0) {
+        return mp_obj_new_float(0);
+    }
+
+    return mp_obj_new_float((mp_float_t)u64Ticks * 1000000 / u32Clk / u32Edges);
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(pyb_counter_period_obj, 1, 2, pyb_counter_period);
+
+static const mp_rom_map_elem_t pyb_counter_locals_dict_table[] = {
+    // instance methods
+    { MP_ROM_QSTR(MP_QSTR_init), MP_ROM_PTR(&pyb_counter_init_obj) },
+    { MP_ROM_QSTR(MP_QSTR_deinit), MP_ROM_PTR(&pyb_counter_deinit_obj) },
+    { MP_ROM_QSTR(MP_QSTR_count), MP_ROM_PTR(&pyb_counter_count_obj) },
+    { MP_ROM_QSTR(MP_QSTR_reset), MP_ROM_PTR(&pyb_counter_reset_obj) },
+    { MP_ROM_QSTR(MP_QSTR_freq), MP_ROM_PTR(&pyb_counter_freq_obj) },
+    { MP_ROM_QSTR(MP_QSTR_period), MP_ROM_PTR(&pyb_counter_period_obj) },
+
+    // class constants
+    { MP_ROM_QSTR(MP_QSTR_RISING), MP_ROM_INT(TIMER_COUNTER_EVENT_RISING) },
+    { MP_ROM_QSTR(MP_QSTR_FALLING), MP_ROM_INT(TIMER_COUNTER_EVENT_FALLING) },
+};
+static MP_DEFINE_CONST_DICT(pyb_counter_locals_dict, pyb_counter_locals_dict_table);
+
+MP_DEFINE_CONST_OBJ_TYPE(
+    machine_counter_type,
+    MP_QSTR_Counter,
+    MP_TYPE_FLAG_NONE,
+    make_new, pyb_counter_make_new,
+    print, pyb_counter_print,
+    locals_dict, &pyb_counter_locals_dict
+);
@@ -43,7 +43,8 @@
 
 enum {
     DMA_NORMAL,
-    DMA_CIRCULAR
+    DMA_CIRCULAR,
+    DMA_PINGPONG
 };
 
 typedef enum {
@@ -61,6 +62,7 @@ typedef struct _pyb_dac_obj_t {
     pyb_dac_state_t state;
     uint32_t dma_trans_len;
     mp_obj_t timer_obj;
+    TIMER_T *timer;
 } pyb_dac_obj_t;
 
 
@@ -83,6 +85,9 @@ static pyb_dac_obj_t pyb_dac_obj[M55M1_MAX_DAC_INST] = {
 #endif
 };
 
+// (buffer, callback) tuple of ping-pong mode, keeps them alive while PDMA plays the buffer
+MP_REGISTER_ROOT_POINTER(mp_obj_t pyb_dac_pingpong_objs[M55M1_MAX_DAC_INST]);
+
 static void switch_pinfun(const pyb_dac_obj_t *self, bool bDAC)
 {
 
@@ -297,12 +302,63 @@ static mp_obj_t pyb_dac_write(mp_obj_t self_in, mp_obj_t val)
 static MP_DEFINE_CONST_FUN_OBJ_2(pyb_dac_write_obj, pyb_dac_write);
 
 
+// Scheduled from the PDMA ISR with (dac_id << 1 | half), the half is given
+// back to PDMA once the Python callback has refilled it.
+static mp_obj_t pyb_dac_pingpong_dispatch(mp_obj_t arg_in)
+{
+    uint32_t arg = MP_OBJ_SMALL_INT_VALUE(arg_in);
+    pyb_dac_obj_t *self = &pyb_dac_obj[arg >> 1];
+    mp_obj_t pingpong = MP_STATE_PORT(pyb_dac_pingpong_objs)[self->dac_id];
+
+    if (pingpong == MP_OBJ_NULL) {
+        return mp_const_none;
+    }
+
+    mp_obj_t *items;
+    mp_obj_tuple_get(pingpong, NULL, &items);
+
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        mp_call_function_1(items[1], MP_OBJ_NEW_SMALL_INT(arg & 1));
+        nlr_pop();
+    } else {
+        DAC_PingPongRelease(self->dac_obj, arg & 1);
+        nlr_jump(nlr.ret_val);
+    }
+
+    DAC_PingPongRelease(self->dac_obj, arg & 1);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_dac_pingpong_dispatch_obj, pyb_dac_pingpong_dispatch);
+
+// Called from PDMA ISR, a full scheduler queue is counted as an underrun by the HAL
+static bool pyb_dac_pingpong_refill(void *pvUserData, uint32_t u32Half)
+{
+    pyb_dac_obj_t *self = pvUserData;
+    return mp_sched_schedule(MP_OBJ_FROM_PTR(&pyb_dac_pingpong_dispatch_obj), MP_OBJ_NEW_SMALL_INT((self->dac_id << 1) | u32Half));
+}
+
+/// \method write_timed(data, freq, *, mode=DAC.NORMAL, callback=None)
+/// Initiates a burst of RAM to DAC using a DMA transfer.
+/// The input data is treated as an array of bytes in 8-bit mode, and
+/// an array of unsigned half-words (array typecode 'H') in 12-bit mode.
+///
+/// `freq` can be an integer specifying the frequency to write the DAC
+/// samples at, using Timer(3).  Or it can be an already-initialised
+/// Timer object which is used to trigger the DAC sample.
+///
+/// `mode` can be `DAC.NORMAL`, `DAC.CIRCULAR` or `DAC.PINGPONG`. In
+/// ping-pong mode the two halves of `data` are played in turn and
+/// `callback` is scheduled with the index (0 or 1) of the half that has
+/// just been played, it refills that half while the other one plays.
+/// A half not refilled in time is played again, see `underrun()`.
 static mp_obj_t pyb_dac_write_timed(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
 {
     static const mp_arg_t allowed_args[] = {
         { MP_QSTR_data, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
         { MP_QSTR_freq, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
         { MP_QSTR_mode, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = DMA_NORMAL} },
+        { MP_QSTR_callback, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
     };
 
     // parse args
@@ -314,6 +370,10 @@ static mp_obj_t pyb_dac_write_timed(size_t n_args, const mp_obj_t *pos_args, mp_
     mp_buffer_info_t bufinfo;
     mp_get_buffer_raise(args[0].u_obj, &bufinfo, MP_BUFFER_READ);
 
+    if ((args[2].u_int == DMA_PINGPONG) && !mp_obj_is_callable(args[3].u_obj)) {
+        mp_raise_ValueError("PINGPONG mode needs a callback");
+    }
+
     uint32_t dac_trigger = DAC_TIMER3_TRIGGER;
     TIMER_T *timer = NULL;
 
@@ -324,6 +384,7 @@ static mp_obj_t pyb_dac_write_timed(size_t n_args, const mp_obj_t *pos_args, mp_
     } else {
         // set the supplied timer to trigger the DAC (timer should be initialised)
         timer = TIMx_Config(args[1].u_obj, &dac_trigger);
+        self->timer_obj = mp_const_none;
     }
 
     if(timer == NULL) {
@@ -334,15 +395,43 @@ static mp_obj_t pyb_dac_write_timed(size_t n_args, const mp_obj_t *pos_args, mp_
         DAC_Final(self->dac_obj);
     }
 
-    DAC_TimerPDMAConv(
-        self->dac_obj,
-        timer,
-        dac_trigger,
-        self->eBitWidth,
-        bufinfo.buf,
-        bufinfo.len,
-        (args[2].u_int == DMA_CIRCULAR)
-    );
+    MP_STATE_PORT(pyb_dac_pingpong_objs)[self->dac_id] = MP_OBJ_NULL;
+
+    int32_t ret;
+
+    if (args[2].u_int == DMA_PINGPONG) {
+        mp_obj_t items[2] = {args[0].u_obj, args[3].u_obj};
+        MP_STATE_PORT(pyb_dac_pingpong_objs)[self->dac_id] = mp_obj_new_tuple(2, items);
+
+        ret = DAC_TimerPDMAPingPong(
+                  self->dac_obj,
+                  timer,
+                  dac_trigger,
+                  self->eBitWidth,
+                  bufinfo.buf,
+                  bufinfo.len,
+                  pyb_dac_pingpong_refill,
+                  self
+              );
+    } else {
+        ret = DAC_TimerPDMAConv(
+                  self->dac_obj,
+                  timer,
+                  dac_trigger,
+                  self->eBitWidth,
+                  bufinfo.buf,
+                  bufinfo.len,
+                  (args[2].u_int == DMA_CIRCULAR)
+              );
+    }
+
+    if (ret != 0) {
+        MP_STATE_PORT(pyb_dac_pingpong_objs)[self->dac_id] = MP_OBJ_NULL;
+        mp_hal_raise(HAL_ERROR);
+    }
+
+    self->timer = timer;
+    self->state = DAC_STATE_DMA_WAVEFORM;
 
     return mp_const_none;
 }
@@ -358,7 +447,8 @@ static mp_obj_t pyb_dac_deinit(mp_obj_t self_in)
     //Close PDMA, if enable dma wavefrom
     if(self->state == DAC_STATE_DMA_WAVEFORM) {
 
-        DAC_StopTimerPDMAConv(self->dac_obj, pyb_timer_get_handle(self->timer_obj));
+        DAC_StopTimerPDMAConv(self->dac_obj, self->timer);
+        MP_STATE_PORT(pyb_dac_pingpong_objs)[self->dac_id] = MP_OBJ_NULL;
 
         //deinit timer
         if(self->timer_obj != mp_const_none) {
@@ -380,6 +470,16 @@ static mp_obj_t pyb_dac_deinit(mp_obj_t self_in)
 }
 static MP_DEFINE_CONST_FUN_OBJ_1(pyb_dac_deinit_obj, pyb_dac_deinit);
 
+/// \method underrun()
+/// Return the number of ping-pong halves played again because the callback
+/// did not refill them in time.
+static mp_obj_t pyb_dac_underrun(mp_obj_t self_in)
+{
+    pyb_dac_obj_t *self = self_in;
+    return mp_obj_new_int_from_uint(DAC_PingPongUnderrun(self->dac_obj));
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_dac_underrun_obj, pyb_dac_underrun);
+
 
 static const mp_rom_map_elem_t pyb_dac_locals_dict_table[] = {
     // instance methods
@@ -387,10 +487,12 @@ static const mp_rom_map_elem_t pyb_dac_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_write), MP_ROM_PTR(&pyb_dac_write_obj) },
     { MP_ROM_QSTR(MP_QSTR_write_timed), MP_ROM_PTR(&pyb_dac_write_timed_obj) },
     { MP_ROM_QSTR(MP_QSTR_deinit), MP_ROM_PTR(&pyb_dac_deinit_obj) },
+    { MP_ROM_QSTR(MP_QSTR_underrun), MP_ROM_PTR(&pyb_dac_underrun_obj) },
 
     // class constants
     { MP_ROM_QSTR(MP_QSTR_NORMAL), MP_ROM_INT(DMA_NORMAL) },
     { MP_ROM_QSTR(MP_QSTR_CIRCULAR), MP_ROM_INT(DMA_CIRCULAR) },
+    { MP_ROM_QSTR(MP_QSTR_PINGPONG), MP_ROM_INT(DMA_PINGPONG) },
 
 };
 
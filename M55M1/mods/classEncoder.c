@@ -0,0 +1,292 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2013, 2014 Damien P. George
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "py/runtime.h"
+#include "py/gc.h"
+#include "py/mphal.h"
+
+#include "classEncoder.h"
+#include "hal/M55M1_EQEI.h"
+
+/// \moduleref machine
+/// \class Encoder - hardware quadrature encoder interface
+///
+/// Encoder(id, pin_a, pin_b, index=None) decodes a quadrature encoder with
+/// the EQEI unit `id` (0~3). Counting is done by hardware, reading the
+/// position is a single register access.
+///
+///     enc = machine.Encoder(0, pin_a, pin_b)
+///     enc.position()      # signed position in counts
+///     enc.direction()     # 1 or -1
+
+#define M55M1_MAX_ENCODER_INST 4
+
+typedef struct _pyb_encoder_obj_t {
+    mp_obj_base_t base;
+    uint8_t encoder_id;
+    bool enabled;
+    bool has_index;
+    eqei_t *eqei_obj;
+} pyb_encoder_obj_t;
+
+static eqei_t s_sEQEI0Obj = {.eqei = EQEI0};
+static eqei_t s_sEQEI1Obj = {.eqei = EQEI1};
+static eqei_t s_sEQEI2Obj = {.eqei = EQEI2};
+static eqei_t s_sEQEI3Obj = {.eqei = EQEI3};
+
+static pyb_encoder_obj_t pyb_encoder_obj[M55M1_MAX_ENCODER_INST] = {
+    {{&machine_encoder_type}, 0, false, false, &s_sEQEI0Obj},
+    {{&machine_encoder_type}, 1, false, false, &s_sEQEI1Obj},
+    {{&machine_encoder_type}, 2, false, false, &s_sEQEI2Obj},
+    {{&machine_encoder_type}, 3, false, false, &s_sEQEI3Obj},
+};
+
+static pyb_encoder_obj_t *encoder_get_enabled(mp_obj_t self_in)
+{
+    pyb_encoder_obj_t *self = self_in;
+
+    if (!self->enabled) {
+        mp_raise_ValueError("Encoder not initialised");
+    }
+    return self;
+}
+
+static void encoder_config_pin(pyb_encoder_obj_t *self, mp_obj_t pin_obj, uint32_t af_type)
+{
+    if (!MP_OBJ_IS_TYPE(pin_obj, &pin_type)) {
+        mp_raise_ValueError("pin argument needs to be be a Pin type");
+    }
+
+    const pin_obj_t *pin = pin_obj;
+    const pin_af_obj_t *af = pin_find_af(pin, AF_FN_EQEI, self->encoder_id);
+
+    if ((af == NULL) || (af->type != af_type)) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "Pin(%q) doesn't have an af for Encoder(%d)", pin->name, self->encoder_id));
+    }
+
+    mp_hal_pin_config_alt(pin, MP_HAL_PIN_MODE_ALT_PUSH_PULL, AF_FN_EQEI, self->encoder_id);
+}
+
+static mp_obj_t pyb_encoder_init_helper(pyb_encoder_obj_t *self, size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_pin_a, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_pin_b, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_index, MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_mode,  MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = EQEI_CTL_X4_FREE_COUNTING_MODE} },
+        { MP_QSTR_max,   MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0} },
+        { MP_QSTR_speed_ms, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 10} },
+    };
+
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    if ((args[3].u_int != EQEI_CTL_X4_FREE_COUNTING_MODE) && (args[3].u_int != EQEI_CTL_X2_FREE_COUNTING_MODE)) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "invalid mode (%d)", args[3].u_int));
+    }
+
+    if ((args[5].u_int < 1) || (args[5].u_int > 1000)) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "invalid speed window (%d)", args[5].u_int));
+    }
+
+    encoder_config_pin(self, args[0].u_obj, AF_PIN_TYPE_EQEI_A);
+    encoder_config_pin(self, args[1].u_obj, AF_PIN_TYPE_EQEI_B);
+
+    self->has_index = (args[2].u_obj != mp_const_none);
+    if (self->has_index) {
+        encoder_config_pin(self, args[2].u_obj, AF_PIN_TYPE_EQEI_INDEX);
+    }
+
+    EQEI_InitTypeDef eqeiInit;
+
+    eqeiInit.u32Mode = args[3].u_int;
+    eqeiInit.u32MaxCount = 0xFFFFFFFF;
+    eqeiInit.bIndexLatch = self->has_index;
+    eqeiInit.u32SpeedWindowUs = args[5].u_int * 1000;
+
+    // max > 0: position wraps in 0 ~ max
+    if (args[4].u_int > 0) {
+        eqeiInit.u32MaxCount = args[4].u_int;
+        if (eqeiInit.u32Mode == EQEI_CTL_X4_FREE_COUNTING_MODE) {
+            eqeiInit.u32Mode = EQEI_CTL_X4_COMPARE_COUNTING_MODE;
+        } else {
+            eqeiInit.u32Mode = EQEI_CTL_X2_COMPARE_COUNTING_MODE;
+        }
+    }
+
+    if (EQEI_Init(self->eqei_obj, &eqeiInit) < 0) {
+        mp_raise_ValueError("Unable to init encoder");
+    }
+
+    self->enabled = true;
+
+    return mp_const_none;
+}
+
+/// \classmethod \constructor(id, pin_a, pin_b, index=None, *, mode=Encoder.X4, max=0, speed_ms=10)
+///
+/// `speed_ms` (1~1000) is the window of the hardware speed capture, see speed().
+static mp_obj_t pyb_encoder_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args)
+{
+    mp_arg_check_num(n_args, n_kw, 1, MP_OBJ_FUN_ARGS_MAX, true);
+
+    mp_int_t encoder_id = mp_obj_get_int(args[0]);
+
+    if (encoder_id < 0 || encoder_id >= M55M1_MAX_ENCODER_INST) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "Encoder(%d) doesn't exist", encoder_id));
+    }
+
+    pyb_encoder_obj_t *self = &pyb_encoder_obj[encoder_id];
+
+    if (n_args > 1 || n_kw > 0) {
+        mp_map_t kw_args;
+        mp_map_init_fixed_table(&kw_args, n_kw, args + n_args);
+        pyb_encoder_init_helper(self, n_args - 1, args + 1, &kw_args);
+    }
+
+    return (mp_obj_t)self;
+}
+
+static void pyb_encoder_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
+{
+    pyb_encoder_obj_t *self = self_in;
+
+    mp_printf(print, "Encoder(%u)", self->encoder_id);
+}
+
+static mp_obj_t pyb_encoder_init(size_t n_args, const mp_obj_t *args, mp_map_t *kw_args)
+{
+    return pyb_encoder_init_helper(args[0], n_args - 1, args + 1, kw_args);
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_encoder_init_obj, 1, pyb_encoder_init);
+
+/// \method deinit()
+static mp_obj_t pyb_encoder_deinit(mp_obj_t self_in)
+{
+    pyb_encoder_obj_t *self = self_in;
+
+    if (self->enabled) {
+        EQEI_Final(self->eqei_obj);
+        self->enabled = false;
+    }
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_encoder_deinit_obj, pyb_encoder_deinit);
+
+/// \method position([value])
+///
+/// Get or set the position counter.
+static mp_obj_t pyb_encoder_position(size_t n_args, const mp_obj_t *args)
+{
+    pyb_encoder_obj_t *self = encoder_get_enabled(args[0]);
+
+    if (n_args == 1) {
+        // get
+        return mp_obj_new_int((int32_t)EQEI_GET_CNT_VALUE(self->eqei_obj->eqei));
+    }
+
+    // set
+    EQEI_SetPosition(self->eqei_obj, (uint32_t)mp_obj_get_int(args[1]));
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(pyb_encoder_position_obj, 1, 2, pyb_encoder_position);
+
+/// \method direction()
+///
+/// Return 1 if the last count was forward, -1 if backward.
+static mp_obj_t pyb_encoder_direction(mp_obj_t self_in)
+{
+    pyb_encoder_obj_t *self = encoder_get_enabled(self_in);
+
+    return MP_OBJ_NEW_SMALL_INT(EQEI_GET_DIR(self->eqei_obj->eqei) ? 1 : -1);
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_encoder_direction_obj, pyb_encoder_direction);
+
+/// \method index()
+///
+/// Return the position latched by hardware on the last index pulse,
+/// None if the encoder has no index pin.
+static mp_obj_t pyb_encoder_index(mp_obj_t self_in)
+{
+    pyb_encoder_obj_t *self = encoder_get_enabled(self_in);
+
+    if (!self->has_index) {
+        return mp_const_none;
+    }
+
+    return mp_obj_new_int((int32_t)EQEI_GET_CNT_INDEX_LATCH_VALUE(self->eqei_obj->eqei));
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_encoder_index_obj, pyb_encoder_index);
+
+/// \method speed()
+///
+/// Return the speed in counts per second over the last `speed_ms` window.
+/// The EQEI unit timer holds the counter at the end of each window, so the
+/// result does not depend on when speed() is called. A wrap of the position
+/// (max > 0) is taken into account.
+static mp_obj_t pyb_encoder_speed(mp_obj_t self_in)
+{
+    pyb_encoder_obj_t *self = encoder_get_enabled(self_in);
+    uint32_t u32WindowUs;
+    int32_t i32Counts = EQEI_GetSpeed(self->eqei_obj, &u32WindowUs);
+
+    if (u32WindowUs == 0) {
+        return mp_obj_new_float(0);
+    }
+
+    return mp_obj_new_float((mp_float_t)i32Counts * 1000000 / u32WindowUs);
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_encoder_speed_obj, pyb_encoder_speed);
+
+static const mp_rom_map_elem_t pyb_encoder_locals_dict_table[] = {
+    // instance methods
+    { MP_ROM_QSTR(MP_QSTR_init), MP_ROM_PTR(&pyb_encoder_init_obj) },
+    { MP_ROM_QSTR(MP_QSTR_deinit), MP_ROM_PTR(&pyb_encoder_deinit_obj) },
+    { MP_ROM_QSTR(MP_QSTR_position), MP_ROM_PTR(&pyb_encoder_position_obj) },
+    { MP_ROM_QSTR(MP_QSTR_direction), MP_ROM_PTR(&pyb_encoder_direction_obj) },
+    { MP_ROM_QSTR(MP_QSTR_index), MP_ROM_PTR(&pyb_encoder_index_obj) },
+    { MP_ROM_QSTR(MP_QSTR_speed), MP_ROM_PTR(&pyb_encoder_speed_obj) },
+
+    // class constants
+    { MP_ROM_QSTR(MP_QSTR_X4), MP_ROM_INT(EQEI_CTL_X4_FREE_COUNTING_MODE) },
+    { MP_ROM_QSTR(MP_QSTR_X2), MP_ROM_INT(EQEI_CTL_X2_FREE_COUNTING_MODE) },
+};
+static MP_DEFINE_CONST_DICT(pyb_encoder_locals_dict, pyb_encoder_locals_dict_table);
+
+MP_DEFINE_CONST_OBJ_TYPE(
+    machine_encoder_type,
+    MP_QSTR_Encoder,
+    MP_TYPE_FLAG_NONE,
+    make_new, pyb_encoder_make_new,
+    print, pyb_encoder_print,
+    locals_dict, &pyb_encoder_locals_dict
+);
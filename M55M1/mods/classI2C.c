@@ -86,6 +86,13 @@
 ///     i2c.mem_write('abc', 0x42, 2, timeout=1000)
 ///                                  #   starting at address 2 in the slave
 ///     i2c.mem_write('abc', 0x42, 2, timeout=1000)
+///
+/// A slave can also present a register map to the master.  Register reads
+/// and writes are served by the interrupt handler straight from a bytearray:
+///
+///     regs = bytearray(32)
+///     i2c.init(I2C.SLAVE, addr=0x42)
+///     i2c.regmap(regs, callback=lambda reg: print(reg))
 
 
 typedef struct  {
@@ -93,6 +100,9 @@ typedef struct  {
     int32_t i2c_id;
     i2c_t *psI2CObj;
     I2C_InitTypeDef init;
+    I2C_REGMAP_PARAM regmap;
+    mp_obj_t regmap_callback;
+    const uint8_t *regmap_watch;	//Bitmap of registers reported to regmap_callback, NULL for all
 } pyb_i2c_obj_t;
 
 
@@ -155,6 +165,11 @@ static pyb_i2c_obj_t pyb_i2c_obj[] = {
 #endif
 };
 
+#define PYB_I2C_NUM_INST (5)
+
+// (buffer, callback, watch) tuple of register-map slave, keeps them alive while the ISR uses them
+MP_REGISTER_ROOT_POINTER(mp_obj_t pyb_i2c_regmap_objs[PYB_I2C_NUM_INST]);
+
 #define MICROPY_HW_I2C_BAUDRATE_DEFAULT (PYB_I2C_SPEED_STANDARD)
 #define MICROPY_HW_I2C_BAUDRATE_MAX (PYB_I2C_SPEED_FAST)
 
@@ -220,11 +235,24 @@ static void pyb_i2c_init(pyb_i2c_obj_t *self)
     }
 }
 
+static void pyb_i2c_regmap_stop(pyb_i2c_obj_t *self)
+{
+    if(self->regmap.pu8RegFile == NULL)
+        return;
+
+    I2C_SlaveRegMapStop(self->psI2CObj);
+    memset(&self->regmap, 0x0, sizeof(I2C_REGMAP_PARAM));
+    self->regmap_callback = MP_OBJ_NULL;
+    self->regmap_watch = NULL;
+    MP_STATE_PORT(pyb_i2c_regmap_objs)[self->i2c_id] = MP_OBJ_NULL;
+}
+
 static void pyb_i2c_deinit(pyb_i2c_obj_t *self)
 {
     const pin_obj_t *scl_pin;
     const pin_obj_t *sda_pin;
 
+    pyb_i2c_regmap_stop(self);
     I2C_Final(self->psI2CObj);
 
     if (0) {
@@ -711,6 +739,115 @@ static mp_obj_t pyb_i2c_mem_write(size_t n_args, const mp_obj_t *pos_args, mp_ma
 }
 static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_i2c_mem_write_obj, 1, pyb_i2c_mem_write);
 
+// Called from I2C ISR when the master has written registers and released the bus
+static void pyb_i2c_regmap_write_notify(void *pvUserData, uint32_t u32RegAddr, uint32_t u32Len)
+{
+    pyb_i2c_obj_t *self = pvUserData;
+    uint32_t u32Reg = u32RegAddr;
+
+    if(self->regmap_callback == MP_OBJ_NULL)
+        return;
+
+    if(u32Len > self->regmap.u32RegFileLen)
+        u32Len = self->regmap.u32RegFileLen;
+
+    // report every watched register of this write transaction, stop once the scheduler queue is full
+    while(u32Len --) {
+        if((self->regmap_watch == NULL) || (self->regmap_watch[u32Reg >> 3] & (1 << (u32Reg & 0x7)))) {
+            if(!mp_sched_schedule(self->regmap_callback, MP_OBJ_NEW_SMALL_INT(u32Reg)))
+                return;
+        }
+
+        u32Reg ++;
+        if(u32Reg >= self->regmap.u32RegFileLen)
+            u32Reg = 0;
+    }
+}
+
+/// \method regmap(buf, *, addr_size=8, callback=None, watch=None)
+///
+/// Serve the bus as a register-mapped slave device.  Only valid in slave mode.
+///
+///   - `buf` is a bytearray used as register file, `None` leaves register-map mode
+///   - `addr_size` selects width of register address sent by master: 8 or 16 bits
+///   - `callback` is scheduled with each written register address after
+///     a write transaction from the master, a burst write gives one call
+///     per register
+///   - `watch` is a bytes object with one bit per register, only writes that
+///     touch a set bit are reported to `callback`
+///
+/// Master reads and writes are answered in the interrupt handler, the register
+/// pointer auto-increments and wraps at the end of `buf`.
+static mp_obj_t pyb_i2c_regmap(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_buf,       MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_addr_size, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 8} },
+        { MP_QSTR_callback,  MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_watch,     MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+    };
+
+    // parse args
+    pyb_i2c_obj_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    if (in_master_mode(self)) {
+        mp_raise_TypeError("I2C must be a slave");
+    }
+
+    pyb_i2c_regmap_stop(self);
+
+    if (args[0].u_obj == mp_const_none) {
+        return mp_const_none;
+    }
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[0].u_obj, &bufinfo, MP_BUFFER_RW);
+
+    if (bufinfo.len == 0) {
+        mp_raise_ValueError("empty register file");
+    }
+
+    if ((args[1].u_int != 8) && (args[1].u_int != 16)) {
+        mp_raise_ValueError("addr_size must be 8 or 16");
+    }
+
+    if ((args[2].u_obj != mp_const_none) && !mp_obj_is_callable(args[2].u_obj)) {
+        mp_raise_ValueError("callback must be None or a callable object");
+    }
+
+    const uint8_t *watch = NULL;
+    if (args[3].u_obj != mp_const_none) {
+        mp_buffer_info_t watchinfo;
+        mp_get_buffer_raise(args[3].u_obj, &watchinfo, MP_BUFFER_READ);
+        if (watchinfo.len < ((bufinfo.len + 7) / 8)) {
+            mp_raise_ValueError("watch needs one bit per register");
+        }
+        watch = watchinfo.buf;
+    }
+
+    mp_obj_t items[3] = {args[0].u_obj, args[2].u_obj, args[3].u_obj};
+    MP_STATE_PORT(pyb_i2c_regmap_objs)[self->i2c_id] = mp_obj_new_tuple(3, items);
+
+    self->regmap_callback = (args[2].u_obj == mp_const_none) ? MP_OBJ_NULL : args[2].u_obj;
+    self->regmap_watch = watch;
+
+    self->regmap.u8AddrLen = (args[1].u_int == 8) ? 1 : 2;
+    self->regmap.pfnWriteNotify = pyb_i2c_regmap_write_notify;
+    self->regmap.pvUserData = self;
+    self->regmap.u32RegFileLen = bufinfo.len;
+    self->regmap.pu8RegFile = bufinfo.buf;
+
+    if (I2C_SlaveRegMapStart(self->psI2CObj, &self->regmap) != 0) {
+        pyb_i2c_regmap_stop(self);
+        mp_hal_raise(HAL_BUSY);
+    }
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_i2c_regmap_obj, 1, pyb_i2c_regmap);
+
 static const mp_rom_map_elem_t pyb_i2c_locals_dict_table[] = {
     // instance methods
     { MP_ROM_QSTR(MP_QSTR_init), MP_ROM_PTR(&pyb_i2c_init_obj) },
@@ -721,6 +858,7 @@ static const mp_rom_map_elem_t pyb_i2c_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_recv), MP_ROM_PTR(&pyb_i2c_recv_obj) },
     { MP_ROM_QSTR(MP_QSTR_mem_read), MP_ROM_PTR(&pyb_i2c_mem_read_obj) },
     { MP_ROM_QSTR(MP_QSTR_mem_write), MP_ROM_PTR(&pyb_i2c_mem_write_obj) },
+    { MP_ROM_QSTR(MP_QSTR_regmap), MP_ROM_PTR(&pyb_i2c_regmap_obj) },
 
     // class constants
     /// \constant MASTER - for initialising the bus to master mode
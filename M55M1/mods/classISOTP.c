@@ -0,0 +1,479 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2013, 2014 Damien P. George
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "py/runtime.h"
+#include "py/gc.h"
+#include "py/mphal.h"
+
+#include "classCAN.h"
+#include "classISOTP.h"
+#include "hal/M55M1_ISOTP.h"
+
+#if MICROPY_HW_ENABLE_CAN
+
+/// \moduleref machine
+/// \class ISOTP - ISO 15765-2 transport over CAN
+///
+/// ISOTP(can, txid, rxid) segments and reassembles messages of up to 4 GB
+/// on a CAN initialized with a send queue. First, consecutive and flow
+/// control frames are handled in the CAN interrupt, Python only sees whole
+/// messages.
+/// Other frames go to the CAN receive queue (init() with rxqueue), without
+/// one they are dropped and counted as rx_overrun in CAN.stats().
+///
+///     can = machine.CAN(0, machine.CAN.NORMAL, baudrate=500000, fd=True,
+///                       data_baudrate=2000000, txqueue=32)
+///     tp = machine.ISOTP(can, 0x7E0, 0x7E8)
+///     tp.send(request)
+///     response = tp.recv(timeout=1000)
+
+#define MAX_ISOTP_LINKS	4
+
+typedef struct _pyb_isotp_obj_t {
+    mp_obj_base_t base;
+    bool active;
+    mp_int_t timeout;			//N_Bs/N_Cr timeout in ms
+    isotp_link_t link;
+} pyb_isotp_obj_t;
+
+static pyb_isotp_obj_t pyb_isotp_obj[MAX_ISOTP_LINKS] = {
+    {{&machine_isotp_type}, false},
+    {{&machine_isotp_type}, false},
+    {{&machine_isotp_type}, false},
+    {{&machine_isotp_type}, false},
+};
+
+// CAN object, receive buffer and message being sent of each link, kept alive while the ISR uses them
+MP_REGISTER_ROOT_POINTER(mp_obj_t pyb_isotp_can[MAX_ISOTP_LINKS]);
+MP_REGISTER_ROOT_POINTER(void *pyb_isotp_rxbuf[MAX_ISOTP_LINKS]);
+MP_REGISTER_ROOT_POINTER(mp_obj_t pyb_isotp_txbuf[MAX_ISOTP_LINKS]);
+
+static size_t isotp_index(pyb_isotp_obj_t *self)
+{
+    return self - &pyb_isotp_obj[0];
+}
+
+static void isotp_close(pyb_isotp_obj_t *self)
+{
+    size_t idx = isotp_index(self);
+
+    if (self->active) {
+        ISOTP_Close(&self->link);
+        self->active = false;
+    }
+
+    MP_STATE_PORT(pyb_isotp_can)[idx] = MP_OBJ_NULL;
+    MP_STATE_PORT(pyb_isotp_rxbuf)[idx] = NULL;
+    MP_STATE_PORT(pyb_isotp_txbuf)[idx] = MP_OBJ_NULL;
+}
+
+static NORETURN void isotp_raise_state(const char *what, E_ISOTP_STATE state)
+{
+    const char *reason;
+
+    switch (state) {
+    case eISOTP_ERR_OVERFLOW:
+        reason = "overflow";
+        break;
+    case eISOTP_ERR_SEQUENCE:
+        reason = "wrong sequence number";
+        break;
+    case eISOTP_ERR_SEND:
+        reason = "send queue full";
+        break;
+    case eISOTP_ERR_FC:
+        reason = "invalid flow status";
+        break;
+    default:
+        reason = "timeout";
+        break;
+    }
+
+    nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_OSError, "ISO-TP %s: %s", what, reason));
+}
+
+/// \classmethod \constructor(can, txid, rxid, *, extid=False, fd=None, brs=True, dl=None, bs=0, stmin=0, padding=0xCC, rxbuf=4095, timeout=1000)
+///
+///   - `can` a machine.CAN initialized with `txqueue` > 0.
+///   - `txid`, `rxid` CAN IDs of the sent and received frames, `extid` for 29 bits IDs.
+///   - `fd` CAN FD frames (default: the CAN setting), `brs` data bit rate switch.
+///   - `dl` frame data length, 8 or a CAN FD length up to 64 (default 64 with FD).
+///   - `bs`, `stmin` block size and separation time sent to the peer in flow control frames.
+///   - `padding` byte filling the frames up to `dl`, None for the shortest frames.
+///   - `rxbuf` largest message received.
+///   - `timeout` ms waiting for flow control or consecutive frames (N_Bs, N_Cr).
+static mp_obj_t pyb_isotp_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *all_args)
+{
+    enum { ARG_can, ARG_txid, ARG_rxid, ARG_extid, ARG_fd, ARG_brs, ARG_dl, ARG_bs, ARG_stmin, ARG_padding, ARG_rxbuf, ARG_timeout };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_can,     MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_txid,    MP_ARG_REQUIRED | MP_ARG_INT, {.u_int = 0} },
+        { MP_QSTR_rxid,    MP_ARG_REQUIRED | MP_ARG_INT, {.u_int = 0} },
+        { MP_QSTR_extid,   MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false} },
+        { MP_QSTR_fd,      MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_brs,     MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = true} },
+        { MP_QSTR_dl,      MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_bs,      MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0} },
+        { MP_QSTR_stmin,   MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0} },
+        { MP_QSTR_padding, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = MP_OBJ_NEW_SMALL_INT(0xCC)} },
+        { MP_QSTR_rxbuf,   MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 4095} },
+        { MP_QSTR_timeout, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 1000} },
+    };
+
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all_kw_array(n_args, n_kw, all_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    bool can_fd;
+    canfd_t *can = pyb_can_get_handle(args[ARG_can].u_obj, &can_fd, true);
+    bool fd = (args[ARG_fd].u_obj == mp_const_none) ? can_fd : mp_obj_is_true(args[ARG_fd].u_obj);
+    mp_int_t dl = (args[ARG_dl].u_obj == mp_const_none) ? (fd ? 64 : 8) : mp_obj_get_int(args[ARG_dl].u_obj);
+    mp_int_t padding = (args[ARG_padding].u_obj == mp_const_none) ? -1 : mp_obj_get_int(args[ARG_padding].u_obj);
+    uint32_t id_max = args[ARG_extid].u_bool ? 0x1FFFFFFF : 0x7FF;
+
+    if (fd && !can_fd) {
+        mp_raise_ValueError("CAN FD not enabled");
+    }
+
+    if (((mp_uint_t)args[ARG_txid].u_int > id_max) || ((mp_uint_t)args[ARG_rxid].u_int > id_max)) {
+        mp_raise_ValueError("invalid CAN ID");
+    }
+
+    if ((padding > 0xFF) || (args[ARG_bs].u_int < 0) || (args[ARG_bs].u_int > 0xFF) ||
+            (args[ARG_stmin].u_int < 0) || (args[ARG_stmin].u_int > 0xFF) || (args[ARG_rxbuf].u_int <= 0)) {
+        mp_raise_ValueError("ISO-TP parameter error");
+    }
+
+    // Reuse the link of the same IDs, or take a free one
+    pyb_isotp_obj_t *self = NULL;
+
+    for (int i = 0; i < MAX_ISOTP_LINKS; i++) {
+        pyb_isotp_obj_t *link = &pyb_isotp_obj[i];
+
+        if (link->active && (link->link.psCANFDObj == can) && (link->link.u32RxId == (uint32_t)args[ARG_rxid].u_int) &&
+                (link->link.bExtId == args[ARG_extid].u_bool)) {
+            isotp_close(link);
+        }
+
+        if ((self == NULL) && !link->active) {
+            self = link;
+        }
+    }
+
+    if (self == NULL) {
+        mp_raise_ValueError("no free ISO-TP link");
+    }
+
+    size_t idx = isotp_index(self);
+    uint8_t *rxbuf = m_new(uint8_t, args[ARG_rxbuf].u_int);
+
+    memset(&self->link, 0, sizeof(self->link));
+    self->link.psCANFDObj = can;
+    self->link.u32TxId = args[ARG_txid].u_int;
+    self->link.u32RxId = args[ARG_rxid].u_int;
+    self->link.bExtId = args[ARG_extid].u_bool;
+    self->link.bFD = fd;
+    self->link.bBRS = args[ARG_brs].u_bool;
+    self->link.u8TxDL = (dl > 0 && dl <= 64) ? dl : 0;
+    self->link.i16Padding = padding;
+    self->link.u8BlockSize = args[ARG_bs].u_int;
+    self->link.u8STmin = args[ARG_stmin].u_int;
+    self->link.pu8RxBuf = rxbuf;
+    self->link.u32RxBufSize = args[ARG_rxbuf].u_int;
+    self->timeout = args[ARG_timeout].u_int;
+
+    MP_STATE_PORT(pyb_isotp_can)[idx] = args[ARG_can].u_obj;
+    MP_STATE_PORT(pyb_isotp_rxbuf)[idx] = rxbuf;
+
+    int32_t ret = ISOTP_Open(&self->link);
+
+    if (ret == -1) {
+        isotp_close(self);
+        mp_raise_ValueError("invalid dl");
+    } else if (ret != 0) {
+        isotp_close(self);
+        mp_hal_raise(HAL_ERROR);
+    }
+
+    self->active = true;
+
+    return MP_OBJ_FROM_PTR(self);
+}
+
+static void pyb_isotp_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
+{
+    pyb_isotp_obj_t *self = self_in;
+
+    if (!self->active) {
+        mp_printf(print, "ISOTP()");
+        return;
+    }
+
+    mp_printf(print, "ISOTP(txid=0x%x, rxid=0x%x, dl=%u, fd=%q)",
+              (unsigned int)self->link.u32TxId,
+              (unsigned int)self->link.u32RxId,
+              self->link.u8TxDL,
+              self->link.bFD ? MP_QSTR_True : MP_QSTR_False);
+}
+
+static void isotp_check_active(pyb_isotp_obj_t *self)
+{
+    if (!self->active) {
+        mp_raise_ValueError("ISO-TP link closed");
+    }
+}
+
+/// \method send(buf, *, wait=True)
+/// Send the message `buf`. With wait=False send returns once the first frame
+/// is queued, `buf` must not change until done() is True.
+static mp_obj_t pyb_isotp_send(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    enum { ARG_buf, ARG_wait };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_buf,  MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_wait, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = true} },
+    };
+
+    pyb_isotp_obj_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    isotp_check_active(self);
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[ARG_buf].u_obj, &bufinfo, MP_BUFFER_READ);
+
+    if (bufinfo.len == 0) {
+        mp_raise_ValueError("empty message");
+    }
+
+    MP_STATE_PORT(pyb_isotp_txbuf)[isotp_index(self)] = args[ARG_buf].u_obj;
+
+    int32_t ret = ISOTP_Send(&self->link, bufinfo.buf, bufinfo.len);
+
+    if (ret == -2) {
+        mp_raise_ValueError("ISO-TP send in progress");
+    } else if (ret != 0) {
+        isotp_raise_state("send", self->link.eTxState);
+    }
+
+    if (!args[ARG_wait].u_bool) {
+        return mp_const_none;
+    }
+
+    nlr_buf_t nlr;
+
+    if (nlr_push(&nlr) == 0) {
+        E_ISOTP_STATE state;
+
+        while (((state = self->link.eTxState) == eISOTP_BUSY) || (state == eISOTP_WAIT_FC)) {
+            // N_Bs: flow control, or a send queue slot, within timeout
+            if ((mp_hal_ticks_ms() - self->link.u32TxEventMs) >= (uint32_t)self->timeout) {
+                ISOTP_SendAbort(&self->link);
+                isotp_raise_state("send", eISOTP_IDLE);
+            }
+            MICROPY_EVENT_POLL_HOOK
+        }
+
+        if (state != eISOTP_DONE) {
+            isotp_raise_state("send", state);
+        }
+        nlr_pop();
+    } else {
+        ISOTP_SendAbort(&self->link);
+        nlr_jump(nlr.ret_val);
+    }
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_isotp_send_obj, 2, pyb_isotp_send);
+
+/// \method done()
+/// Return True when no message is being sent. A failed send raises OSError.
+static mp_obj_t pyb_isotp_done(mp_obj_t self_in)
+{
+    pyb_isotp_obj_t *self = self_in;
+    E_ISOTP_STATE state = self->link.eTxState;
+
+    isotp_check_active(self);
+
+    if ((state == eISOTP_BUSY) || (state == eISOTP_WAIT_FC)) {
+        if ((mp_hal_ticks_ms() - self->link.u32TxEventMs) < (uint32_t)self->timeout) {
+            return mp_const_false;
+        }
+        ISOTP_SendAbort(&self->link);
+        isotp_raise_state("send", eISOTP_IDLE);
+    }
+
+    if ((state != eISOTP_IDLE) && (state != eISOTP_DONE)) {
+        ISOTP_SendAbort(&self->link);
+        isotp_raise_state("send", state);
+    }
+
+    return mp_const_true;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_isotp_done_obj, pyb_isotp_done);
+
+// Wait for a complete message, false on timeout. Errors release the buffer and raise.
+static bool isotp_recv_wait(pyb_isotp_obj_t *self, mp_int_t timeout)
+{
+    uint32_t start = mp_hal_ticks_ms();
+
+    isotp_check_active(self);
+
+    while (1) {
+        E_ISOTP_STATE state = self->link.eRxState;
+
+        if (state == eISOTP_DONE) {
+            return true;
+        }
+
+        if (state == eISOTP_BUSY) {
+            // N_Cr: the next consecutive frame within timeout
+            if ((mp_hal_ticks_ms() - self->link.u32RxEventMs) >= (uint32_t)self->timeout) {
+                ISOTP_RecvRelease(&self->link);
+                isotp_raise_state("recv", eISOTP_IDLE);
+            }
+        } else if (state != eISOTP_IDLE) {
+            ISOTP_RecvRelease(&self->link);
+            isotp_raise_state("recv", state);
+        } else if ((timeout >= 0) && ((mp_hal_ticks_ms() - start) >= (uint32_t)timeout)) {
+            return false;
+        }
+
+        MICROPY_EVENT_POLL_HOOK
+    }
+}
+
+/// \method any()
+/// Return True if a complete message is waiting.
+static mp_obj_t pyb_isotp_any(mp_obj_t self_in)
+{
+    pyb_isotp_obj_t *self = self_in;
+
+    return mp_obj_new_bool(isotp_recv_wait(self, 0));
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_isotp_any_obj, pyb_isotp_any);
+
+/// \method recv(*, timeout=-1)
+/// Wait at most `timeout` ms (-1 forever) for the start of a message.
+///
+/// Return value: the message as bytes, or None on timeout.
+static mp_obj_t pyb_isotp_recv(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    enum { ARG_timeout };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_timeout, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = -1} },
+    };
+
+    pyb_isotp_obj_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    if (!isotp_recv_wait(self, args[ARG_timeout].u_int)) {
+        return mp_const_none;
+    }
+
+    mp_obj_t msg = mp_obj_new_bytes(self->link.pu8RxBuf, self->link.u32RxLen);
+
+    ISOTP_RecvRelease(&self->link);
+    return msg;
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_isotp_recv_obj, 1, pyb_isotp_recv);
+
+/// \method recv_into(buf, *, timeout=-1)
+/// Receive a message into `buf` without heap allocation.
+///
+/// Return value: the message length, or None on timeout. A message longer
+/// than `buf` raises ValueError and is dropped.
+static mp_obj_t pyb_isotp_recv_into(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    enum { ARG_buf, ARG_timeout };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_buf,     MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_timeout, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = -1} },
+    };
+
+    pyb_isotp_obj_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[ARG_buf].u_obj, &bufinfo, MP_BUFFER_WRITE);
+
+    if (!isotp_recv_wait(self, args[ARG_timeout].u_int)) {
+        return mp_const_none;
+    }
+
+    uint32_t len = self->link.u32RxLen;
+
+    if (len > bufinfo.len) {
+        ISOTP_RecvRelease(&self->link);
+        mp_raise_ValueError("buf too small");
+    }
+
+    memcpy(bufinfo.buf, self->link.pu8RxBuf, len);
+    ISOTP_RecvRelease(&self->link);
+
+    return mp_obj_new_int_from_uint(len);
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_isotp_recv_into_obj, 2, pyb_isotp_recv_into);
+
+/// \method deinit()
+/// Detach the link from the CAN. Frames of `rxid` are then stored in the CAN
+/// receive queue, or counted as rx_overrun in CAN.stats() without one.
+static mp_obj_t pyb_isotp_deinit(mp_obj_t self_in)
+{
+    isotp_close(self_in);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_isotp_deinit_obj, pyb_isotp_deinit);
+
+static const mp_rom_map_elem_t pyb_isotp_locals_dict_table[] = {
+    // instance methods
+    { MP_ROM_QSTR(MP_QSTR_send), MP_ROM_PTR(&pyb_isotp_send_obj) },
+    { MP_ROM_QSTR(MP_QSTR_done), MP_ROM_PTR(&pyb_isotp_done_obj) },
+    { MP_ROM_QSTR(MP_QSTR_any), MP_ROM_PTR(&pyb_isotp_any_obj) },
+    { MP_ROM_QSTR(MP_QSTR_recv), MP_ROM_PTR(&pyb_isotp_recv_obj) },
+    { MP_ROM_QSTR(MP_QSTR_recv_into), MP_ROM_PTR(&pyb_isotp_recv_into_obj) },
+    { MP_ROM_QSTR(MP_QSTR_deinit), MP_ROM_PTR(&pyb_isotp_deinit_obj) },
+};
+
+static MP_DEFINE_CONST_DICT(pyb_isotp_locals_dict, pyb_isotp_locals_dict_table);
+
+MP_DEFINE_CONST_OBJ_TYPE(
+    machine_isotp_type,
+    MP_QSTR_ISOTP,
+    MP_TYPE_FLAG_NONE,
+    make_new, pyb_isotp_make_new,
+    print, pyb_isotp_print,
+    locals_dict, &pyb_isotp_locals_dict
+);
+
+#endif
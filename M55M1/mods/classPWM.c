@@ -67,6 +67,7 @@ typedef struct _pyb_pwm_obj_t {
     pwm_t *pwm_obj;
     bool enabled;
     uint32_t freq;
+    uint8_t motor_pairs;	//bit n: pair CH2n/CH2n+1 driven by motor()
     pyb_pwm_channel_obj_t channel[M55M1_MAX_PWM_CHANNEL_INST];
 } pyb_pwm_obj_t;
 
@@ -171,6 +172,7 @@ static mp_obj_t pyb_pwm_init_helper(pyb_pwm_obj_t *self, size_t n_args, const mp
 
     self->freq = (uint32_t) mp_obj_get_int(args[0].u_obj);
     self->enabled = true;
+    self->motor_pairs = 0;
 
     return mp_const_none;
 }
@@ -254,6 +256,7 @@ static mp_obj_t pyb_pwm_deinit(mp_obj_t self_in)
     }
 
     self->enabled = false;
+    self->motor_pairs = 0;
     return mp_const_none;
 }
 static MP_DEFINE_CONST_FUN_OBJ_1(pyb_pwm_deinit_obj, pyb_pwm_deinit);
@@ -380,6 +383,112 @@ static mp_obj_t pyb_pwm_channel(size_t n_args, const mp_obj_t *pos_args, mp_map_
 }
 static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_pwm_channel_obj, 1, pyb_pwm_channel);
 
+/// \method motor(pins, *, deadtime=500, adc_trigger=PWM.CENTER)
+///
+/// EPWM motor control mode. `pins` are the EPWM output pins of the phases;
+/// each pair (CH0/1, CH2/3, CH4/5) with a pin in `pins` is driven as a
+/// complementary pair with `deadtime` ns dead-time, center aligned at the
+/// PWM frequency. All pairs start together with 0% duty.
+/// `adc_trigger` (CENTER, ZERO or None) raises the EPWM EADC trigger of the
+/// even channel of the lowest pair (EADC source EPWMxTG0, TG2 or TG4).
+static mp_obj_t pyb_pwm_motor(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_pins,        MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_deadtime,    MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 500} },
+        { MP_QSTR_adc_trigger, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = MP_OBJ_NEW_SMALL_INT(PWM_MOTOR_ADC_TRG_CENTER)} },
+    };
+
+    pyb_pwm_obj_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    if((self->pwm_obj->bEPWM == false) || (!self->enabled)) {
+        mp_raise_ValueError("motor mode needs an initialised EPWM");
+    }
+
+    size_t pin_count;
+    mp_obj_t *pin_items;
+    mp_obj_get_array(args[0].u_obj, &pin_count, &pin_items);
+
+    PWM_MotorInitTypeDef motorInit;
+    size_t i;
+
+    motorInit.u32Freq = self->freq;
+    motorInit.u32PairMask = 0;
+    motorInit.u32DeadTimeNs = args[1].u_int;
+    motorInit.u32ADCTrigger = PWM_MOTOR_ADC_TRG_NONE;
+
+    if(args[2].u_obj != mp_const_none) {
+        motorInit.u32ADCTrigger = mp_obj_get_int(args[2].u_obj);
+    }
+
+    for(i = 0; i < pin_count; i ++) {
+        if (!MP_OBJ_IS_TYPE(pin_items[i], &pin_type)) {
+            mp_raise_ValueError("pin argument needs to be be a Pin type");
+        }
+
+        pin_obj_t *pin = pin_items[i];
+        const pin_af_obj_t *af = pin_find_af(pin, AF_FN_EPWM, self->pwm_id);
+
+        if ((af == NULL) || (af->type > AF_PIN_TYPE_EPWM_CH5)) {
+            nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "Pin(%q) doesn't have an af for PWM(%d)", pin->name, self->pwm_id));
+        }
+
+        mp_hal_pin_config_alt(pin, MP_HAL_PIN_MODE_ALT_PUSH_PULL, AF_FN_EPWM, self->pwm_id);
+
+        pyb_pwm_channel_obj_t *chann = &self->channel[af->type];
+        chann->mode = CHANNEL_MODE_OUTPUT;
+        chann->pin = pin;
+        chann->freq = self->freq;
+        chann->duty = 0;
+
+        motorInit.u32PairMask |= (1 << (af->type / 2));
+    }
+
+    if(PWM_MotorInit(self->pwm_obj, &motorInit) < 0) {
+        mp_raise_ValueError("Unable to start motor mode");
+    }
+
+    self->motor_pairs = motorInit.u32PairMask;
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_pwm_motor_obj, 2, pyb_pwm_motor);
+
+/// \method motor_duty(duty0, [duty1, duty2])
+///
+/// Set the high side duty (0~100 percent, float) of the motor pairs in
+/// ascending pair order. All pairs are updated in the same PWM period.
+static mp_obj_t pyb_pwm_motor_duty(size_t n_args, const mp_obj_t *args)
+{
+    pyb_pwm_obj_t *self = args[0];
+    uint16_t au16Duty[M55M1_MAX_PWM_CHANNEL_INST / 2] = {0};
+    size_t arg_idx = 1;
+    int pair;
+
+    for(pair = 0; (pair < (M55M1_MAX_PWM_CHANNEL_INST / 2)) && (arg_idx < n_args); pair ++) {
+        if(!(self->motor_pairs & (1 << pair)))
+            continue;
+
+        mp_float_t duty = mp_obj_get_float(args[arg_idx++]);
+
+        if(duty < 0)
+            duty = 0;
+        else if(duty > 100)
+            duty = 100;
+
+        au16Duty[pair] = (uint16_t)(duty * 65535 / 100);
+    }
+
+    if((self->motor_pairs == 0) || (PWM_MotorSetDuty(self->pwm_obj, au16Duty) < 0)) {
+        mp_raise_ValueError("motor mode not started");
+    }
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(pyb_pwm_motor_duty_obj, 2, 4, pyb_pwm_motor_duty);
+
 static void pyb_pwm_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
 {
     pyb_pwm_obj_t *self = self_in;
@@ -404,6 +513,8 @@ static const mp_rom_map_elem_t pyb_pwm_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_init), MP_ROM_PTR(&pyb_pwm_init_obj) },
     { MP_ROM_QSTR(MP_QSTR_channel), MP_ROM_PTR(&pyb_pwm_channel_obj) },
     { MP_ROM_QSTR(MP_QSTR_deinit), MP_ROM_PTR(&pyb_pwm_deinit_obj) },
+    { MP_ROM_QSTR(MP_QSTR_motor), MP_ROM_PTR(&pyb_pwm_motor_obj) },
+    { MP_ROM_QSTR(MP_QSTR_motor_duty), MP_ROM_PTR(&pyb_pwm_motor_duty_obj) },
 
     { MP_ROM_QSTR(MP_QSTR_OUTPUT), MP_ROM_INT(CHANNEL_MODE_OUTPUT) },
     { MP_ROM_QSTR(MP_QSTR_CAPTURE), MP_ROM_INT(CHANNEL_MODE_CAPTURE) },
@@ -412,6 +523,9 @@ static const mp_rom_map_elem_t pyb_pwm_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_FALLING), MP_ROM_INT(eCAPTURE_FALLING_LATCH) },
     { MP_ROM_QSTR(MP_QSTR_RISING_FALLING), MP_ROM_INT(eCAPTURE_RISING_FALLING_LATCH) },
 
+    { MP_ROM_QSTR(MP_QSTR_CENTER), MP_ROM_INT(PWM_MOTOR_ADC_TRG_CENTER) },
+    { MP_ROM_QSTR(MP_QSTR_ZERO), MP_ROM_INT(PWM_MOTOR_ADC_TRG_ZERO) },
+
     { MP_ROM_QSTR(MP_QSTR_BPWM), MP_ROM_INT(0) },
     { MP_ROM_QSTR(MP_QSTR_EPWM), MP_ROM_INT(1) },
 
@@ -531,12 +645,103 @@ static mp_obj_t pyb_pwm_channel_capture(mp_obj_t self_in, mp_obj_t edge_latch)
 }
 static MP_DEFINE_CONST_FUN_OBJ_2(pyb_pwm_channel_capture_obj, pyb_pwm_channel_capture);
 
+#define CAPTURE_FALLING_FLAG	(1 << 16)
+
+/// \method capture_into(buf, *, timeout=-1)
+///
+/// Store the capture counter values of the channel into `buf` by PDMA, no
+/// Python code runs per edge. EPWM capture channels only.
+///
+/// `buf` is an array('H') for raw counter values, or an array('I') to get each
+/// value tagged with its edge: bit 16 is set for a falling edge. With
+/// RISING_FALLING capture edges the values alternate rising, falling, ...
+/// Waits until `buf` is full or `timeout` ms have elapsed (-1 waits forever)
+/// and returns the number of captured values.
+static mp_obj_t pyb_pwm_channel_capture_into(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_buf,     MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_timeout, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = -1} },
+    };
+
+    pyb_pwm_channel_obj_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    pwm_t *pwm_obj = self->pyb_pwm_obj->pwm_obj;
+
+    if((pwm_obj->bEPWM == false) || (self->mode != CHANNEL_MODE_CAPTURE)) {
+        mp_raise_ValueError("Not an EPWM capture channel");
+    }
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[0].u_obj, &bufinfo, MP_BUFFER_WRITE);
+
+    size_t itemsize = mp_binary_get_size('@', bufinfo.typecode, NULL);
+    bool tagged = (itemsize == 4);
+
+    if((itemsize != 2) && (!tagged)) {
+        mp_raise_ValueError("buf must be array('H') or array('I')");
+    }
+
+    size_t len = bufinfo.len / itemsize;
+    if(len == 0) {
+        return MP_OBJ_NEW_SMALL_INT(0);
+    }
+
+    // Tagged buffer: capture 16 bits values into the upper half, widened in place afterwards
+    uint16_t *cap_buf = tagged ? (uint16_t *)bufinfo.buf + len : bufinfo.buf;
+
+    if(PWM_CapturePDMAStart(pwm_obj, self->chann_id, self->capture_edge, cap_buf, len) < 0) {
+        mp_raise_ValueError("Unable to start capture DMA");
+    }
+
+    mp_int_t timeout = args[1].u_int;
+    uint32_t start = mp_hal_ticks_ms();
+    uint32_t count;
+    nlr_buf_t nlr;
+
+    if (nlr_push(&nlr) == 0) {
+        while ((count = PWM_CapturePDMACount(pwm_obj, self->chann_id)) < len) {
+            if((timeout >= 0) && ((mp_hal_ticks_ms() - start) >= (uint32_t)timeout))
+                break;
+            MICROPY_EVENT_POLL_HOOK
+        }
+        nlr_pop();
+    } else {
+        PWM_CapturePDMAStop(pwm_obj, self->chann_id);
+        nlr_jump(nlr.ret_val);
+    }
+
+    PWM_CapturePDMAStop(pwm_obj, self->chann_id);
+
+    if(tagged) {
+        uint32_t *out_buf = bufinfo.buf;
+        uint32_t i;
+
+        // Forward widening is safe, each 32 bits slot only overlaps values already read
+        for(i = 0; i < count; i ++) {
+            uint32_t u32Value = cap_buf[i];
+
+            if((self->capture_edge == eCAPTURE_FALLING_LATCH) ||
+                    ((self->capture_edge == eCAPTURE_RISING_FALLING_LATCH) && (i & 1)))
+                u32Value |= CAPTURE_FALLING_FLAG;
+
+            out_buf[i] = u32Value;
+        }
+    }
+
+    return MP_OBJ_NEW_SMALL_INT(count);
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_pwm_channel_capture_into_obj, 2, pyb_pwm_channel_capture_into);
+
 static const mp_rom_map_elem_t pyb_pwm_channel_locals_dict_table[] = {
     // instance methods
     { MP_ROM_QSTR(MP_QSTR_callback), MP_ROM_PTR(&pyb_pwm_channel_cb_obj) },
     { MP_ROM_QSTR(MP_QSTR_pulse_width_percent), MP_ROM_PTR(&pyb_pwm_channel_pulse_width_percent_obj) },
     { MP_ROM_QSTR(MP_QSTR_disable), MP_ROM_PTR(&pyb_pwm_channel_disable_obj) },
     { MP_ROM_QSTR(MP_QSTR_capture), MP_ROM_PTR(&pyb_pwm_channel_capture_obj) },
+    { MP_ROM_QSTR(MP_QSTR_capture_into), MP_ROM_PTR(&pyb_pwm_channel_capture_into_obj) },
 
 //    { MP_ROM_QSTR(MP_QSTR_compare), MP_ROM_PTR(&pyb_timer_channel_compare_obj) },
 };
@@ -675,3 +880,12 @@ static void PWM_CaptureInt_Handler(void *obj, uint32_t u32ChannelGroup)
     }
 }
 
+
+pwm_t *pyb_pwm_get_handle(mp_obj_t pwm)
+{
+    if (mp_obj_get_type(pwm) != &machine_pwm_type) {
+        mp_raise_ValueError("need a PWM object");
+    }
+    pyb_pwm_obj_t *self = pwm;
+    return self->pwm_obj;
+}
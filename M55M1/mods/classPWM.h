@@ -28,7 +28,12 @@
 #define MICROPY_INCLUDED_CLASS_PWM_H
 
 
+#include "hal/M55M1_PWM.h"
+
 extern const mp_obj_type_t machine_pwm_type;
 
+// For C code hooking the motor control mode, see PWM_MotorSetPeriodHandler()
+pwm_t *pyb_pwm_get_handle(mp_obj_t pwm);
+
 
 #endif // MICROPY_INCLUDED_CLASS_PWM_H
@@ -0,0 +1,458 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2013, 2014 Damien P. George
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "py/runtime.h"
+#include "py/gc.h"
+#include "py/binary.h"
+#include "py/mphal.h"
+#include "py/mperrno.h"
+
+#include "classPortReader.h"
+#include "classPin.h"
+#include "classTimer.h"
+#include "hal/M55M1_GPIO.h"
+#include "hal/pin_int.h"
+
+/// \moduleref machine
+/// \class PortReader - timer paced GPIO capture (logic analyzer)
+///
+/// PortReader(port, timer, buf) samples the input register of a GPIO port
+/// into `buf` on each event of `timer` by PDMA. The capture can be started
+/// by an edge of a trigger pin, rle() compacts the samples afterwards.
+///
+///     tim = machine.Timer(1, freq=2000000)
+///     la = machine.PortReader(2, tim, samples, mask=0x000F, trigger=machine.Pin('PC0'))
+///     la.wait()
+///     n, used = la.rle(runs)
+///
+/// A port runs either a PortWriter or a PortReader at a time, starting the
+/// other one raises OSError(EBUSY) until the first is stopped.
+
+typedef struct _pyb_portreader_obj_t {
+    mp_obj_base_t base;
+    uint8_t port;
+    bool active;
+    uint32_t mask;
+    uint32_t captured;
+    const pin_obj_t *trigger;
+    gpio_port_t gpio_obj;
+} pyb_portreader_obj_t;
+
+static pyb_portreader_obj_t pyb_portreader_obj[PORT_END] = {
+    {{&machine_portreader_type}, PORT_A, false, 0xFFFF, 0, NULL, {.gpio = PA}},
+    {{&machine_portreader_type}, PORT_B, false, 0xFFFF, 0, NULL, {.gpio = PB}},
+    {{&machine_portreader_type}, PORT_C, false, 0xFFFF, 0, NULL, {.gpio = PC}},
+    {{&machine_portreader_type}, PORT_D, false, 0xFFFF, 0, NULL, {.gpio = PD}},
+    {{&machine_portreader_type}, PORT_E, false, 0xFFFF, 0, NULL, {.gpio = PE}},
+    {{&machine_portreader_type}, PORT_F, false, 0xFFFF, 0, NULL, {.gpio = PF}},
+    {{&machine_portreader_type}, PORT_G, false, 0xFFFF, 0, NULL, {.gpio = PG}},
+    {{&machine_portreader_type}, PORT_H, false, 0xFFFF, 0, NULL, {.gpio = PH}},
+    {{&machine_portreader_type}, PORT_I, false, 0xFFFF, 0, NULL, {.gpio = PI}},
+    {{&machine_portreader_type}, PORT_J, false, 0xFFFF, 0, NULL, {.gpio = PJ}},
+};
+
+// Capture buffer of each port, keeps it alive while PDMA writes it
+MP_REGISTER_ROOT_POINTER(mp_obj_t pyb_portreader_buf[PORT_END]);
+
+static void portreader_disarm(pyb_portreader_obj_t *self)
+{
+    const pin_obj_t *pin = self->trigger;
+
+    if (pin == NULL) {
+        return;
+    }
+
+    self->trigger = NULL;
+
+    // Release the line, extint_register_pin() leaves the interrupt enabled
+    mp_uint_t irq_state = disable_irq();
+    extint_register_pin(pin, GPIO_INT_RISING, true, mp_const_none);
+    GPIO_DisableInt(pin->gpio, pin->pin);
+    GPIO_CLR_INT_FLAG(pin->gpio, 1 << pin->pin);
+    enable_irq(irq_state);
+}
+
+// Pin.irq() handler of the trigger pin, runs in GPIO interrupt context
+static mp_obj_t portreader_trigger_irq(mp_obj_t pin_in)
+{
+    const pin_obj_t *pin = pin_in;
+
+    // One shot, the trigger line stays registered until the capture is stopped
+    GPIO_DisableInt(pin->gpio, pin->pin);
+
+    for (int i = 0; i < PORT_END; i++) {
+        if (pyb_portreader_obj[i].active && (pyb_portreader_obj[i].trigger == pin)) {
+            GPIO_TimerPDMAStart(&pyb_portreader_obj[i].gpio_obj);
+        }
+    }
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(portreader_trigger_irq_obj, portreader_trigger_irq);
+
+static void portreader_stop(pyb_portreader_obj_t *self)
+{
+    portreader_disarm(self);
+
+    if (self->active) {
+        self->captured = GPIO_TimerPDMACount(&self->gpio_obj);
+        GPIO_StopTimerPDMA(&self->gpio_obj);
+        self->active = false;
+    }
+}
+
+static uint32_t portreader_sample(const void *buf, size_t size, size_t idx)
+{
+    if (size == 1) {
+        return ((const uint8_t *)buf)[idx];
+    } else if (size == 2) {
+        return ((const uint16_t *)buf)[idx];
+    }
+    return ((const uint32_t *)buf)[idx];
+}
+
+static void portreader_start(pyb_portreader_obj_t *self, mp_obj_t timer, mp_obj_t buf, mp_obj_t trigger, uint32_t edge)
+{
+    TIMER_T *timer_handle = pyb_timer_get_handle(timer);
+    const pin_obj_t *trigger_pin = NULL;
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(buf, &bufinfo, MP_BUFFER_WRITE);
+
+    size_t itemsize = mp_binary_get_size('@', bufinfo.typecode, NULL);
+
+    if ((itemsize != 1) && (itemsize != 2) && (itemsize != 4)) {
+        mp_raise_ValueError("buf must be array('B'), array('H') or array('I')");
+    }
+
+    size_t len = bufinfo.len / itemsize;
+    if (len == 0) {
+        mp_raise_ValueError("buf is empty");
+    }
+
+    if (trigger != mp_const_none) {
+        trigger_pin = pin_find(trigger);
+    }
+
+    portreader_stop(self);
+    self->captured = 0;
+    MP_STATE_PORT(pyb_portreader_buf)[self->port] = buf;
+
+    int32_t ret = GPIO_TimerPDMARead(&self->gpio_obj, timer_handle, bufinfo.buf, itemsize * 8, len, trigger_pin != NULL);
+
+    if (ret < 0) {
+        MP_STATE_PORT(pyb_portreader_buf)[self->port] = MP_OBJ_NULL;
+        if (ret == -4) {
+            mp_raise_OSError(MP_EBUSY);
+        }
+        mp_raise_ValueError("Unable to start PortReader DMA, Timer 0~3 only");
+    }
+
+    self->active = true;
+
+    if (trigger_pin) {
+        nlr_buf_t nlr;
+
+        if (nlr_push(&nlr) == 0) {
+            self->trigger = trigger_pin;
+            extint_register_pin(trigger_pin, edge, true, MP_OBJ_FROM_PTR(&portreader_trigger_irq_obj));
+            nlr_pop();
+        } else {
+            // Trigger line taken by another Pin.irq()
+            self->trigger = NULL;
+            portreader_stop(self);
+            MP_STATE_PORT(pyb_portreader_buf)[self->port] = MP_OBJ_NULL;
+            nlr_jump(nlr.ret_val);
+        }
+    }
+}
+
+/// \classmethod \constructor(port, timer, buf, *, mask=0xFFFF, trigger=None, edge=Pin.IRQ_RISING)
+///
+///   - `port` is the GPIO port index 0~9 for PA~PJ, as returned by Pin.port().
+///   - `timer` is a machine.Timer (0~3) set up with the sample rate as frequency.
+///   - `buf` is an array('B'), array('H') or array('I') receiving the samples.
+///   - `mask` selects the pins kept by rle(), the raw samples are not masked.
+///   - `trigger` None starts sampling at once, or a Pin whose `edge`
+///     (Pin.IRQ_RISING/Pin.IRQ_FALLING) starts it. The trigger is taken by a
+///     GPIO interrupt, sampling starts a few microseconds after the edge.
+static mp_obj_t pyb_portreader_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *all_args)
+{
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_port,    MP_ARG_REQUIRED | MP_ARG_INT, {.u_int = 0} },
+        { MP_QSTR_timer,   MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_buf,     MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_mask,    MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0xFFFF} },
+        { MP_QSTR_trigger, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_edge,    MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = GPIO_INT_RISING} },
+    };
+
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all_kw_array(n_args, n_kw, all_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    mp_int_t port = args[0].u_int;
+
+    if (port < 0 || port >= PORT_END) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "GPIO port(%d) doesn't exist", port));
+    }
+
+    if ((args[5].u_int != GPIO_INT_RISING) && (args[5].u_int != GPIO_INT_FALLING)) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "invalid edge (%d)", args[5].u_int));
+    }
+
+    pyb_portreader_obj_t *self = &pyb_portreader_obj[port];
+
+    self->mask = args[3].u_int & 0xFFFF;
+    portreader_start(self, args[1].u_obj, args[2].u_obj, args[4].u_obj, args[5].u_int);
+
+    return (mp_obj_t)self;
+}
+
+static void pyb_portreader_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
+{
+    pyb_portreader_obj_t *self = self_in;
+
+    mp_printf(print, "PortReader(port=P%c, mask=0x%04x)", 'A' + self->port, (unsigned int)self->mask);
+}
+
+/// \method read(timer, buf, *, trigger=None, edge=Pin.IRQ_RISING)
+/// Start a new capture, the running one is stopped first.
+static mp_obj_t pyb_portreader_read(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_timer,   MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_buf,     MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_trigger, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_edge,    MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = GPIO_INT_RISING} },
+    };
+
+    pyb_portreader_obj_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    if ((args[3].u_int != GPIO_INT_RISING) && (args[3].u_int != GPIO_INT_FALLING)) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "invalid edge (%d)", args[3].u_int));
+    }
+
+    portreader_start(self, args[0].u_obj, args[1].u_obj, args[2].u_obj, args[3].u_int);
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_portreader_read_obj, 3, pyb_portreader_read);
+
+/// \method done()
+/// Return True when `buf` is full or the reader is stopped.
+static mp_obj_t pyb_portreader_done(mp_obj_t self_in)
+{
+    pyb_portreader_obj_t *self = self_in;
+
+    return mp_obj_new_bool(GPIO_IsTimerPDMADone(&self->gpio_obj));
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_portreader_done_obj, pyb_portreader_done);
+
+/// \method count()
+/// Number of samples captured so far.
+static mp_obj_t pyb_portreader_count(mp_obj_t self_in)
+{
+    pyb_portreader_obj_t *self = self_in;
+
+    if (!self->active) {
+        return mp_obj_new_int_from_uint(self->captured);
+    }
+    return mp_obj_new_int_from_uint(GPIO_TimerPDMACount(&self->gpio_obj));
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_portreader_count_obj, pyb_portreader_count);
+
+/// \method wait(timeout=-1)
+/// Wait for `buf` to be full, at most `timeout` ms (-1 waits forever).
+/// The capture is stopped and the number of samples is returned.
+static mp_obj_t pyb_portreader_wait(size_t n_args, const mp_obj_t *args)
+{
+    pyb_portreader_obj_t *self = args[0];
+    mp_int_t timeout = (n_args > 1) ? mp_obj_get_int(args[1]) : -1;
+    uint32_t start = mp_hal_ticks_ms();
+    nlr_buf_t nlr;
+
+    if (nlr_push(&nlr) == 0) {
+        while (!GPIO_IsTimerPDMADone(&self->gpio_obj)) {
+            if ((timeout >= 0) && ((mp_hal_ticks_ms() - start) >= (uint32_t)timeout)) {
+                break;
+            }
+            MICROPY_EVENT_POLL_HOOK
+        }
+        nlr_pop();
+    } else {
+        portreader_stop(self);
+        nlr_jump(nlr.ret_val);
+    }
+
+    portreader_stop(self);
+
+    return mp_obj_new_int_from_uint(self->captured);
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(pyb_portreader_wait_obj, 1, 2, pyb_portreader_wait);
+
+/// \method stop()
+/// Stop the capture, the samples taken so far are valid in `buf`.
+static mp_obj_t pyb_portreader_stop(mp_obj_t self_in)
+{
+    portreader_stop(self_in);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_portreader_stop_obj, pyb_portreader_stop);
+
+/// \method deinit()
+static mp_obj_t pyb_portreader_deinit(mp_obj_t self_in)
+{
+    pyb_portreader_obj_t *self = self_in;
+
+    portreader_stop(self);
+    MP_STATE_PORT(pyb_portreader_buf)[self->port] = MP_OBJ_NULL;
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_portreader_deinit_obj, pyb_portreader_deinit);
+
+/// \method rle(out, start=0, count=-1)
+///
+/// Run-length encode the masked samples of the last capture from index
+/// `start` into `out`, an array('H') or array('I') distinct from `buf`.
+/// Each run is stored as a pair (value, length). A run longer than the item
+/// range of `out` is split. Encoding stops when `out` is full.
+///
+/// Returns (items, samples): the number of items written into `out` and of
+/// samples consumed, call again with start += samples to resume.
+static mp_obj_t pyb_portreader_rle(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_out,   MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_start, MP_ARG_INT, {.u_int = 0} },
+        { MP_QSTR_count, MP_ARG_INT, {.u_int = -1} },
+    };
+
+    pyb_portreader_obj_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    mp_obj_t buf = MP_STATE_PORT(pyb_portreader_buf)[self->port];
+
+    if (buf == MP_OBJ_NULL) {
+        mp_raise_ValueError("no capture");
+    }
+
+    if (!GPIO_IsTimerPDMADone(&self->gpio_obj)) {
+        mp_raise_ValueError("capture is running");
+    }
+
+    // Samples reach the CPU view once the HAL has been stopped
+    portreader_stop(self);
+
+    mp_buffer_info_t inbuf;
+    mp_buffer_info_t outbuf;
+    mp_get_buffer_raise(buf, &inbuf, MP_BUFFER_READ);
+    mp_get_buffer_raise(args[0].u_obj, &outbuf, MP_BUFFER_WRITE);
+
+    size_t in_size = mp_binary_get_size('@', inbuf.typecode, NULL);
+    size_t out_size = mp_binary_get_size('@', outbuf.typecode, NULL);
+
+    if ((out_size != 2) && (out_size != 4)) {
+        mp_raise_ValueError("out must be array('H') or array('I')");
+    }
+
+    if (((uint8_t *)outbuf.buf < (uint8_t *)inbuf.buf + inbuf.len) &&
+            ((uint8_t *)inbuf.buf < (uint8_t *)outbuf.buf + outbuf.len)) {
+        mp_raise_ValueError("out overlaps the capture buffer");
+    }
+
+    size_t in_len = MIN(inbuf.len / in_size, self->captured);
+    size_t out_len = outbuf.len / out_size;
+    size_t in_idx = args[1].u_int;
+    size_t in_end = in_len;
+    size_t out_idx = 0;
+    uint32_t run_max = (out_size == 2) ? 0xFFFF : 0xFFFFFFFF;
+
+    if ((args[1].u_int < 0) || (in_idx > in_len)) {
+        mp_raise_ValueError("start out of range");
+    }
+
+    if ((args[2].u_int >= 0) && ((size_t)args[2].u_int < in_len - in_idx)) {
+        in_end = in_idx + args[2].u_int;
+    }
+
+    size_t in_start = in_idx;
+
+    while ((in_idx < in_end) && (out_idx + 2 <= out_len)) {
+        uint32_t value = portreader_sample(inbuf.buf, in_size, in_idx) & self->mask;
+        uint32_t run = 1;
+
+        in_idx ++;
+        while ((in_idx < in_end) && (run < run_max) &&
+                ((portreader_sample(inbuf.buf, in_size, in_idx) & self->mask) == value)) {
+            run ++;
+            in_idx ++;
+        }
+
+        if (out_size == 2) {
+            ((uint16_t *)outbuf.buf)[out_idx] = value;
+            ((uint16_t *)outbuf.buf)[out_idx + 1] = run;
+        } else {
+            ((uint32_t *)outbuf.buf)[out_idx] = value;
+            ((uint32_t *)outbuf.buf)[out_idx + 1] = run;
+        }
+        out_idx += 2;
+    }
+
+    mp_obj_t tuple[2] = {
+        mp_obj_new_int_from_uint(out_idx),
+        mp_obj_new_int_from_uint(in_idx - in_start),
+    };
+    return mp_obj_new_tuple(2, tuple);
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_portreader_rle_obj, 2, pyb_portreader_rle);
+
+static const mp_rom_map_elem_t pyb_portreader_locals_dict_table[] = {
+    // instance methods
+    { MP_ROM_QSTR(MP_QSTR_read), MP_ROM_PTR(&pyb_portreader_read_obj) },
+    { MP_ROM_QSTR(MP_QSTR_done), MP_ROM_PTR(&pyb_portreader_done_obj) },
+    { MP_ROM_QSTR(MP_QSTR_count), MP_ROM_PTR(&pyb_portreader_count_obj) },
+    { MP_ROM_QSTR(MP_QSTR_wait), MP_ROM_PTR(&pyb_portreader_wait_obj) },
+    { MP_ROM_QSTR(MP_QSTR_stop), MP_ROM_PTR(&pyb_portreader_stop_obj) },
+    { MP_ROM_QSTR(MP_QSTR_rle), MP_ROM_PTR(&pyb_portreader_rle_obj) },
+    { MP_ROM_QSTR(MP_QSTR_deinit), MP_ROM_PTR(&pyb_portreader_deinit_obj) },
+};
+static MP_DEFINE_CONST_DICT(pyb_portreader_locals_dict, pyb_portreader_locals_dict_table);
+
+MP_DEFINE_CONST_OBJ_TYPE(
+    machine_portreader_type,
+    MP_QSTR_PortReader,
+    MP_TYPE_FLAG_NONE,
+    make_new, pyb_portreader_make_new,
+    print, pyb_portreader_print,
+    locals_dict, &pyb_portreader_locals_dict
+);
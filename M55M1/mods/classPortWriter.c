@@ -0,0 +1,266 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2013, 2014 Damien P. George
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "py/runtime.h"
+#include "py/gc.h"
+#include "py/binary.h"
+#include "py/mphal.h"
+#include "py/mperrno.h"
+
+#include "classPortWriter.h"
+#include "classTimer.h"
+#include "hal/M55M1_GPIO.h"
+
+/// \moduleref machine
+/// \class PortWriter - timer paced GPIO pattern generator
+///
+/// PortWriter(port, mask, timer, buf) copies one word of `buf` into the
+/// output register of a GPIO port on each event of `timer` by PDMA, no Python
+/// code runs per word. Only the pins set in `mask` are driven.
+///
+///     tim = machine.Timer(0, freq=1000000)
+///     pw = machine.PortWriter(1, 0x00FF, tim, pattern)    # PB0~PB7
+///     pw.wait()
+///
+/// A port runs either a PortWriter or a PortReader at a time, starting the
+/// other one raises OSError(EBUSY) until the first is stopped.
+
+typedef struct _pyb_portwriter_obj_t {
+    mp_obj_base_t base;
+    uint8_t port;
+    bool active;
+    bool circular;
+    uint32_t mask;
+    gpio_port_t gpio_obj;
+} pyb_portwriter_obj_t;
+
+static pyb_portwriter_obj_t pyb_portwriter_obj[PORT_END] = {
+    {{&machine_portwriter_type}, PORT_A, false, false, 0, {.gpio = PA}},
+    {{&machine_portwriter_type}, PORT_B, false, false, 0, {.gpio = PB}},
+    {{&machine_portwriter_type}, PORT_C, false, false, 0, {.gpio = PC}},
+    {{&machine_portwriter_type}, PORT_D, false, false, 0, {.gpio = PD}},
+    {{&machine_portwriter_type}, PORT_E, false, false, 0, {.gpio = PE}},
+    {{&machine_portwriter_type}, PORT_F, false, false, 0, {.gpio = PF}},
+    {{&machine_portwriter_type}, PORT_G, false, false, 0, {.gpio = PG}},
+    {{&machine_portwriter_type}, PORT_H, false, false, 0, {.gpio = PH}},
+    {{&machine_portwriter_type}, PORT_I, false, false, 0, {.gpio = PI}},
+    {{&machine_portwriter_type}, PORT_J, false, false, 0, {.gpio = PJ}},
+};
+
+// Pattern buffer of each port, keeps it alive while PDMA reads it
+MP_REGISTER_ROOT_POINTER(mp_obj_t pyb_portwriter_buf[PORT_END]);
+
+static void portwriter_stop(pyb_portwriter_obj_t *self)
+{
+    GPIO_StopTimerPDMA(&self->gpio_obj);
+    MP_STATE_PORT(pyb_portwriter_buf)[self->port] = MP_OBJ_NULL;
+    self->active = false;
+}
+
+static void portwriter_start(pyb_portwriter_obj_t *self, mp_obj_t timer, mp_obj_t buf, bool circular)
+{
+    TIMER_T *timer_handle = pyb_timer_get_handle(timer);
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(buf, &bufinfo, MP_BUFFER_READ);
+
+    size_t itemsize = mp_binary_get_size('@', bufinfo.typecode, NULL);
+
+    if ((itemsize != 1) && (itemsize != 2) && (itemsize != 4)) {
+        mp_raise_ValueError("buf must be array('B'), array('H') or array('I')");
+    }
+
+    size_t len = bufinfo.len / itemsize;
+    if (len == 0) {
+        mp_raise_ValueError("buf is empty");
+    }
+
+    portwriter_stop(self);
+
+    // Set the root pointer first, PDMA may read the buffer as soon as it is started
+    MP_STATE_PORT(pyb_portwriter_buf)[self->port] = buf;
+
+    int32_t ret = GPIO_TimerPDMAWrite(&self->gpio_obj, timer_handle, self->mask,
+                                      bufinfo.buf, itemsize * 8, len, circular);
+
+    if (ret < 0) {
+        MP_STATE_PORT(pyb_portwriter_buf)[self->port] = MP_OBJ_NULL;
+        if (ret == -2) {
+            mp_raise_ValueError("buf too long for circular mode");
+        }
+        if (ret == -4) {
+            mp_raise_OSError(MP_EBUSY);
+        }
+        mp_raise_ValueError("Unable to start PortWriter DMA, Timer 0~3 only");
+    }
+
+    self->circular = circular;
+    self->active = true;
+}
+
+/// \classmethod \constructor(port, mask, timer, buf, *, circular=False)
+///
+///   - `port` is the GPIO port index 0~9 for PA~PJ, as returned by Pin.port().
+///   - `mask` selects the pins of the port driven by the pattern, they are
+///     switched to output mode. The other pins are left untouched.
+///   - `timer` is a machine.Timer (0~3) set up with the word rate as frequency.
+///   - `buf` is an array('B'), array('H') or array('I') of port values.
+///   - `circular` replays `buf` until stop() is called, otherwise the last
+///     word stays on the port once `buf` is written.
+static mp_obj_t pyb_portwriter_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *all_args)
+{
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_port,     MP_ARG_REQUIRED | MP_ARG_INT, {.u_int = 0} },
+        { MP_QSTR_mask,     MP_ARG_REQUIRED | MP_ARG_INT, {.u_int = 0} },
+        { MP_QSTR_timer,    MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_buf,      MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_circular, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false} },
+    };
+
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all_kw_array(n_args, n_kw, all_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    mp_int_t port = args[0].u_int;
+
+    if (port < 0 || port >= PORT_END) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "GPIO port(%d) doesn't exist", port));
+    }
+
+    if ((args[1].u_int & 0xFFFF) == 0) {
+        mp_raise_ValueError("mask selects no pin");
+    }
+
+    pyb_portwriter_obj_t *self = &pyb_portwriter_obj[port];
+
+    self->mask = args[1].u_int & 0xFFFF;
+    portwriter_start(self, args[2].u_obj, args[3].u_obj, args[4].u_bool);
+
+    return (mp_obj_t)self;
+}
+
+static void pyb_portwriter_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
+{
+    pyb_portwriter_obj_t *self = self_in;
+
+    mp_printf(print, "PortWriter(port=P%c, mask=0x%04x, circular=%d)", 'A' + self->port, (unsigned int)self->mask, self->circular);
+}
+
+/// \method write(timer, buf, *, circular=False)
+/// Start a new pattern on the same pins, the running one is stopped first.
+static mp_obj_t pyb_portwriter_write(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_timer,    MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_buf,      MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_circular, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false} },
+    };
+
+    pyb_portwriter_obj_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    portwriter_start(self, args[0].u_obj, args[1].u_obj, args[2].u_bool);
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_portwriter_write_obj, 3, pyb_portwriter_write);
+
+/// \method done()
+/// Return True when a one-shot pattern has been written or the writer is stopped.
+static mp_obj_t pyb_portwriter_done(mp_obj_t self_in)
+{
+    pyb_portwriter_obj_t *self = self_in;
+
+    return mp_obj_new_bool(GPIO_IsTimerPDMADone(&self->gpio_obj));
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_portwriter_done_obj, pyb_portwriter_done);
+
+/// \method count()
+/// Number of words written so far by a one-shot pattern.
+static mp_obj_t pyb_portwriter_count(mp_obj_t self_in)
+{
+    pyb_portwriter_obj_t *self = self_in;
+
+    return mp_obj_new_int_from_uint(GPIO_TimerPDMACount(&self->gpio_obj));
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_portwriter_count_obj, pyb_portwriter_count);
+
+/// \method wait(timeout=-1)
+/// Wait for a one-shot pattern to be written, at most `timeout` ms (-1 waits
+/// forever). Return True if it is done.
+static mp_obj_t pyb_portwriter_wait(size_t n_args, const mp_obj_t *args)
+{
+    pyb_portwriter_obj_t *self = args[0];
+    mp_int_t timeout = (n_args > 1) ? mp_obj_get_int(args[1]) : -1;
+    uint32_t start = mp_hal_ticks_ms();
+
+    if (self->circular && self->active) {
+        mp_raise_ValueError("circular pattern never ends");
+    }
+
+    while (!GPIO_IsTimerPDMADone(&self->gpio_obj)) {
+        if ((timeout >= 0) && ((mp_hal_ticks_ms() - start) >= (uint32_t)timeout)) {
+            return mp_const_false;
+        }
+        MICROPY_EVENT_POLL_HOOK
+    }
+
+    return mp_const_true;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(pyb_portwriter_wait_obj, 1, 2, pyb_portwriter_wait);
+
+/// \method stop()
+/// Stop the pattern, the port keeps its current output value.
+static mp_obj_t pyb_portwriter_stop(mp_obj_t self_in)
+{
+    portwriter_stop(self_in);
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(pyb_portwriter_stop_obj, pyb_portwriter_stop);
+
+static const mp_rom_map_elem_t pyb_portwriter_locals_dict_table[] = {
+    // instance methods
+    { MP_ROM_QSTR(MP_QSTR_write), MP_ROM_PTR(&pyb_portwriter_write_obj) },
+    { MP_ROM_QSTR(MP_QSTR_done), MP_ROM_PTR(&pyb_portwriter_done_obj) },
+    { MP_ROM_QSTR(MP_QSTR_count), MP_ROM_PTR(&pyb_portwriter_count_obj) },
+    { MP_ROM_QSTR(MP_QSTR_wait), MP_ROM_PTR(&pyb_portwriter_wait_obj) },
+    { MP_ROM_QSTR(MP_QSTR_stop), MP_ROM_PTR(&pyb_portwriter_stop_obj) },
+    { MP_ROM_QSTR(MP_QSTR_deinit), MP_ROM_PTR(&pyb_portwriter_stop_obj) },
+};
+static MP_DEFINE_CONST_DICT(pyb_portwriter_locals_dict, pyb_portwriter_locals_dict_table);
+
+MP_DEFINE_CONST_OBJ_TYPE(
+    machine_portwriter_type,
+    MP_QSTR_PortWriter,
+    MP_TYPE_FLAG_NONE,
+    make_new, pyb_portwriter_make_new,
+    print, pyb_portwriter_print,
+    locals_dict, &pyb_portwriter_locals_dict
+);
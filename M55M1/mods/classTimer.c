@@ -92,6 +92,9 @@ static pyb_timer_obj_t pyb_timer_obj[M55M1_MAX_TIMER_INST] = {
     {{&machine_timer_type}, 5, 0, &s_sTimer5Obj, mp_const_none, NULL},
 };
 
+// Compare value buffer of duty_stream(), keeps it alive while PDMA reads it
+MP_REGISTER_ROOT_POINTER(mp_obj_t pyb_timer_duty_stream_buf[M55M1_MAX_TIMER_INST]);
+
 static uint32_t compute_prescaler_period_from_freq(hw_timer_t *timer_obj, uint32_t u32Freq, uint32_t *pu32Prescale, uint32_t *pu32Period)
 {
     uint32_t u32Clk;
@@ -372,6 +375,9 @@ static mp_obj_t pyb_timer_deinit(mp_obj_t self_in)
     // Disable the base interrupt
     pyb_timer_callback(self_in, mp_const_none);
 
+    Timer_PWMPDMAStreamStop(self->timer_obj);
+    MP_STATE_PORT(pyb_timer_duty_stream_buf)[self->tim_id] = MP_OBJ_NULL;
+
     pyb_timer_channel_obj_t *chan = self->channel;
     self->channel = NULL;
 
@@ -812,6 +818,79 @@ static mp_obj_t pyb_timer_channel_compare(size_t n_args, const mp_obj_t *args)
 }
 static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(pyb_timer_channel_compare_obj, 1, 2, pyb_timer_channel_compare);
 
+/// \method duty_stream(buf, *, circular=False)
+///
+/// Load the compare value of a PWM channel from `buf`, an array('H'), on every
+/// PWM period by PDMA: buf[0] is used from the next period, then buf[1] and so
+/// on, no Python code runs per period. Values are raw compare counts, see
+/// compare() and timer.period().
+///
+/// One-shot (the default) waits until the buffer is done, the last value stays
+/// in effect. With `circular=True` the buffer is replayed until duty_stream(None)
+/// or timer.deinit() is called, and the method returns immediately.
+static mp_obj_t pyb_timer_channel_duty_stream(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_buf,      MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_circular, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false} },
+    };
+
+    pyb_timer_channel_obj_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    hw_timer_t *timer_obj = self->timer->timer_obj;
+
+    Timer_PWMPDMAStreamStop(timer_obj);
+    MP_STATE_PORT(pyb_timer_duty_stream_buf)[self->timer->tim_id] = MP_OBJ_NULL;
+
+    if(args[0].u_obj == mp_const_none) {
+        return mp_const_none;
+    }
+
+    if((self->mode != CHANNEL_MODE_PWM_NORMAL) || (timer_obj->bLPTimer)) {
+        mp_raise_ValueError("Not a Timer PWM channel");
+    }
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[0].u_obj, &bufinfo, MP_BUFFER_READ);
+
+    if(mp_binary_get_size('@', bufinfo.typecode, NULL) != 2) {
+        mp_raise_ValueError("buf must be array('H')");
+    }
+
+    uint32_t len = bufinfo.len / sizeof(uint16_t);
+    if(len == 0) {
+        return mp_const_none;
+    }
+
+    if(Timer_PWMPDMAStream(timer_obj, bufinfo.buf, len, args[1].u_bool) < 0) {
+        mp_raise_ValueError("Unable to start duty stream DMA");
+    }
+
+    if(args[1].u_bool) {
+        MP_STATE_PORT(pyb_timer_duty_stream_buf)[self->timer->tim_id] = args[0].u_obj;
+        return mp_const_none;
+    }
+
+    nlr_buf_t nlr;
+
+    if (nlr_push(&nlr) == 0) {
+        while (!Timer_IsPWMPDMAStreamDone(timer_obj)) {
+            MICROPY_EVENT_POLL_HOOK
+        }
+        nlr_pop();
+    } else {
+        Timer_PWMPDMAStreamStop(timer_obj);
+        nlr_jump(nlr.ret_val);
+    }
+
+    Timer_PWMPDMAStreamStop(timer_obj);
+
+    return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(pyb_timer_channel_duty_stream_obj, 2, pyb_timer_channel_duty_stream);
+
 
 static const mp_rom_map_elem_t pyb_timer_channel_locals_dict_table[] = {
     // instance methods
@@ -819,6 +898,7 @@ static const mp_rom_map_elem_t pyb_timer_channel_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_pulse_width_percent), MP_ROM_PTR(&pyb_timer_channel_pulse_width_percent_obj) },
     { MP_ROM_QSTR(MP_QSTR_capture), MP_ROM_PTR(&pyb_timer_channel_capture_obj) },
     { MP_ROM_QSTR(MP_QSTR_compare), MP_ROM_PTR(&pyb_timer_channel_compare_obj) },
+    { MP_ROM_QSTR(MP_QSTR_duty_stream), MP_ROM_PTR(&pyb_timer_channel_duty_stream_obj) },
 };
 static MP_DEFINE_CONST_DICT(pyb_timer_channel_locals_dict, pyb_timer_channel_locals_dict_table);
 
@@ -35,19 +35,27 @@
 #include "classI2C.h"
 #include "classSPI.h"
 #include "classCAN.h"
+#include "classISOTP.h"
+#include "classCANSignals.h"
 #include "classPWM.h"
 #include "classADC.h"
 #include "classTimer.h"
 #include "classDAC.h"
 #include "classRTC.h"
 #include "classWDT.h"
+#include "classCounter.h"
+#include "classEncoder.h"
+#include "classPortWriter.h"
+#include "classPortReader.h"
 
 
 // This file is never compiled standalone, it's included directly from
 // extmod/modmachine.c via MICROPY_PY_MACHINE_INCLUDEFILE.
 
 #if MICROPY_HW_ENABLE_CAN
-#define MACHINE_CAN_CLASS      { MP_ROM_QSTR(MP_QSTR_CAN), MP_ROM_PTR(&machine_can_type) },
+#define MACHINE_CAN_CLASS      { MP_ROM_QSTR(MP_QSTR_CAN), MP_ROM_PTR(&machine_can_type) }, \
+                               { MP_ROM_QSTR(MP_QSTR_ISOTP), MP_ROM_PTR(&machine_isotp_type) }, \
+                               { MP_ROM_QSTR(MP_QSTR_CANSignals), MP_ROM_PTR(&machine_cansignals_type) },
 #else
 #define MACHINE_CAN_CLASS
 #endif
@@ -80,6 +88,10 @@
 	{ MP_ROM_QSTR(MP_QSTR_Timer),				MP_ROM_PTR(&machine_timer_type) }, \
 	{ MP_ROM_QSTR(MP_QSTR_RTC),					MP_ROM_PTR(&machine_rtc_type) }, \
 	{ MP_ROM_QSTR(MP_QSTR_WDT),					MP_ROM_PTR(&machine_wdt_type) }, \
+	{ MP_ROM_QSTR(MP_QSTR_Counter),				MP_ROM_PTR(&machine_counter_type) }, \
+	{ MP_ROM_QSTR(MP_QSTR_Encoder),				MP_ROM_PTR(&machine_encoder_type) }, \
+	{ MP_ROM_QSTR(MP_QSTR_PortWriter),			MP_ROM_PTR(&machine_portwriter_type) }, \
+	{ MP_ROM_QSTR(MP_QSTR_PortReader),			MP_ROM_PTR(&machine_portreader_type) }, \
 	MACHINE_CAN_CLASS	\
 	MACHINE_ADC_CLASS	\
 	MACHINE_DAC_CLASS 	\
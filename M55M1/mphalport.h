@@ -8,6 +8,11 @@ typedef enum {
 
 NORETURN void mp_hal_raise(HAL_StatusTypeDef status);
 
+// Send the gathered cooked output now
+void mp_hal_stdout_flush(void);
+// System tick interrupt: send the gathered cooked output once it is older than the flush timeout
+void mp_hal_stdout_tick(void);
+
 #if MICROPY_KBD_EXCEPTION
 #include "shared/runtime/interrupt_char.h"
 #else